@@ -12,10 +12,27 @@
 #ifndef CHECKHEADER_SLIB_STREAMER_HEADER
 #define CHECKHEADER_SLIB_STREAMER_HEADER
 
+#include "streamer/buffer.h"
+#include "streamer/packet.h"
+#include "streamer/queue.h"
+#include "streamer/statistics.h"
 #include "streamer/graph.h"
+#include "streamer/station.h"
+#include "streamer/mixer.h"
+#include "streamer/scheduler.h"
+#include "streamer/pcm.h"
+#include "streamer/resampler.h"
 #include "streamer/audio.h"
 #include "streamer/codec.h"
+#include "streamer/encode_service.h"
+#include "streamer/bitrate.h"
+#include "streamer/vad.h"
 #include "streamer/network.h"
+#include "streamer/shared_memory.h"
+#include "streamer/fec.h"
+#include "streamer/aead.h"
 #include "streamer/filters.h"
+#include "streamer/jitter.h"
+#include "streamer/synthetic.h"
 
 #endif
@@ -0,0 +1,87 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CHECKHEADER_SLIB_STREAMER_AEAD
+#define CHECKHEADER_SLIB_STREAMER_AEAD
+
+#include "definition.h"
+
+#include <slib/core/object.h>
+
+/***********************************
+
+- AeadCipher
+Authenticated encryption with associated data, used to protect the
+datagrams with a shared key (see DatagramAeadSendFilter).
+
+AES-GCM (RFC 5288) runs on AES-NI and PCLMULQDQ when the processor
+supports them, and on the constant-time bitsliced implementation
+otherwise, which is several times slower than the accelerated one.
+ChaCha20-Poly1305 (RFC 8439) is the portable choice for the processors
+without the AES instructions.
+
+The nonce is always 12 bytes and must not repeat for one key. The tag
+is 16 bytes, and may be truncated down to 4 bytes; the forgery
+resistance is reduced to the bits kept.
+
+************************************/
+
+#define SLIB_STREAMER_AEAD_NONCE_SIZE 12
+#define SLIB_STREAMER_AEAD_TAG_SIZE 16
+#define SLIB_STREAMER_AEAD_MIN_TAG_SIZE 4
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class AeadCipher : public Object
+		{
+			SLIB_DECLARE_OBJECT
+			
+		public:
+			enum Algorithm {
+				algorithmAES_GCM = 0
+				, algorithmChaCha20_Poly1305 = 1
+			};
+			
+		protected:
+			AeadCipher();
+			
+			~AeadCipher();
+			
+		public:
+			// AES-GCM: 16, 24 or 32 bytes of the key; ChaCha20-Poly1305: 32 bytes of the key
+			static Ref<AeadCipher> create(Algorithm algorithm, const void* key, sl_uint32 sizeKey);
+			
+			// checks the known-answer vectors (GCM test cases 2, 4, 10 and 16 of NIST, and RFC 8439 2.8.2)
+			// on the accelerated and the portable implementations
+			static sl_bool runSelfTest();
+			
+		public:
+			virtual Algorithm getAlgorithm() = 0;
+			
+			// whether the processor instructions are used
+			virtual sl_bool isAccelerated() = 0;
+			
+			// encrypts `size` bytes from `src` to `dst` (may be same), and writes `sizeTag` bytes of the tag
+			virtual void encrypt(const sl_uint8* nonce, const void* aad, sl_size sizeAad, const void* src, void* dst, sl_size size, sl_uint8* tag, sl_uint32 sizeTag) = 0;
+			
+			// verifies the tag first, and then decrypts `size` bytes from `src` to `dst` (may be same)
+			virtual sl_bool decrypt(const sl_uint8* nonce, const void* aad, sl_size sizeAad, const void* src, void* dst, sl_size size, const sl_uint8* tag, sl_uint32 sizeTag) = 0;
+			
+		};
+		
+	}
+	
+}
+
+#endif
@@ -35,10 +35,13 @@ namespace slib
 			SLIB_INLINE AudioRecordSource()
 			{
 				setVolume(1.0f);
+				setStreamId(0);
 			}
 			
 		public:
 			SLIB_PROPERTY(float, Volume);
+			// written to Packet::streamId
+			SLIB_PROPERTY(sl_uint32, StreamId);
 			
 		public:
 			
@@ -54,8 +57,16 @@ namespace slib
 		class AudioPlaySink : public Sink
 		{
 		public:
-			SLIB_INLINE AudioPlaySink() {}
+			SLIB_INLINE AudioPlaySink()
+			{
+				setVolume(1.0f);
+			}
 			
+		public:
+			SLIB_PROPERTY(float, Volume);
+			
+		public:
+			// mono and stereo packets are converted to the channels of the player
 			static Ref<AudioPlaySink> create(const AudioPlaySinkParam& param);
 			
 		};
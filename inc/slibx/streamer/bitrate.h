@@ -0,0 +1,106 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CHECKHEADER_SLIB_STREAMER_BITRATE
+#define CHECKHEADER_SLIB_STREAMER_BITRATE
+
+#include "definition.h"
+
+#include "codec.h"
+#include "network.h"
+
+/***********************************
+
+- AudioBitrateController
+Adapts an AudioOpusEncodeFilter to the path, from the receiver reports
+of NetworkUdpSink (see Feedback in network.h).
+
+The send rate follows the loss: it grows by 8% per report while the
+loss is under `LowLossThreshold`, holds between the thresholds, and is
+cut by half of the loss above `HighLossThreshold`. A round-trip time
+rising well above the lowest one seen (queues building up) cuts the
+rate by 15% before the loss appears.
+
+The redundancy (formatAudio_OPUS_RED) is enabled with the loss, and the
+encoder bitrate is the send rate shared by the primary and the
+redundant frames. The encoder keeps the formatAudio_OPUS_RED framing
+while the redundancy is off (see `Redundancy` in codec.h), so the
+receiver decodes with `RawFormat` = formatAudio_OPUS_RED. At low
+bitrates the frames are made longer, so the packet headers take a
+smaller part of the rate. The reports arrive on
+the sending thread, so the settings are posted to the filter (see
+AudioOpusEncodeFilter::postSettings) and applied by the encoding thread.
+
+************************************/
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class AudioBitrateController : public Object
+		{
+			SLIB_DECLARE_OBJECT
+			
+		protected:
+			AudioBitrateController();
+			
+			~AudioBitrateController();
+			
+		public:
+			static Ref<AudioBitrateController> create(const Ref<AudioOpusEncodeFilter>& filter);
+			
+		public:
+			void onReport(const NetworkUdpReport& report);
+			
+			// for NetworkUdpSink::setReportListener()
+			Function<void(const NetworkUdpReport&)> getReportListener();
+			
+			// bits per second, including the redundancy
+			sl_uint32 getSendRate();
+			
+			// smoothed fraction of the lost packets (0 ~ 1)
+			float getLoss();
+			
+			// milliseconds; negative when unknown
+			sl_int32 getRtt();
+			
+		public:
+			SLIB_PROPERTY(sl_uint32, MinBitrate);
+			SLIB_PROPERTY(sl_uint32, MaxBitrate);
+			// milliseconds
+			SLIB_PROPERTY(sl_uint32, MinFrameDuration);
+			SLIB_PROPERTY(sl_uint32, MaxFrameDuration);
+			SLIB_PROPERTY(float, LowLossThreshold);
+			SLIB_PROPERTY(float, HighLossThreshold);
+			
+		private:
+			sl_uint32 getLossPercentage();
+			
+			sl_uint32 getRedundancy();
+			
+			void apply();
+			
+		private:
+			Ref<AudioOpusEncodeFilter> m_filter;
+			sl_uint32 m_rate;
+			float m_loss;
+			sl_bool m_flagFec;
+			sl_int32 m_rtt;
+			sl_int32 m_rttMin;
+			
+		};
+		
+	}
+	
+}
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CHECKHEADER_SLIB_STREAMER_BUFFER
+#define CHECKHEADER_SLIB_STREAMER_BUFFER
+
+#include "definition.h"
+
+#include <slib/core/object.h>
+#include <slib/core/memory.h>
+
+/***********************************
+
+- PacketBufferPool
+Packet payloads are allocated in size classes (256 bytes ~ 64KB).
+Released buffers are kept in a small per-thread cache first, and then
+in a lock-free global free-list shared by all threads, so the steady
+state of a graph does not call malloc() for the packets.
+
+- PacketBuffer
+Reference-counted payload storage. The header and the payload are
+placed in one pooled block, and the block returns to the pool when
+the last reference is released.
+
+- PacketData
+Payload of a Packet. It refers to a PacketBuffer from the pool, or to
+a Memory for the compatibility with the code producing Memory objects.
+A PacketData is a view (offset + size) over the buffer, so slicing and
+stripping headers do not copy the payload.
+
+- Headroom and tailroom
+Sources reserve free space before and after the payload, and filters
+adding headers or trailers write them in place with prepend()/append().
+Several views can share one buffer, so the buffer remembers the range
+claimed by its views; a view can extend only into the unclaimed space,
+and copies the payload to a new buffer otherwise.
+
+************************************/
+
+#define SLIB_STREAMER_PACKET_HEADROOM 64
+#define SLIB_STREAMER_PACKET_TAILROOM 32
+
+namespace slib
+{
+
+	namespace streamer
+	{
+
+		struct PacketBufferPoolStatistics
+		{
+			sl_uint64 countHits; // served from the per-thread cache or the global free-list
+			sl_uint64 countMisses; // served by the system allocator
+			sl_uint64 countOversized; // larger than the biggest size class, never pooled
+			sl_uint64 sizeAllocated; // bytes allocated from the system for the pooled blocks
+		};
+
+		class PacketBufferPool
+		{
+		public:
+			// returns the pointer to the usable memory, which is at least `size` bytes
+			static void* allocate(sl_size size, sl_size* pOutCapacity = sl_null);
+
+			static void free(void* ptr);
+
+			static void getStatistics(PacketBufferPoolStatistics& _out);
+
+			// returns the blocks cached by the calling thread to the global free-list
+			static void flushThreadCache();
+
+		};
+
+		class PacketBuffer : public Referable
+		{
+		private:
+			PacketBuffer(sl_size capacity, sl_size offset, sl_size size);
+
+			~PacketBuffer();
+
+		public:
+			// the range [headroom, headroom + size) is claimed by the first view
+			static Ref<PacketBuffer> create(sl_size size, sl_size headroom = 0, sl_size tailroom = 0);
+
+			static Ref<PacketBuffer> create(const void* data, sl_size size);
+
+		public:
+			SLIB_INLINE sl_uint8* getData()
+			{
+				return m_data;
+			}
+
+			SLIB_INLINE sl_size getCapacity()
+			{
+				return m_capacity;
+			}
+
+			// extends the claimed range to [offset - size, ...), only when `offset` is the current front of the range
+			sl_bool claimFront(sl_size offset, sl_size size);
+
+			// extends the claimed range to [..., offset + size), only when `offset` is the current back of the range
+			sl_bool claimBack(sl_size offset, sl_size size);
+
+		public:
+			// create() allocates the block from the pool, and constructs the object at its front
+			static void* operator new(size_t sizeObject, void* place) throw();
+
+			static void operator delete(void* ptr);
+
+			static void operator delete(void* ptr, void* place);
+
+		private:
+			sl_uint8* m_data;
+			sl_size m_capacity;
+			sl_reg m_claimFront;
+			sl_reg m_claimBack;
+
+			friend class PacketData;
+
+		};
+
+		class PacketData
+		{
+		public:
+			PacketData();
+
+			PacketData(const PacketData& other);
+
+			PacketData(const Memory& mem);
+
+			PacketData(const Ref<PacketBuffer>& buffer, sl_size size);
+
+			PacketData(const Ref<PacketBuffer>& buffer, sl_size offset, sl_size size);
+
+			~PacketData();
+
+		public:
+			PacketData& operator=(const PacketData& other);
+
+			PacketData& operator=(const Memory& mem);
+
+		public:
+			SLIB_INLINE void* getData() const
+			{
+				return m_data;
+			}
+
+			SLIB_INLINE sl_size getSize() const
+			{
+				return m_size;
+			}
+
+			SLIB_INLINE sl_bool isNull() const
+			{
+				return m_data == sl_null;
+			}
+
+			SLIB_INLINE sl_bool isNotNull() const
+			{
+				return m_data != sl_null;
+			}
+
+			SLIB_INLINE sl_bool isEmpty() const
+			{
+				return m_size == 0;
+			}
+
+			SLIB_INLINE sl_bool isNotEmpty() const
+			{
+				return m_size != 0;
+			}
+
+			SLIB_INLINE const Ref<PacketBuffer>& getBuffer() const
+			{
+				return m_buffer;
+			}
+
+			void setNull();
+
+			// allocates new payload from the pool
+			sl_bool allocate(sl_size size, sl_size headroom = 0, sl_size tailroom = 0);
+
+			// copies the content into new payload from the pool
+			sl_bool copyFrom(const void* data, sl_size size, sl_size headroom = 0, sl_size tailroom = 0);
+
+			sl_size getHeadroom() const;
+
+			sl_size getTailroom() const;
+
+			// zero-copy view of the part of the payload
+			PacketData sub(sl_size offset, sl_size size = SLIB_SIZE_MAX) const;
+
+			// extends the payload to the front, and returns the pointer to the new bytes
+			sl_uint8* prepend(sl_size size);
+
+			// extends the payload to the back, and returns the pointer to the new bytes
+			sl_uint8* append(sl_size size);
+
+			// strips the bytes from the front without copying
+			sl_bool removeFront(sl_size size);
+
+			// strips the bytes from the back without copying
+			sl_bool removeBack(sl_size size);
+
+			// does not copy when the payload is already a Memory
+			Memory getMemory() const;
+
+			SLIB_INLINE operator Memory() const
+			{
+				return getMemory();
+			}
+
+		private:
+			Ref<PacketBuffer> m_buffer;
+			Memory m_memory;
+			sl_uint8* m_data;
+			sl_size m_size;
+
+		};
+
+	}
+
+}
+
+#endif
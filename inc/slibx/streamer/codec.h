@@ -16,6 +16,40 @@
 #include "graph.h"
 
 #include <slib/media/codec_opus.h>
+#include <slib/core/spin_lock.h>
+
+/***********************************
+
+- Loss recovery
+Opus frames are small, so instead of re-sending whole datagrams the
+encoder can repeat the previous frames inside the following packets
+(formatAudio_OPUS_RED, RFC 2198 style redundancy):
+
+	[count:1] { [distance:1] [size:2 LE] [frame] } x count [primary frame]
+
+`distance` is the sequence distance back from the primary frame. The
+encoder numbers its frames by itself, so the input packets may be
+re-framed to `FrameDuration` at runtime (see AudioBitrateController).
+AudioOpusDecodeFilter conceals a frame released with Packet::flagLost
+(JitterBufferFilter) at once, at its playout time. The jitter buffer
+attaches the next packet to the lost one when it is already buffered,
+so the redundant copy at distance 1 is decoded instead of running the
+packet-loss concealment. Without a jitter buffer, the gaps of
+Packet::sequence are concealed when the next packet arrives, from its
+redundant copies when available.
+
+The receiver parses the packets by their format (or `RawFormat` for
+formatRaw), so the framing must not change while streaming: with
+`Redundancy` (set by AudioBitrateController) every packet is framed as
+formatAudio_OPUS_RED, carrying no redundant frame while FecPercentage
+is 0.
+
+With `Dtx`, the frames marked by VoiceActivityFilter are skipped (see
+vad.h), and the gaps following a silent frame are not concealed.
+
+************************************/
+
+#define SLIB_STREAMER_OPUS_MAX_REDUNDANCY 3
 
 namespace slib
 {
@@ -23,18 +57,90 @@ namespace slib
 	namespace streamer
 	{
 	
+		struct AudioOpusEncodeSettings
+		{
+			// 0 keeps the bitrate of the encoder
+			sl_uint32 bitrate;
+			sl_uint32 fecPercentage;
+			sl_uint32 expectedLossPercentage;
+			sl_uint32 frameDuration;
+		};
+		
 		class AudioOpusEncodeFilter : public Filter
 		{
 		public:
 			SLIB_INLINE AudioOpusEncodeFilter(const Ref<OpusEncoder>& encoder)
 			{
 				m_encoder = encoder;
+				setFecPercentage(0);
+				setRedundancy(sl_false);
+				setExpectedLossPercentage(0);
+				setFrameDuration(0);
+				setDtx(sl_false);
+				setDtxInterval(400);
+				m_fecCredit = 0;
+				m_indexHistory = 0;
+				m_sequence = 0;
+				m_nBuffered = 0;
+				m_flagSilence = sl_false;
+				m_durationSilence = 0;
+				m_flagSettingsPosted = 0;
+			}
+			
+			using Filter::filter;
+			
+			void filter(const Packet& input, PacketEmitter& emitter);
+			
+			SLIB_INLINE const Ref<OpusEncoder>& getEncoder()
+			{
+				return m_encoder;
 			}
 			
-			List<Packet> filter(const Packet& input);
+			// may be called on any thread; the encoding thread applies the last posted settings before the next input packet
+			void postSettings(const AudioOpusEncodeSettings& settings);
+			
+		public:
+			// percentage of the packets carrying the redundant copies of the previous frames; 0 disables the redundancy
+			SLIB_PROPERTY(sl_uint32, FecPercentage);
+			
+			// frames every packet as formatAudio_OPUS_RED, also the packets without a redundant copy, so FecPercentage may change while streaming
+			SLIB_PROPERTY(sl_bool, Redundancy);
+			
+			// one more previous frame is carried per 10% of the expected loss, up to SLIB_STREAMER_OPUS_MAX_REDUNDANCY frames
+			SLIB_PROPERTY(sl_uint32, ExpectedLossPercentage);
+			
+			// milliseconds of the encoded frames (10, 20, 40 or 60); 0 encodes every input packet as one frame
+			SLIB_PROPERTY(sl_uint32, FrameDuration);
+			
+			// skips the frames marked with Packet::flagSilence
+			SLIB_PROPERTY(sl_bool, Dtx);
+			
+			// milliseconds between the silent frames still sent to refresh the background noise; 0 sends only the first one
+			SLIB_PROPERTY(sl_uint32, DtxInterval);
+			
+		private:
+			void encodeFrame(OpusEncoder* encoder, const sl_int16* samples, sl_uint32 count, const Packet& metadata, PacketEmitter& emitter);
 			
 		private:
 			Ref<OpusEncoder> m_encoder;
+			sl_uint32 m_fecCredit;
+			// the last encoded frames, indexed by `m_indexHistory`
+			Memory m_history[SLIB_STREAMER_OPUS_MAX_REDUNDANCY];
+			sl_uint64 m_sequencesHistory[SLIB_STREAMER_OPUS_MAX_REDUNDANCY];
+			sl_uint32 m_indexHistory;
+			// sequence of the encoded frames
+			sl_uint64 m_sequence;
+			// samples waiting for a frame of `FrameDuration`, and the metadata of the first one
+			Memory m_bufferFrame;
+			sl_uint32 m_nBuffered;
+			Packet m_packetBuffered;
+			// in the silence, and the milliseconds since the last sent frame
+			sl_bool m_flagSilence;
+			sl_uint32 m_durationSilence;
+			// posted by postSettings()
+			SpinLock m_lockSettings;
+			AudioOpusEncodeSettings m_settingsPosted;
+			sl_int32 m_flagSettingsPosted;
 		};
 		
 		class AudioOpusDecodeFilter : public Filter
@@ -43,16 +149,47 @@ namespace slib
 			SLIB_INLINE AudioOpusDecodeFilter(const Ref<OpusDecoder>& decoder)
 			{
 				m_decoder = decoder;
-				setMaxSamplesPerFrame(1600);
+				setMaxSamplesPerFrame(5760);
+				setLossConcealment(sl_true);
+				setMaxConcealedFrames(5);
+				setRawFormat(Packet::formatAudio_OPUS);
+				m_flagSequence = sl_false;
+				m_sequenceNext = 0;
+				m_nSamplesLastFrame = 0;
+				m_flagSilence = sl_false;
 			}
 			
-			List<Packet> filter(const Packet& input);
+			using Filter::filter;
+			
+			void filter(const Packet& input, PacketEmitter& emitter);
 			
 		public:
+			// samples per channel of the longest frame; the default is 120ms (the longest Opus frame) at 48kHz
 			SLIB_PROPERTY(sl_uint32, MaxSamplesPerFrame);
 			
+			// decodes the redundant frames or synthesizes the lost frames
+			SLIB_PROPERTY(sl_bool, LossConcealment);
+			
+			// longer gaps are not concealed
+			SLIB_PROPERTY(sl_uint32, MaxConcealedFrames);
+			
+			// format of the formatRaw packets received from the network
+			SLIB_PROPERTY(Packet::Format, RawFormat);
+			
+		private:
+			// decodes `size` bytes, or conceals one frame when `data` is null
+			void decodeFrame(const void* data, sl_uint32 size, const Packet& input, sl_uint64 sequence, sl_bool flagConcealed, PacketEmitter& emitter);
+			
+			// conceals the frame released as lost by JitterBufferFilter
+			void concealLostFrame(const Packet& input, PacketEmitter& emitter);
+			
 		private:
 			Ref<OpusDecoder> m_decoder;
+			sl_bool m_flagSequence;
+			sl_uint64 m_sequenceNext;
+			sl_uint32 m_nSamplesLastFrame;
+			// the last frame is silent, so a gap is skipped by the sender
+			sl_bool m_flagSilence;
 			
 		};
 		
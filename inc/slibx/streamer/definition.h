@@ -13,4 +13,9 @@
 
 #include <slib/core/definition.h>
 
+// define SLIB_STREAMER_NO_STATISTICS to remove the instrumentation of the graphs from the build
+#ifndef SLIB_STREAMER_NO_STATISTICS
+#define SLIB_STREAMER_SUPPORT_STATISTICS
+#endif
+
 #endif
@@ -0,0 +1,136 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CHECKHEADER_SLIB_STREAMER_ENCODE_SERVICE
+#define CHECKHEADER_SLIB_STREAMER_ENCODE_SERVICE
+
+#include "definition.h"
+
+#include "codec.h"
+
+#include <slib/core/spin_lock.h>
+
+/***********************************
+
+- OpusEncodeService
+Encodes the audio of many streams (conference rooms, transcoding) on a
+fixed pool of worker threads, instead of encoding every stream on the
+thread of its own graph.
+
+Every stream is bound to one worker for its lifetime, so the state of
+its encoder stays in the cache of one core and its frames are encoded
+in the order of the submission. The workers take all the queued frames
+at once, link the frames of each stream in one pass, and encode the
+frames of the same stream back to back. The job storage is reused
+between the batches and grown out of the submission lock.
+
+The encoded packets (formatAudio_OPUS, or formatAudio_OPUS_RED when the
+redundancy is enabled) are returned through the completion callback of
+the stream, called on the worker thread.
+
+- OpusEncodeStream
+A Sink submitting the packets to the service, so it can terminate a
+Graph directly. sendPacket() does not wait for the encoding, and fails
+when `MaxQueuedFrames` frames of the stream are already waiting.
+
+************************************/
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class OpusEncodeService;
+		class _OpusEncodeServiceWorker;
+		
+		class OpusEncodeStream : public Sink
+		{
+			SLIB_DECLARE_OBJECT
+			
+		protected:
+			OpusEncodeStream(const Ref<OpusEncoder>& encoder);
+			
+			~OpusEncodeStream();
+			
+		public:
+			// override
+			sl_bool sendPacket(const Packet& packet);
+			
+			// the redundancy settings of the stream
+			const Ref<AudioOpusEncodeFilter>& getFilter();
+			
+			sl_bool isRemoved();
+			
+			sl_uint64 getEncodedCount();
+			
+			sl_uint64 getDroppedCount();
+			
+		public:
+			// frames waiting for the encoding; further submissions fail
+			SLIB_PROPERTY(sl_uint32, MaxQueuedFrames);
+			
+		private:
+			void encode(const Packet& input, PacketVector& output);
+			
+		private:
+			Ref<AudioOpusEncodeFilter> m_filter;
+			Function<void(const Packet&)> m_callback;
+			WeakRef<_OpusEncodeServiceWorker> m_worker;
+			sl_int32 m_flagRemoved;
+			sl_int32 m_countQueued;
+			sl_int64 m_countEncoded;
+			sl_int64 m_countDropped;
+			// the jobs of the stream in the batch of the worker, accessed only by the worker
+			sl_size m_jobFirst;
+			sl_size m_jobLast;
+			
+			friend class OpusEncodeService;
+			
+		};
+		
+		class OpusEncodeService : public Object
+		{
+			SLIB_DECLARE_OBJECT
+			
+		protected:
+			OpusEncodeService();
+			
+			~OpusEncodeService();
+			
+		public:
+			// nThreads = 0: the number of the processors
+			static Ref<OpusEncodeService> create(sl_uint32 nThreads = 0, sl_bool flagPinThreads = sl_false);
+			
+		public:
+			// `callback` receives the encoded packets on the worker thread; `worker` < 0 selects the least loaded worker
+			Ref<OpusEncodeStream> addStream(const Ref<OpusEncoder>& encoder, const Function<void(const Packet&)>& callback, sl_int32 worker = -1);
+			
+			// the frames already queued for the stream are discarded
+			void removeStream(const Ref<OpusEncodeStream>& stream);
+			
+			void release();
+			
+			sl_uint32 getThreadsCount();
+			
+		private:
+			static void runWorker(Ref<_OpusEncodeServiceWorker> worker, sl_bool flagPin);
+			
+		private:
+			Array< Ref<_OpusEncodeServiceWorker> > m_workers;
+			sl_bool m_flagReleased;
+			
+		};
+		
+	}
+	
+}
+
+#endif
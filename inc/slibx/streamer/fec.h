@@ -0,0 +1,100 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#ifndef CHECKHEADER_SLIB_STREAMER_FEC
+#define CHECKHEADER_SLIB_STREAMER_FEC
+
+#include "definition.h"
+
+/***********************************
+
+- GaloisField256
+Arithmetic over GF(2^8) (polynomial 0x11D). The bulk operations use
+PSHUFB (SSSE3/AVX2) or TBL (NEON) nibble tables when the processor
+supports them.
+
+- ReedSolomonCode
+Systematic erasure code of k data symbols and m parity symbols based on
+a Cauchy matrix, so any k of the k + m symbols recover the data.
+The first parity row is normalized to all ones, so the first parity is
+the plain XOR of the data symbols.
+
+************************************/
+
+#define SLIB_STREAMER_FEC_MAX_DATA 64
+#define SLIB_STREAMER_FEC_MAX_PARITY 16
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class GaloisField256
+		{
+		public:
+			static sl_uint8 multiply(sl_uint8 a, sl_uint8 b);
+			
+			static sl_uint8 inverse(sl_uint8 a);
+			
+			// dst[i] ^= c * src[i]
+			static void multiplyAdd(sl_uint8* dst, const sl_uint8* src, sl_uint8 c, sl_size size);
+			
+			// dst[i] ^= src[i]
+			static void add(sl_uint8* dst, const sl_uint8* src, sl_size size);
+			
+			// inverts the n x n matrix (row-major) in place
+			static sl_bool invertMatrix(sl_uint8* matrix, sl_uint32 n);
+			
+		};
+		
+		class ReedSolomonCode
+		{
+		public:
+			ReedSolomonCode();
+			
+		public:
+			sl_bool initialize(sl_uint32 nData, sl_uint32 nParity);
+			
+			SLIB_INLINE sl_uint32 getDataCount() const
+			{
+				return m_nData;
+			}
+			
+			SLIB_INLINE sl_uint32 getParityCount() const
+			{
+				return m_nParity;
+			}
+			
+			SLIB_INLINE sl_uint8 getCoefficient(sl_uint32 row, sl_uint32 col) const
+			{
+				return m_matrix[row * SLIB_STREAMER_FEC_MAX_DATA + col];
+			}
+			
+			// parity[row] ^= coefficient * data[col]
+			void encode(sl_uint8* parity, sl_uint32 row, const sl_uint8* data, sl_uint32 col, sl_size size) const;
+			
+			// computes the matrix turning the syndromes of the given parity rows into the missing data symbols
+			// `outMatrix`: n x n, where n is the count of the missing columns
+			sl_bool getRecoveryMatrix(const sl_uint32* missingColumns, const sl_uint32* parityRows, sl_uint32 n, sl_uint8* outMatrix) const;
+			
+		private:
+			sl_uint32 m_nData;
+			sl_uint32 m_nParity;
+			sl_uint8 m_matrix[SLIB_STREAMER_FEC_MAX_PARITY * SLIB_STREAMER_FEC_MAX_DATA];
+			
+		};
+		
+	}
+	
+}
+
+#endif
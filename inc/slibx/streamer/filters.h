@@ -14,6 +14,8 @@
 #include "definition.h"
 
 #include "graph.h"
+#include "fec.h"
+#include "aead.h"
 
 namespace slib
 {
@@ -27,7 +29,9 @@ namespace slib
 			DatagramHashSHA256SendFilter() {}
 			~DatagramHashSHA256SendFilter() {}
 			
-			List<Packet> filter(const Packet& input);
+			using Filter::filter;
+			
+			void filter(const Packet& input, PacketEmitter& emitter);
 		};
 		
 		class DatagramHashSHA256ReceiveFilter : public Filter
@@ -36,7 +40,192 @@ namespace slib
 			DatagramHashSHA256ReceiveFilter() {}
 			~DatagramHashSHA256ReceiveFilter() {}
 			
-			List<Packet> filter(const Packet& input);
+			using Filter::filter;
+			
+			void filter(const Packet& input, PacketEmitter& emitter);
+		};
+		
+		/*
+			Keyed replacement of the SHA-256 filters. The datagram is `[epoch: 4 BE] [counter: 8 BE] [ciphertext] [tag: TagSize]`,
+			and the header is the nonce of the packet, authenticated with the payload. The epoch is the start time of the
+			sender in seconds, and the counter starts from a random value.
+			The header and the tag are written in the headroom and the tailroom, and the payload is encrypted in place
+			unless its buffer is shared with other packets. The receiver drops the replayed counters within an epoch and
+			the packets of the older epochs. An authenticated packet of a newer epoch (a restarted sender) resets the
+			replay window, so a sender restarted within the same second, or with its clock set back, is not accepted
+			until its epoch passes the previous one.
+			Both sides should use the same `TagSize`, and each direction should use its own key.
+		*/
+		class DatagramAeadSendFilter : public Filter
+		{
+		public:
+			DatagramAeadSendFilter(const Ref<AeadCipher>& cipher);
+			~DatagramAeadSendFilter();
+			
+			using Filter::filter;
+			
+			void filter(const Packet& input, PacketEmitter& emitter);
+			
+		public:
+			// bytes of the tag (4 ~ 16)
+			SLIB_PROPERTY(sl_uint32, TagSize);
+			
+		private:
+			Ref<AeadCipher> m_cipher;
+			sl_uint32 m_epoch;
+			sl_uint64 m_counter;
+		};
+		
+		class DatagramAeadReceiveFilter : public Filter
+		{
+		public:
+			DatagramAeadReceiveFilter(const Ref<AeadCipher>& cipher);
+			~DatagramAeadReceiveFilter();
+			
+			using Filter::filter;
+			
+			void filter(const Packet& input, PacketEmitter& emitter);
+			
+		public:
+			// bytes of the tag (4 ~ 16)
+			SLIB_PROPERTY(sl_uint32, TagSize);
+			
+		private:
+			Ref<AeadCipher> m_cipher;
+			sl_bool m_flagReceived;
+			sl_uint32 m_epoch;
+			sl_uint64 m_counterLast;
+			// bit n: `m_counterLast - n` was received
+			sl_uint64 m_maskReceived;
+		};
+		
+		// carries the timestamp, the sequence, the stream id and the flags of the packet in a compact header (2 ~ 20 bytes)
+		class DatagramMetadataSendFilter : public Filter
+		{
+		public:
+			DatagramMetadataSendFilter() {}
+			~DatagramMetadataSendFilter() {}
+			
+			using Filter::filter;
+			
+			void filter(const Packet& input, PacketEmitter& emitter);
+		};
+		
+		/*
+			The timestamp on the wire is on the monotonic clock of the sender, which has no relation
+			to the local clock. It is converted to the local clock with the smallest difference between
+			the arrival time and the sender timestamp seen in the last 10 ~ 20 seconds, so the converted
+			timestamp never exceeds the arrival time. The ages measured from it exclude the base delay
+			of the link and count only the delay above it (queueing, jitter, processing).
+		*/
+		class DatagramSenderClock
+		{
+		public:
+			DatagramSenderClock();
+			
+		public:
+			// `arrival` is the local arrival time, or 0 for now
+			sl_int64 convert(sl_int64 timestamp, sl_int64 arrival);
+			
+		private:
+			sl_bool m_flagOffset;
+			// smallest `arrival - sender timestamp` of the current and the previous windows
+			sl_int64 m_offsetWindow;
+			sl_int64 m_offsetPrevious;
+			sl_int64 m_timeWindow;
+		};
+		
+		// converts the timestamp by DatagramSenderClock, and marks the packet with Packet::flagSenderTime
+		class DatagramMetadataReceiveFilter : public Filter
+		{
+		public:
+			DatagramMetadataReceiveFilter();
+			~DatagramMetadataReceiveFilter();
+			
+			using Filter::filter;
+			
+			void filter(const Packet& input, PacketEmitter& emitter);
+			
+		private:
+			DatagramSenderClock m_clock;
+		};
+		
+		/*
+			Packet-level FEC. The data packets are sent at once with a small header, and every
+			`nData` data packets are followed by `nParity` parity packets (XOR parity when `nParity` is 1),
+			so any `nData` packets of a block recover the block.
+			With `interleave` > 1, consecutive packets are spread over `interleave` blocks,
+			so a burst of up to `interleave * nParity` lost packets is recovered.
+			The metadata (see Packet::writeMetadata()) is sent and protected with the payload,
+			so the received and the recovered packets have the sequence, the stream id and the flags
+			of the sender. The sender timestamp is converted as DatagramMetadataReceiveFilter does
+			(Packet::flagSenderTime), and the packets without one have the local arrival time.
+			The recovered packets are marked with `flagConcealed`.
+			The receiver keeps the last 32 blocks. The data packets of an older block are still passed
+			(without the recovery), and a block id going back by more than the window restarts the
+			receiver, as the restarted sender numbers the blocks from 0 again.
+		*/
+		class DatagramFecSendFilter : public Filter
+		{
+		public:
+			DatagramFecSendFilter(sl_uint32 nData = 4, sl_uint32 nParity = 1, sl_uint32 interleave = 1, sl_uint32 maxPacketSize = 2000);
+			~DatagramFecSendFilter();
+			
+			using Filter::filter;
+			
+			void filter(const Packet& input, PacketEmitter& emitter);
+			
+		private:
+			void emitParity(sl_uint32 indexBlock, const Packet& input, PacketEmitter& emitter);
+			
+		private:
+			struct Block {
+				sl_uint32 id;
+				sl_size sizeSymbol;
+				PacketData data[SLIB_STREAMER_FEC_MAX_DATA];
+			};
+			ReedSolomonCode m_code;
+			Block* m_blocks;
+			sl_uint32 m_interleave;
+			sl_uint32 m_maxPacketSize;
+			sl_uint32 m_position;
+			sl_uint32 m_idGroup;
+		};
+		
+		class DatagramFecReceiveFilter : public Filter
+		{
+		public:
+			DatagramFecReceiveFilter(sl_uint32 maxPacketSize = 2000);
+			~DatagramFecReceiveFilter();
+			
+			using Filter::filter;
+			
+			void filter(const Packet& input, PacketEmitter& emitter);
+			
+		private:
+			struct Block {
+				sl_bool flagUsed;
+				sl_bool flagDone;
+				sl_uint32 id;
+				sl_uint32 nData;
+				sl_uint32 nParity;
+				sl_uint64 maskData;
+				sl_uint32 maskParity;
+				PacketData data[SLIB_STREAMER_FEC_MAX_DATA];
+				PacketData parity[SLIB_STREAMER_FEC_MAX_PARITY];
+			};
+			
+			void recover(Block* block, const Packet& input, PacketEmitter& emitter);
+			
+		private:
+			void setTimestamp(Packet& output, const Packet& input);
+			
+		private:
+			ReedSolomonCode m_code;
+			Block* m_blocks;
+			Memory m_bufferSyndromes;
+			sl_uint32 m_maxPacketSize;
+			DatagramSenderClock m_clock;
 		};
 		
 		class DatagramErrorCorrectionSendFilter : public Filter
@@ -45,14 +234,20 @@ namespace slib
 			DatagramErrorCorrectionSendFilter(sl_uint32 level = 1, sl_uint32 maxPacketSize = 2000);
 			~DatagramErrorCorrectionSendFilter();
 			
-			List<Packet> filter(const Packet& input);
+			using Filter::filter;
+			
+			void filter(const Packet& input, PacketEmitter& emitter);
 			
 		private:
-			struct SendPacket {
+			// ring of the last `level + 1` packets; the payloads are shared, not copied
+			struct Slot {
 				sl_uint64 num;
-				Memory mem;
+				PacketData data;
 			};
-			Queue<SendPacket> m_packetsSend;
+			Slot* m_slots;
+			sl_uint32 m_countSlots;
+			sl_uint32 m_countFilled;
+			sl_uint32 m_indexNextSlot;
 			sl_uint64 m_lastSentPacketNumber;
 			sl_uint32 m_level;
 			sl_uint32 m_maxPacketSize;
@@ -64,10 +259,14 @@ namespace slib
 			DatagramErrorCorrectionReceiveFilter(sl_uint32 maxPacketSize = 2000);
 			~DatagramErrorCorrectionReceiveFilter();
 			
-			List<Packet> filter(const Packet& input);
+			using Filter::filter;
+			
+			void filter(const Packet& input, PacketEmitter& emitter);
 			
 		private:
 			sl_uint64 m_lastReceivedPacketNumber;
+			// bit `i` is set when the packet `m_lastReceivedPacketNumber - i` is received
+			sl_uint64 m_maskReceived;
 			sl_uint32 m_maxPacketSize;
 		};
 		
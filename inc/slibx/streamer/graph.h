@@ -14,10 +14,16 @@
 
 #include "definition.h"
 
+#include "packet.h"
+#include "queue.h"
+#include "statistics.h"
+
 #include <slib/core/object.h>
 #include <slib/core/memory.h>
+#include <slib/core/array.h>
 #include <slib/core/queue.h>
 #include <slib/core/thread.h>
+#include <slib/core/spin_lock.h>
 
 /***********************************
 
@@ -36,6 +42,25 @@ Station provides linked sink and sources.
 	                \
 					 -> Source3
 
+- Pipelined Graph
+When pipelined mode is enabled, the filter chain is split into stages.
+Every stage runs on its own worker thread and receives packets from the
+previous stage through a bounded lock-free PacketQueue.
+
+	Source -> [Queue] -> Stage1 -> [Queue] -> Stage2 -> ... -> Sink
+
+By default every filter is a stage and the sink runs on the last stage.
+Call addStageBreak() between addFilter() calls to group filters manually.
+
+- Timers
+Filters releasing the packets by the time (such as JitterBufferFilter)
+and sinks buffering the packets return a non-zero getTimerInterval().
+The graph then calls Filter::process() and Sink::flush() at the shortest
+of the intervals while no packet is arriving, from its own thread, from
+the stage threads in pipelined mode, or from the GraphScheduler workers
+(at PollInterval granularity). The packets released by process() pass
+through the following filters to the sink. The intervals are read when
+the graph is started or added to a scheduler.
 
 ************************************/
 
@@ -45,31 +70,6 @@ namespace slib
 	namespace streamer
 	{
 
-		struct Packet
-		{
-			enum Format {
-				formatRaw = 0
-				, formatAudio_PCM_S16 = 10
-				, formatAudio_OPUS = 11
-			};
-			Format format;
-
-			struct AudioParam
-			{
-				sl_uint32 nSamplesPerSecond;
-				sl_uint32 nChannels;
-			};
-			AudioParam audioParam;
-			struct NetworkParam
-			{
-				String addressFrom;
-				String addressTo;
-			};
-			NetworkParam networkParam;
-
-			Memory data;
-		};
-
 		class Source : public Object
 		{
 			SLIB_DECLARE_OBJECT
@@ -84,6 +84,30 @@ namespace slib
 			
 			virtual sl_bool receivePacket(Packet* out) = 0;
 
+			// returns sl_true when the source calls notifyPacketReady() whenever new packets are available
+			virtual sl_bool isReadyListenerSupported();
+
+			// the listener is invoked by notifyPacketReady(), and is used by GraphScheduler instead of waiting for the event
+			virtual void setReadyListener(const Function<void()>& listener);
+
+			/*
+				Returns the descriptor (file descriptor on Linux) which becomes readable when receivePacket()
+				may return new packets, or -1 when not supported. After a descriptor is returned, the source
+				receives the packets in receivePacket() on the calling threads instead of its own thread, and
+				the caller watches the descriptor in edge-triggered mode until detachPoller() is called.
+			*/
+			virtual sl_int64 attachPoller();
+
+			virtual void detachPoller();
+
+		protected:
+			// sets the event and invokes the ready listener
+			void notifyPacketReady();
+
+		private:
+			Function<void()> m_listenerReady;
+			SpinLock m_lockListenerReady;
+
 		};
 
 		class Sink : public Object
@@ -98,8 +122,72 @@ namespace slib
 		public:
 			virtual sl_bool sendPacket(const Packet& packet) = 0;
 			
+			// called after the packets for one input packet are sent, for the sinks buffering the packets, and by the timer
+			virtual void flush();
+			
+			// milliseconds between the timer calls of flush(), or 0 when the timer is not needed
+			virtual sl_uint32 getTimerInterval();
+			
 		};
 
+		class PacketEmitter
+		{
+		public:
+			virtual void emit(const Packet& packet) = 0;
+			
+		};
+		
+		// growable packet array keeping its storage between uses
+		class PacketVector : public PacketEmitter
+		{
+		public:
+			PacketVector();
+			
+			~PacketVector();
+			
+		public:
+			// override
+			void emit(const Packet& packet);
+			
+			sl_bool add(const Packet& packet);
+			
+			// releases the packets, but keeps the storage
+			void clear();
+			
+			SLIB_INLINE sl_size getCount()
+			{
+				return m_count;
+			}
+			
+			SLIB_INLINE Packet* getData()
+			{
+				return m_data;
+			}
+			
+			SLIB_INLINE Packet& operator[](sl_size index)
+			{
+				return m_data[index];
+			}
+			
+		private:
+			PacketVector(const PacketVector& other);
+			PacketVector& operator=(const PacketVector& other);
+			
+		private:
+			Packet* m_data;
+			sl_size m_count;
+			sl_size m_capacity;
+			
+		};
+
+		/*
+			Filters override one of two filter() methods.
+			The push-style one writes the outputs into the emitter and does not need
+			any allocation for the output list. Each default implementation adapts to the other,
+			and a filter overriding neither produces no output (the error is logged).
+			The derived filters declare `using Filter::filter;`, so overriding one of them does
+			not hide the other.
+		*/
 		class Filter : public Object
 		{
 			SLIB_DECLARE_OBJECT
@@ -110,10 +198,30 @@ namespace slib
 			~Filter();
 			
 		public:
-			virtual List<Packet> filter(const Packet& input) = 0;
+			virtual List<Packet> filter(const Packet& input);
+			
+			virtual void filter(const Packet& input, PacketEmitter& output);
+			
+			// called by the timer of the graph, and releases the packets whose time has come
+			virtual void process(PacketEmitter& output);
+			
+			// milliseconds between the timer calls of process(), or 0 when the timer is not needed
+			virtual sl_uint32 getTimerInterval();
 			
 		};
 
+		class _GraphStage;
+		class _GraphStatisticsBlock;
+
+		struct GraphStageStatus
+		{
+			sl_uint32 filtersCount;
+			sl_bool flagSink;
+			sl_uint32 queueDepth;
+			sl_uint32 queueCapacity;
+			sl_uint64 countDroppedPackets;
+		};
+
 		class Graph : public Object
 		{
 			SLIB_DECLARE_OBJECT
@@ -132,9 +240,50 @@ namespace slib
 
 			virtual void feedPacket(const Packet& packet);
 
+			// receives and feeds up to `nMaxPackets` packets from the source without waiting, and returns the count
+			sl_uint32 processSourcePackets(sl_uint32 nMaxPackets);
+
+			// runs the timers of the filters and the sink when the timer interval has passed since the last run
+			void processTimers();
+
+			// the shortest timer interval of the filters and the sink in milliseconds, or 0 when no timer is needed
+			sl_uint32 getTimerInterval();
+
+			// valid while the graph is running in pipelined mode
+			List<GraphStageStatus> getStageStatus();
+
+			// counters recorded while StatisticsEnabled is set; always empty when built with SLIB_STREAMER_NO_STATISTICS
+			List<GraphNodeStatistics> getStatistics();
+
 		protected:
 			virtual void run();
 
+			// runs the packet through the filters using the two scratch vectors, and returns the one holding the outputs
+			PacketVector* processFilters(const Ref<Filter>* filters, sl_size nFilters, const Packet& packet, PacketVector* buffers, sl_size indexFirstFilter = 0);
+
+			// calls process() of the filters, runs the released packets through the following filters, and adds the outputs to `outputs`
+			void processFilterTimers(const Ref<Filter>* filters, sl_size nFilters, PacketVector* buffers, PacketVector& released, PacketVector& outputs, sl_size indexFirstFilter = 0);
+
+		private:
+			sl_bool startStages();
+
+			void releaseStages();
+
+			void runStage(Ref<_GraphStage> stage);
+
+			void processStageTimers(_GraphStage* stage);
+
+			void sendStageOutputs(_GraphStage* stage, PacketVector& outputs);
+
+			void startTimers();
+
+			void sendOutputs(Sink* sink, PacketVector& outputs);
+
+			// returns the counters of the calling thread, or null when the statistics are disabled
+			_GraphStatisticsBlock* getStatisticsBlock();
+
+			friend class GraphScheduler;
+
 		public:
 			SLIB_INLINE Ref<Source> getSource()
 			{
@@ -158,23 +307,45 @@ namespace slib
 			{
 				return m_filters;
 			}
-			SLIB_INLINE void addFilter(const Ref<Filter>& filter)
-			{
-				if (filter.isNotNull()) {
-					m_filters.add(filter);
-				}
-			}
+			void addFilter(const Ref<Filter>& filter);
+
+			// following filters run on a new worker thread in pipelined mode
+			void addStageBreak();
 
 			SLIB_INLINE Ref<Thread> getThread()
 			{
 				return m_thread;
 			}
 
+		public:
+			SLIB_PROPERTY(sl_bool, Pipelined);
+			SLIB_PROPERTY(sl_uint32, StageQueueSize);
+			SLIB_PROPERTY(PacketQueue::OverflowPolicy, StageOverflowPolicy);
+			SLIB_PROPERTY(sl_bool, StatisticsEnabled);
+
 		private:
 			Ref<Source> m_source;
 			Ref<Sink> m_sink;
 			List< Ref<Filter> > m_filters;
+			// copy-on-write snapshot of m_filters used by feedPacket()
+			Array< Ref<Filter> > m_chain;
+			// first of m_stages in pipelined mode, used by feedPacket(); guarded by m_lockChain with m_chain
+			Ref<_GraphStage> m_stageFirst;
+			SpinLock m_lockChain;
+			List<sl_size> m_stageBreaks;
 			Ref<Thread> m_thread;
+			List< Ref<_GraphStage> > m_stages;
+			
+			Mutex m_lockFeed;
+			PacketVector m_buffers[2];
+			PacketVector m_buffersTimer[2];
+			
+			sl_uint32 m_timerInterval;
+			sl_int64 m_timeLastTimer;
+
+			// lock-free list of the per-thread counters
+			_GraphStatisticsBlock* m_statisticsBlocks;
+			sl_int64 m_idStatistics;
 			
 		};
 
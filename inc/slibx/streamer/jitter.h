@@ -0,0 +1,166 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#ifndef CHECKHEADER_SLIB_STREAMER_JITTER
+#define CHECKHEADER_SLIB_STREAMER_JITTER
+
+#include "definition.h"
+
+#include "graph.h"
+
+/***********************************
+
+- JitterBufferFilter
+Reorders the packets by `Packet::sequence` and releases them after an
+adaptive playout delay. The delay follows the measured network jitter
+between MinDelay and MaxDelay, so it stays short on a clean link and
+grows only when the packets really arrive late.
+
+The playout is scheduled from the sender time of the packets
+(Packet::flagSenderTime, set by DatagramMetadataReceiveFilter and
+DatagramFecReceiveFilter), so the sender may change the frame duration
+while streaming (see AudioBitrateController). The interval per sequence number is learned
+from the sender times, and places the missing packets and the packets
+without a sender time after the previous one. `FrameDuration` is only
+the interval assumed until two sender times are received; the arrival
+times stamped by NetworkUdpSource are not used.
+
+Missing packets are released with Packet::flagLost, so the decoder can
+run the concealment or the in-band FEC in order. When the next packet is
+already buffered, the lost packet carries its format and data (looking
+ahead one slot), so the decoder can recover the frame from the
+redundancy of the next packet; otherwise the lost packet is empty.
+The packets are released when the filter is called, and by process()
+which the graph calls every half frame (see the timers in graph.h), so
+the packets are released in time while no packet is arriving.
+A jump of the sequence beyond the capacity restarts the buffer instead
+of releasing the whole gap as lost packets.
+
+After a packet with Packet::flagSilence, the sender may skip the frames
+by DTX (see vad.h). The missing packets are released as empty packets
+with flagSilence instead of flagLost, also by process() while the
+buffer is empty, so the comfort noise keeps the sink running.
+
+	NetworkUdpSource -> DatagramFecReceiveFilter -> JitterBufferFilter -> AudioOpusDecodeFilter -> AudioPlaySink
+	NetworkUdpSource -> DatagramErrorCorrectionReceiveFilter -> DatagramMetadataReceiveFilter -> JitterBufferFilter -> ...
+
+************************************/
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		struct JitterBufferStatistics
+		{
+			sl_uint64 countReceived;
+			sl_uint64 countReleased;
+			sl_uint64 countLost; // released as flagLost
+			sl_uint64 countSilence; // released as flagSilence, skipped by the sender
+			sl_uint64 countLate; // arrived after the sequence was released
+			sl_uint64 countDuplicated;
+			sl_uint64 countResets;
+			sl_uint32 jitter; // microseconds
+			sl_uint32 delayTarget; // microseconds
+		};
+		
+		class JitterBufferFilter : public Filter
+		{
+		public:
+			// `capacity` is the maximum count of the buffered packets, and is rounded up to a power of two
+			JitterBufferFilter(sl_uint32 capacity = 64);
+			
+			~JitterBufferFilter();
+			
+		public:
+			using Filter::filter;
+			
+			// override
+			void filter(const Packet& input, PacketEmitter& emitter);
+			
+			// override; releases the packets whose playout time has passed
+			void process(PacketEmitter& emitter);
+			
+			// override; half of FrameDuration
+			sl_uint32 getTimerInterval();
+			
+			// drops the buffered packets and restarts the measurement
+			void reset();
+			
+			void getStatistics(JitterBufferStatistics& _out);
+			
+		public:
+			// microseconds, the interval of the sequence numbers assumed until it is learned from the timestamps
+			SLIB_PROPERTY(sl_uint32, FrameDuration);
+			
+			// microseconds
+			SLIB_PROPERTY(sl_uint32, MinDelay);
+			
+			// microseconds
+			SLIB_PROPERTY(sl_uint32, MaxDelay);
+			
+		private:
+			// microseconds of the media time since the first packet
+			sl_int64 _getPosition(const Packet& input);
+			
+			void _measure(sl_int64 position, sl_int64 now);
+			
+			void _release(sl_int64 now, PacketEmitter& emitter);
+			
+			void _releaseFirst(PacketEmitter& emitter);
+			
+			void _reset();
+			
+			sl_int64 _getDelayTarget();
+			
+		private:
+			struct Slot {
+				sl_bool flagUsed;
+				sl_int64 position;
+				Packet packet;
+			};
+			Slot* m_slots;
+			sl_uint32 m_mask;
+			sl_uint32 m_countBuffered;
+			
+			sl_bool m_flagStarted;
+			sl_uint64 m_sequenceNext;
+			// timestamp (nanoseconds) of the position 0, valid after the first timestamped packet
+			sl_bool m_flagTimestamp;
+			sl_int64 m_timestampBase;
+			// the newest received sequence and its position
+			sl_uint64 m_sequenceLast;
+			sl_int64 m_positionLast;
+			// position of the last released packet
+			sl_int64 m_positionReleased;
+			// microseconds per sequence number, learned from the timestamps
+			sl_int64 m_durationFrame;
+			// arrival time of the position 0 on the least delayed path
+			sl_int64 m_timeBase;
+			sl_int64 m_timeBaseWindow;
+			sl_uint32 m_countWindow;
+			sl_int64 m_delayLast;
+			sl_int64 m_jitter; // x16
+			sl_int64 m_delayPeak;
+			Packet m_packetLast;
+			// the last released packet is silent
+			sl_bool m_flagSilence;
+			
+			JitterBufferStatistics m_statistics;
+			
+		};
+		
+	}
+	
+}
+
+#endif
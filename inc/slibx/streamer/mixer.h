@@ -0,0 +1,151 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#ifndef CHECKHEADER_SLIB_STREAMER_MIXER
+#define CHECKHEADER_SLIB_STREAMER_MIXER
+
+#include "definition.h"
+
+#include "graph.h"
+#include "queue.h"
+
+#include <slib/core/spin_lock.h>
+
+/***********************************
+
+- AudioMixStation
+Server-side conference mixer. Every participant sends its voice to an
+input (Sink) and receives the mix from an output (Source). An output
+created for an input gets the mix-minus of the input, so a speaker
+does not hear itself.
+
+	Participant1 -> Input1 \                   / Output1 (all - 1) -> Participant1
+	                        -> AudioMixStation  -> Output2 (all - 2) -> Participant2
+	Participant2 -> Input2 /                   \ Output3 (all)     -> Recorder
+
+The mixing thread produces one frame per tick (nSamplesPerFrame).
+The ticks follow a mix clock running `MixDelay` behind the timestamps
+(Packet::getCurrentTimestamp()), and the samples of every input are
+placed in the frame by the timestamps of their packets, so the inputs
+started at different times stay in phase with each other. The packets
+need not be aligned to the frames, and a gap between the packets is
+mixed as silence. A packet starting within half a frame of the end of
+the previous one (or without a timestamp) continues it without a gap,
+so the jitter of the capture timestamps is not heard, and the late or
+duplicated packets are dropped. An input falling behind the mix clock
+(for example, behind a jitter buffer longer than MixDelay) or running
+ahead of it by more than MaxQueuedFrames is shifted to the current tick,
+and keeps its own timing from there. The mixed packets are stamped with
+the time of the mix clock.
+Only the inputs having samples for the tick are mixed: their samples
+are accumulated once in 32 bits, the outputs of the silent participants
+share one packed frame, and only the outputs of the active speakers
+subtract their own voice, so the cost follows the count of the active
+speakers.
+
+************************************/
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		struct AudioMixStationParam
+		{
+			sl_uint32 nSamplesPerSecond;
+			sl_uint32 nChannels;
+			// samples per channel in one frame
+			sl_uint32 nSamplesPerFrame;
+			
+		public:
+			SLIB_INLINE AudioMixStationParam()
+			{
+				nSamplesPerSecond = 48000;
+				nChannels = 1;
+				nSamplesPerFrame = 960;
+			}
+		};
+		
+		class _AudioMixInput;
+		class _AudioMixOutput;
+		
+		class AudioMixStation : public Object
+		{
+			SLIB_DECLARE_OBJECT
+			
+		protected:
+			AudioMixStation();
+			
+			~AudioMixStation();
+			
+		public:
+			static Ref<AudioMixStation> create(const AudioMixStationParam& param);
+			
+		public:
+			// accepts formatAudio_PCM_S16 packets of the mixing format; one thread should send to an input at a time
+			Ref<Sink> createInput();
+			
+			void removeInput(const Ref<Sink>& input);
+			
+			// the mix of all inputs except `inputExcluded`
+			Ref<Source> createOutput(const Ref<Sink>& inputExcluded = sl_null);
+			
+			void removeOutput(const Ref<Source>& output);
+			
+			void release();
+			
+			SLIB_INLINE const AudioMixStationParam& getParam()
+			{
+				return m_param;
+			}
+			
+		public:
+			// frames an input may run ahead of the mix clock beyond MixDelay before it is shifted to the current tick
+			SLIB_PROPERTY(sl_uint32, MaxQueuedFrames);
+			// microseconds the mix clock runs behind the timestamps of the inputs; the queue of an input is sized for it when the input is created
+			SLIB_PROPERTY(sl_uint32, MixDelay);
+			// capacity of the queue created for each output
+			SLIB_PROPERTY(sl_uint32, QueueSize);
+			
+		private:
+			void mix();
+			
+			void updateSnapshots();
+			
+			static void run(Ref<Event> ev, WeakRef<AudioMixStation> station, sl_int64 durationFrame);
+			
+		private:
+			AudioMixStationParam m_param;
+			sl_uint32 m_nSamplesPerFrame;
+			sl_int32* m_accumulator;
+			sl_uint64 m_sequence;
+			// mix time of the first tick since the clock was started, and the ticks since then
+			sl_int64 m_timeMixBase;
+			sl_uint64 m_countTicks;
+			
+			List< Ref<_AudioMixInput> > m_inputs;
+			List< Ref<_AudioMixOutput> > m_outputs;
+			// copy-on-write snapshots used by the mixing thread
+			Array< Ref<_AudioMixInput> > m_snapshotInputs;
+			Array< Ref<_AudioMixOutput> > m_snapshotOutputs;
+			SpinLock m_lockSnapshot;
+			
+			Ref<Thread> m_thread;
+			Ref<Event> m_event;
+			
+		};
+		
+	}
+	
+}
+
+#endif
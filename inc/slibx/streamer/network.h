@@ -14,24 +14,124 @@
 #include "definition.h"
 
 #include "graph.h"
+#include "queue.h"
 
 #include <slib/network/socket.h>
 
+/***********************************
+
+- NetworkUdpSource
+The receiving thread sleeps until the socket becomes readable (epoll on
+Linux, SocketEvent on other platforms), and then drains the pending
+datagrams. The thread is started when the source is used by a Graph or
+by the ready listener. On Linux, GraphScheduler instead watches the
+socket with its shared poller (see Source::attachPoller()), and the
+datagrams are received on the worker running the graph, so the sources
+of a scheduler do not need a thread each. On Linux, up to `ReceiveBatchSize` datagrams are received by
+one recvmmsg() call, directly into the pooled packet buffers.
+The received packets are passed to the graph through a lock-free
+PacketQueue of `QueueSize` packets, and the graph is woken only when it
+has drained the queue since the last wakeup, not for every datagram.
+
+- NetworkUdpSink
+In batch mode, sendPacket() only collects the packets, and flush() sends
+them with one sendmmsg() call on Linux. When all the collected packets
+share one destination, they are sent as one UDP_SEGMENT (GSO) datagram
+if SegmentationOffload is enabled and supported by the kernel. GSO is
+turned off for the sink only when the socket option probe fails; a
+batch rejected by the kernel is sent again by sendmmsg().
+Graph calls flush() after every fed packet is processed, so the batch
+covers all the packets emitted for one feedPacket() call. With a non-zero
+`FlushDelay` (microseconds), flush() keeps the batch until its first
+packet has waited for the delay, so the packets of several feedPacket()
+calls are sent together; the graph timer (see graph.h) sends the rest
+while no packet is fed.
+
+- Feedback
+When `Feedback` is enabled on both ends, NetworkUdpSink prepends a
+transport header to every datagram:
+
+	[0xF0] [transport sequence: 4 BE] [send time: 4 BE, ms]
+
+and NetworkUdpSource strips it, and reports the reception back to the
+sender every `ReportInterval` milliseconds (RTCP receiver report style):
+
+	[0xF1] [highest sequence: 4 BE] [cumulative lost: 4 BE] [fraction lost: 1, x/256]
+	[echoed send time: 4 BE, ms] [delay since the echoed datagram: 4 BE, ms]
+
+The sink drains the reports from its socket when it sends, and passes
+them to `ReportListener` with the round-trip time (see
+AudioBitrateController). On Linux, the reports are stamped by the kernel
+on their arrival (SO_TIMESTAMPNS), so the time they waited for the next
+send is not counted in the round-trip time. The socket of a sink in the feedback mode
+should not be shared with a NetworkUdpSource.
+
+The transport sequence is counted per destination (up to
+SLIB_STREAMER_UDP_FEEDBACK_MAX_TARGETS, the least recently used one is
+restarted beyond it), so every receiver of a fan-out sees a gapless
+sequence, and the reports of all the destinations are passed to the
+listener (`NetworkUdpReport::from`). The reports are received without
+waiting (MSG_DONTWAIT on Linux), so the mode of the socket is not
+changed; on the other platforms, the socket should be non-blocking, as
+the sockets created by NetworkUdpSink::create() are.
+
+************************************/
+
+#define SLIB_STREAMER_UDP_RECEIVE_BATCH_MAX 64
+#define SLIB_STREAMER_UDP_SEND_BATCH_MAX 64
+#define SLIB_STREAMER_UDP_FEEDBACK_HEADER_SIZE 9
+#define SLIB_STREAMER_UDP_REPORT_SIZE 18
+#define SLIB_STREAMER_UDP_FEEDBACK_MAX_TARGETS 16
+
 namespace slib
 {
 	
 	namespace streamer
 	{
+		
+		struct NetworkUdpReport
+		{
+			SocketAddress from;
+			// 0 ~ 1, since the previous report
+			float fractionLost;
+			sl_uint32 countLost;
+			sl_uint32 sequenceHighest;
+			// milliseconds; negative when unknown
+			sl_int32 rtt;
+		};
 	
 		class NetworkUdpSource : public Source
 		{
 		protected:
 			SLIB_INLINE NetworkUdpSource()
 			{
+				setReceiveBatchSize(16);
+				setStreamId(0);
+				setQueueSize(1024);
+				setOverflowPolicy(PacketQueue::overflowDropOldest);
+				setFeedback(sl_false);
+				setReportInterval(500);
 			}
 			
 		public:
 			SLIB_PROPERTY(Ref<Socket>, Socket);
+			// maximum datagrams received per wakeup (1 ~ SLIB_STREAMER_UDP_RECEIVE_BATCH_MAX)
+			SLIB_PROPERTY(sl_uint32, ReceiveBatchSize);
+			// written to Packet::streamId; the received packets are stamped with the arrival time and order
+			SLIB_PROPERTY(sl_uint32, StreamId);
+			// the queue is created with these when the first datagram is received
+			SLIB_PROPERTY(sl_uint32, QueueSize);
+			SLIB_PROPERTY(PacketQueue::OverflowPolicy, OverflowPolicy);
+			// expects the transport header of NetworkUdpSink, and sends the reports to the sender
+			SLIB_PROPERTY(sl_bool, Feedback);
+			// milliseconds
+			SLIB_PROPERTY(sl_uint32, ReportInterval);
+			
+		public:
+			// datagrams discarded by the overflow policy
+			virtual sl_uint64 getDroppedCount() = 0;
+			
+			virtual sl_uint32 getQueuedCount() = 0;
 			
 		public:
 			static Ref<NetworkUdpSource> create(const Ref<Socket>& socket);
@@ -42,24 +142,73 @@ namespace slib
 		class NetworkUdpSink : public Sink
 		{
 		private:
-			SLIB_INLINE NetworkUdpSink()
-			{
-			}
+			NetworkUdpSink();
 			
 		public:
+			// override
 			sl_bool sendPacket(const Packet& packet);
 			
+			// override
+			void flush();
+			
+			// override
+			sl_uint32 getTimerInterval();
+			
 			virtual sl_bool resolveTarget(const Packet& packet, SocketAddress& target);
 			
 		public:
 			SLIB_PROPERTY(Ref<Socket>, Socket);
 			SLIB_PROPERTY(SocketAddress, DefaultTarget);
+			SLIB_PROPERTY(sl_bool, BatchMode);
+			SLIB_PROPERTY(sl_bool, SegmentationOffload);
+			// microseconds the batch may wait for the following packets; 0 sends it at every flush()
+			SLIB_PROPERTY(sl_uint32, FlushDelay);
+			// prepends the transport header, and receives the reports
+			SLIB_PROPERTY(sl_bool, Feedback);
+			// called on the sending thread
+			SLIB_PROPERTY(Function<void(const NetworkUdpReport&)>, ReportListener);
 			
 		public:
 			static Ref<NetworkUdpSink> create(const Ref<Socket>& socket);
 			static Ref<NetworkUdpSink> create(SocketAddress addressBind, SocketAddress defaultTarget, sl_bool flagBroadcast = sl_false);
 			static Ref<NetworkUdpSink> createMulticast(SocketAddress addressBind, SocketAddress defaultTarget, const IPv4Address& group);
 			
+		private:
+			sl_bool _sendBatch(Socket* socket, sl_uint32 n);
+			
+			sl_bool _sendSegmented(Socket* socket, sl_uint32 n);
+			
+			sl_bool _probeSegmentation(Socket* socket);
+			
+			void _receiveReports(Socket* socket);
+			
+			sl_uint32 _getFeedbackSequence(const SocketAddress& target, sl_int64 now);
+			
+		private:
+			Packet m_batchPackets[SLIB_STREAMER_UDP_SEND_BATCH_MAX];
+			SocketAddress m_batchTargets[SLIB_STREAMER_UDP_SEND_BATCH_MAX];
+			sl_uint32 m_countBatch;
+			// when the first packet of the batch is collected
+			sl_int64 m_timeBatchStarted;
+			Memory m_bufferSegments;
+			// 0: not probed, 1: supported, 2: unsupported
+			sl_uint32 m_stateSegmentation;
+			
+			String m_lastTargetString;
+			SocketAddress m_lastTarget;
+			
+			sl_bool m_flagFeedbackStarted;
+			// transport sequences per destination
+			struct FeedbackTarget {
+				SocketAddress address;
+				sl_uint32 sequence;
+				sl_int64 timeLastSent;
+			};
+			FeedbackTarget m_feedbackTargets[SLIB_STREAMER_UDP_FEEDBACK_MAX_TARGETS];
+			sl_uint32 m_countFeedbackTargets;
+			sl_uint32 m_indexFeedbackTargetLast;
+			sl_int64 m_timeLastReportPoll;
+			
 		};
 
 	}
@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CHECKHEADER_SLIB_STREAMER_PACKET
+#define CHECKHEADER_SLIB_STREAMER_PACKET
+
+#include "definition.h"
+
+#include "buffer.h"
+
+#include <slib/core/memory.h>
+#include <slib/core/string.h>
+#include <slib/network/socket_address.h>
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+
+		struct Packet
+		{
+			enum Format {
+				formatRaw = 0
+				, formatAudio_PCM_S16 = 10
+				, formatAudio_OPUS = 11
+				// Opus frame following the redundant copies of the previous frames, see AudioOpusEncodeFilter
+				, formatAudio_OPUS_RED = 12
+			};
+			Format format;
+
+			struct AudioParam
+			{
+				sl_uint32 nSamplesPerSecond;
+				sl_uint32 nChannels;
+			};
+			AudioParam audioParam;
+			struct NetworkParam
+			{
+				// native addresses, used by the network sources and sinks without formatting
+				SocketAddress from;
+				SocketAddress to;
+				// textual addresses, kept for compatibility; the native address is preferred when valid.
+				// NetworkUdpSource fills both `from` and `addressFrom`
+				String addressFrom;
+				String addressTo;
+
+				SLIB_INLINE String getAddressFrom() const
+				{
+					if (from.isValid()) {
+						return from.toString();
+					}
+					return addressFrom;
+				}
+
+				SLIB_INLINE String getAddressTo() const
+				{
+					if (to.isValid()) {
+						return to.toString();
+					}
+					return addressTo;
+				}
+			};
+			NetworkParam networkParam;
+
+			// capture time in nanoseconds of the local monotonic clock (see getCurrentTimestamp()), 0 when unknown.
+			// the clocks of the hosts are not related; see DatagramMetadataReceiveFilter for the packets from a network
+			sl_int64 timestamp;
+
+			enum Flags {
+				// `sequence` is valid
+				flagSequence = 0x0001
+				// marks the lost packet of `sequence`; has no payload
+				, flagLost = 0x0002
+				// the payload is recovered from the redundancy or synthesized by the concealment
+				, flagConcealed = 0x0004
+				// the payload is silence or background noise (VoiceActivityFilter); an empty packet with the flag
+				// stands for a frame skipped by the discontinuous transmission
+				, flagSilence = 0x0008
+				// `timestamp` is the capture time of the sender converted to the local clock (DatagramMetadataReceiveFilter),
+				// not the arrival time; it is not sent on the wire
+				, flagSenderTime = 0x0010
+			};
+			sl_uint32 flags;
+
+			sl_uint64 sequence;
+
+			// identifies the stream among the streams sharing a transport or a station, 0 when unused
+			sl_uint32 streamId;
+
+			PacketData data;
+
+		public:
+			SLIB_INLINE Packet()
+			{
+				format = formatRaw;
+				timestamp = 0;
+				flags = 0;
+				sequence = 0;
+				streamId = 0;
+			}
+
+			// copies the timestamp, the sequence, the stream id and the flags
+			SLIB_INLINE void copyMetadata(const Packet& other)
+			{
+				timestamp = other.timestamp;
+				flags = other.flags;
+				sequence = other.sequence;
+				streamId = other.streamId;
+			}
+
+		public:
+			// nanoseconds of the monotonic clock
+			static sl_int64 getCurrentTimestamp();
+
+			// size of the compact wire encoding of the metadata (timestamp, sequence, stream id and flags)
+			sl_size getMetadataSize() const;
+
+			// writes getMetadataSize() bytes, and returns the end of the written bytes
+			sl_uint8* writeMetadata(sl_uint8* buf) const;
+
+			// returns the end of the parsed bytes, or null when the encoding is invalid.
+			// the timestamp read is on the clock of the sender (see DatagramMetadataReceiveFilter)
+			const sl_uint8* readMetadata(const sl_uint8* buf, const sl_uint8* end);
+		};
+
+	}
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#ifndef CHECKHEADER_SLIB_STREAMER_PCM
+#define CHECKHEADER_SLIB_STREAMER_PCM
+
+#include "definition.h"
+
+/***********************************
+
+- PcmKernels
+Bulk operations on 16-bit PCM samples. The implementation is selected
+once at run time: AVX2 or SSE2 on x86, NEON on ARM64, and the portable
+scalar code otherwise. The results saturate instead of wrapping.
+
+dotProduct() is the inner loop of the polyphase resampler, and
+getEnergy() is run on every captured frame by the voice activity
+detection.
+
+Mixing keeps 32-bit accumulators, so a mix-minus output (everyone but
+one speaker) is made from the accumulated total by one subtraction.
+
+	accumulate(total, speaker[i]) for every active speaker
+	pack(output, total)                        for the listeners
+	packExcluding(output, total, speaker[i])   for the speaker i
+
+************************************/
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class PcmKernels
+		{
+		public:
+			// samples[i] = saturate(samples[i] * gain)
+			static void applyGain(sl_int16* samples, sl_size count, float gain);
+			
+			// dst[i] = saturate(sum of sources[k][i]); `dst` may be one of the sources
+			static void mix(sl_int16* dst, const sl_int16* const* sources, sl_uint32 nSources, sl_size count);
+			
+			// acc[i] += src[i]
+			static void accumulate(sl_int32* acc, const sl_int16* src, sl_size count);
+			
+			// dst[i] = saturate(acc[i])
+			static void pack(sl_int16* dst, const sl_int32* acc, sl_size count);
+			
+			// dst[i] = saturate(acc[i] - exclude[i])
+			static void packExcluding(sl_int16* dst, const sl_int32* acc, const sl_int16* exclude, sl_size count);
+			
+			// duplicates every sample into the left and right channels
+			static void convertMonoToStereo(sl_int16* dst, const sl_int16* src, sl_size nFrames);
+			
+			// averages the left and right channels; `dst` may be `src`
+			static void convertStereoToMono(sl_int16* dst, const sl_int16* src, sl_size nFrames);
+			
+			// maps to [-1, 1)
+			static void convertInt16ToFloat(float* dst, const sl_int16* src, sl_size count);
+			
+			static void convertFloatToInt16(sl_int16* dst, const float* src, sl_size count);
+			
+			// sum of a[i] * b[i]
+			static float dotProduct(const float* a, const float* b, sl_size count);
+			
+			// sum of samples[i]^2, and the count of the sign changes between the adjacent samples (features of VoiceActivityFilter)
+			static sl_uint64 getEnergy(const sl_int16* samples, sl_size count, sl_size* pZeroCrossings = sl_null);
+			
+		};
+		
+	}
+	
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CHECKHEADER_SLIB_STREAMER_QUEUE
+#define CHECKHEADER_SLIB_STREAMER_QUEUE
+
+#include "definition.h"
+
+#include "packet.h"
+
+#include <slib/core/object.h>
+#include <slib/core/thread.h>
+
+/***********************************
+
+- PacketQueue
+Bounded lock-free ring between one producer thread and one consumer thread.
+Every slot carries a sequence number, so the producer may also discard
+the oldest packet (overflowDropOldest) without taking a lock.
+
+************************************/
+
+namespace slib
+{
+
+	namespace streamer
+	{
+
+		class PacketQueue : public Object
+		{
+			SLIB_DECLARE_OBJECT
+
+		public:
+			enum OverflowPolicy {
+				overflowBlock = 0
+				, overflowDropOldest = 1
+				, overflowDropNewest = 2
+			};
+
+		protected:
+			PacketQueue();
+
+			~PacketQueue();
+
+		public:
+			// capacity is rounded up to a power of two
+			static Ref<PacketQueue> create(sl_uint32 capacity, OverflowPolicy policy = overflowBlock);
+
+		public:
+			// called only by the producer thread; overflowBlock waits until a slot is free, the queue is closed or the producer thread is stopping
+			sl_bool push(const Packet& packet);
+
+			// called only by the consumer thread
+			sl_bool pop(Packet* out);
+
+			// waits until a packet is available, the queue is closed or the timeout expires
+			sl_bool waitPacket(sl_int32 timeout = -1);
+
+			// releases all waiting threads; following pushes fail
+			void close();
+
+			sl_bool isClosed();
+
+			sl_uint32 getCount();
+
+			SLIB_INLINE sl_uint32 getCapacity()
+			{
+				return (sl_uint32)(m_mask + 1);
+			}
+
+			SLIB_INLINE OverflowPolicy getOverflowPolicy()
+			{
+				return m_policy;
+			}
+
+			sl_uint64 getDroppedCount();
+
+		private:
+			sl_bool _tryPush(const Packet& packet);
+
+			sl_bool _tryPop(Packet* out);
+
+		private:
+			struct Cell
+			{
+				sl_reg sequence;
+				Packet packet;
+			};
+			Cell* m_cells;
+			sl_reg m_mask;
+			OverflowPolicy m_policy;
+
+			sl_uint8 m_padding1[64];
+			sl_reg m_posEnqueue;
+			sl_uint8 m_padding2[64];
+			sl_reg m_posDequeue;
+			sl_uint8 m_padding3[64];
+
+			sl_int64 m_countDropped;
+			sl_int32 m_flagClosed;
+			sl_int32 m_flagWaitingConsumer;
+			sl_int32 m_flagWaitingProducer;
+			Ref<Event> m_eventNotEmpty;
+			Ref<Event> m_eventNotFull;
+
+		};
+
+	}
+
+}
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#ifndef CHECKHEADER_SLIB_STREAMER_RESAMPLER
+#define CHECKHEADER_SLIB_STREAMER_RESAMPLER
+
+#include "definition.h"
+
+#include "graph.h"
+
+/***********************************
+
+- AudioResampler
+Polyphase windowed-sinc (Kaiser) sample-rate converter for 16-bit PCM.
+The ratio is reduced to L/M, and the coefficients of the L phases are
+computed once per (L, M, taps) and shared by all resamplers of the same
+rate pair. The input history and the phase are kept between the calls,
+so the stream is converted seamlessly packet by packet.
+
+- AudioResampleFilter
+Converts formatAudio_PCM_S16 packets to the given rate and channels
+(mono <-> stereo), so the endpoints of different formats are bridged.
+The resampler is created on the first packet and whenever the input
+format changes; the packets already in the output format pass through.
+
+	AudioOpusDecodeFilter (16kHz mono) -> AudioResampleFilter(48000, 2) -> AudioPlaySink (48kHz stereo)
+
+************************************/
+
+#define SLIB_STREAMER_RESAMPLER_DEFAULT_TAPS 32
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class _AudioResamplerTable;
+		
+		class AudioResampler : public Object
+		{
+			SLIB_DECLARE_OBJECT
+			
+		protected:
+			AudioResampler();
+			
+			~AudioResampler();
+			
+		public:
+			// `nTaps` is the filter length per phase when upsampling, and grows with the decimation ratio
+			static Ref<AudioResampler> create(sl_uint32 nSamplesPerSecondInput, sl_uint32 nSamplesPerSecondOutput, sl_uint32 nChannels, sl_uint32 nTaps = SLIB_STREAMER_RESAMPLER_DEFAULT_TAPS);
+			
+		public:
+			// the upper bound of the output frames for `nFramesInput` input frames
+			sl_uint32 getMaxOutputFrames(sl_uint32 nFramesInput);
+			
+			// converts the interleaved frames, and returns the count of the output frames
+			sl_uint32 process(const sl_int16* input, sl_uint32 nFramesInput, sl_int16* output, sl_uint32 nMaxFramesOutput);
+			
+			// clears the history
+			void reset();
+			
+			SLIB_INLINE sl_uint32 getInputSampleRate()
+			{
+				return m_nSamplesPerSecondInput;
+			}
+			
+			SLIB_INLINE sl_uint32 getOutputSampleRate()
+			{
+				return m_nSamplesPerSecondOutput;
+			}
+			
+			SLIB_INLINE sl_uint32 getChannelsCount()
+			{
+				return m_nChannels;
+			}
+			
+		private:
+			sl_bool reserve(sl_uint32 nFramesInput);
+			
+		private:
+			Ref<_AudioResamplerTable> m_table;
+			sl_uint32 m_nSamplesPerSecondInput;
+			sl_uint32 m_nSamplesPerSecondOutput;
+			sl_uint32 m_nChannels;
+			
+			// per channel: (taps - 1) samples of the history followed by the input
+			float* m_history;
+			sl_uint32 m_nCapacity;
+			float* m_output;
+			sl_uint32 m_nCapacityOutput;
+			// position of the next output in the input, relative to the first new input frame
+			sl_uint32 m_position;
+			sl_uint32 m_phase;
+			
+		};
+		
+		class AudioResampleFilter : public Filter
+		{
+		public:
+			AudioResampleFilter(sl_uint32 nSamplesPerSecond, sl_uint32 nChannels);
+			
+			~AudioResampleFilter();
+			
+		public:
+			using Filter::filter;
+			
+			// override
+			void filter(const Packet& input, PacketEmitter& emitter);
+			
+		public:
+			SLIB_PROPERTY(sl_uint32, Taps);
+			
+		private:
+			sl_uint32 m_nSamplesPerSecond;
+			sl_uint32 m_nChannels;
+			Ref<AudioResampler> m_resampler;
+			sl_uint32 m_nChannelsInput;
+			sl_int16* m_bufferChannels;
+			sl_uint32 m_nCapacityChannels;
+			
+		};
+		
+	}
+	
+}
+
+#endif
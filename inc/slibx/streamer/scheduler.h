@@ -0,0 +1,128 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#ifndef CHECKHEADER_SLIB_STREAMER_SCHEDULER
+#define CHECKHEADER_SLIB_STREAMER_SCHEDULER
+
+#include "definition.h"
+
+#include "graph.h"
+
+#include <slib/core/spin_lock.h>
+
+/***********************************
+
+- GraphScheduler
+Runs many graphs on a fixed pool of worker threads (one per processor
+by default) instead of one thread per graph.
+
+A graph is scheduled when its source reports new packets through the
+ready listener (see Source::notifyPacketReady()), and then processes up
+to `PacketsPerTurn` packets before yielding the worker to other graphs.
+Sources not supporting the ready listener, and the graphs having timers
+(see graph.h), are polled every `PollInterval` milliseconds.
+On Linux, the sources providing a descriptor by Source::attachPoller()
+(such as NetworkUdpSource) are watched by one epoll thread shared by all
+the graphs of the scheduler, and are received on the workers.
+
+Every worker has its own run queue, and idle workers steal the graphs
+queued on busy workers. A graph added with a CPU index always runs on
+the worker of that index; when the workers are pinned, worker N runs on
+CPU N. Pinning is supported only on Linux, and create() fails on the
+other platforms when it is requested.
+
+************************************/
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class _GraphSchedulerEntry;
+		class _GraphSchedulerWorker;
+		
+		class GraphScheduler : public Object
+		{
+			SLIB_DECLARE_OBJECT
+			
+		protected:
+			GraphScheduler();
+			
+			~GraphScheduler();
+			
+		public:
+			// nThreads = 0: the number of the processors
+			static Ref<GraphScheduler> create(sl_uint32 nThreads = 0, sl_bool flagPinThreads = sl_false);
+			
+		public:
+			// the graph should not be started by Graph::start(); `cpu` < 0 means any worker
+			sl_bool addGraph(const Ref<Graph>& graph, sl_int32 cpu = -1);
+			
+			void removeGraph(const Ref<Graph>& graph);
+			
+			void release();
+			
+			sl_uint32 getThreadsCount();
+			
+		public:
+			SLIB_PROPERTY(sl_uint32, PacketsPerTurn);
+			SLIB_PROPERTY(sl_uint32, PollInterval);
+			
+		private:
+			void schedule(_GraphSchedulerEntry* entry);
+			
+			void enqueue(_GraphSchedulerEntry* entry);
+			
+			sl_bool dequeue(_GraphSchedulerWorker* worker, Ref<_GraphSchedulerEntry>& _out);
+			
+			void runEntry(_GraphSchedulerEntry* entry);
+			
+			void pollSources();
+			
+			sl_bool watchSource(_GraphSchedulerEntry* entry, sl_int64 handle);
+			
+			void unwatchSource(_GraphSchedulerEntry* entry);
+			
+			static void runPoller(WeakRef<GraphScheduler> scheduler, sl_int64 handlePoller);
+			
+			void updatePolledEntries();
+			
+			static void runWorker(WeakRef<GraphScheduler> scheduler, Ref<_GraphSchedulerWorker> worker);
+			
+			static void onReady(WeakRef<GraphScheduler> scheduler, WeakRef<_GraphSchedulerEntry> entry);
+			
+		private:
+			Array< Ref<_GraphSchedulerWorker> > m_workers;
+			sl_bool m_flagPinThreads;
+			sl_bool m_flagReleased;
+			sl_int32 m_indexNextWorker;
+			
+			List< Ref<_GraphSchedulerEntry> > m_entries;
+			// copy-on-write snapshot of the entries polled by the workers
+			Array< Ref<_GraphSchedulerEntry> > m_entriesPolled;
+			SpinLock m_lockEntriesPolled;
+			sl_int64 m_timeLastPoll;
+			
+			// epoll descriptor watching the sources, closed by the poller thread
+			sl_int64 m_handlePoller;
+			Ref<Thread> m_threadPoller;
+			// unwatched entries, kept until the poller returns from the wait
+			List< Ref<_GraphSchedulerEntry> > m_entriesUnwatched;
+			SpinLock m_lockPoller;
+			
+		};
+		
+	}
+	
+}
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#ifndef CHECKHEADER_SLIB_STREAMER_SHARED_MEMORY
+#define CHECKHEADER_SLIB_STREAMER_SHARED_MEMORY
+
+#include "definition.h"
+
+#include "graph.h"
+
+/***********************************
+
+- SharedMemorySink / SharedMemorySource
+Connect the graphs running in separate processes through a ring buffer
+in an anonymous shared memory file (memfd, Linux and Android; create()
+and open() return null on the other platforms). One side creates the
+ring, and the other side opens it with the file descriptor, passed by
+SCM_RIGHTS or inherited across fork() (it is created close-on-exec).
+A ring has one sink and one source. The role left by a released object,
+or by an exited process (the processes share the pid namespace), can be
+taken over by a restarted one; a new source drops the records left to
+the previous source.
+
+	capture process:  AudioRecordSource -> VoiceActivityFilter -> SharedMemorySink::create() -> getHandle()
+	encode process:   SharedMemorySource::open(handle) -> AudioOpusEncodeFilter -> ...
+
+- Ring
+	[header: 4KB] [records: capacity bytes]
+	record: [size 4] [payload size 4] [format 4] [flags 4] [sequence 8] [timestamp 8]
+	        [stream id 4] [sample rate 4] [channels 4] [reserved 4] [payload] (aligned to 8 bytes)
+
+A record never wraps around the end of the ring; the rest of the lap is
+skipped by a record of size 0. The sink copies the payload into the
+ring once, and never blocks: the packets are dropped while the ring is
+full, as on a UDP socket. The source hands out views of the payloads in
+the ring, and the bytes return to the sink when the last view is
+released. While the views hold more than half of the ring (a jitter
+buffer keeping the packets, for example), the source copies the
+payloads to the pool instead, so the sink is not stalled. The source
+checks every record against the published position, and keeps the
+sizes of the records it has not returned on its own side, so a broken
+peer cannot make it read or return outside the ring.
+
+- Wakeups
+The receiving thread of the source sleeps on a futex in the header, and
+notifies the graph when the records arrive. The graph raises a flag in
+the header when it finds the ring empty, and the sink calls the futex
+only when the flag is raised. While the records arrive before the graph
+drains the ring, neither side makes a system call; otherwise each
+record costs one futex wake by the sink and one notification of the
+graph (see Source::notifyPacketReady), as for a socket.
+
+************************************/
+
+#define SLIB_STREAMER_SHARED_MEMORY_DEFAULT_CAPACITY 0x100000
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class SharedMemorySink : public Sink
+		{
+		protected:
+			SLIB_INLINE SharedMemorySink() {}
+			
+		public:
+			// file descriptor of the shared memory, valid while this object is alive
+			virtual sl_int32 getHandle() = 0;
+			
+			// packets dropped while the ring is full
+			virtual sl_uint64 getDroppedCount() = 0;
+			
+			// the source is released
+			virtual sl_bool isClosed() = 0;
+			
+		public:
+			// `capacity` is rounded up to a power of two
+			static Ref<SharedMemorySink> create(sl_uint32 capacity = SLIB_STREAMER_SHARED_MEMORY_DEFAULT_CAPACITY);
+			
+			// attaches to the ring created by SharedMemorySource::create(); the handle is duplicated
+			static Ref<SharedMemorySink> open(sl_int32 handle);
+			
+		};
+		
+		class SharedMemorySource : public Source
+		{
+		protected:
+			SLIB_INLINE SharedMemorySource() {}
+			
+		public:
+			// file descriptor of the shared memory, valid while this object is alive
+			virtual sl_int32 getHandle() = 0;
+			
+			// packets dropped by the sink while the ring is full
+			virtual sl_uint64 getDroppedCount() = 0;
+			
+			// the sink is released; the packets already in the ring are still received
+			virtual sl_bool isClosed() = 0;
+			
+		public:
+			// `capacity` is rounded up to a power of two
+			static Ref<SharedMemorySource> create(sl_uint32 capacity = SLIB_STREAMER_SHARED_MEMORY_DEFAULT_CAPACITY);
+			
+			// attaches to the ring created by SharedMemorySink::create(); the handle is duplicated
+			static Ref<SharedMemorySource> open(sl_int32 handle);
+			
+		};
+		
+	}
+	
+}
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#ifndef CHECKHEADER_SLIB_STREAMER_STATION
+#define CHECKHEADER_SLIB_STREAMER_STATION
+
+#include "definition.h"
+
+#include "graph.h"
+#include "queue.h"
+
+#include <slib/core/spin_lock.h>
+
+/***********************************
+
+- Station
+Links any number of sinks (inputs) to any number of sources (outputs).
+
+	Graph1 -> Sink1 \                  / Source1 -> GraphA
+	                 -> Station (merge) -> Source2 -> GraphB
+	Graph2 -> Sink2 /                  \ Source3 -> GraphC
+
+Every input and output has its own bounded PacketQueue. The dispatching
+thread of the station merges the inputs in the order of the packet
+timestamps (the arrival time is used for the packets without timestamp),
+and shares every packet with all outputs without copying the payload.
+An output that is not drained drops its oldest packets by default, so a
+slow consumer does not stall the others.
+
+************************************/
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class _StationSink;
+		class _StationSource;
+		
+		class Station : public Object
+		{
+			SLIB_DECLARE_OBJECT
+			
+		protected:
+			Station();
+			
+			~Station();
+			
+		public:
+			static Ref<Station> create();
+			
+		public:
+			// new input of the station; one thread should send to a sink at a time
+			Ref<Sink> createSink();
+			
+			void removeSink(const Ref<Sink>& sink);
+			
+			// new output of the station
+			Ref<Source> createSource();
+			
+			void removeSource(const Ref<Source>& source);
+			
+			void release();
+			
+		public:
+			// capacity of the queue created for each input and output
+			SLIB_PROPERTY(sl_uint32, QueueSize);
+			SLIB_PROPERTY(PacketQueue::OverflowPolicy, OverflowPolicy);
+			
+		private:
+			void notify();
+			
+			void dispatch();
+			
+			static void run(Ref<Event> ev, WeakRef<Station> station);
+			
+		private:
+			List< Ref<_StationSink> > m_sinks;
+			List< Ref<_StationSource> > m_sources;
+			// copy-on-write snapshots used by the dispatching thread
+			Array< Ref<_StationSink> > m_snapshotSinks;
+			Array< Ref<_StationSource> > m_snapshotSources;
+			SpinLock m_lockSnapshot;
+			
+			Ref<Thread> m_thread;
+			Ref<Event> m_event;
+			sl_int32 m_flagSignaled;
+			
+			friend class _StationSink;
+			
+		};
+		
+	}
+	
+}
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#ifndef CHECKHEADER_SLIB_STREAMER_STATISTICS
+#define CHECKHEADER_SLIB_STREAMER_STATISTICS
+
+#include "definition.h"
+
+/***********************************
+
+- LatencyHistogram
+Log-linear histogram of durations in nanoseconds (HDR style): every
+power of two is divided into 8 buckets, so the recorded values keep
+about 6% of precision from 16ns up to 18 minutes.
+
+- GraphNodeStatistics
+Counters of the source, a filter or the sink of a Graph, summed over
+all threads running the graph. See Graph::getStatistics().
+The first SLIB_STREAMER_STATISTICS_FILTERS_MAX filters of a chain are
+counted one by one; the filters beyond them are summed into one node of
+`nodeOtherFilters`.
+
+************************************/
+
+#define SLIB_STREAMER_HISTOGRAM_SUB_BITS 4
+#define SLIB_STREAMER_HISTOGRAM_MAX_BITS 40
+#define SLIB_STREAMER_STATISTICS_FILTERS_MAX 61
+
+#define SLIB_STREAMER_HISTOGRAM_BUCKETS ((SLIB_STREAMER_HISTOGRAM_MAX_BITS - SLIB_STREAMER_HISTOGRAM_SUB_BITS) * (1 << (SLIB_STREAMER_HISTOGRAM_SUB_BITS - 1)) + (1 << SLIB_STREAMER_HISTOGRAM_SUB_BITS))
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class LatencyHistogram
+		{
+		public:
+			sl_uint64 counts[SLIB_STREAMER_HISTOGRAM_BUCKETS];
+			
+		public:
+			LatencyHistogram();
+			
+		public:
+			static sl_uint32 getBucketIndex(sl_uint64 value);
+			
+			// the smallest value of the bucket
+			static sl_uint64 getBucketValue(sl_uint32 index);
+			
+			SLIB_INLINE void add(sl_uint64 value)
+			{
+				counts[getBucketIndex(value)]++;
+			}
+			
+			void add(const LatencyHistogram& other);
+			
+			void reset();
+			
+			sl_uint64 getCount() const;
+			
+			// `percent`: 0 ~ 100; returns the highest value equivalent to the value at the percentile
+			sl_uint64 getPercentile(double percent) const;
+			
+			sl_uint64 getMaximum() const;
+			
+		};
+		
+		struct GraphNodeStatistics
+		{
+			enum NodeType {
+				nodeSource = 0
+				, nodeFilter = 1
+				, nodeSink = 2
+				// the filters from SLIB_STREAMER_STATISTICS_FILTERS_MAX to the end of the chain
+				, nodeOtherFilters = 3
+			};
+			NodeType type;
+			// index in the filter chain (nodeFilter), or the first filter summed (nodeOtherFilters)
+			sl_uint32 index;
+			
+			sl_uint64 countCalls;
+			sl_uint64 countPacketsIn;
+			sl_uint64 countPacketsOut;
+			sl_uint64 sizeBytesIn;
+			sl_uint64 sizeBytesOut;
+			// nanoseconds per call
+			sl_uint64 timeTotal;
+			LatencyHistogram latency;
+			// nanoseconds from Packet::timestamp (the capture) to the sink, recorded only for the sink
+			LatencyHistogram age;
+		};
+		
+	}
+	
+}
+
+#endif
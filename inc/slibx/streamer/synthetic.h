@@ -0,0 +1,196 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CHECKHEADER_SLIB_STREAMER_SYNTHETIC
+#define CHECKHEADER_SLIB_STREAMER_SYNTHETIC
+
+#include "definition.h"
+
+#include "graph.h"
+#include "statistics.h"
+
+#include <slib/core/spin_lock.h>
+
+/***********************************
+
+Synthetic endpoints to drive and measure the graphs without the audio
+devices or the sockets. The scenarios of src/bench/streamer_bench.cpp
+are built on them.
+
+- SyntheticSource
+Generates the packets at a constant rate (paced by the clock), or as
+fast as the graph consumes them when `nPacketsPerSecond` is 0. PCM
+packets carry a sine tone, and the other formats a counting pattern.
+Every packet is stamped with its due time, the sequence and the stream
+id, so the sink can measure the latency and the loss.
+
+- LoopbackSink
+Counts the received packets, measures their age (now - timestamp) and
+the sequence gaps, and optionally queues them for getSource(), so the
+output of a sending graph can feed a receiving graph.
+
+- NetworkImpairmentFilter
+Emulates a lossy network between the send and the receive graphs:
+bursty loss (Gilbert-Elliott model), random delay (reordering unless
+`KeepOrder` is set) and duplication. The random sequence is determined
+by the seed, so a scenario is reproducible.
+
+************************************/
+
+#define SLIB_STREAMER_IMPAIRMENT_MAX_HELD 256
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		struct SyntheticSourceParam
+		{
+			Packet::Format format;
+			// PCM format
+			sl_uint32 nSamplesPerSecond;
+			sl_uint32 nChannels;
+			sl_uint32 nSamplesPerFrame;
+			// payload bytes of the other formats
+			sl_uint32 sizePacket;
+			// 0: not paced
+			sl_uint32 nPacketsPerSecond;
+			// 0: unlimited
+			sl_uint64 nPackets;
+			sl_uint32 streamId;
+			
+		public:
+			SyntheticSourceParam();
+		};
+		
+		class SyntheticSource : public Source
+		{
+		protected:
+			SLIB_INLINE SyntheticSource() {}
+			
+		public:
+			static Ref<SyntheticSource> create(const SyntheticSourceParam& param);
+			
+		public:
+			virtual sl_uint64 getGeneratedCount() = 0;
+			
+			// all `nPackets` packets are generated
+			virtual sl_bool isFinished() = 0;
+			
+		};
+		
+		struct LoopbackSinkStatistics
+		{
+			sl_uint64 countPackets;
+			sl_uint64 sizeBytes;
+			// by the gaps of Packet::sequence
+			sl_uint64 countLost;
+			sl_uint64 countReordered;
+			sl_uint64 countDuplicated;
+			// nanoseconds from Packet::timestamp
+			LatencyHistogram age;
+		};
+		
+		class LoopbackSink : public Sink
+		{
+		protected:
+			LoopbackSink();
+			
+			~LoopbackSink();
+			
+		public:
+			// queueSize = 0: the packets are only counted
+			static Ref<LoopbackSink> create(sl_uint32 queueSize = 0);
+			
+		public:
+			// override
+			sl_bool sendPacket(const Packet& packet);
+			
+			// the queued packets; null when created without the queue
+			Ref<Source> getSource();
+			
+			void getStatistics(LoopbackSinkStatistics& _out);
+			
+			void resetStatistics();
+			
+		private:
+			Ref<Source> m_source;
+			
+			SpinLock m_lock;
+			LoopbackSinkStatistics m_statistics;
+			sl_bool m_flagSequence;
+			sl_uint64 m_sequenceNext;
+			// bit n: `m_sequenceNext - 1 - n` was received
+			sl_uint64 m_maskReceived;
+			
+		};
+		
+		class NetworkImpairmentFilter : public Filter
+		{
+		public:
+			NetworkImpairmentFilter(sl_uint32 seed = 1);
+			
+			~NetworkImpairmentFilter();
+			
+		public:
+			using Filter::filter;
+			
+			void filter(const Packet& input, PacketEmitter& emitter);
+			
+			// emits all the delayed packets
+			void flush(PacketEmitter& emitter);
+			
+			sl_uint64 getLostCount();
+			
+			sl_uint64 getDuplicatedCount();
+			
+		public:
+			// 0 ~ 1
+			SLIB_PROPERTY(float, LossRate);
+			// average length of the loss bursts in packets; 1 means independent losses
+			SLIB_PROPERTY(float, MeanBurstLength);
+			// 0 ~ 1
+			SLIB_PROPERTY(float, DuplicateRate);
+			// maximum of the uniformly distributed delay, in microseconds
+			SLIB_PROPERTY(sl_uint32, MaxDelay);
+			// the delayed packets are not reordered
+			SLIB_PROPERTY(sl_bool, KeepOrder);
+			
+		private:
+			float random();
+			
+			void hold(const Packet& packet, sl_int64 timeRelease, PacketEmitter& emitter);
+			
+			void release(sl_int64 now, PacketEmitter& emitter);
+			
+		private:
+			sl_uint64 m_random;
+			sl_bool m_flagBurst;
+			sl_uint64 m_countLost;
+			sl_uint64 m_countDuplicated;
+			sl_int64 m_timeLastRelease;
+			
+			// sorted by the release time
+			struct Held
+			{
+				sl_int64 timeRelease;
+				Packet packet;
+			};
+			Held m_held[SLIB_STREAMER_IMPAIRMENT_MAX_HELD];
+			sl_uint32 m_nHeld;
+			
+		};
+		
+	}
+	
+}
+
+#endif
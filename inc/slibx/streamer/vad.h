@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#ifndef CHECKHEADER_SLIB_STREAMER_VAD
+#define CHECKHEADER_SLIB_STREAMER_VAD
+
+#include "definition.h"
+
+#include "graph.h"
+
+/***********************************
+
+- VoiceActivityFilter
+Marks the silent PCM packets with Packet::flagSilence. A frame is
+active when its energy exceeds the tracked noise floor by `Threshold`,
+or a lower margin with many zero crossings (unvoiced consonants). The
+decision is held for `Hangover` after the speech, not to clip the
+trailing syllables.
+
+- Discontinuous transmission (DTX)
+With AudioOpusEncodeFilter::Dtx, the silent frames are not encoded
+except one frame at the start of the silence and one per DtxInterval,
+which keep the background level at the receiver. The skipped frames
+still take the sequence numbers, so the receiver tells them from the
+lost frames by the flagSilence of the last frame.
+
+	AudioRecordSource -> VoiceActivityFilter -> AudioOpusEncodeFilter(Dtx) -> DatagramMetadataSendFilter -> NetworkUdpSink
+
+- ComfortNoiseFilter
+JitterBufferFilter releases the skipped frames as empty packets with
+flagSilence, which AudioOpusDecodeFilter passes as PCM, and this filter
+fills them with noise at the level of the last silent frames, so the
+sink keeps playing at its clock.
+
+	NetworkUdpSource -> DatagramMetadataReceiveFilter -> JitterBufferFilter -> AudioOpusDecodeFilter -> ComfortNoiseFilter -> AudioPlaySink
+
+************************************/
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class VoiceActivityFilter : public Filter
+		{
+		public:
+			SLIB_INLINE VoiceActivityFilter()
+			{
+				setThreshold(9.0f);
+				setMinLevel(-55.0f);
+				setHangover(300);
+				m_flagStarted = sl_false;
+				m_noise = 0;
+				m_hangover = 0;
+				m_flagActive = sl_true;
+			}
+			
+		public:
+			using Filter::filter;
+			
+			// override
+			void filter(const Packet& input, PacketEmitter& emitter);
+			
+			// decision on the last frame
+			SLIB_INLINE sl_bool isActive()
+			{
+				return m_flagActive;
+			}
+			
+		public:
+			// dB over the noise floor
+			SLIB_PROPERTY(float, Threshold);
+			
+			// dBFS, the quieter frames are always silent
+			SLIB_PROPERTY(float, MinLevel);
+			
+			// milliseconds
+			SLIB_PROPERTY(sl_uint32, Hangover);
+			
+		private:
+			sl_bool m_flagStarted;
+			// mean square of the samples in the background
+			double m_noise;
+			sl_int32 m_hangover;
+			sl_bool m_flagActive;
+			
+		};
+		
+		class ComfortNoiseFilter : public Filter
+		{
+		public:
+			SLIB_INLINE ComfortNoiseFilter()
+			{
+				setMaxLevel(1000);
+				m_level = 0;
+				m_nSamplesLastFrame = 0;
+				m_seed = 0x9E3779B9;
+			}
+			
+		public:
+			using Filter::filter;
+			
+			// override
+			void filter(const Packet& input, PacketEmitter& emitter);
+			
+		public:
+			// RMS of the generated noise in the sample unit, against the loud frames misjudged as silent
+			SLIB_PROPERTY(sl_uint32, MaxLevel);
+			
+		private:
+			// RMS of the last silent frames
+			float m_level;
+			sl_uint32 m_nSamplesLastFrame;
+			sl_uint32 m_seed;
+			
+		};
+		
+	}
+	
+}
+
+#endif
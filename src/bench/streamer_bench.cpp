@@ -0,0 +1,893 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/***********************************
+
+- streamer_bench
+Measures the streamer without the audio devices: the packets come from
+SyntheticSource, pass through the filters of a scenario (with
+NetworkImpairmentFilter for the lossy ones), and end in LoopbackSink.
+
+	streamer_bench [scenario prefix] [packets]
+
+Every scenario prints one JSON object per line:
+
+	{"scenario":"fec.rs.8+2.loss5","packets":100000,"packets_per_second":...,"ns_per_packet":...,
+	 "allocations_per_packet":...,"p50_ns":...,"p99_ns":...,"p999_ns":..., <fields of the scenario>}
+
+The in-process scenarios time every Graph::feedPacket() call (so the
+latency is the processing time of one packet), and count the heap
+allocations made during the calls. The threaded scenarios (encode
+service, UDP) measure the wall time of the run and the age of the
+packets at the sink, and count all the allocations of the process.
+The udp.*.legacy scenarios receive with the former polling loop of
+NetworkUdpSource (sleeping 5ms on an empty socket), as the baseline of
+the readiness-driven receiving.
+
+************************************/
+
+#include "../../inc/slibx/streamer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(__GLIBC__)
+#include <new>
+#endif
+
+using namespace slib;
+using namespace slib::streamer;
+
+#define STREAMER_BENCH_DEFAULT_PACKETS 100000
+#define STREAMER_BENCH_MAX_WARMUP 1000
+// the codec scenarios run this fraction of the packets
+#define STREAMER_BENCH_OPUS_DIVIDER 10
+#define STREAMER_BENCH_UDP_DIVIDER 20
+#define STREAMER_BENCH_UDP_PORT 47310
+#define STREAMER_BENCH_UDP_DRAIN_TIME 300
+#define STREAMER_BENCH_WAIT_TIMEOUT 60000
+
+static sl_int64 _g_StreamerBench_countAllocations = 0;
+
+SLIB_INLINE static void _StreamerBench_countAllocation()
+{
+	Base::interlockedIncrement64(&_g_StreamerBench_countAllocations);
+}
+
+SLIB_INLINE static sl_int64 _StreamerBench_getAllocationsCount()
+{
+	return Base::interlockedAdd64(&_g_StreamerBench_countAllocations, 0);
+}
+
+#if defined(__GLIBC__)
+// every heap allocation of the process (operator new, slib::Memory, the codecs) goes through malloc
+extern "C"
+{
+	extern void* __libc_malloc(size_t size);
+	extern void* __libc_calloc(size_t count, size_t size);
+	extern void* __libc_realloc(void* ptr, size_t size);
+
+	void* malloc(size_t size)
+	{
+		_StreamerBench_countAllocation();
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t count, size_t size)
+	{
+		_StreamerBench_countAllocation();
+		return __libc_calloc(count, size);
+	}
+
+	void* realloc(void* ptr, size_t size)
+	{
+		_StreamerBench_countAllocation();
+		return __libc_realloc(ptr, size);
+	}
+}
+#else
+// only operator new is counted on the other C libraries
+void* operator new(std::size_t size)
+{
+	_StreamerBench_countAllocation();
+	void* ptr = ::malloc(size ? size : 1);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	::free(ptr);
+}
+#endif
+
+struct _StreamerBenchResult
+{
+	sl_uint64 countPackets;
+	// nanoseconds spent in the measured calls, or the wall time of the run
+	sl_int64 timeTotal;
+	sl_int64 countAllocations;
+	LatencyHistogram latency;
+
+	_StreamerBenchResult()
+	{
+		countPackets = 0;
+		timeTotal = 0;
+		countAllocations = 0;
+	}
+};
+
+static const char* _g_StreamerBench_prefix = sl_null;
+
+static sl_bool _StreamerBench_isSelected(const char* scenario)
+{
+	return !_g_StreamerBench_prefix || !(strncmp(scenario, _g_StreamerBench_prefix, strlen(_g_StreamerBench_prefix)));
+}
+
+// `extra` is empty, or the fields of the scenario starting with a comma
+static void _StreamerBench_print(const char* scenario, const _StreamerBenchResult& result, const char* extra)
+{
+	double n = result.countPackets ? (double)(result.countPackets) : 1;
+	double seconds = (double)(result.timeTotal) / 1e9;
+	printf("{\"scenario\":\"%s\",\"packets\":%llu,\"packets_per_second\":%.0f,\"ns_per_packet\":%.1f,\"allocations_per_packet\":%.3f,\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu%s}\n",
+		scenario,
+		(unsigned long long)(result.countPackets),
+		seconds > 0 ? (double)(result.countPackets) / seconds : 0.0,
+		(double)(result.timeTotal) / n,
+		(double)(result.countAllocations) / n,
+		(unsigned long long)(result.latency.getPercentile(50)),
+		(unsigned long long)(result.latency.getPercentile(99)),
+		(unsigned long long)(result.latency.getPercentile(99.9)),
+		extra ? extra : "");
+	fflush(stdout);
+}
+
+static void _StreamerBench_printUnavailable(const char* scenario, const char* reason)
+{
+	printf("{\"scenario\":\"%s\",\"error\":\"%s\"}\n", scenario, reason);
+	fflush(stdout);
+}
+
+// feeds the packets of the source to the graph, and measures every feedPacket() call
+static void _StreamerBench_feed(Graph* graph, Source* source, sl_uint64 nPackets, _StreamerBenchResult& result)
+{
+	Packet packet;
+	for (sl_uint64 i = 0; i < nPackets; i++) {
+		if (!(source->receivePacket(&packet))) {
+			break;
+		}
+		sl_int64 countAllocations = _StreamerBench_getAllocationsCount();
+		sl_int64 timeStart = Packet::getCurrentTimestamp();
+		graph->feedPacket(packet);
+		sl_int64 timeEnd = Packet::getCurrentTimestamp();
+		result.countAllocations += _StreamerBench_getAllocationsCount() - countAllocations;
+		result.timeTotal += timeEnd - timeStart;
+		result.latency.add((sl_uint64)(timeEnd - timeStart));
+		result.countPackets++;
+	}
+}
+
+// fills the pools and the caches with a part of the packets, and then clears the counters of the sink
+static void _StreamerBench_warmUp(Graph* graph, Source* source, sl_uint64 nPackets, LoopbackSink* sink)
+{
+	_StreamerBenchResult result;
+	sl_uint64 nWarmup = nPackets / 10;
+	if (nWarmup > STREAMER_BENCH_MAX_WARMUP) {
+		nWarmup = STREAMER_BENCH_MAX_WARMUP;
+	}
+	_StreamerBench_feed(graph, source, nWarmup, result);
+	sink->resetStatistics();
+}
+
+static void _StreamerBench_run(Graph* graph, Source* source, sl_uint64 nPackets, _StreamerBenchResult& result, LoopbackSink* sink)
+{
+	_StreamerBench_warmUp(graph, source, nPackets, sink);
+	_StreamerBench_feed(graph, source, nPackets, result);
+}
+
+static Ref<SyntheticSource> _StreamerBench_createDatagramSource(sl_uint32 size)
+{
+	SyntheticSourceParam param;
+	param.format = Packet::formatRaw;
+	param.sizePacket = size;
+	param.nPacketsPerSecond = 0;
+	return SyntheticSource::create(param);
+}
+
+static Ref<SyntheticSource> _StreamerBench_createAudioSource()
+{
+	// 20ms frames of 48kHz mono
+	SyntheticSourceParam param;
+	param.nPacketsPerSecond = 0;
+	return SyntheticSource::create(param);
+}
+
+static Ref<OpusEncoder> _StreamerBench_createEncoder()
+{
+	OpusEncoderParam param;
+	param.samplesPerSecond = 48000;
+	param.channelsCount = 1;
+	param.bitsPerSecond = 32000;
+	return OpusEncoder::create(param);
+}
+
+class _StreamerBenchPassFilter : public Filter
+{
+public:
+	using Filter::filter;
+
+	void filter(const Packet& input, PacketEmitter& emitter)
+	{
+		emitter.emit(input);
+	}
+
+};
+
+// counts the datagrams put on the emulated network
+class _StreamerBenchCountFilter : public Filter
+{
+public:
+	sl_uint64 count;
+
+public:
+	_StreamerBenchCountFilter()
+	{
+		count = 0;
+	}
+
+public:
+	using Filter::filter;
+
+	void filter(const Packet& input, PacketEmitter& emitter)
+	{
+		count++;
+		emitter.emit(input);
+	}
+
+};
+
+// writes the sending time in the payload, because NetworkUdpSource stamps the packets with the arrival time;
+// the payload is copied to a new buffer, as the buffer of the input may be shared with the other consumers of the packet
+class _StreamerBenchStampFilter : public Filter
+{
+public:
+	using Filter::filter;
+
+	void filter(const Packet& input, PacketEmitter& emitter)
+	{
+		sl_size size = input.data.getSize();
+		if (size < 8) {
+			return;
+		}
+		Packet packet = input;
+		if (!(packet.data.copyFrom(input.data.getData(), size, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM))) {
+			return;
+		}
+		sl_int64 now = Packet::getCurrentTimestamp();
+		Base::copyMemory(packet.data.getData(), &now, 8);
+		emitter.emit(packet);
+	}
+
+};
+
+class _StreamerBenchUnstampFilter : public Filter
+{
+public:
+	using Filter::filter;
+
+	void filter(const Packet& input, PacketEmitter& emitter)
+	{
+		if (input.data.getSize() < 8) {
+			return;
+		}
+		Packet packet = input;
+		Base::copyMemory(&(packet.timestamp), input.data.getData(), 8);
+		emitter.emit(packet);
+	}
+
+};
+
+// the receiving loop of NetworkUdpSource before the readiness-driven receiving, as the baseline of the UDP scenarios:
+// polls the socket, copies every datagram, and sleeps 5ms whenever the socket is empty
+class _StreamerBenchLegacyUdpSource : public Source
+{
+public:
+	static Ref<_StreamerBenchLegacyUdpSource> create(const SocketAddress& addressBind, sl_uint32 sizeQueue)
+	{
+		Ref<Socket> socket = Socket::openUdp();
+		if (socket.isNull() || !(socket->bind(addressBind))) {
+			return sl_null;
+		}
+		socket->setNonBlockingMode(sl_true);
+		Ref<_StreamerBenchLegacyUdpSource> ret = new _StreamerBenchLegacyUdpSource;
+		if (ret.isNull()) {
+			return sl_null;
+		}
+		ret->m_queue = PacketQueue::create(sizeQueue, PacketQueue::overflowDropOldest);
+		ret->m_event = Event::create();
+		if (ret->m_queue.isNull() || ret->m_event.isNull()) {
+			return sl_null;
+		}
+		ret->m_thread = Thread::start(Function<void()>::bind(&_StreamerBenchLegacyUdpSource::run, socket, ret->m_queue, ret->m_event));
+		if (ret->m_thread.isNull()) {
+			return sl_null;
+		}
+		return ret;
+	}
+
+	~_StreamerBenchLegacyUdpSource()
+	{
+		if (m_thread.isNotNull()) {
+			m_thread->finishAndWait();
+		}
+	}
+
+	sl_uint64 getDroppedCount()
+	{
+		return m_queue->getDroppedCount();
+	}
+
+public:
+	Ref<Event> getEvent()
+	{
+		return m_event;
+	}
+
+	sl_bool receivePacket(Packet* out)
+	{
+		return m_queue->pop(out);
+	}
+
+private:
+	static void run(Ref<Socket> socket, Ref<PacketQueue> queue, Ref<Event> event)
+	{
+		char buf[2000];
+		while (!(Thread::isStoppingCurrent())) {
+			SocketAddress address;
+			sl_int32 n = socket->receiveFrom(address, buf, sizeof(buf));
+			if (n > 0) {
+				Packet packet;
+				packet.format = Packet::formatRaw;
+				packet.networkParam.from = address;
+				packet.timestamp = Packet::getCurrentTimestamp();
+				if (packet.data.copyFrom(buf, n, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM)) {
+					queue->push(packet);
+					event->set();
+				}
+			} else {
+				Thread::sleep(5);
+			}
+		}
+	}
+
+private:
+	Ref<PacketQueue> m_queue;
+	Ref<Event> m_event;
+	Ref<Thread> m_thread;
+
+};
+
+static void _StreamerBench_runGraphFeed(sl_uint64 nPackets)
+{
+	for (sl_uint32 k = 0; k < 3; k++) {
+		sl_uint32 nFilters = k ? 8 : 0;
+		sl_bool flagStatistics = k == 2;
+		const char* scenario = k == 0 ? "graph.feed.direct" : (k == 1 ? "graph.feed.filters8" : "graph.feed.filters8.statistics");
+		if (!(_StreamerBench_isSelected(scenario))) {
+			continue;
+		}
+		Ref<SyntheticSource> source = _StreamerBench_createAudioSource();
+		Ref<LoopbackSink> sink = LoopbackSink::create();
+		Ref<Graph> graph = Graph::create();
+		if (source.isNull() || sink.isNull() || graph.isNull()) {
+			_StreamerBench_printUnavailable(scenario, "create");
+			continue;
+		}
+		for (sl_uint32 i = 0; i < nFilters; i++) {
+			graph->addFilter(new _StreamerBenchPassFilter);
+		}
+		graph->setSink(sink);
+		graph->setStatisticsEnabled(flagStatistics);
+		_StreamerBenchResult result;
+		_StreamerBench_run(graph.get(), source.get(), nPackets, result, sink.get());
+		char extra[64];
+		snprintf(extra, sizeof(extra), ",\"filters\":%u", nFilters);
+		_StreamerBench_print(scenario, result, extra);
+	}
+}
+
+static void _StreamerBench_runHash(sl_uint64 nPackets)
+{
+	static const sl_uint32 sizes[] = {200, 1400};
+	for (sl_uint32 k = 0; k < 2; k++) {
+		char scenario[64];
+		snprintf(scenario, sizeof(scenario), "hash.sha256.%u", sizes[k]);
+		if (!(_StreamerBench_isSelected(scenario))) {
+			continue;
+		}
+		Ref<SyntheticSource> source = _StreamerBench_createDatagramSource(sizes[k]);
+		Ref<LoopbackSink> sink = LoopbackSink::create();
+		Ref<Graph> graph = Graph::create();
+		if (source.isNull() || sink.isNull() || graph.isNull()) {
+			_StreamerBench_printUnavailable(scenario, "create");
+			continue;
+		}
+		graph->addFilter(new DatagramHashSHA256SendFilter);
+		graph->addFilter(new DatagramHashSHA256ReceiveFilter);
+		graph->setSink(sink);
+		_StreamerBenchResult result;
+		_StreamerBench_run(graph.get(), source.get(), nPackets, result, sink.get());
+		LoopbackSinkStatistics statistics;
+		sink->getStatistics(statistics);
+		char extra[128];
+		snprintf(extra, sizeof(extra), ",\"bytes\":%u,\"verified\":%llu", sizes[k], (unsigned long long)(statistics.countPackets));
+		_StreamerBench_print(scenario, result, extra);
+	}
+}
+
+static void _StreamerBench_runAead(sl_uint64 nPackets)
+{
+	if (_StreamerBench_isSelected("aead.selftest")) {
+		printf("{\"scenario\":\"aead.selftest\",\"passed\":%s}\n", AeadCipher::runSelfTest() ? "true" : "false");
+		fflush(stdout);
+	}
+	static const sl_uint32 sizes[] = {200, 1400};
+	static const AeadCipher::Algorithm algorithms[] = {AeadCipher::algorithmAES_GCM, AeadCipher::algorithmChaCha20_Poly1305};
+	static const char* names[] = {"aes_gcm", "chacha20_poly1305"};
+	sl_uint8 key[32];
+	for (sl_uint32 i = 0; i < 32; i++) {
+		key[i] = (sl_uint8)(i * 7 + 1);
+	}
+	for (sl_uint32 a = 0; a < 2; a++) {
+		for (sl_uint32 k = 0; k < 2; k++) {
+			char scenario[64];
+			snprintf(scenario, sizeof(scenario), "aead.%s.%u", names[a], sizes[k]);
+			if (!(_StreamerBench_isSelected(scenario))) {
+				continue;
+			}
+			Ref<AeadCipher> cipher = AeadCipher::create(algorithms[a], key, 32);
+			Ref<SyntheticSource> source = _StreamerBench_createDatagramSource(sizes[k]);
+			Ref<LoopbackSink> sink = LoopbackSink::create();
+			Ref<Graph> graph = Graph::create();
+			if (cipher.isNull() || source.isNull() || sink.isNull() || graph.isNull()) {
+				_StreamerBench_printUnavailable(scenario, "create");
+				continue;
+			}
+			graph->addFilter(new DatagramAeadSendFilter(cipher));
+			graph->addFilter(new DatagramAeadReceiveFilter(cipher));
+			graph->setSink(sink);
+			_StreamerBenchResult result;
+			_StreamerBench_run(graph.get(), source.get(), nPackets, result, sink.get());
+			LoopbackSinkStatistics statistics;
+			sink->getStatistics(statistics);
+			char extra[128];
+			snprintf(extra, sizeof(extra), ",\"bytes\":%u,\"accelerated\":%s,\"verified\":%llu", sizes[k], cipher->isAccelerated() ? "true" : "false", (unsigned long long)(statistics.countPackets));
+			_StreamerBench_print(scenario, result, extra);
+		}
+	}
+}
+
+struct _StreamerBenchFecCode
+{
+	const char* name;
+	// 0: DatagramErrorCorrection filters of `level` 1
+	sl_uint32 nData;
+	sl_uint32 nParity;
+	sl_uint32 interleave;
+};
+
+static void _StreamerBench_runFec(sl_uint64 nPackets)
+{
+	static const _StreamerBenchFecCode codes[] = {
+		{"xor.4+1", 4, 1, 1},
+		{"rs.8+2", 8, 2, 1},
+		{"rs.8+2.interleave4", 8, 2, 4},
+		{"ecc.1", 0, 0, 0}
+	};
+	// percent of the datagrams lost in bursts of 1.5 datagrams on average
+	static const sl_uint32 losses[] = {0, 5};
+	for (sl_uint32 c = 0; c < sizeof(codes) / sizeof(codes[0]); c++) {
+		const _StreamerBenchFecCode& code = codes[c];
+		for (sl_uint32 k = 0; k < 2; k++) {
+			char scenario[64];
+			snprintf(scenario, sizeof(scenario), "fec.%s.loss%u", code.name, losses[k]);
+			if (!(_StreamerBench_isSelected(scenario))) {
+				continue;
+			}
+			Ref<SyntheticSource> source = _StreamerBench_createDatagramSource(1000);
+			Ref<LoopbackSink> sink = LoopbackSink::create();
+			Ref<Graph> graph = Graph::create();
+			Ref<_StreamerBenchCountFilter> counter = new _StreamerBenchCountFilter;
+			Ref<NetworkImpairmentFilter> impairment = new NetworkImpairmentFilter(c + 1);
+			if (source.isNull() || sink.isNull() || graph.isNull() || counter.isNull() || impairment.isNull()) {
+				_StreamerBench_printUnavailable(scenario, "create");
+				continue;
+			}
+			impairment->setLossRate((float)(losses[k]) / 100);
+			impairment->setMeanBurstLength(1.5f);
+			if (code.nData) {
+				graph->addFilter(new DatagramFecSendFilter(code.nData, code.nParity, code.interleave));
+			} else {
+				graph->addFilter(new DatagramErrorCorrectionSendFilter(1));
+			}
+			graph->addFilter(counter);
+			graph->addFilter(impairment);
+			if (code.nData) {
+				graph->addFilter(new DatagramFecReceiveFilter);
+			} else {
+				graph->addFilter(new DatagramErrorCorrectionReceiveFilter);
+			}
+			graph->setSink(sink);
+			_StreamerBench_warmUp(graph.get(), source.get(), nPackets, sink.get());
+			sl_uint64 countSent = counter->count;
+			sl_uint64 countLost = impairment->getLostCount();
+			_StreamerBenchResult result;
+			_StreamerBench_feed(graph.get(), source.get(), nPackets, result);
+			countSent = counter->count - countSent;
+			countLost = impairment->getLostCount() - countLost;
+			LoopbackSinkStatistics statistics;
+			sink->getStatistics(statistics);
+			sl_uint64 countReceived = statistics.countPackets - statistics.countDuplicated;
+			double n = result.countPackets ? (double)(result.countPackets) : 1;
+			char extra[256];
+			snprintf(extra, sizeof(extra), ",\"bytes\":1000,\"datagrams_per_packet\":%.3f,\"loss_network\":%.4f,\"loss_residual\":%.4f,\"reordered\":%llu",
+				(double)countSent / n,
+				countSent ? (double)countLost / (double)countSent : 0.0,
+				countReceived < result.countPackets ? (double)(result.countPackets - countReceived) / n : 0.0,
+				(unsigned long long)(statistics.countReordered));
+			_StreamerBench_print(scenario, result, extra);
+		}
+	}
+}
+
+// returns the source of `nPackets` Opus packets, encoded with the redundancy when `fecPercentage` is not 0, and lost by `lossPercentage`
+static Ref<Source> _StreamerBench_encodeOpus(sl_uint64 nPackets, sl_uint32 fecPercentage, sl_uint32 lossPercentage, sl_uint64& countLost)
+{
+	countLost = 0;
+	Ref<OpusEncoder> encoder = _StreamerBench_createEncoder();
+	Ref<SyntheticSource> source = _StreamerBench_createAudioSource();
+	Ref<LoopbackSink> sink = LoopbackSink::create((sl_uint32)nPackets);
+	Ref<Graph> graph = Graph::create();
+	if (encoder.isNull() || source.isNull() || sink.isNull() || graph.isNull()) {
+		return sl_null;
+	}
+	Ref<AudioOpusEncodeFilter> filter = new AudioOpusEncodeFilter(encoder);
+	if (filter.isNull()) {
+		return sl_null;
+	}
+	filter->setFecPercentage(fecPercentage);
+	filter->setExpectedLossPercentage(lossPercentage);
+	graph->addFilter(filter);
+	Ref<NetworkImpairmentFilter> impairment;
+	if (lossPercentage) {
+		impairment = new NetworkImpairmentFilter(7);
+		if (impairment.isNull()) {
+			return sl_null;
+		}
+		impairment->setLossRate((float)lossPercentage / 100);
+		impairment->setMeanBurstLength(1.5f);
+		graph->addFilter(impairment);
+	}
+	graph->setSink(sink);
+	_StreamerBenchResult result;
+	_StreamerBench_feed(graph.get(), source.get(), nPackets, result);
+	if (impairment.isNotNull()) {
+		countLost = impairment->getLostCount();
+	}
+	return sink->getSource();
+}
+
+static void _StreamerBench_runOpus(sl_uint64 nPackets)
+{
+	for (sl_uint32 k = 0; k < 2; k++) {
+		const char* scenario = k ? "opus.encode.red" : "opus.encode";
+		if (!(_StreamerBench_isSelected(scenario))) {
+			continue;
+		}
+		Ref<OpusEncoder> encoder = _StreamerBench_createEncoder();
+		Ref<SyntheticSource> source = _StreamerBench_createAudioSource();
+		Ref<LoopbackSink> sink = LoopbackSink::create();
+		Ref<Graph> graph = Graph::create();
+		if (encoder.isNull() || source.isNull() || sink.isNull() || graph.isNull()) {
+			_StreamerBench_printUnavailable(scenario, "create");
+			continue;
+		}
+		Ref<AudioOpusEncodeFilter> filter = new AudioOpusEncodeFilter(encoder);
+		if (k) {
+			filter->setFecPercentage(100);
+			filter->setExpectedLossPercentage(20);
+		}
+		graph->addFilter(filter);
+		graph->setSink(sink);
+		_StreamerBenchResult result;
+		_StreamerBench_run(graph.get(), source.get(), nPackets, result, sink.get());
+		LoopbackSinkStatistics statistics;
+		sink->getStatistics(statistics);
+		char extra[128];
+		snprintf(extra, sizeof(extra), ",\"bytes_per_packet\":%.1f", statistics.countPackets ? (double)(statistics.sizeBytes) / (double)(statistics.countPackets) : 0.0);
+		_StreamerBench_print(scenario, result, extra);
+	}
+	for (sl_uint32 k = 0; k < 2; k++) {
+		const char* scenario = k ? "opus.decode.red.loss10" : "opus.decode";
+		if (!(_StreamerBench_isSelected(scenario))) {
+			continue;
+		}
+		sl_uint64 countLost;
+		Ref<Source> source = _StreamerBench_encodeOpus(nPackets, k ? 100 : 0, k ? 10 : 0, countLost);
+		Ref<OpusDecoder> decoder = OpusDecoder::create(48000, 1);
+		Ref<LoopbackSink> sink = LoopbackSink::create();
+		Ref<Graph> graph = Graph::create();
+		if (source.isNull() || decoder.isNull() || sink.isNull() || graph.isNull()) {
+			_StreamerBench_printUnavailable(scenario, "create");
+			continue;
+		}
+		graph->addFilter(new AudioOpusDecodeFilter(decoder));
+		graph->setSink(sink);
+		_StreamerBenchResult result;
+		_StreamerBench_feed(graph.get(), source.get(), nPackets, result);
+		LoopbackSinkStatistics statistics;
+		sink->getStatistics(statistics);
+		char extra[128];
+		snprintf(extra, sizeof(extra), ",\"lost\":%llu,\"frames_out\":%llu", (unsigned long long)countLost, (unsigned long long)(statistics.countPackets));
+		_StreamerBench_print(scenario, result, extra);
+	}
+}
+
+static void _StreamerBench_onEncoded(Ref<LoopbackSink> sink, const Packet& packet)
+{
+	sink->sendPacket(packet);
+}
+
+static void _StreamerBench_runEncodeService(sl_uint64 nPackets)
+{
+	static const sl_uint32 counts[] = {64, 1024};
+	for (sl_uint32 k = 0; k < 2; k++) {
+		char scenario[64];
+		sl_uint32 nStreams = counts[k];
+		snprintf(scenario, sizeof(scenario), "encode_service.streams%u", nStreams);
+		if (!(_StreamerBench_isSelected(scenario))) {
+			continue;
+		}
+		sl_uint32 nFrames = (sl_uint32)(nPackets / nStreams);
+		if (!nFrames) {
+			nFrames = 1;
+		}
+		Ref<SyntheticSource> source = _StreamerBench_createAudioSource();
+		Ref<LoopbackSink> sink = LoopbackSink::create();
+		Ref<OpusEncodeService> service = OpusEncodeService::create();
+		if (source.isNull() || sink.isNull() || service.isNull()) {
+			_StreamerBench_printUnavailable(scenario, "create");
+			continue;
+		}
+		Function<void(const Packet&)> callback = Function<void(const Packet&)>::bind(&_StreamerBench_onEncoded, sink);
+		List< Ref<OpusEncodeStream> > streams;
+		for (sl_uint32 i = 0; i < nStreams; i++) {
+			Ref<OpusEncodeStream> stream = service->addStream(_StreamerBench_createEncoder(), callback);
+			if (stream.isNull()) {
+				break;
+			}
+			// all the frames of the run are submitted at once
+			stream->setMaxQueuedFrames(nFrames + 1);
+			streams.add(stream);
+		}
+		if (streams.getCount() != nStreams) {
+			_StreamerBench_printUnavailable(scenario, "stream");
+			service->release();
+			continue;
+		}
+		Packet frame;
+		if (!(source->receivePacket(&frame))) {
+			_StreamerBench_printUnavailable(scenario, "frame");
+			service->release();
+			continue;
+		}
+		ListLocker< Ref<OpusEncodeStream> > list(streams);
+		sl_int64 countAllocations = _StreamerBench_getAllocationsCount();
+		sl_int64 timeStart = Packet::getCurrentTimestamp();
+		sl_uint64 countSubmitted = 0;
+		for (sl_uint32 f = 0; f < nFrames; f++) {
+			for (sl_uint32 i = 0; i < nStreams; i++) {
+				Packet packet = frame;
+				packet.sequence = f;
+				packet.streamId = i;
+				packet.timestamp = Packet::getCurrentTimestamp();
+				if (list[i]->sendPacket(packet)) {
+					countSubmitted++;
+				}
+			}
+		}
+		LoopbackSinkStatistics statistics;
+		for (sl_uint32 t = 0; t < STREAMER_BENCH_WAIT_TIMEOUT; t++) {
+			sink->getStatistics(statistics);
+			if (statistics.countPackets >= countSubmitted) {
+				break;
+			}
+			Thread::sleep(1);
+		}
+		_StreamerBenchResult result;
+		result.timeTotal = Packet::getCurrentTimestamp() - timeStart;
+		result.countAllocations = _StreamerBench_getAllocationsCount() - countAllocations;
+		result.countPackets = statistics.countPackets;
+		result.latency = statistics.age;
+		char extra[128];
+		snprintf(extra, sizeof(extra), ",\"streams\":%u,\"threads\":%u,\"submitted\":%llu", nStreams, service->getThreadsCount(), (unsigned long long)countSubmitted);
+		_StreamerBench_print(scenario, result, extra);
+		service->release();
+	}
+}
+
+struct _StreamerBenchUdpCase
+{
+	const char* name;
+	// 0: as fast as the graph sends
+	sl_uint32 nPacketsPerSecond;
+	// 0: _StreamerBenchLegacyUdpSource
+	sl_uint32 receiveBatchSize;
+	sl_bool flagSendBatch;
+};
+
+static void _StreamerBench_runUdp(sl_uint64 nPackets)
+{
+	static const _StreamerBenchUdpCase cases[] = {
+		{"udp.paced1000.legacy", 1000, 0, sl_false},
+		{"udp.paced1000.batch1", 1000, 1, sl_false},
+		{"udp.paced1000.batch16", 1000, 16, sl_false},
+		{"udp.flood.legacy", 0, 0, sl_false},
+		{"udp.flood.batch16", 0, 16, sl_false},
+		{"udp.flood.batch16.sendbatch", 0, 16, sl_true}
+	};
+	for (sl_uint32 c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+		const _StreamerBenchUdpCase& param = cases[c];
+		if (!(_StreamerBench_isSelected(param.name))) {
+			continue;
+		}
+		sl_uint64 n = param.nPacketsPerSecond ? nPackets / STREAMER_BENCH_UDP_DIVIDER : nPackets;
+		if (!n) {
+			n = 1;
+		}
+		SocketAddress addressReceive, addressSend;
+		char address[64];
+		snprintf(address, sizeof(address), "127.0.0.1:%u", STREAMER_BENCH_UDP_PORT + c * 2);
+		addressReceive.parse(address);
+		snprintf(address, sizeof(address), "127.0.0.1:%u", STREAMER_BENCH_UDP_PORT + c * 2 + 1);
+		addressSend.parse(address);
+
+		SyntheticSourceParam paramSource;
+		paramSource.format = Packet::formatRaw;
+		paramSource.sizePacket = 200;
+		paramSource.nPacketsPerSecond = param.nPacketsPerSecond;
+		paramSource.nPackets = n;
+
+		Ref<NetworkUdpSource> udpSource;
+		Ref<_StreamerBenchLegacyUdpSource> legacySource;
+		if (param.receiveBatchSize) {
+			udpSource = NetworkUdpSource::create(addressReceive);
+			if (udpSource.isNotNull()) {
+				udpSource->setReceiveBatchSize(param.receiveBatchSize);
+				udpSource->setQueueSize(4096);
+			}
+		} else {
+			legacySource = _StreamerBenchLegacyUdpSource::create(addressReceive, 4096);
+		}
+		Ref<LoopbackSink> sink = LoopbackSink::create();
+		Ref<Graph> graphReceive = Graph::create();
+		Ref<NetworkUdpSink> udpSink = NetworkUdpSink::create(addressSend, addressReceive);
+		Ref<Graph> graphSend = Graph::create();
+		if ((udpSource.isNull() && legacySource.isNull()) || sink.isNull() || graphReceive.isNull() || udpSink.isNull() || graphSend.isNull()) {
+			_StreamerBench_printUnavailable(param.name, "socket");
+			continue;
+		}
+		if (udpSource.isNotNull()) {
+			graphReceive->setSource(udpSource);
+		} else {
+			graphReceive->setSource(legacySource);
+		}
+		graphReceive->addFilter(new _StreamerBenchUnstampFilter);
+		graphReceive->setSink(sink);
+		udpSink->setBatchMode(param.flagSendBatch);
+		graphSend->addFilter(new _StreamerBenchStampFilter);
+		graphSend->setSink(udpSink);
+		if (!(graphReceive->start())) {
+			_StreamerBench_printUnavailable(param.name, "start");
+			continue;
+		}
+
+		sl_int64 countAllocations = _StreamerBench_getAllocationsCount();
+		sl_int64 timeStart = Packet::getCurrentTimestamp();
+		Ref<SyntheticSource> source = SyntheticSource::create(paramSource);
+		if (source.isNull()) {
+			graphReceive->release();
+			_StreamerBench_printUnavailable(param.name, "create");
+			continue;
+		}
+		graphSend->setSource(source);
+		if (!(graphSend->start())) {
+			graphReceive->release();
+			_StreamerBench_printUnavailable(param.name, "start");
+			continue;
+		}
+		LoopbackSinkStatistics statistics;
+		sl_uint64 countLast = 0;
+		sl_int64 timeLast = timeStart;
+		// until all the packets arrive, or nothing arrives for the drain time after the last one is sent
+		for (sl_uint32 t = 0; t < STREAMER_BENCH_WAIT_TIMEOUT; t++) {
+			Thread::sleep(1);
+			sink->getStatistics(statistics);
+			sl_int64 now = Packet::getCurrentTimestamp();
+			if (statistics.countPackets != countLast) {
+				countLast = statistics.countPackets;
+				timeLast = now;
+			}
+			if (countLast >= n) {
+				break;
+			}
+			if (source->isFinished() && now - timeLast > (sl_int64)STREAMER_BENCH_UDP_DRAIN_TIME * 1000000) {
+				break;
+			}
+		}
+		graphSend->release();
+		graphReceive->release();
+		sink->getStatistics(statistics);
+
+		_StreamerBenchResult result;
+		// to the last arrival
+		result.timeTotal = timeLast - timeStart;
+		result.countAllocations = _StreamerBench_getAllocationsCount() - countAllocations;
+		result.countPackets = statistics.countPackets;
+		result.latency = statistics.age;
+		char extra[256];
+		snprintf(extra, sizeof(extra), ",\"bytes\":200,\"rate\":%u,\"receive_batch\":%u,\"legacy\":%s,\"send_batch\":%s,\"sent\":%llu,\"lost\":%llu,\"dropped_queue\":%llu",
+			param.nPacketsPerSecond, param.receiveBatchSize, param.receiveBatchSize ? "false" : "true", param.flagSendBatch ? "true" : "false",
+			(unsigned long long)(source->getGeneratedCount()),
+			(unsigned long long)(n > statistics.countPackets ? n - statistics.countPackets : 0),
+			(unsigned long long)(udpSource.isNotNull() ? udpSource->getDroppedCount() : legacySource->getDroppedCount()));
+		_StreamerBench_print(param.name, result, extra);
+	}
+}
+
+int main(int argc, const char* argv[])
+{
+	if (argc > 1) {
+		_g_StreamerBench_prefix = argv[1];
+	}
+	sl_uint64 nPackets = STREAMER_BENCH_DEFAULT_PACKETS;
+	if (argc > 2) {
+		nPackets = (sl_uint64)(strtoull(argv[2], sl_null, 10));
+		if (!nPackets) {
+			fprintf(stderr, "usage: %s [scenario prefix] [packets]\n", argv[0]);
+			return 1;
+		}
+	}
+	sl_uint64 nCodecPackets = nPackets / STREAMER_BENCH_OPUS_DIVIDER;
+	if (!nCodecPackets) {
+		nCodecPackets = 1;
+	}
+	_StreamerBench_runGraphFeed(nPackets);
+	_StreamerBench_runHash(nPackets);
+	_StreamerBench_runAead(nPackets);
+	_StreamerBench_runFec(nPackets);
+	_StreamerBench_runOpus(nCodecPackets);
+	_StreamerBench_runEncodeService(nCodecPackets);
+	_StreamerBench_runUdp(nPackets);
+	return 0;
+}
@@ -0,0 +1,1100 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "../../../inc/slibx/streamer/aead.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STREAMER_AEAD_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		SLIB_INLINE static sl_uint32 _Aead_readBE32(const sl_uint8* p)
+		{
+			return ((sl_uint32)(p[0]) << 24) | ((sl_uint32)(p[1]) << 16) | ((sl_uint32)(p[2]) << 8) | (sl_uint32)(p[3]);
+		}
+		
+		SLIB_INLINE static void _Aead_writeBE32(sl_uint8* p, sl_uint32 v)
+		{
+			p[0] = (sl_uint8)(v >> 24);
+			p[1] = (sl_uint8)(v >> 16);
+			p[2] = (sl_uint8)(v >> 8);
+			p[3] = (sl_uint8)v;
+		}
+		
+		SLIB_INLINE static sl_uint32 _Aead_readLE32(const sl_uint8* p)
+		{
+			return (sl_uint32)(p[0]) | ((sl_uint32)(p[1]) << 8) | ((sl_uint32)(p[2]) << 16) | ((sl_uint32)(p[3]) << 24);
+		}
+		
+		SLIB_INLINE static void _Aead_writeLE32(sl_uint8* p, sl_uint32 v)
+		{
+			p[0] = (sl_uint8)v;
+			p[1] = (sl_uint8)(v >> 8);
+			p[2] = (sl_uint8)(v >> 16);
+			p[3] = (sl_uint8)(v >> 24);
+		}
+		
+		// constant time comparison of the tags
+		static sl_bool _Aead_equalsTag(const sl_uint8* a, const sl_uint8* b, sl_uint32 size)
+		{
+			sl_uint8 d = 0;
+			for (sl_uint32 i = 0; i < size; i++) {
+				d |= a[i] ^ b[i];
+			}
+			return d == 0;
+		}
+		
+		static sl_uint32 _Aead_clampTagSize(sl_uint32 size)
+		{
+			if (size < SLIB_STREAMER_AEAD_MIN_TAG_SIZE) {
+				return SLIB_STREAMER_AEAD_MIN_TAG_SIZE;
+			}
+			if (size > SLIB_STREAMER_AEAD_TAG_SIZE) {
+				return SLIB_STREAMER_AEAD_TAG_SIZE;
+			}
+			return size;
+		}
+		
+		
+		/*
+			AES-GCM
+			The portable path runs in constant time: AES is bitsliced over 4 blocks, and GHASH
+			multiplies bit by bit with masks, so neither the memory accesses nor the branches
+			depend on the key or the data.
+		*/
+		
+		// the bit `i` of the bytes of 4 blocks in one word each: the bit `16 * block + byte` of q[i]
+		SLIB_INLINE static sl_uint64 _Aes_transpose8(sl_uint64 x)
+		{
+			sl_uint64 t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+			x = x ^ t ^ (t << 7);
+			t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+			x = x ^ t ^ (t << 14);
+			t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+			return x ^ t ^ (t << 28);
+		}
+		
+		static void _Aes_load(const sl_uint8* src, sl_uint64* q)
+		{
+			for (sl_uint32 i = 0; i < 8; i++) {
+				q[i] = 0;
+			}
+			for (sl_uint32 m = 0; m < 8; m++) {
+				sl_uint64 x = 0;
+				for (sl_uint32 k = 0; k < 8; k++) {
+					x |= (sl_uint64)(src[(m << 3) + k]) << (k << 3);
+				}
+				x = _Aes_transpose8(x);
+				for (sl_uint32 i = 0; i < 8; i++) {
+					q[i] |= ((x >> (i << 3)) & 0xFF) << (m << 3);
+				}
+			}
+		}
+		
+		static void _Aes_store(const sl_uint64* q, sl_uint8* dst)
+		{
+			for (sl_uint32 m = 0; m < 8; m++) {
+				sl_uint64 x = 0;
+				for (sl_uint32 i = 0; i < 8; i++) {
+					x |= ((q[i] >> (m << 3)) & 0xFF) << (i << 3);
+				}
+				x = _Aes_transpose8(x);
+				for (sl_uint32 k = 0; k < 8; k++) {
+					dst[(m << 3) + k] = (sl_uint8)(x >> (k << 3));
+				}
+			}
+		}
+		
+		// the S-box circuit of Boyar and Peralta, applied to all the bytes at once
+		static void _Aes_subBytes(sl_uint64* q)
+		{
+			sl_uint64 x0 = q[7], x1 = q[6], x2 = q[5], x3 = q[4], x4 = q[3], x5 = q[2], x6 = q[1], x7 = q[0];
+			
+			sl_uint64 y14 = x3 ^ x5;
+			sl_uint64 y13 = x0 ^ x6;
+			sl_uint64 y9 = x0 ^ x3;
+			sl_uint64 y8 = x0 ^ x5;
+			sl_uint64 t0 = x1 ^ x2;
+			sl_uint64 y1 = t0 ^ x7;
+			sl_uint64 y4 = y1 ^ x3;
+			sl_uint64 y12 = y13 ^ y14;
+			sl_uint64 y2 = y1 ^ x0;
+			sl_uint64 y5 = y1 ^ x6;
+			sl_uint64 y3 = y5 ^ y8;
+			sl_uint64 t1 = x4 ^ y12;
+			sl_uint64 y15 = t1 ^ x5;
+			sl_uint64 y20 = t1 ^ x1;
+			sl_uint64 y6 = y15 ^ x7;
+			sl_uint64 y10 = y15 ^ t0;
+			sl_uint64 y11 = y20 ^ y9;
+			sl_uint64 y7 = x7 ^ y11;
+			sl_uint64 y17 = y10 ^ y11;
+			sl_uint64 y19 = y10 ^ y8;
+			sl_uint64 y16 = t0 ^ y11;
+			sl_uint64 y21 = y13 ^ y16;
+			sl_uint64 y18 = x0 ^ y16;
+			
+			sl_uint64 t2 = y12 & y15;
+			sl_uint64 t3 = y3 & y6;
+			sl_uint64 t4 = t3 ^ t2;
+			sl_uint64 t5 = y4 & x7;
+			sl_uint64 t6 = t5 ^ t2;
+			sl_uint64 t7 = y13 & y16;
+			sl_uint64 t8 = y5 & y1;
+			sl_uint64 t9 = t8 ^ t7;
+			sl_uint64 t10 = y2 & y7;
+			sl_uint64 t11 = t10 ^ t7;
+			sl_uint64 t12 = y9 & y11;
+			sl_uint64 t13 = y14 & y17;
+			sl_uint64 t14 = t13 ^ t12;
+			sl_uint64 t15 = y8 & y10;
+			sl_uint64 t16 = t15 ^ t12;
+			sl_uint64 t17 = t4 ^ t14;
+			sl_uint64 t18 = t6 ^ t16;
+			sl_uint64 t19 = t9 ^ t14;
+			sl_uint64 t20 = t11 ^ t16;
+			sl_uint64 t21 = t17 ^ y20;
+			sl_uint64 t22 = t18 ^ y19;
+			sl_uint64 t23 = t19 ^ y21;
+			sl_uint64 t24 = t20 ^ y18;
+			
+			sl_uint64 t25 = t21 ^ t22;
+			sl_uint64 t26 = t21 & t23;
+			sl_uint64 t27 = t24 ^ t26;
+			sl_uint64 t28 = t25 & t27;
+			sl_uint64 t29 = t28 ^ t22;
+			sl_uint64 t30 = t23 ^ t24;
+			sl_uint64 t31 = t22 ^ t26;
+			sl_uint64 t32 = t31 & t30;
+			sl_uint64 t33 = t32 ^ t24;
+			sl_uint64 t34 = t23 ^ t33;
+			sl_uint64 t35 = t27 ^ t33;
+			sl_uint64 t36 = t24 & t35;
+			sl_uint64 t37 = t36 ^ t34;
+			sl_uint64 t38 = t27 ^ t36;
+			sl_uint64 t39 = t29 & t38;
+			sl_uint64 t40 = t25 ^ t39;
+			
+			sl_uint64 t41 = t40 ^ t37;
+			sl_uint64 t42 = t29 ^ t33;
+			sl_uint64 t43 = t29 ^ t40;
+			sl_uint64 t44 = t33 ^ t37;
+			sl_uint64 t45 = t42 ^ t41;
+			sl_uint64 z0 = t44 & y15;
+			sl_uint64 z1 = t37 & y6;
+			sl_uint64 z2 = t33 & x7;
+			sl_uint64 z3 = t43 & y16;
+			sl_uint64 z4 = t40 & y1;
+			sl_uint64 z5 = t29 & y7;
+			sl_uint64 z6 = t42 & y11;
+			sl_uint64 z7 = t45 & y17;
+			sl_uint64 z8 = t41 & y10;
+			sl_uint64 z9 = t44 & y12;
+			sl_uint64 z10 = t37 & y3;
+			sl_uint64 z11 = t33 & y4;
+			sl_uint64 z12 = t43 & y13;
+			sl_uint64 z13 = t40 & y5;
+			sl_uint64 z14 = t29 & y2;
+			sl_uint64 z15 = t42 & y9;
+			sl_uint64 z16 = t45 & y14;
+			sl_uint64 z17 = t41 & y8;
+			
+			sl_uint64 t46 = z15 ^ z16;
+			sl_uint64 t47 = z10 ^ z11;
+			sl_uint64 t48 = z5 ^ z13;
+			sl_uint64 t49 = z9 ^ z10;
+			sl_uint64 t50 = z2 ^ z12;
+			sl_uint64 t51 = z2 ^ z5;
+			sl_uint64 t52 = z7 ^ z8;
+			sl_uint64 t53 = z0 ^ z3;
+			sl_uint64 t54 = z6 ^ z7;
+			sl_uint64 t55 = z16 ^ z17;
+			sl_uint64 t56 = z12 ^ t48;
+			sl_uint64 t57 = t50 ^ t53;
+			sl_uint64 t58 = z4 ^ t46;
+			sl_uint64 t59 = z3 ^ t54;
+			sl_uint64 t60 = t46 ^ t57;
+			sl_uint64 t61 = z14 ^ t57;
+			sl_uint64 t62 = t52 ^ t58;
+			sl_uint64 t63 = t49 ^ t58;
+			sl_uint64 t64 = z4 ^ t59;
+			sl_uint64 t65 = t61 ^ t62;
+			sl_uint64 t66 = z1 ^ t63;
+			sl_uint64 s0 = t59 ^ t63;
+			sl_uint64 s6 = t56 ^ ~t62;
+			sl_uint64 s7 = t48 ^ ~t60;
+			sl_uint64 t67 = t64 ^ t65;
+			sl_uint64 s3 = t53 ^ t66;
+			sl_uint64 s4 = t51 ^ t66;
+			sl_uint64 s5 = t47 ^ t65;
+			sl_uint64 s1 = t64 ^ ~s3;
+			sl_uint64 s2 = t55 ^ ~t67;
+			
+			q[7] = s0;
+			q[6] = s1;
+			q[5] = s2;
+			q[4] = s3;
+			q[3] = s4;
+			q[2] = s5;
+			q[1] = s6;
+			q[0] = s7;
+		}
+		
+		// the byte `r + 4 * c` of a block is on the row `r` and the column `c`
+		static void _Aes_shiftRows(sl_uint64* q)
+		{
+			for (sl_uint32 i = 0; i < 8; i++) {
+				sl_uint64 x = q[i];
+				sl_uint64 r1 = x & 0x2222222222222222ULL;
+				sl_uint64 r2 = x & 0x4444444444444444ULL;
+				sl_uint64 r3 = x & 0x8888888888888888ULL;
+				q[i] = (x & 0x1111111111111111ULL)
+					| ((r1 >> 4) & 0x0FFF0FFF0FFF0FFFULL) | ((r1 << 12) & 0xF000F000F000F000ULL)
+					| ((r2 >> 8) & 0x00FF00FF00FF00FFULL) | ((r2 << 8) & 0xFF00FF00FF00FF00ULL)
+					| ((r3 >> 12) & 0x000F000F000F000FULL) | ((r3 << 4) & 0xFFF0FFF0FFF0FFF0ULL);
+			}
+		}
+		
+#define AES_ROTATE_ROWS1(x) ((((x) >> 1) & 0x7777777777777777ULL) | (((x) << 3) & 0x8888888888888888ULL))
+#define AES_ROTATE_ROWS2(x) ((((x) >> 2) & 0x3333333333333333ULL) | (((x) << 2) & 0xCCCCCCCCCCCCCCCCULL))
+#define AES_ROTATE_ROWS3(x) ((((x) >> 3) & 0x1111111111111111ULL) | (((x) << 1) & 0xEEEEEEEEEEEEEEEEULL))
+		
+		// out[r] = 2 * (a[r] ^ a[r + 1]) ^ a[r + 1] ^ a[r + 2] ^ a[r + 3] on every column
+		static void _Aes_mixColumns(sl_uint64* q)
+		{
+			sl_uint64 t[8];
+			sl_uint64 u[8];
+			for (sl_uint32 i = 0; i < 8; i++) {
+				sl_uint64 a1 = AES_ROTATE_ROWS1(q[i]);
+				t[i] = q[i] ^ a1;
+				u[i] = a1 ^ AES_ROTATE_ROWS2(q[i]) ^ AES_ROTATE_ROWS3(q[i]);
+			}
+			// multiplication by 2 modulo x^8 + x^4 + x^3 + x + 1
+			q[0] = t[7] ^ u[0];
+			q[1] = t[0] ^ t[7] ^ u[1];
+			q[2] = t[1] ^ u[2];
+			q[3] = t[2] ^ t[7] ^ u[3];
+			q[4] = t[3] ^ t[7] ^ u[4];
+			q[5] = t[4] ^ u[5];
+			q[6] = t[5] ^ u[6];
+			q[7] = t[6] ^ u[7];
+		}
+		
+		// SubWord of the key expansion on the big endian word
+		static sl_uint32 _Aes_subWord(sl_uint32 w)
+		{
+			sl_uint8 bytes[64] = {0};
+			_Aead_writeBE32(bytes, w);
+			sl_uint64 q[8];
+			_Aes_load(bytes, q);
+			_Aes_subBytes(q);
+			_Aes_store(q, bytes);
+			return _Aead_readBE32(bytes);
+		}
+		
+		class _AeadCipher_AesGcm;
+		
+		// src and dst may be same; `counter` is the counter of the first block
+		typedef void (*_AesGcm_CtrFunc)(const _AeadCipher_AesGcm* aes, const sl_uint8* nonce, sl_uint32 counter, const sl_uint8* src, sl_uint8* dst, sl_size size);
+		
+		// absorbs the data into the hash state `x`, padding the last block with zeros
+		typedef void (*_AesGcm_GhashFunc)(const _AeadCipher_AesGcm* aes, sl_uint8* x, const sl_uint8* data, sl_size size);
+		
+		class _AeadCipher_AesGcm : public AeadCipher
+		{
+		public:
+			// bytes for AES-NI, and the bit planes (see _Aes_load) for the bitsliced rounds
+			sl_uint8 roundKeyBytes[240];
+			sl_uint64 roundKeyPlanes[15][8];
+			sl_uint32 nRounds;
+			// hash key, and its big endian halves
+			sl_uint8 H[16];
+			sl_uint64 HH;
+			sl_uint64 HL;
+			
+			_AesGcm_CtrFunc funcCtr;
+			_AesGcm_GhashFunc funcGhash;
+			sl_bool flagAccelerated;
+			
+		public:
+			sl_bool initialize(const void* _key, sl_uint32 sizeKey);
+			
+			// encrypts 4 blocks (64 bytes)
+			void encryptBlocks(const sl_uint8* src, sl_uint8* dst) const;
+			
+			void encryptBlock(const sl_uint8* src, sl_uint8* dst) const;
+			
+			void multiplyH(sl_uint8* x) const;
+			
+			void computeTag(const sl_uint8* nonce, const void* aad, sl_size sizeAad, const sl_uint8* cipherText, sl_size size, sl_uint8* tag);
+			
+		public:
+			// override
+			Algorithm getAlgorithm()
+			{
+				return algorithmAES_GCM;
+			}
+			
+			// override
+			sl_bool isAccelerated()
+			{
+				return flagAccelerated;
+			}
+			
+			// override
+			void encrypt(const sl_uint8* nonce, const void* aad, sl_size sizeAad, const void* src, void* dst, sl_size size, sl_uint8* tag, sl_uint32 sizeTag)
+			{
+				funcCtr(this, nonce, 2, (const sl_uint8*)src, (sl_uint8*)dst, size);
+				sl_uint8 t[16];
+				computeTag(nonce, aad, sizeAad, (const sl_uint8*)dst, size, t);
+				Base::copyMemory(tag, t, _Aead_clampTagSize(sizeTag));
+			}
+			
+			// override
+			sl_bool decrypt(const sl_uint8* nonce, const void* aad, sl_size sizeAad, const void* src, void* dst, sl_size size, const sl_uint8* tag, sl_uint32 sizeTag)
+			{
+				sl_uint8 t[16];
+				computeTag(nonce, aad, sizeAad, (const sl_uint8*)src, size, t);
+				if (!(_Aead_equalsTag(t, tag, _Aead_clampTagSize(sizeTag)))) {
+					return sl_false;
+				}
+				funcCtr(this, nonce, 2, (const sl_uint8*)src, (sl_uint8*)dst, size);
+				return sl_true;
+			}
+			
+		};
+		
+		static void _AesGcm_ctr_Scalar(const _AeadCipher_AesGcm* aes, const sl_uint8* nonce, sl_uint32 counter, const sl_uint8* src, sl_uint8* dst, sl_size size)
+		{
+			sl_uint8 blocks[64];
+			sl_uint8 stream[64];
+			for (sl_uint32 k = 0; k < 4; k++) {
+				Base::copyMemory(blocks + (k << 4), nonce, 12);
+			}
+			while (size) {
+				for (sl_uint32 k = 0; k < 4; k++) {
+					_Aead_writeBE32(blocks + (k << 4) + 12, counter + k);
+				}
+				counter += 4;
+				aes->encryptBlocks(blocks, stream);
+				sl_size n = size < 64 ? size : 64;
+				for (sl_size i = 0; i < n; i++) {
+					dst[i] = src[i] ^ stream[i];
+				}
+				src += n;
+				dst += n;
+				size -= n;
+			}
+		}
+		
+		static void _AesGcm_ghash_Scalar(const _AeadCipher_AesGcm* aes, sl_uint8* x, const sl_uint8* data, sl_size size)
+		{
+			while (size) {
+				sl_size n = size < 16 ? size : 16;
+				for (sl_size i = 0; i < n; i++) {
+					x[i] ^= data[i];
+				}
+				aes->multiplyH(x);
+				data += n;
+				size -= n;
+			}
+		}
+		
+#if defined(STREAMER_AEAD_X86_DISPATCH)
+		__attribute__((target("aes,sse2")))
+		static void _AesGcm_ctr_AESNI(const _AeadCipher_AesGcm* aes, const sl_uint8* nonce, sl_uint32 counter, const sl_uint8* src, sl_uint8* dst, sl_size size)
+		{
+			__m128i rk[15];
+			sl_uint32 nRounds = aes->nRounds;
+			for (sl_uint32 i = 0; i <= nRounds; i++) {
+				rk[i] = _mm_loadu_si128((const __m128i*)(aes->roundKeyBytes + (i << 4)));
+			}
+			sl_uint8 blocks[64];
+			for (sl_uint32 k = 0; k < 4; k++) {
+				Base::copyMemory(blocks + (k << 4), nonce, 12);
+			}
+			// four independent blocks per iteration to hide the latency of AESENC
+			while (size >= 64) {
+				_Aead_writeBE32(blocks + 12, counter);
+				_Aead_writeBE32(blocks + 28, counter + 1);
+				_Aead_writeBE32(blocks + 44, counter + 2);
+				_Aead_writeBE32(blocks + 60, counter + 3);
+				counter += 4;
+				__m128i b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)blocks), rk[0]);
+				__m128i b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(blocks + 16)), rk[0]);
+				__m128i b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(blocks + 32)), rk[0]);
+				__m128i b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(blocks + 48)), rk[0]);
+				for (sl_uint32 i = 1; i < nRounds; i++) {
+					b0 = _mm_aesenc_si128(b0, rk[i]);
+					b1 = _mm_aesenc_si128(b1, rk[i]);
+					b2 = _mm_aesenc_si128(b2, rk[i]);
+					b3 = _mm_aesenc_si128(b3, rk[i]);
+				}
+				b0 = _mm_aesenclast_si128(b0, rk[nRounds]);
+				b1 = _mm_aesenclast_si128(b1, rk[nRounds]);
+				b2 = _mm_aesenclast_si128(b2, rk[nRounds]);
+				b3 = _mm_aesenclast_si128(b3, rk[nRounds]);
+				_mm_storeu_si128((__m128i*)dst, _mm_xor_si128(b0, _mm_loadu_si128((const __m128i*)src)));
+				_mm_storeu_si128((__m128i*)(dst + 16), _mm_xor_si128(b1, _mm_loadu_si128((const __m128i*)(src + 16))));
+				_mm_storeu_si128((__m128i*)(dst + 32), _mm_xor_si128(b2, _mm_loadu_si128((const __m128i*)(src + 32))));
+				_mm_storeu_si128((__m128i*)(dst + 48), _mm_xor_si128(b3, _mm_loadu_si128((const __m128i*)(src + 48))));
+				src += 64;
+				dst += 64;
+				size -= 64;
+			}
+			while (size) {
+				_Aead_writeBE32(blocks + 12, counter);
+				counter++;
+				__m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)blocks), rk[0]);
+				for (sl_uint32 i = 1; i < nRounds; i++) {
+					b = _mm_aesenc_si128(b, rk[i]);
+				}
+				b = _mm_aesenclast_si128(b, rk[nRounds]);
+				if (size >= 16) {
+					_mm_storeu_si128((__m128i*)dst, _mm_xor_si128(b, _mm_loadu_si128((const __m128i*)src)));
+					src += 16;
+					dst += 16;
+					size -= 16;
+				} else {
+					sl_uint8 stream[16];
+					_mm_storeu_si128((__m128i*)stream, b);
+					for (sl_size i = 0; i < size; i++) {
+						dst[i] = src[i] ^ stream[i];
+					}
+					size = 0;
+				}
+			}
+		}
+		
+		// multiplication in GF(2^128) on the byte-reflected operands (Intel carry-less multiplication white paper)
+		__attribute__((target("pclmul,ssse3")))
+		static inline __m128i _AesGcm_multiply_CLMUL(__m128i a, __m128i b)
+		{
+			__m128i t3 = _mm_clmulepi64_si128(a, b, 0x00);
+			__m128i t4 = _mm_clmulepi64_si128(a, b, 0x10);
+			__m128i t5 = _mm_clmulepi64_si128(a, b, 0x01);
+			__m128i t6 = _mm_clmulepi64_si128(a, b, 0x11);
+			t4 = _mm_xor_si128(t4, t5);
+			t5 = _mm_slli_si128(t4, 8);
+			t4 = _mm_srli_si128(t4, 8);
+			t3 = _mm_xor_si128(t3, t5);
+			t6 = _mm_xor_si128(t6, t4);
+			// shifts the 256-bit product left by one bit
+			__m128i t7 = _mm_srli_epi32(t3, 31);
+			__m128i t8 = _mm_srli_epi32(t6, 31);
+			t3 = _mm_slli_epi32(t3, 1);
+			t6 = _mm_slli_epi32(t6, 1);
+			__m128i t9 = _mm_srli_si128(t7, 12);
+			t8 = _mm_slli_si128(t8, 4);
+			t7 = _mm_slli_si128(t7, 4);
+			t3 = _mm_or_si128(t3, t7);
+			t6 = _mm_or_si128(t6, t8);
+			t6 = _mm_or_si128(t6, t9);
+			// reduces modulo x^128 + x^7 + x^2 + x + 1
+			t7 = _mm_slli_epi32(t3, 31);
+			t8 = _mm_slli_epi32(t3, 30);
+			t9 = _mm_slli_epi32(t3, 25);
+			t7 = _mm_xor_si128(t7, t8);
+			t7 = _mm_xor_si128(t7, t9);
+			t8 = _mm_srli_si128(t7, 4);
+			t7 = _mm_slli_si128(t7, 12);
+			t3 = _mm_xor_si128(t3, t7);
+			__m128i t2 = _mm_srli_epi32(t3, 1);
+			t4 = _mm_srli_epi32(t3, 2);
+			t5 = _mm_srli_epi32(t3, 7);
+			t2 = _mm_xor_si128(t2, t4);
+			t2 = _mm_xor_si128(t2, t5);
+			t2 = _mm_xor_si128(t2, t8);
+			t3 = _mm_xor_si128(t3, t2);
+			return _mm_xor_si128(t6, t3);
+		}
+		
+		__attribute__((target("pclmul,ssse3")))
+		static void _AesGcm_ghash_CLMUL(const _AeadCipher_AesGcm* aes, sl_uint8* _x, const sl_uint8* data, sl_size size)
+		{
+			const __m128i maskSwap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+			__m128i h = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(aes->H)), maskSwap);
+			__m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)_x), maskSwap);
+			while (size >= 16) {
+				x = _mm_xor_si128(x, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), maskSwap));
+				x = _AesGcm_multiply_CLMUL(x, h);
+				data += 16;
+				size -= 16;
+			}
+			if (size) {
+				sl_uint8 block[16] = {0};
+				Base::copyMemory(block, data, size);
+				x = _mm_xor_si128(x, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)block), maskSwap));
+				x = _AesGcm_multiply_CLMUL(x, h);
+			}
+			_mm_storeu_si128((__m128i*)_x, _mm_shuffle_epi8(x, maskSwap));
+		}
+#endif
+		
+		sl_bool _AeadCipher_AesGcm::initialize(const void* _key, sl_uint32 sizeKey)
+		{
+			if (sizeKey != 16 && sizeKey != 24 && sizeKey != 32) {
+				return sl_false;
+			}
+			const sl_uint8* key = (const sl_uint8*)_key;
+			sl_uint32 nk = sizeKey >> 2;
+			nRounds = nk + 6;
+			sl_uint32 nWords = (nRounds + 1) << 2;
+			sl_uint32 roundKeys[60];
+			for (sl_uint32 i = 0; i < nk; i++) {
+				roundKeys[i] = _Aead_readBE32(key + (i << 2));
+			}
+			sl_uint32 rcon = 1;
+			for (sl_uint32 i = nk; i < nWords; i++) {
+				sl_uint32 t = roundKeys[i - 1];
+				if (i % nk == 0) {
+					t = _Aes_subWord((t << 8) | (t >> 24));
+					t ^= rcon << 24;
+					rcon = (rcon << 1) ^ ((rcon & 0x80) ? 0x11B : 0);
+				} else if (nk > 6 && i % nk == 4) {
+					t = _Aes_subWord(t);
+				}
+				roundKeys[i] = roundKeys[i - nk] ^ t;
+			}
+			for (sl_uint32 i = 0; i < nWords; i++) {
+				_Aead_writeBE32(roundKeyBytes + (i << 2), roundKeys[i]);
+			}
+			Base::zeroMemory(roundKeys, sizeof(roundKeys));
+			// the round key is same for the 4 blocks
+			for (sl_uint32 r = 0; r <= nRounds; r++) {
+				sl_uint8 bytes[64];
+				for (sl_uint32 k = 0; k < 4; k++) {
+					Base::copyMemory(bytes + (k << 4), roundKeyBytes + (r << 4), 16);
+				}
+				_Aes_load(bytes, roundKeyPlanes[r]);
+			}
+			
+			sl_uint8 zero[16] = {0};
+			encryptBlock(zero, H);
+			HH = ((sl_uint64)(_Aead_readBE32(H)) << 32) | _Aead_readBE32(H + 4);
+			HL = ((sl_uint64)(_Aead_readBE32(H + 8)) << 32) | _Aead_readBE32(H + 12);
+			
+			funcCtr = _AesGcm_ctr_Scalar;
+			funcGhash = _AesGcm_ghash_Scalar;
+			flagAccelerated = sl_false;
+#if defined(STREAMER_AEAD_X86_DISPATCH)
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3")) {
+				funcCtr = _AesGcm_ctr_AESNI;
+				funcGhash = _AesGcm_ghash_CLMUL;
+				flagAccelerated = sl_true;
+			}
+#endif
+			return sl_true;
+		}
+		
+		void _AeadCipher_AesGcm::encryptBlocks(const sl_uint8* src, sl_uint8* dst) const
+		{
+			sl_uint64 q[8];
+			_Aes_load(src, q);
+			for (sl_uint32 i = 0; i < 8; i++) {
+				q[i] ^= roundKeyPlanes[0][i];
+			}
+			for (sl_uint32 r = 1; r < nRounds; r++) {
+				_Aes_subBytes(q);
+				_Aes_shiftRows(q);
+				_Aes_mixColumns(q);
+				for (sl_uint32 i = 0; i < 8; i++) {
+					q[i] ^= roundKeyPlanes[r][i];
+				}
+			}
+			_Aes_subBytes(q);
+			_Aes_shiftRows(q);
+			for (sl_uint32 i = 0; i < 8; i++) {
+				q[i] ^= roundKeyPlanes[nRounds][i];
+			}
+			_Aes_store(q, dst);
+		}
+		
+		void _AeadCipher_AesGcm::encryptBlock(const sl_uint8* src, sl_uint8* dst) const
+		{
+			sl_uint8 blocks[64] = {0};
+			Base::copyMemory(blocks, src, 16);
+			encryptBlocks(blocks, blocks);
+			Base::copyMemory(dst, blocks, 16);
+		}
+		
+		// multiplies by H bit by bit, selecting with the masks instead of the branches
+		void _AeadCipher_AesGcm::multiplyH(sl_uint8* x) const
+		{
+			sl_uint64 xh = ((sl_uint64)(_Aead_readBE32(x)) << 32) | _Aead_readBE32(x + 4);
+			sl_uint64 xl = ((sl_uint64)(_Aead_readBE32(x + 8)) << 32) | _Aead_readBE32(x + 12);
+			sl_uint64 zh = 0;
+			sl_uint64 zl = 0;
+			sl_uint64 vh = HH;
+			sl_uint64 vl = HL;
+			for (sl_uint32 i = 0; i < 128; i++) {
+				sl_uint64 bit = i < 64 ? (xh >> (63 - i)) : (xl >> (127 - i));
+				sl_uint64 mask = (sl_uint64)0 - (bit & 1);
+				zh ^= vh & mask;
+				zl ^= vl & mask;
+				sl_uint64 reduce = (sl_uint64)0 - (vl & 1);
+				vl = (vl >> 1) | (vh << 63);
+				vh = (vh >> 1) ^ (0xE100000000000000ULL & reduce);
+			}
+			_Aead_writeBE32(x, (sl_uint32)(zh >> 32));
+			_Aead_writeBE32(x + 4, (sl_uint32)zh);
+			_Aead_writeBE32(x + 8, (sl_uint32)(zl >> 32));
+			_Aead_writeBE32(x + 12, (sl_uint32)zl);
+		}
+		
+		void _AeadCipher_AesGcm::computeTag(const sl_uint8* nonce, const void* aad, sl_size sizeAad, const sl_uint8* cipherText, sl_size size, sl_uint8* tag)
+		{
+			sl_uint8 x[16] = {0};
+			funcGhash(this, x, (const sl_uint8*)aad, sizeAad);
+			funcGhash(this, x, cipherText, size);
+			sl_uint8 lengths[16];
+			sl_uint64 bitsAad = (sl_uint64)sizeAad << 3;
+			sl_uint64 bitsText = (sl_uint64)size << 3;
+			_Aead_writeBE32(lengths, (sl_uint32)(bitsAad >> 32));
+			_Aead_writeBE32(lengths + 4, (sl_uint32)bitsAad);
+			_Aead_writeBE32(lengths + 8, (sl_uint32)(bitsText >> 32));
+			_Aead_writeBE32(lengths + 12, (sl_uint32)bitsText);
+			funcGhash(this, x, lengths, 16);
+			// tag = E(K, J0) ^ GHASH, J0 = nonce || 1
+			sl_uint8 j0[16];
+			Base::copyMemory(j0, nonce, 12);
+			_Aead_writeBE32(j0 + 12, 1);
+			encryptBlock(j0, tag);
+			for (sl_uint32 i = 0; i < 16; i++) {
+				tag[i] ^= x[i];
+			}
+		}
+		
+		
+		/*
+			ChaCha20-Poly1305
+		*/
+		
+#define CHACHA_ROTL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define CHACHA_QUARTER_ROUND(a, b, c, d) \
+	a += b; d ^= a; d = CHACHA_ROTL(d, 16); \
+	c += d; b ^= c; b = CHACHA_ROTL(b, 12); \
+	a += b; d ^= a; d = CHACHA_ROTL(d, 8); \
+	c += d; b ^= c; b = CHACHA_ROTL(b, 7);
+		
+		static void _ChaCha20_block(const sl_uint32* key, sl_uint32 counter, const sl_uint8* nonce, sl_uint8* output)
+		{
+			sl_uint32 input[16];
+			input[0] = 0x61707865;
+			input[1] = 0x3320646E;
+			input[2] = 0x79622D32;
+			input[3] = 0x6B206574;
+			for (sl_uint32 i = 0; i < 8; i++) {
+				input[4 + i] = key[i];
+			}
+			input[12] = counter;
+			input[13] = _Aead_readLE32(nonce);
+			input[14] = _Aead_readLE32(nonce + 4);
+			input[15] = _Aead_readLE32(nonce + 8);
+			sl_uint32 x[16];
+			for (sl_uint32 i = 0; i < 16; i++) {
+				x[i] = input[i];
+			}
+			for (sl_uint32 i = 0; i < 10; i++) {
+				CHACHA_QUARTER_ROUND(x[0], x[4], x[8], x[12])
+				CHACHA_QUARTER_ROUND(x[1], x[5], x[9], x[13])
+				CHACHA_QUARTER_ROUND(x[2], x[6], x[10], x[14])
+				CHACHA_QUARTER_ROUND(x[3], x[7], x[11], x[15])
+				CHACHA_QUARTER_ROUND(x[0], x[5], x[10], x[15])
+				CHACHA_QUARTER_ROUND(x[1], x[6], x[11], x[12])
+				CHACHA_QUARTER_ROUND(x[2], x[7], x[8], x[13])
+				CHACHA_QUARTER_ROUND(x[3], x[4], x[9], x[14])
+			}
+			for (sl_uint32 i = 0; i < 16; i++) {
+				_Aead_writeLE32(output + (i << 2), x[i] + input[i]);
+			}
+		}
+		
+		static void _ChaCha20_xor(const sl_uint32* key, sl_uint32 counter, const sl_uint8* nonce, const sl_uint8* src, sl_uint8* dst, sl_size size)
+		{
+			sl_uint8 stream[64];
+			while (size) {
+				_ChaCha20_block(key, counter, nonce, stream);
+				counter++;
+				sl_size n = size < 64 ? size : 64;
+				for (sl_size i = 0; i < n; i++) {
+					dst[i] = src[i] ^ stream[i];
+				}
+				src += n;
+				dst += n;
+				size -= n;
+			}
+		}
+		
+		// 26-bit limbs, so the products fit in 64 bits without the 128-bit arithmetic
+		class _Poly1305
+		{
+		public:
+			sl_uint32 r[5];
+			sl_uint32 h[5];
+			sl_uint32 pad[4];
+			
+		public:
+			_Poly1305(const sl_uint8* key)
+			{
+				r[0] = _Aead_readLE32(key) & 0x3FFFFFF;
+				r[1] = (_Aead_readLE32(key + 3) >> 2) & 0x3FFFF03;
+				r[2] = (_Aead_readLE32(key + 6) >> 4) & 0x3FFC0FF;
+				r[3] = (_Aead_readLE32(key + 9) >> 6) & 0x3F03FFF;
+				r[4] = (_Aead_readLE32(key + 12) >> 8) & 0x00FFFFF;
+				for (sl_uint32 i = 0; i < 5; i++) {
+					h[i] = 0;
+				}
+				for (sl_uint32 i = 0; i < 4; i++) {
+					pad[i] = _Aead_readLE32(key + 16 + (i << 2));
+				}
+			}
+			
+		public:
+			void block(const sl_uint8* m)
+			{
+				sl_uint32 r0 = r[0], r1 = r[1], r2 = r[2], r3 = r[3], r4 = r[4];
+				sl_uint32 s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+				sl_uint32 h0 = h[0] + (_Aead_readLE32(m) & 0x3FFFFFF);
+				sl_uint32 h1 = h[1] + ((_Aead_readLE32(m + 3) >> 2) & 0x3FFFFFF);
+				sl_uint32 h2 = h[2] + ((_Aead_readLE32(m + 6) >> 4) & 0x3FFFFFF);
+				sl_uint32 h3 = h[3] + ((_Aead_readLE32(m + 9) >> 6) & 0x3FFFFFF);
+				sl_uint32 h4 = h[4] + ((_Aead_readLE32(m + 12) >> 8) | (1 << 24));
+				sl_uint64 d0 = (sl_uint64)h0 * r0 + (sl_uint64)h1 * s4 + (sl_uint64)h2 * s3 + (sl_uint64)h3 * s2 + (sl_uint64)h4 * s1;
+				sl_uint64 d1 = (sl_uint64)h0 * r1 + (sl_uint64)h1 * r0 + (sl_uint64)h2 * s4 + (sl_uint64)h3 * s3 + (sl_uint64)h4 * s2;
+				sl_uint64 d2 = (sl_uint64)h0 * r2 + (sl_uint64)h1 * r1 + (sl_uint64)h2 * r0 + (sl_uint64)h3 * s4 + (sl_uint64)h4 * s3;
+				sl_uint64 d3 = (sl_uint64)h0 * r3 + (sl_uint64)h1 * r2 + (sl_uint64)h2 * r1 + (sl_uint64)h3 * r0 + (sl_uint64)h4 * s4;
+				sl_uint64 d4 = (sl_uint64)h0 * r4 + (sl_uint64)h1 * r3 + (sl_uint64)h2 * r2 + (sl_uint64)h3 * r1 + (sl_uint64)h4 * r0;
+				sl_uint32 c = (sl_uint32)(d0 >> 26);
+				h0 = (sl_uint32)d0 & 0x3FFFFFF;
+				d1 += c;
+				c = (sl_uint32)(d1 >> 26);
+				h1 = (sl_uint32)d1 & 0x3FFFFFF;
+				d2 += c;
+				c = (sl_uint32)(d2 >> 26);
+				h2 = (sl_uint32)d2 & 0x3FFFFFF;
+				d3 += c;
+				c = (sl_uint32)(d3 >> 26);
+				h3 = (sl_uint32)d3 & 0x3FFFFFF;
+				d4 += c;
+				c = (sl_uint32)(d4 >> 26);
+				h4 = (sl_uint32)d4 & 0x3FFFFFF;
+				h0 += c * 5;
+				c = h0 >> 26;
+				h0 &= 0x3FFFFFF;
+				h1 += c;
+				h[0] = h0;
+				h[1] = h1;
+				h[2] = h2;
+				h[3] = h3;
+				h[4] = h4;
+			}
+			
+			// the last partial block is padded with zeros, as AEAD_CHACHA20_POLY1305 does
+			void updatePadded(const sl_uint8* data, sl_size size)
+			{
+				while (size >= 16) {
+					block(data);
+					data += 16;
+					size -= 16;
+				}
+				if (size) {
+					sl_uint8 last[16] = {0};
+					Base::copyMemory(last, data, size);
+					block(last);
+				}
+			}
+			
+			void finish(sl_uint8* mac)
+			{
+				sl_uint32 h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+				sl_uint32 c = h1 >> 26;
+				h1 &= 0x3FFFFFF;
+				h2 += c;
+				c = h2 >> 26;
+				h2 &= 0x3FFFFFF;
+				h3 += c;
+				c = h3 >> 26;
+				h3 &= 0x3FFFFFF;
+				h4 += c;
+				c = h4 >> 26;
+				h4 &= 0x3FFFFFF;
+				h0 += c * 5;
+				c = h0 >> 26;
+				h0 &= 0x3FFFFFF;
+				h1 += c;
+				// g = h + 5 - 2^130, selected when h >= 2^130 - 5
+				sl_uint32 g0 = h0 + 5;
+				c = g0 >> 26;
+				g0 &= 0x3FFFFFF;
+				sl_uint32 g1 = h1 + c;
+				c = g1 >> 26;
+				g1 &= 0x3FFFFFF;
+				sl_uint32 g2 = h2 + c;
+				c = g2 >> 26;
+				g2 &= 0x3FFFFFF;
+				sl_uint32 g3 = h3 + c;
+				c = g3 >> 26;
+				g3 &= 0x3FFFFFF;
+				sl_uint32 g4 = h4 + c - (1 << 26);
+				sl_uint32 mask = (g4 >> 31) - 1;
+				g0 &= mask;
+				g1 &= mask;
+				g2 &= mask;
+				g3 &= mask;
+				g4 &= mask;
+				mask = ~mask;
+				h0 = (h0 & mask) | g0;
+				h1 = (h1 & mask) | g1;
+				h2 = (h2 & mask) | g2;
+				h3 = (h3 & mask) | g3;
+				h4 = (h4 & mask) | g4;
+				h0 = h0 | (h1 << 26);
+				h1 = (h1 >> 6) | (h2 << 20);
+				h2 = (h2 >> 12) | (h3 << 14);
+				h3 = (h3 >> 18) | (h4 << 8);
+				sl_uint64 f = (sl_uint64)h0 + pad[0];
+				_Aead_writeLE32(mac, (sl_uint32)f);
+				f = (sl_uint64)h1 + pad[1] + (f >> 32);
+				_Aead_writeLE32(mac + 4, (sl_uint32)f);
+				f = (sl_uint64)h2 + pad[2] + (f >> 32);
+				_Aead_writeLE32(mac + 8, (sl_uint32)f);
+				f = (sl_uint64)h3 + pad[3] + (f >> 32);
+				_Aead_writeLE32(mac + 12, (sl_uint32)f);
+			}
+			
+		};
+		
+		class _AeadCipher_ChaCha20Poly1305 : public AeadCipher
+		{
+		public:
+			sl_uint32 key[8];
+			
+		public:
+			void computeTag(const sl_uint8* nonce, const void* aad, sl_size sizeAad, const sl_uint8* cipherText, sl_size size, sl_uint8* tag)
+			{
+				sl_uint8 block0[64];
+				_ChaCha20_block(key, 0, nonce, block0);
+				_Poly1305 poly(block0);
+				poly.updatePadded((const sl_uint8*)aad, sizeAad);
+				poly.updatePadded(cipherText, size);
+				sl_uint8 lengths[16];
+				sl_uint64 n = sizeAad;
+				_Aead_writeLE32(lengths, (sl_uint32)n);
+				_Aead_writeLE32(lengths + 4, (sl_uint32)(n >> 32));
+				n = size;
+				_Aead_writeLE32(lengths + 8, (sl_uint32)n);
+				_Aead_writeLE32(lengths + 12, (sl_uint32)(n >> 32));
+				poly.block(lengths);
+				poly.finish(tag);
+				Base::zeroMemory(block0, sizeof(block0));
+			}
+			
+		public:
+			// override
+			Algorithm getAlgorithm()
+			{
+				return algorithmChaCha20_Poly1305;
+			}
+			
+			// override
+			sl_bool isAccelerated()
+			{
+				return sl_false;
+			}
+			
+			// override
+			void encrypt(const sl_uint8* nonce, const void* aad, sl_size sizeAad, const void* src, void* dst, sl_size size, sl_uint8* tag, sl_uint32 sizeTag)
+			{
+				_ChaCha20_xor(key, 1, nonce, (const sl_uint8*)src, (sl_uint8*)dst, size);
+				sl_uint8 t[16];
+				computeTag(nonce, aad, sizeAad, (const sl_uint8*)dst, size, t);
+				Base::copyMemory(tag, t, _Aead_clampTagSize(sizeTag));
+			}
+			
+			// override
+			sl_bool decrypt(const sl_uint8* nonce, const void* aad, sl_size sizeAad, const void* src, void* dst, sl_size size, const sl_uint8* tag, sl_uint32 sizeTag)
+			{
+				sl_uint8 t[16];
+				computeTag(nonce, aad, sizeAad, (const sl_uint8*)src, size, t);
+				if (!(_Aead_equalsTag(t, tag, _Aead_clampTagSize(sizeTag)))) {
+					return sl_false;
+				}
+				_ChaCha20_xor(key, 1, nonce, (const sl_uint8*)src, (sl_uint8*)dst, size);
+				return sl_true;
+			}
+			
+		};
+		
+		
+		SLIB_DEFINE_OBJECT(AeadCipher, Object)
+		
+		AeadCipher::AeadCipher()
+		{
+		}
+		
+		AeadCipher::~AeadCipher()
+		{
+		}
+		
+		Ref<AeadCipher> AeadCipher::create(Algorithm algorithm, const void* key, sl_uint32 sizeKey)
+		{
+			if (!key) {
+				return sl_null;
+			}
+			if (algorithm == algorithmAES_GCM) {
+				Ref<_AeadCipher_AesGcm> ret = new _AeadCipher_AesGcm;
+				if (ret.isNotNull() && ret->initialize(key, sizeKey)) {
+					return Ref<AeadCipher>::from(ret);
+				}
+			} else if (algorithm == algorithmChaCha20_Poly1305) {
+				if (sizeKey != 32) {
+					return sl_null;
+				}
+				Ref<_AeadCipher_ChaCha20Poly1305> ret = new _AeadCipher_ChaCha20Poly1305;
+				if (ret.isNotNull()) {
+					for (sl_uint32 i = 0; i < 8; i++) {
+						ret->key[i] = _Aead_readLE32((const sl_uint8*)key + (i << 2));
+					}
+					return Ref<AeadCipher>::from(ret);
+				}
+			}
+			return sl_null;
+		}
+		
+		
+		/*
+			Known-answer tests
+		*/
+		
+		struct _AeadTestVector
+		{
+			AeadCipher::Algorithm algorithm;
+			const char* key;
+			const char* nonce;
+			const char* aad;
+			const char* plainText;
+			const char* cipherText;
+			const char* tag;
+		};
+		
+		static const _AeadTestVector _g_Aead_testVectors[] = {
+			// GCM test case 2
+			{ AeadCipher::algorithmAES_GCM, "00000000000000000000000000000000", "000000000000000000000000", "",
+				"00000000000000000000000000000000",
+				"0388dace60b6a392f328c2b971b2fe78",
+				"ab6e47d42cec13bdf53a67b21257bddf" },
+			// GCM test case 4
+			{ AeadCipher::algorithmAES_GCM, "feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888", "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+				"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+				"42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091",
+				"5bc94fbc3221a5db94fae95ae7121a47" },
+			// GCM test case 10
+			{ AeadCipher::algorithmAES_GCM, "feffe9928665731c6d6a8f9467308308feffe9928665731c", "cafebabefacedbaddecaf888", "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+				"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+				"3980ca0b3c00e841eb06fac4872a2757859e1ceaa6efd984628593b40ca1e19c7d773d00c144c525ac619d18c84a3f4718e2448b2fe324d9ccda2710",
+				"2519498e80f1478f37ba55bd6d27618c" },
+			// GCM test case 16
+			{ AeadCipher::algorithmAES_GCM, "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888", "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+				"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+				"522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662",
+				"76fc6ece0f4e1768cddf8853bb2d551b" },
+			// RFC 8439 2.8.2: "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it."
+			{ AeadCipher::algorithmChaCha20_Poly1305, "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f", "070000004041424344454647", "50515253c0c1c2c3c4c5c6c7",
+				"4c616469657320616e642047656e746c656d656e206f662074686520636c617373206f66202739393a204966204920636f756c64206f6666657220796f75206f6e6c79206f6e652074697020666f7220746865206675747572652c2073756e73637265656e20776f756c642062652069742e",
+				"d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d63dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b3692ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc3ff4def08e4b7a9de576d26586cec64b6116",
+				"1ae10b594f09e26a7e902ecbd0600691" }
+		};
+		
+#define AEAD_TEST_MAX_SIZE 128
+		
+		static sl_uint32 _Aead_parseHex(const char* hex, sl_uint8* output)
+		{
+			sl_uint32 n = 0;
+			while (hex[0] && hex[1] && n < AEAD_TEST_MAX_SIZE) {
+				sl_uint8 v = 0;
+				for (sl_uint32 i = 0; i < 2; i++) {
+					char c = hex[i];
+					v <<= 4;
+					if (c >= '0' && c <= '9') {
+						v |= (sl_uint8)(c - '0');
+					} else if (c >= 'a' && c <= 'f') {
+						v |= (sl_uint8)(c - 'a' + 10);
+					}
+				}
+				output[n++] = v;
+				hex += 2;
+			}
+			return n;
+		}
+		
+		static sl_bool _Aead_checkVector(AeadCipher* cipher, const _AeadTestVector& v)
+		{
+			sl_uint8 nonce[AEAD_TEST_MAX_SIZE], aad[AEAD_TEST_MAX_SIZE], plainText[AEAD_TEST_MAX_SIZE], cipherText[AEAD_TEST_MAX_SIZE], tag[AEAD_TEST_MAX_SIZE];
+			_Aead_parseHex(v.nonce, nonce);
+			sl_uint32 sizeAad = _Aead_parseHex(v.aad, aad);
+			sl_uint32 size = _Aead_parseHex(v.plainText, plainText);
+			_Aead_parseHex(v.cipherText, cipherText);
+			_Aead_parseHex(v.tag, tag);
+			sl_uint8 output[AEAD_TEST_MAX_SIZE];
+			sl_uint8 tagOutput[SLIB_STREAMER_AEAD_TAG_SIZE];
+			cipher->encrypt(nonce, aad, sizeAad, plainText, output, size, tagOutput, SLIB_STREAMER_AEAD_TAG_SIZE);
+			if (Base::compareMemory(output, cipherText, size) != 0 || Base::compareMemory(tagOutput, tag, SLIB_STREAMER_AEAD_TAG_SIZE) != 0) {
+				return sl_false;
+			}
+			if (!(cipher->decrypt(nonce, aad, sizeAad, cipherText, output, size, tag, SLIB_STREAMER_AEAD_TAG_SIZE))) {
+				return sl_false;
+			}
+			if (Base::compareMemory(output, plainText, size) != 0) {
+				return sl_false;
+			}
+			tag[0] ^= 1;
+			if (cipher->decrypt(nonce, aad, sizeAad, cipherText, output, size, tag, SLIB_STREAMER_AEAD_TAG_SIZE)) {
+				return sl_false;
+			}
+			return sl_true;
+		}
+		
+		sl_bool AeadCipher::runSelfTest()
+		{
+			for (sl_size i = 0; i < sizeof(_g_Aead_testVectors) / sizeof(_AeadTestVector); i++) {
+				const _AeadTestVector& v = _g_Aead_testVectors[i];
+				sl_uint8 key[AEAD_TEST_MAX_SIZE];
+				sl_uint32 sizeKey = _Aead_parseHex(v.key, key);
+				Ref<AeadCipher> cipher = create(v.algorithm, key, sizeKey);
+				if (cipher.isNull()) {
+					return sl_false;
+				}
+				if (!(_Aead_checkVector(cipher.get(), v))) {
+					return sl_false;
+				}
+				if (cipher->isAccelerated() && v.algorithm == algorithmAES_GCM) {
+					_AeadCipher_AesGcm* aes = (_AeadCipher_AesGcm*)(cipher.get());
+					aes->funcCtr = _AesGcm_ctr_Scalar;
+					aes->funcGhash = _AesGcm_ghash_Scalar;
+					aes->flagAccelerated = sl_false;
+					if (!(_Aead_checkVector(aes, v))) {
+						return sl_false;
+					}
+				}
+			}
+			return sl_true;
+		}
+		
+	}
+	
+}
@@ -10,6 +10,8 @@
 
 #include "../../../inc/slibx/streamer/audio.h"
 
+#include "../../../inc/slibx/streamer/pcm.h"
+
 namespace slib
 {
 	
@@ -23,10 +25,12 @@ namespace slib
 			sl_uint32 m_nSamplesPerFrame;
 			sl_uint32 m_nSamplesPerSecond;
 			Ref<Event> m_event;
+			sl_uint64 m_sequence;
 			
 		private:
 			_AudioRecordSourceImpl()
 			{
+				m_sequence = 0;
 			}
 			
 			~_AudioRecordSourceImpl()
@@ -64,22 +68,22 @@ namespace slib
 			sl_bool receivePacket(Packet* out)
 			{
 				sl_uint32 n = m_nSamplesPerFrame;
-				Memory mem = Memory::create(n * 2);
-				if (mem.isNotNull()) {
+				Ref<PacketBuffer> buffer = PacketBuffer::create(n * 2);
+				if (buffer.isNotNull()) {
 					AudioData data;
 					data.format = AudioFormat::Int16_Mono;
-					data.data = mem.getData();
+					data.data = buffer->getData();
 					data.count = n;
 					if (m_recorder->read(data)) {
-						float volume = getVolume();
-						sl_int16* s = (sl_int16*)(mem.getData());
-						for (sl_uint32 i = 0; i < n; i++) {
-							s[i] = (sl_int16)(s[i] * volume);
-						}
-						out->data = mem;
+						PcmKernels::applyGain((sl_int16*)(buffer->getData()), n, getVolume());
+						out->data = PacketData(buffer, n * 2);
 						out->format = Packet::formatAudio_PCM_S16;
 						out->audioParam.nChannels = 1;
 						out->audioParam.nSamplesPerSecond = m_nSamplesPerSecond;
+						out->timestamp = Packet::getCurrentTimestamp();
+						out->flags = Packet::flagSequence;
+						out->sequence = m_sequence++;
+						out->streamId = getStreamId();
 						return sl_true;
 					}
 				}
@@ -145,19 +149,41 @@ namespace slib
 				if (input.audioParam.nSamplesPerSecond != m_nSamplesPerSecond) {
 					return sl_false;
 				}
-				if (input.audioParam.nChannels != m_nChannels) {
+				sl_uint32 nChannels = input.audioParam.nChannels;
+				if (nChannels != m_nChannels && !((nChannels == 1 || nChannels == 2) && (m_nChannels == 1 || m_nChannels == 2))) {
 					return sl_false;
 				}
-				sl_uint32 n = (sl_uint32)(input.data.getSize()) / 2;
-				if (n > 0) {
-					AudioData data;
-					data.format = AudioFormat::Int16_Mono;
-					data.data = input.data.getData();
-					data.count = n;
-					m_playerBuffer->write(data);
-					return sl_true;
+				sl_uint32 nFrames = (sl_uint32)(input.data.getSize()) / 2 / nChannels;
+				if (!nFrames) {
+					return sl_false;
 				}
-				return sl_false;
+				sl_uint32 n = nFrames * m_nChannels;
+				const sl_int16* samples = (const sl_int16*)(input.data.getData());
+				float volume = getVolume();
+				Ref<PacketBuffer> buffer;
+				if (nChannels != m_nChannels || volume != 1.0f) {
+					// the input payload may be shared with other sinks, so it is not modified
+					buffer = PacketBuffer::create(n * 2);
+					if (buffer.isNull()) {
+						return sl_false;
+					}
+					sl_int16* output = (sl_int16*)(buffer->getData());
+					if (nChannels == m_nChannels) {
+						Base::copyMemory(output, samples, n * 2);
+					} else if (m_nChannels == 2) {
+						PcmKernels::convertMonoToStereo(output, samples, nFrames);
+					} else {
+						PcmKernels::convertStereoToMono(output, samples, nFrames);
+					}
+					PcmKernels::applyGain(output, n, volume);
+					samples = output;
+				}
+				AudioData data;
+				data.format = AudioFormat::Int16_Mono;
+				data.data = (void*)samples;
+				data.count = n;
+				m_playerBuffer->write(data);
+				return sl_true;
 			}
 			
 		};
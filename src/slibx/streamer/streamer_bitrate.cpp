@@ -0,0 +1,197 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "../../../inc/slibx/streamer/bitrate.h"
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		SLIB_DEFINE_OBJECT(AudioBitrateController, Object)
+		
+		AudioBitrateController::AudioBitrateController()
+		{
+			setMinBitrate(6000);
+			setMaxBitrate(64000);
+			setMinFrameDuration(20);
+			setMaxFrameDuration(60);
+			setLowLossThreshold(0.02f);
+			setHighLossThreshold(0.1f);
+			m_rate = 0;
+			m_loss = 0;
+			m_flagFec = sl_false;
+			m_rtt = -1;
+			m_rttMin = -1;
+		}
+		
+		AudioBitrateController::~AudioBitrateController()
+		{
+		}
+		
+		Ref<AudioBitrateController> AudioBitrateController::create(const Ref<AudioOpusEncodeFilter>& filter)
+		{
+			if (filter.isNull() || filter->getEncoder().isNull()) {
+				return sl_null;
+			}
+			Ref<AudioBitrateController> ret = new AudioBitrateController;
+			if (ret.isNotNull()) {
+				ret->m_filter = filter;
+				sl_uint32 rate = filter->getEncoder()->getBitrate();
+				if (!rate) {
+					rate = ret->getMaxBitrate();
+				}
+				ret->m_rate = rate;
+				// the redundancy is switched by the loss, so the framing is kept for the receiver
+				filter->setRedundancy(sl_true);
+			}
+			return ret;
+		}
+		
+		static void _AudioBitrateController_onReport(const WeakRef<AudioBitrateController>& weak, const NetworkUdpReport& report)
+		{
+			Ref<AudioBitrateController> controller = weak;
+			if (controller.isNotNull()) {
+				controller->onReport(report);
+			}
+		}
+		
+		Function<void(const NetworkUdpReport&)> AudioBitrateController::getReportListener()
+		{
+			return Function<void(const NetworkUdpReport&)>::bind(&_AudioBitrateController_onReport, WeakRef<AudioBitrateController>(this));
+		}
+		
+		void AudioBitrateController::onReport(const NetworkUdpReport& report)
+		{
+			ObjectLocker lock(this);
+			float loss = report.fractionLost;
+			m_loss = m_loss * 0.7f + loss * 0.3f;
+			
+			sl_bool flagQueueing = sl_false;
+			if (report.rtt >= 0) {
+				m_rtt = report.rtt;
+				if (m_rttMin < 0 || report.rtt < m_rttMin) {
+					m_rttMin = report.rtt;
+				}
+				// a queue of 50ms over 1.5x the base delay
+				if (report.rtt > m_rttMin + m_rttMin / 2 + 50) {
+					flagQueueing = sl_true;
+				}
+			}
+			
+			// hysteresis, not to toggle the redundancy on every report
+			if (m_flagFec) {
+				if (m_loss < 0.005f) {
+					m_flagFec = sl_false;
+				}
+			} else {
+				if (m_loss > 0.01f) {
+					m_flagFec = sl_true;
+				}
+			}
+			
+			double rate = m_rate;
+			if (loss > getHighLossThreshold()) {
+				rate *= 1 - 0.5 * loss;
+			} else if (flagQueueing) {
+				rate *= 0.85;
+			} else if (loss < getLowLossThreshold()) {
+				rate = rate * 1.08 + 1000;
+			}
+			sl_uint32 minRate = getMinBitrate();
+			sl_uint32 maxRate = getMaxBitrate() * (1 + getRedundancy());
+			if (rate < minRate) {
+				rate = minRate;
+			}
+			if (rate > maxRate) {
+				rate = maxRate;
+			}
+			m_rate = (sl_uint32)rate;
+			apply();
+		}
+		
+		sl_uint32 AudioBitrateController::getLossPercentage()
+		{
+			return (sl_uint32)(m_loss * 100 + 0.5f);
+		}
+		
+		// redundant frames per packet, as AudioOpusEncodeFilter derives from ExpectedLossPercentage
+		sl_uint32 AudioBitrateController::getRedundancy()
+		{
+			if (!m_flagFec) {
+				return 0;
+			}
+			sl_uint32 n = 1 + getLossPercentage() / 10;
+			if (n > SLIB_STREAMER_OPUS_MAX_REDUNDANCY) {
+				n = SLIB_STREAMER_OPUS_MAX_REDUNDANCY;
+			}
+			return n;
+		}
+		
+		// the reports arrive on the sending thread, so the settings are posted to the encoding thread
+		void AudioBitrateController::apply()
+		{
+			AudioOpusEncodeSettings settings;
+			sl_uint32 nRedundant = getRedundancy();
+			if (nRedundant) {
+				settings.expectedLossPercentage = getLossPercentage();
+				settings.fecPercentage = 100;
+			} else {
+				settings.expectedLossPercentage = 0;
+				settings.fecPercentage = 0;
+			}
+			sl_uint32 bitrate = m_rate / (1 + nRedundant);
+			if (bitrate < getMinBitrate()) {
+				bitrate = getMinBitrate();
+			}
+			if (bitrate > getMaxBitrate()) {
+				bitrate = getMaxBitrate();
+			}
+			settings.bitrate = bitrate;
+			
+			// 40 bytes of IP/UDP/RTP-like headers per packet are 16kbps at 20ms, and 5.3kbps at 60ms
+			sl_uint32 duration = 20;
+			if (bitrate < 12000) {
+				duration = 60;
+			} else if (bitrate < 24000) {
+				duration = 40;
+			}
+			if (duration > getMaxFrameDuration()) {
+				duration = getMaxFrameDuration();
+			}
+			if (duration < getMinFrameDuration()) {
+				duration = getMinFrameDuration();
+			}
+			settings.frameDuration = duration;
+			m_filter->postSettings(settings);
+		}
+		
+		sl_uint32 AudioBitrateController::getSendRate()
+		{
+			ObjectLocker lock(this);
+			return m_rate;
+		}
+		
+		float AudioBitrateController::getLoss()
+		{
+			ObjectLocker lock(this);
+			return m_loss;
+		}
+		
+		sl_int32 AudioBitrateController::getRtt()
+		{
+			ObjectLocker lock(this);
+			return m_rtt;
+		}
+		
+	}
+	
+}
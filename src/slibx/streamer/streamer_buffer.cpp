@@ -0,0 +1,542 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "../../../inc/slibx/streamer/buffer.h"
+
+#define POOL_CLASS_COUNT 9
+#define POOL_CLASS_MIN_SHIFT 8
+#define POOL_CLASS_OVERSIZED 0xFF
+#define POOL_THREAD_CACHE_LIMIT 64
+#define POOL_THREAD_HITS_FLUSH 1024
+
+namespace slib
+{
+
+	namespace streamer
+	{
+
+		struct _PacketBufferPool_Block
+		{
+			_PacketBufferPool_Block* next;
+			sl_uint32 sizeClass;
+			sl_uint32 reserved;
+		};
+
+		// keeps the payload following the header aligned to 16 bytes
+		#define POOL_BLOCK_HEADER_SIZE ((sizeof(_PacketBufferPool_Block) + 15) & ~((sl_size)15))
+
+		// lock-free stacks; blocks are pushed one by one or as a linked chain, and popped only all at once, so there is no ABA problem
+		static sl_reg _g_PacketBufferPool_freeLists[POOL_CLASS_COUNT] = {0};
+
+		static sl_int64 _g_PacketBufferPool_countHits = 0;
+		static sl_int64 _g_PacketBufferPool_countMisses = 0;
+		static sl_int64 _g_PacketBufferPool_countOversized = 0;
+		static sl_int64 _g_PacketBufferPool_sizeAllocated = 0;
+
+		SLIB_INLINE static sl_size _PacketBufferPool_getClassSize(sl_uint32 sizeClass)
+		{
+			return ((sl_size)1) << (sizeClass + POOL_CLASS_MIN_SHIFT);
+		}
+
+		static sl_uint32 _PacketBufferPool_getClass(sl_size size)
+		{
+			for (sl_uint32 i = 0; i < POOL_CLASS_COUNT; i++) {
+				if (size <= _PacketBufferPool_getClassSize(i)) {
+					return i;
+				}
+			}
+			return POOL_CLASS_OVERSIZED;
+		}
+
+		static void _PacketBufferPool_pushChain(sl_uint32 sizeClass, _PacketBufferPool_Block* first, _PacketBufferPool_Block* last)
+		{
+			sl_reg* head = _g_PacketBufferPool_freeLists + sizeClass;
+			for (;;) {
+				sl_reg old = Base::interlockedAdd(head, 0);
+				last->next = (_PacketBufferPool_Block*)old;
+				if (Base::interlockedCompareExchange(head, (sl_reg)first, old)) {
+					return;
+				}
+			}
+		}
+
+		static _PacketBufferPool_Block* _PacketBufferPool_popAll(sl_uint32 sizeClass)
+		{
+			sl_reg* head = _g_PacketBufferPool_freeLists + sizeClass;
+			for (;;) {
+				sl_reg old = Base::interlockedAdd(head, 0);
+				if (!old) {
+					return sl_null;
+				}
+				if (Base::interlockedCompareExchange(head, 0, old)) {
+					return (_PacketBufferPool_Block*)old;
+				}
+			}
+		}
+
+		class _PacketBufferPool_ThreadCache
+		{
+		public:
+			_PacketBufferPool_Block* heads[POOL_CLASS_COUNT];
+			_PacketBufferPool_Block* tails[POOL_CLASS_COUNT];
+			sl_uint32 counts[POOL_CLASS_COUNT];
+			sl_uint32 countHits;
+
+		public:
+			_PacketBufferPool_ThreadCache()
+			{
+				for (sl_uint32 i = 0; i < POOL_CLASS_COUNT; i++) {
+					heads[i] = sl_null;
+					tails[i] = sl_null;
+					counts[i] = 0;
+				}
+				countHits = 0;
+			}
+
+			~_PacketBufferPool_ThreadCache();
+
+		public:
+			void flush()
+			{
+				for (sl_uint32 i = 0; i < POOL_CLASS_COUNT; i++) {
+					if (heads[i]) {
+						_PacketBufferPool_pushChain(i, heads[i], tails[i]);
+						heads[i] = sl_null;
+						tails[i] = sl_null;
+						counts[i] = 0;
+					}
+				}
+				flushHits();
+			}
+
+			void flushHits()
+			{
+				if (countHits) {
+					Base::interlockedAdd64(&_g_PacketBufferPool_countHits, countHits);
+					countHits = 0;
+				}
+			}
+
+			_PacketBufferPool_Block* pop(sl_uint32 sizeClass)
+			{
+				_PacketBufferPool_Block* block = heads[sizeClass];
+				if (!block) {
+					// refill from the global free-list
+					block = _PacketBufferPool_popAll(sizeClass);
+					if (!block) {
+						return sl_null;
+					}
+					_PacketBufferPool_Block* last = block;
+					sl_uint32 n = 1;
+					while (last->next) {
+						last = last->next;
+						n++;
+					}
+					heads[sizeClass] = block;
+					tails[sizeClass] = last;
+					counts[sizeClass] = n;
+				}
+				heads[sizeClass] = block->next;
+				if (!(block->next)) {
+					tails[sizeClass] = sl_null;
+				}
+				counts[sizeClass]--;
+				countHits++;
+				if (countHits >= POOL_THREAD_HITS_FLUSH) {
+					flushHits();
+				}
+				return block;
+			}
+
+			void push(_PacketBufferPool_Block* block)
+			{
+				sl_uint32 sizeClass = block->sizeClass;
+				if (counts[sizeClass] >= POOL_THREAD_CACHE_LIMIT) {
+					_PacketBufferPool_pushChain(sizeClass, heads[sizeClass], tails[sizeClass]);
+					heads[sizeClass] = sl_null;
+					tails[sizeClass] = sl_null;
+					counts[sizeClass] = 0;
+				}
+				block->next = heads[sizeClass];
+				if (!(heads[sizeClass])) {
+					tails[sizeClass] = block;
+				}
+				heads[sizeClass] = block;
+				counts[sizeClass]++;
+			}
+
+		};
+
+		// set when the cache of the current thread is destroyed while exiting the thread
+		static thread_local sl_bool _t_PacketBufferPool_flagCacheDestroyed = sl_false;
+
+		static thread_local _PacketBufferPool_ThreadCache _t_PacketBufferPool_cache;
+
+		_PacketBufferPool_ThreadCache::~_PacketBufferPool_ThreadCache()
+		{
+			flush();
+			_t_PacketBufferPool_flagCacheDestroyed = sl_true;
+		}
+
+		void* PacketBufferPool::allocate(sl_size size, sl_size* pOutCapacity)
+		{
+			sl_uint32 sizeClass = _PacketBufferPool_getClass(size + POOL_BLOCK_HEADER_SIZE);
+			_PacketBufferPool_Block* block = sl_null;
+			sl_size sizeBlock;
+			if (sizeClass == POOL_CLASS_OVERSIZED) {
+				sizeBlock = size + POOL_BLOCK_HEADER_SIZE;
+				Base::interlockedIncrement64(&_g_PacketBufferPool_countOversized);
+			} else {
+				sizeBlock = _PacketBufferPool_getClassSize(sizeClass);
+				if (_t_PacketBufferPool_flagCacheDestroyed) {
+					block = _PacketBufferPool_popAll(sizeClass);
+					if (block) {
+						if (block->next) {
+							_PacketBufferPool_Block* last = block->next;
+							while (last->next) {
+								last = last->next;
+							}
+							_PacketBufferPool_pushChain(sizeClass, block->next, last);
+						}
+						Base::interlockedIncrement64(&_g_PacketBufferPool_countHits);
+					}
+				} else {
+					block = _t_PacketBufferPool_cache.pop(sizeClass);
+				}
+			}
+			if (!block) {
+				block = (_PacketBufferPool_Block*)(Base::createMemory(sizeBlock));
+				if (!block) {
+					return sl_null;
+				}
+				block->sizeClass = sizeClass;
+				if (sizeClass != POOL_CLASS_OVERSIZED) {
+					Base::interlockedIncrement64(&_g_PacketBufferPool_countMisses);
+					Base::interlockedAdd64(&_g_PacketBufferPool_sizeAllocated, sizeBlock);
+				}
+			}
+			block->next = sl_null;
+			if (pOutCapacity) {
+				*pOutCapacity = sizeBlock - POOL_BLOCK_HEADER_SIZE;
+			}
+			return ((sl_uint8*)block) + POOL_BLOCK_HEADER_SIZE;
+		}
+
+		void PacketBufferPool::free(void* ptr)
+		{
+			if (!ptr) {
+				return;
+			}
+			_PacketBufferPool_Block* block = (_PacketBufferPool_Block*)(((sl_uint8*)ptr) - POOL_BLOCK_HEADER_SIZE);
+			if (block->sizeClass == POOL_CLASS_OVERSIZED) {
+				Base::freeMemory(block);
+				return;
+			}
+			if (_t_PacketBufferPool_flagCacheDestroyed) {
+				_PacketBufferPool_pushChain(block->sizeClass, block, block);
+			} else {
+				_t_PacketBufferPool_cache.push(block);
+			}
+		}
+
+		void PacketBufferPool::getStatistics(PacketBufferPoolStatistics& _out)
+		{
+			_out.countHits = (sl_uint64)(Base::interlockedAdd64(&_g_PacketBufferPool_countHits, 0));
+			_out.countMisses = (sl_uint64)(Base::interlockedAdd64(&_g_PacketBufferPool_countMisses, 0));
+			_out.countOversized = (sl_uint64)(Base::interlockedAdd64(&_g_PacketBufferPool_countOversized, 0));
+			_out.sizeAllocated = (sl_uint64)(Base::interlockedAdd64(&_g_PacketBufferPool_sizeAllocated, 0));
+		}
+
+		void PacketBufferPool::flushThreadCache()
+		{
+			if (!_t_PacketBufferPool_flagCacheDestroyed) {
+				_t_PacketBufferPool_cache.flush();
+			}
+		}
+
+
+#define PACKET_BUFFER_HEADER_SIZE ((sizeof(PacketBuffer) + 15) & ~((sl_size)15))
+
+		PacketBuffer::PacketBuffer(sl_size capacity, sl_size offset, sl_size size)
+		{
+			m_data = ((sl_uint8*)this) + PACKET_BUFFER_HEADER_SIZE;
+			m_capacity = capacity;
+			m_claimFront = (sl_reg)offset;
+			m_claimBack = (sl_reg)(offset + size);
+		}
+
+		PacketBuffer::~PacketBuffer()
+		{
+		}
+
+		void* PacketBuffer::operator new(size_t sizeObject, void* place) throw()
+		{
+			return place;
+		}
+
+		void PacketBuffer::operator delete(void* ptr)
+		{
+			PacketBufferPool::free(ptr);
+		}
+
+		void PacketBuffer::operator delete(void* ptr, void* place)
+		{
+			PacketBufferPool::free(ptr);
+		}
+
+		Ref<PacketBuffer> PacketBuffer::create(sl_size size, sl_size headroom, sl_size tailroom)
+		{
+			sl_size sizeBlock = 0;
+			void* block = PacketBufferPool::allocate(PACKET_BUFFER_HEADER_SIZE + headroom + size + tailroom, &sizeBlock);
+			if (!block) {
+				return sl_null;
+			}
+			// the capacity is known before the constructor is called
+			sl_size capacity = sizeBlock - PACKET_BUFFER_HEADER_SIZE;
+			return new (block) PacketBuffer(capacity, headroom, size);
+		}
+
+		Ref<PacketBuffer> PacketBuffer::create(const void* data, sl_size size)
+		{
+			Ref<PacketBuffer> ret = create(size);
+			if (ret.isNotNull()) {
+				Base::copyMemory(ret->m_data, data, size);
+			}
+			return ret;
+		}
+
+		sl_bool PacketBuffer::claimFront(sl_size offset, sl_size size)
+		{
+			if (size > offset) {
+				return sl_false;
+			}
+			return Base::interlockedCompareExchange(&m_claimFront, (sl_reg)(offset - size), (sl_reg)offset);
+		}
+
+		sl_bool PacketBuffer::claimBack(sl_size offset, sl_size size)
+		{
+			if (offset + size > m_capacity) {
+				return sl_false;
+			}
+			return Base::interlockedCompareExchange(&m_claimBack, (sl_reg)(offset + size), (sl_reg)offset);
+		}
+
+
+		PacketData::PacketData()
+		{
+			m_data = sl_null;
+			m_size = 0;
+		}
+
+		PacketData::PacketData(const PacketData& other) : m_buffer(other.m_buffer), m_memory(other.m_memory)
+		{
+			m_data = other.m_data;
+			m_size = other.m_size;
+		}
+
+		PacketData::PacketData(const Memory& mem) : m_memory(mem)
+		{
+			m_data = (sl_uint8*)(mem.getData());
+			m_size = mem.getSize();
+		}
+
+		PacketData::PacketData(const Ref<PacketBuffer>& buffer, sl_size size) : m_buffer(buffer)
+		{
+			if (buffer.isNotNull()) {
+				m_data = buffer->getData();
+				m_size = size;
+			} else {
+				m_data = sl_null;
+				m_size = 0;
+			}
+		}
+
+		PacketData::PacketData(const Ref<PacketBuffer>& buffer, sl_size offset, sl_size size) : m_buffer(buffer)
+		{
+			if (buffer.isNotNull()) {
+				m_data = buffer->getData() + offset;
+				m_size = size;
+			} else {
+				m_data = sl_null;
+				m_size = 0;
+			}
+		}
+
+		PacketData::~PacketData()
+		{
+		}
+
+		PacketData& PacketData::operator=(const PacketData& other)
+		{
+			m_buffer = other.m_buffer;
+			m_memory = other.m_memory;
+			m_data = other.m_data;
+			m_size = other.m_size;
+			return *this;
+		}
+
+		PacketData& PacketData::operator=(const Memory& mem)
+		{
+			m_buffer.setNull();
+			m_memory = mem;
+			m_data = (sl_uint8*)(mem.getData());
+			m_size = mem.getSize();
+			return *this;
+		}
+
+		void PacketData::setNull()
+		{
+			m_buffer.setNull();
+			m_memory.setNull();
+			m_data = sl_null;
+			m_size = 0;
+		}
+
+		sl_bool PacketData::allocate(sl_size size, sl_size headroom, sl_size tailroom)
+		{
+			Ref<PacketBuffer> buffer = PacketBuffer::create(size, headroom, tailroom);
+			if (buffer.isNotNull()) {
+				*this = PacketData(buffer, headroom, size);
+				return sl_true;
+			}
+			return sl_false;
+		}
+
+		sl_bool PacketData::copyFrom(const void* data, sl_size size, sl_size headroom, sl_size tailroom)
+		{
+			Ref<PacketBuffer> buffer = PacketBuffer::create(size, headroom, tailroom);
+			if (buffer.isNotNull()) {
+				Base::copyMemory(buffer->getData() + headroom, data, size);
+				*this = PacketData(buffer, headroom, size);
+				return sl_true;
+			}
+			return sl_false;
+		}
+
+		sl_size PacketData::getHeadroom() const
+		{
+			PacketBuffer* buffer = m_buffer.get();
+			if (buffer) {
+				sl_reg offset = (sl_reg)(m_data - buffer->m_data);
+				if (Base::interlockedAdd(&(buffer->m_claimFront), 0) == offset) {
+					return (sl_size)offset;
+				}
+			}
+			return 0;
+		}
+
+		sl_size PacketData::getTailroom() const
+		{
+			PacketBuffer* buffer = m_buffer.get();
+			if (buffer) {
+				sl_reg offset = (sl_reg)(m_data + m_size - buffer->m_data);
+				if (Base::interlockedAdd(&(buffer->m_claimBack), 0) == offset) {
+					return buffer->m_capacity - (sl_size)offset;
+				}
+			}
+			return 0;
+		}
+
+		PacketData PacketData::sub(sl_size offset, sl_size size) const
+		{
+			PacketData ret;
+			if (offset <= m_size) {
+				if (size > m_size - offset) {
+					size = m_size - offset;
+				}
+				ret = *this;
+				ret.m_data = m_data + offset;
+				ret.m_size = size;
+			}
+			return ret;
+		}
+
+		sl_uint8* PacketData::prepend(sl_size size)
+		{
+			PacketBuffer* buffer = m_buffer.get();
+			if (buffer) {
+				if (buffer->claimFront(m_data - buffer->m_data, size)) {
+					m_data -= size;
+					m_size += size;
+					return m_data;
+				}
+			}
+			sl_size headroom = SLIB_STREAMER_PACKET_HEADROOM;
+			Ref<PacketBuffer> bufferNew = PacketBuffer::create(size + m_size, headroom, SLIB_STREAMER_PACKET_TAILROOM);
+			if (bufferNew.isNull()) {
+				return sl_null;
+			}
+			if (m_size) {
+				Base::copyMemory(bufferNew->m_data + headroom + size, m_data, m_size);
+			}
+			*this = PacketData(bufferNew, headroom, size + m_size);
+			return m_data;
+		}
+
+		sl_uint8* PacketData::append(sl_size size)
+		{
+			PacketBuffer* buffer = m_buffer.get();
+			if (buffer) {
+				if (buffer->claimBack(m_data + m_size - buffer->m_data, size)) {
+					sl_uint8* ret = m_data + m_size;
+					m_size += size;
+					return ret;
+				}
+			}
+			sl_size headroom = SLIB_STREAMER_PACKET_HEADROOM;
+			Ref<PacketBuffer> bufferNew = PacketBuffer::create(m_size + size, headroom, SLIB_STREAMER_PACKET_TAILROOM);
+			if (bufferNew.isNull()) {
+				return sl_null;
+			}
+			sl_size sizeOld = m_size;
+			if (sizeOld) {
+				Base::copyMemory(bufferNew->m_data + headroom, m_data, sizeOld);
+			}
+			*this = PacketData(bufferNew, headroom, sizeOld + size);
+			return m_data + sizeOld;
+		}
+
+		sl_bool PacketData::removeFront(sl_size size)
+		{
+			if (size > m_size) {
+				return sl_false;
+			}
+			m_data += size;
+			m_size -= size;
+			return sl_true;
+		}
+
+		sl_bool PacketData::removeBack(sl_size size)
+		{
+			if (size > m_size) {
+				return sl_false;
+			}
+			m_size -= size;
+			return sl_true;
+		}
+
+		Memory PacketData::getMemory() const
+		{
+			if (m_buffer.isNotNull()) {
+				return Memory::createStatic(m_data, m_size, m_buffer.get());
+			}
+			if (m_memory.isNotNull()) {
+				sl_size offset = m_data - (sl_uint8*)(m_memory.getData());
+				if (offset == 0 && m_size == m_memory.getSize()) {
+					return m_memory;
+				}
+				return m_memory.sub(offset, m_size);
+			}
+			return sl_null;
+		}
+
+	}
+
+}
@@ -10,76 +10,395 @@
 
 #include "../../../inc/slibx/streamer/codec.h"
 
-#include <slib/core/scoped.h>
-
 namespace slib
 {
 	
 	namespace streamer
 	{
 		
-		List<Packet> AudioOpusEncodeFilter::filter(const Packet& input)
+		void AudioOpusEncodeFilter::postSettings(const AudioOpusEncodeSettings& settings)
+		{
+			SpinLocker lock(&m_lockSettings);
+			m_settingsPosted = settings;
+			Base::interlockedCompareExchange32(&m_flagSettingsPosted, 1, 0);
+		}
+		
+		void AudioOpusEncodeFilter::filter(const Packet& input, PacketEmitter& emitter)
 		{
 			Ref<OpusEncoder> encoder = m_encoder;
 			if (encoder.isNull()) {
-				return sl_null;
+				return;
+			}
+			if (Base::interlockedCompareExchange32(&m_flagSettingsPosted, 0, 1)) {
+				AudioOpusEncodeSettings settings;
+				{
+					SpinLocker lock(&m_lockSettings);
+					settings = m_settingsPosted;
+				}
+				if (settings.bitrate) {
+					encoder->setBitrate(settings.bitrate);
+				}
+				setFecPercentage(settings.fecPercentage);
+				setExpectedLossPercentage(settings.expectedLossPercentage);
+				setFrameDuration(settings.frameDuration);
 			}
 			if (input.format != Packet::formatAudio_PCM_S16
 				|| input.data.getSize() % 2 != 0
 				|| input.audioParam.nChannels != encoder->getChannelsCount()
 				|| input.audioParam.nSamplesPerSecond != encoder->getSamplesCountPerSecond()) {
-				return List<Packet>::null();
+				return;
+			}
+			const sl_int16* samples = (const sl_int16*)(input.data.getData());
+			sl_uint32 count = (sl_uint32)(input.data.getSize()) / 2;
+			sl_uint32 duration = getFrameDuration();
+			if (!duration) {
+				// the samples buffered for the previous duration are discarded
+				m_nBuffered = 0;
+				encodeFrame(encoder.get(), samples, count, input, emitter);
+				return;
+			}
+			sl_uint32 nChannels = input.audioParam.nChannels;
+			sl_uint32 nSamplesPerSecond = input.audioParam.nSamplesPerSecond;
+			sl_uint32 nFrame = nSamplesPerSecond / 1000 * duration * nChannels;
+			if (!nFrame) {
+				return;
 			}
+			if (m_bufferFrame.getSize() < nFrame * 2) {
+				Memory mem = Memory::create(nFrame * 2);
+				if (mem.isNull()) {
+					return;
+				}
+				if (m_nBuffered) {
+					Base::copyMemory(mem.getData(), m_bufferFrame.getData(), m_nBuffered * 2);
+				}
+				m_bufferFrame = mem;
+			}
+			sl_int16* buf = (sl_int16*)(m_bufferFrame.getData());
+			sl_uint32 offset = 0;
+			while (offset < count) {
+				if (!m_nBuffered) {
+					m_packetBuffered.audioParam = input.audioParam;
+					m_packetBuffered.copyMetadata(input);
+					if (input.timestamp) {
+						m_packetBuffered.timestamp = input.timestamp + (sl_int64)(offset / nChannels) * 1000000000 / nSamplesPerSecond;
+					}
+				}
+				sl_uint32 n = 0;
+				if (m_nBuffered < nFrame) {
+					n = nFrame - m_nBuffered;
+					if (n > count - offset) {
+						n = count - offset;
+					}
+					Base::copyMemory(buf + m_nBuffered, samples + offset, n * 2);
+					m_nBuffered += n;
+					// the frame is silent only when all of the parts are silent
+					if (!(input.flags & Packet::flagSilence)) {
+						m_packetBuffered.flags &= ~((sl_uint32)(Packet::flagSilence));
+					}
+					offset += n;
+				}
+				// a shortened duration may leave more than one frame
+				while (m_nBuffered >= nFrame) {
+					encodeFrame(encoder.get(), buf, nFrame, m_packetBuffered, emitter);
+					m_nBuffered -= nFrame;
+					if (m_nBuffered) {
+						Base::moveMemory(buf, buf + nFrame, m_nBuffered * 2);
+						if (m_packetBuffered.timestamp) {
+							m_packetBuffered.timestamp += (sl_int64)duration * 1000000;
+						}
+					}
+				}
+			}
+		}
+		
+		void AudioOpusEncodeFilter::encodeFrame(OpusEncoder* encoder, const sl_int16* samples, sl_uint32 count, const Packet& metadata, PacketEmitter& emitter)
+		{
+			if (getDtx() && (metadata.flags & Packet::flagSilence)) {
+				sl_uint32 nChannels = metadata.audioParam.nChannels;
+				sl_uint32 nSamplesPerSecond = metadata.audioParam.nSamplesPerSecond;
+				sl_uint32 duration = (nChannels && nSamplesPerSecond) ? (sl_uint32)((sl_uint64)(count / nChannels) * 1000 / nSamplesPerSecond) : 0;
+				sl_uint32 interval = getDtxInterval();
+				if (m_flagSilence && (!interval || m_durationSilence < interval)) {
+					m_durationSilence += duration;
+					// the skipped frame keeps its sequence, so the receiver can still follow the timing
+					m_sequence++;
+					return;
+				}
+				m_flagSilence = sl_true;
+				m_durationSilence = duration;
+			} else {
+				m_flagSilence = sl_false;
+			}
+			
 			AudioData data;
 			data.format = AudioFormat::Int16_Mono;
-			data.data = input.data.getData();
-			data.count = (sl_uint32)(input.data.getSize()) / 2;
+			data.data = (void*)samples;
+			data.count = count;
 			Memory dataOut = encoder->encode(data);
 			if (dataOut.isNull()) {
-				return sl_null;
+				return;
 			}
 			Packet output;
-			output.format = Packet::formatAudio_OPUS;
-			output.audioParam = input.audioParam;
-			output.data = dataOut;
-			return List<Packet>::createFromElement(output);
+			output.audioParam = metadata.audioParam;
+			output.copyMetadata(metadata);
+			output.flags |= Packet::flagSequence;
+			output.sequence = m_sequence++;
+			
+			sl_uint32 percentage = getFecPercentage();
+			if (percentage == 0 && !(getRedundancy())) {
+				output.format = Packet::formatAudio_OPUS;
+				output.data = dataOut;
+				emitter.emit(output);
+				return;
+			}
+			
+			// framed with no redundant frame when FecPercentage is 0 (see `Redundancy`)
+			sl_uint32 nRedundant = 0;
+			m_fecCredit += percentage > 100 ? 100 : percentage;
+			if (m_fecCredit >= 100) {
+				m_fecCredit -= 100;
+				nRedundant = 1 + getExpectedLossPercentage() / 10;
+				if (nRedundant > SLIB_STREAMER_OPUS_MAX_REDUNDANCY) {
+					nRedundant = SLIB_STREAMER_OPUS_MAX_REDUNDANCY;
+				}
+			}
+			Memory* history[SLIB_STREAMER_OPUS_MAX_REDUNDANCY];
+			sl_uint32 distances[SLIB_STREAMER_OPUS_MAX_REDUNDANCY];
+			sl_uint32 nFrames = 0;
+			sl_size sizeOutput = 1 + dataOut.getSize();
+			// the oldest frame comes first
+			for (sl_uint32 k = nRedundant; k >= 1; k--) {
+				sl_uint32 index = (m_indexHistory + SLIB_STREAMER_OPUS_MAX_REDUNDANCY - k) % SLIB_STREAMER_OPUS_MAX_REDUNDANCY;
+				Memory& frame = m_history[index];
+				sl_size size = frame.getSize();
+				// the frames skipped by DTX make the distance longer than `k`
+				sl_uint64 distance = output.sequence - m_sequencesHistory[index];
+				if (size > 0 && size <= 0xFFFF && distance >= 1 && distance <= 0xFF) {
+					history[nFrames] = &frame;
+					distances[nFrames] = (sl_uint32)distance;
+					nFrames++;
+					sizeOutput += 3 + size;
+				}
+			}
+			
+			if (output.data.allocate(sizeOutput, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM)) {
+				sl_uint8* p = (sl_uint8*)(output.data.getData());
+				*(p++) = (sl_uint8)nFrames;
+				for (sl_uint32 i = 0; i < nFrames; i++) {
+					sl_size size = history[i]->getSize();
+					p[0] = (sl_uint8)(distances[i]);
+					p[1] = (sl_uint8)(size);
+					p[2] = (sl_uint8)(size >> 8);
+					Base::copyMemory(p + 3, history[i]->getData(), size);
+					p += 3 + size;
+				}
+				Base::copyMemory(p, dataOut.getData(), dataOut.getSize());
+				output.format = Packet::formatAudio_OPUS_RED;
+				emitter.emit(output);
+			}
+			
+			m_history[m_indexHistory] = dataOut;
+			m_sequencesHistory[m_indexHistory] = output.sequence;
+			m_indexHistory = (m_indexHistory + 1) % SLIB_STREAMER_OPUS_MAX_REDUNDANCY;
 		}
 		
-		List<Packet> AudioOpusDecodeFilter::filter(const Packet& input)
+		static sl_bool _AudioOpusDecode_parseRedundancy(const sl_uint8*& data, sl_size& size, const sl_uint8** redundant, sl_uint32* sizesRedundant, sl_uint32* distancesRedundant, sl_uint32& nRedundant)
+		{
+			if (size < 1) {
+				return sl_false;
+			}
+			sl_uint32 n = data[0];
+			data++;
+			size--;
+			for (sl_uint32 i = 0; i < n; i++) {
+				if (size < 3) {
+					return sl_false;
+				}
+				sl_uint32 sizeFrame = data[1] | ((sl_uint32)(data[2]) << 8);
+				if (size < 3 + (sl_size)sizeFrame) {
+					return sl_false;
+				}
+				if (nRedundant < SLIB_STREAMER_OPUS_MAX_REDUNDANCY) {
+					distancesRedundant[nRedundant] = data[0];
+					redundant[nRedundant] = data + 3;
+					sizesRedundant[nRedundant] = sizeFrame;
+					nRedundant++;
+				}
+				data += 3 + sizeFrame;
+				size -= 3 + sizeFrame;
+			}
+			return sl_true;
+		}
+		
+		void AudioOpusDecodeFilter::filter(const Packet& input, PacketEmitter& emitter)
 		{
 			Ref<OpusDecoder> decoder = m_decoder;
 			if (decoder.isNull()) {
-				return sl_null;
+				return;
 			}
-			if (input.format != Packet::formatAudio_OPUS && input.format != Packet::formatRaw) {
-				return sl_null;
+			if (input.flags & Packet::flagLost) {
+				concealLostFrame(input, emitter);
+				return;
 			}
-			if (input.format == Packet::formatAudio_OPUS) {
+			if ((input.flags & Packet::flagSilence) && input.data.isEmpty()) {
+				// the frame skipped by DTX, left to ComfortNoiseFilter
+				if (input.flags & Packet::flagSequence) {
+					m_flagSequence = sl_true;
+					m_sequenceNext = input.sequence + 1;
+				}
+				m_flagSilence = sl_true;
+				Packet output;
+				output.format = Packet::formatAudio_PCM_S16;
+				output.audioParam.nChannels = decoder->getChannelsCount();
+				output.audioParam.nSamplesPerSecond = decoder->getSamplesCountPerSecond();
+				output.copyMetadata(input);
+				emitter.emit(output);
+				return;
+			}
+			Packet::Format format = input.format;
+			if (format == Packet::formatRaw) {
+				format = getRawFormat();
+			} else {
 				if (input.audioParam.nChannels != decoder->getChannelsCount()
 					|| input.audioParam.nSamplesPerSecond != decoder->getSamplesCountPerSecond()) {
-					return sl_null;
+					return;
+				}
+			}
+			if (format != Packet::formatAudio_OPUS && format != Packet::formatAudio_OPUS_RED) {
+				return;
+			}
+			
+			const sl_uint8* data = (const sl_uint8*)(input.data.getData());
+			sl_size size = input.data.getSize();
+			const sl_uint8* redundant[SLIB_STREAMER_OPUS_MAX_REDUNDANCY];
+			sl_uint32 sizesRedundant[SLIB_STREAMER_OPUS_MAX_REDUNDANCY];
+			sl_uint32 distancesRedundant[SLIB_STREAMER_OPUS_MAX_REDUNDANCY];
+			sl_uint32 nRedundant = 0;
+			if (format == Packet::formatAudio_OPUS_RED) {
+				if (!(_AudioOpusDecode_parseRedundancy(data, size, redundant, sizesRedundant, distancesRedundant, nRedundant))) {
+					return;
 				}
 			}
 			
+			sl_bool flagSequence = (input.flags & Packet::flagSequence) != 0;
+			if (flagSequence) {
+				sl_uint64 sequence = input.sequence;
+				if (m_flagSequence) {
+					sl_int64 distance = (sl_int64)(sequence - m_sequenceNext);
+					if (distance < 0 && distance > -1000) {
+						// decoding the older frame would break the decoder state
+						return;
+					}
+					if (distance > 0 && getLossConcealment() && !m_flagSilence) {
+						sl_uint64 first = m_sequenceNext;
+						sl_uint32 nMax = getMaxConcealedFrames();
+						if ((sl_uint64)distance > nMax) {
+							first = sequence - nMax;
+						}
+						for (sl_uint64 lost = first; lost < sequence; lost++) {
+							sl_uint64 d = sequence - lost;
+							sl_uint32 i = 0;
+							for (; i < nRedundant; i++) {
+								if (distancesRedundant[i] == d) {
+									break;
+								}
+							}
+							if (i < nRedundant) {
+								decodeFrame(redundant[i], sizesRedundant[i], input, lost, sl_true, emitter);
+							} else {
+								decodeFrame(sl_null, 0, input, lost, sl_true, emitter);
+							}
+						}
+					}
+				}
+				m_flagSequence = sl_true;
+				m_sequenceNext = sequence + 1;
+			}
+			m_flagSilence = (input.flags & Packet::flagSilence) != 0;
+			decodeFrame(data, (sl_uint32)size, input, input.sequence, sl_false, emitter);
+		}
+		
+		void AudioOpusDecodeFilter::concealLostFrame(const Packet& input, PacketEmitter& emitter)
+		{
+			if (!(input.flags & Packet::flagSequence)) {
+				return;
+			}
+			sl_uint64 sequence = input.sequence;
+			if (m_flagSequence) {
+				sl_int64 distance = (sl_int64)(sequence - m_sequenceNext);
+				if (distance < 0 && distance > -1000) {
+					return;
+				}
+			}
+			// the playout of the lost frame is due now, so the next packet must not conceal it again
+			m_flagSequence = sl_true;
+			m_sequenceNext = sequence + 1;
+			if (!(getLossConcealment()) || m_flagSilence) {
+				return;
+			}
+			// JitterBufferFilter attaches the next packet (sequence + 1) when it is already buffered
+			const sl_uint8* data = (const sl_uint8*)(input.data.getData());
+			sl_size size = input.data.getSize();
+			Packet::Format format = input.format;
+			if (format == Packet::formatRaw) {
+				format = getRawFormat();
+			}
+			if (size && format == Packet::formatAudio_OPUS_RED) {
+				const sl_uint8* redundant[SLIB_STREAMER_OPUS_MAX_REDUNDANCY];
+				sl_uint32 sizesRedundant[SLIB_STREAMER_OPUS_MAX_REDUNDANCY];
+				sl_uint32 distancesRedundant[SLIB_STREAMER_OPUS_MAX_REDUNDANCY];
+				sl_uint32 nRedundant = 0;
+				if (_AudioOpusDecode_parseRedundancy(data, size, redundant, sizesRedundant, distancesRedundant, nRedundant)) {
+					for (sl_uint32 i = 0; i < nRedundant; i++) {
+						if (distancesRedundant[i] == 1) {
+							decodeFrame(redundant[i], sizesRedundant[i], input, sequence, sl_true, emitter);
+							return;
+						}
+					}
+				}
+			}
+			decodeFrame(sl_null, 0, input, sequence, sl_true, emitter);
+		}
+		
+		void AudioOpusDecodeFilter::decodeFrame(const void* data, sl_uint32 size, const Packet& input, sl_uint64 sequence, sl_bool flagConcealed, PacketEmitter& emitter)
+		{
+			Ref<OpusDecoder>& decoder = m_decoder;
 			sl_uint32 nOutput = getMaxSamplesPerFrame();
-			SLIB_SCOPED_BUFFER(sl_int16, 4096, enc, nOutput);
-			if (!enc) {
-				return sl_null;
+			if (!data) {
+				// the concealment synthesizes the same duration as the last frame
+				nOutput = m_nSamplesLastFrame;
+				if (!nOutput) {
+					return;
+				}
+			}
+			Ref<PacketBuffer> buffer = PacketBuffer::create(nOutput * 2);
+			if (buffer.isNull()) {
+				return;
 			}
 			AudioData dataOutput;
 			dataOutput.format = AudioFormat::Int16_Mono;
-			dataOutput.data = enc;
+			dataOutput.data = buffer->getData();
 			dataOutput.count = nOutput;
-			nOutput = decoder->decode(input.data.getData(), (sl_uint32)(input.data.getSize()), dataOutput);
+			// a null frame runs the packet-loss concealment of libopus
+			nOutput = decoder->decode(data, size, dataOutput);
 			if (!nOutput) {
-				return sl_null;
+				return;
+			}
+			if (data) {
+				m_nSamplesLastFrame = nOutput;
 			}
 			Packet output;
 			output.format = Packet::formatAudio_PCM_S16;
 			output.audioParam.nChannels = decoder->getChannelsCount();
 			output.audioParam.nSamplesPerSecond = decoder->getSamplesCountPerSecond();
-			output.data = Memory::create(enc, nOutput * 2);
-			return List<Packet>::createFromElement(output);
+			output.copyMetadata(input);
+			output.sequence = sequence;
+			if (flagConcealed) {
+				output.timestamp = 0;
+				output.flags |= Packet::flagConcealed;
+			}
+			output.data = PacketData(buffer, nOutput * 2);
+			emitter.emit(output);
 		}
 		
 	}
@@ -0,0 +1,464 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "../../../inc/slibx/streamer/encode_service.h"
+
+#include <slib/core/system.h>
+
+#if defined(SLIB_PLATFORM_IS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#define ENCODE_SERVICE_JOBS_INITIAL 64
+#define ENCODE_SERVICE_NO_JOB ((sl_size)-1)
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		struct _OpusEncodeServiceJob
+		{
+			Ref<OpusEncodeStream> stream;
+			Packet packet;
+			// the next job of the same stream in the batch
+			sl_size next;
+		};
+		
+		// job array keeping its storage between the batches; grown by the submitter out of the lock
+		class _OpusEncodeServiceJobs
+		{
+		public:
+			_OpusEncodeServiceJob* data;
+			sl_size count;
+			sl_size capacity;
+			
+		public:
+			_OpusEncodeServiceJobs()
+			{
+				data = sl_null;
+				count = 0;
+				capacity = 0;
+			}
+			
+			~_OpusEncodeServiceJobs()
+			{
+				if (data) {
+					delete[] data;
+				}
+			}
+			
+		public:
+			// requires `count < capacity`
+			void add(OpusEncodeStream* stream, const Packet& packet)
+			{
+				data[count].stream = stream;
+				data[count].packet = packet;
+				count++;
+			}
+			
+			// moves the jobs to `dataNew`, and returns the previous storage to be freed by the caller
+			_OpusEncodeServiceJob* replace(_OpusEncodeServiceJob* dataNew, sl_size capacityNew)
+			{
+				for (sl_size i = 0; i < count; i++) {
+					dataNew[i].stream = data[i].stream;
+					dataNew[i].packet = data[i].packet;
+				}
+				_OpusEncodeServiceJob* dataOld = data;
+				data = dataNew;
+				capacity = capacityNew;
+				return dataOld;
+			}
+			
+			void clear()
+			{
+				for (sl_size i = 0; i < count; i++) {
+					data[i].stream.setNull();
+					data[i].packet = Packet();
+				}
+				count = 0;
+			}
+			
+			void swap(_OpusEncodeServiceJobs& other)
+			{
+				_OpusEncodeServiceJob* t = data;
+				data = other.data;
+				other.data = t;
+				sl_size n = count;
+				count = other.count;
+				other.count = n;
+				n = capacity;
+				capacity = other.capacity;
+				other.capacity = n;
+			}
+			
+		};
+		
+		class _OpusEncodeServiceWorker : public Referable
+		{
+		public:
+			sl_uint32 index;
+			Ref<Thread> thread;
+			Ref<Event> event;
+			sl_int32 flagIdle;
+			sl_int32 countStreams;
+			
+			SpinLock lock;
+			_OpusEncodeServiceJobs jobs;
+			
+		public:
+			_OpusEncodeServiceWorker()
+			{
+				index = 0;
+				flagIdle = 0;
+				countStreams = 0;
+			}
+			
+		public:
+			sl_bool submit(OpusEncodeStream* stream, const Packet& packet)
+			{
+				_OpusEncodeServiceJob* dataNew = sl_null;
+				_OpusEncodeServiceJob* dataOld = sl_null;
+				sl_size capacityNew = 0;
+				for (;;) {
+					{
+						SpinLocker locker(&lock);
+						if (jobs.count == jobs.capacity && dataNew && capacityNew > jobs.capacity) {
+							dataOld = jobs.replace(dataNew, capacityNew);
+							dataNew = sl_null;
+						}
+						if (jobs.count < jobs.capacity) {
+							jobs.add(stream, packet);
+							break;
+						}
+						capacityNew = jobs.capacity ? jobs.capacity * 2 : ENCODE_SERVICE_JOBS_INITIAL;
+					}
+					// the storage is allocated out of the lock, so the worker and the other submitters are not held by the allocator
+					if (dataNew) {
+						delete[] dataNew;
+					}
+					dataNew = new _OpusEncodeServiceJob[capacityNew];
+					if (!dataNew) {
+						return sl_false;
+					}
+				}
+				if (dataNew) {
+					delete[] dataNew;
+				}
+				if (dataOld) {
+					delete[] dataOld;
+				}
+				// the wakeups are coalesced while the worker is busy
+				if (Base::interlockedCompareExchange32(&flagIdle, 0, 1)) {
+					event->set();
+				}
+				return sl_true;
+			}
+			
+		};
+		
+		static void _OpusEncodeService_setAffinity(sl_uint32 cpu)
+		{
+#if defined(SLIB_PLATFORM_IS_LINUX)
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+		}
+		
+		
+		SLIB_DEFINE_OBJECT(OpusEncodeStream, Sink)
+		
+		OpusEncodeStream::OpusEncodeStream(const Ref<OpusEncoder>& encoder)
+		{
+			m_filter = new AudioOpusEncodeFilter(encoder);
+			setMaxQueuedFrames(16);
+			m_flagRemoved = 0;
+			m_countQueued = 0;
+			m_countEncoded = 0;
+			m_countDropped = 0;
+			m_jobFirst = ENCODE_SERVICE_NO_JOB;
+			m_jobLast = ENCODE_SERVICE_NO_JOB;
+		}
+		
+		OpusEncodeStream::~OpusEncodeStream()
+		{
+		}
+		
+		sl_bool OpusEncodeStream::sendPacket(const Packet& packet)
+		{
+			if (m_flagRemoved) {
+				return sl_false;
+			}
+			Ref<_OpusEncodeServiceWorker> worker = m_worker;
+			if (worker.isNull()) {
+				return sl_false;
+			}
+			if (Base::interlockedIncrement32(&m_countQueued) > (sl_int32)(getMaxQueuedFrames())) {
+				Base::interlockedDecrement32(&m_countQueued);
+				Base::interlockedIncrement64(&m_countDropped);
+				return sl_false;
+			}
+			if (!(worker->submit(this, packet))) {
+				Base::interlockedDecrement32(&m_countQueued);
+				Base::interlockedIncrement64(&m_countDropped);
+				return sl_false;
+			}
+			return sl_true;
+		}
+		
+		const Ref<AudioOpusEncodeFilter>& OpusEncodeStream::getFilter()
+		{
+			return m_filter;
+		}
+		
+		sl_bool OpusEncodeStream::isRemoved()
+		{
+			return m_flagRemoved != 0;
+		}
+		
+		sl_uint64 OpusEncodeStream::getEncodedCount()
+		{
+			return (sl_uint64)(Base::interlockedAdd64(&m_countEncoded, 0));
+		}
+		
+		sl_uint64 OpusEncodeStream::getDroppedCount()
+		{
+			return (sl_uint64)(Base::interlockedAdd64(&m_countDropped, 0));
+		}
+		
+		void OpusEncodeStream::encode(const Packet& input, PacketVector& output)
+		{
+			Base::interlockedDecrement32(&m_countQueued);
+			if (m_flagRemoved) {
+				return;
+			}
+			m_filter->filter(input, output);
+			sl_size n = output.getCount();
+			for (sl_size i = 0; i < n; i++) {
+				if (m_callback.isNotNull()) {
+					m_callback(output[i]);
+				}
+			}
+			output.clear();
+			Base::interlockedIncrement64(&m_countEncoded);
+		}
+		
+		
+		SLIB_DEFINE_OBJECT(OpusEncodeService, Object)
+		
+		OpusEncodeService::OpusEncodeService()
+		{
+			m_flagReleased = sl_false;
+		}
+		
+		OpusEncodeService::~OpusEncodeService()
+		{
+			Ref<_OpusEncodeServiceWorker>* workers = m_workers.getData();
+			sl_size nWorkers = m_workers.getCount();
+			for (sl_size i = 0; i < nWorkers; i++) {
+				Ref<Thread> thread = workers[i]->thread;
+				if (thread.isNotNull()) {
+					thread->finish();
+					workers[i]->event->set();
+				}
+			}
+		}
+		
+		Ref<OpusEncodeService> OpusEncodeService::create(sl_uint32 nThreads, sl_bool flagPinThreads)
+		{
+			if (nThreads == 0) {
+				nThreads = System::getProcessorsCount();
+				if (nThreads == 0) {
+					nThreads = 1;
+				}
+			}
+			Ref<OpusEncodeService> ret = new OpusEncodeService;
+			if (ret.isNull()) {
+				return sl_null;
+			}
+			Array< Ref<_OpusEncodeServiceWorker> > workers = Array< Ref<_OpusEncodeServiceWorker> >::create(nThreads);
+			if (workers.isNull()) {
+				return sl_null;
+			}
+			for (sl_uint32 i = 0; i < nThreads; i++) {
+				Ref<_OpusEncodeServiceWorker> worker = new _OpusEncodeServiceWorker;
+				if (worker.isNull()) {
+					return sl_null;
+				}
+				worker->index = i;
+				worker->event = Event::create();
+				if (worker->event.isNull()) {
+					return sl_null;
+				}
+				_OpusEncodeServiceJob* jobs = new _OpusEncodeServiceJob[ENCODE_SERVICE_JOBS_INITIAL];
+				if (!jobs) {
+					return sl_null;
+				}
+				worker->jobs.replace(jobs, ENCODE_SERVICE_JOBS_INITIAL);
+				workers[i] = worker;
+			}
+			ret->m_workers = workers;
+			for (sl_uint32 i = 0; i < nThreads; i++) {
+				Ref<Thread> thread = Thread::start(Function<void()>::bind(&OpusEncodeService::runWorker, workers[i], flagPinThreads));
+				if (thread.isNull()) {
+					ret->release();
+					return sl_null;
+				}
+				workers[i]->thread = thread;
+			}
+			return ret;
+		}
+		
+		Ref<OpusEncodeStream> OpusEncodeService::addStream(const Ref<OpusEncoder>& encoder, const Function<void(const Packet&)>& callback, sl_int32 worker)
+		{
+			if (encoder.isNull()) {
+				return sl_null;
+			}
+			Ref<OpusEncodeStream> stream = new OpusEncodeStream(encoder);
+			if (stream.isNull() || stream->m_filter.isNull()) {
+				return sl_null;
+			}
+			stream->m_callback = callback;
+			ObjectLocker lock(this);
+			if (m_flagReleased) {
+				return sl_null;
+			}
+			Ref<_OpusEncodeServiceWorker>* workers = m_workers.getData();
+			sl_uint32 nWorkers = (sl_uint32)(m_workers.getCount());
+			if (!nWorkers) {
+				return sl_null;
+			}
+			sl_uint32 index = 0;
+			if (worker >= 0) {
+				index = (sl_uint32)worker % nWorkers;
+			} else {
+				for (sl_uint32 i = 1; i < nWorkers; i++) {
+					if (workers[i]->countStreams < workers[index]->countStreams) {
+						index = i;
+					}
+				}
+			}
+			Base::interlockedIncrement32(&(workers[index]->countStreams));
+			stream->m_worker = workers[index];
+			return stream;
+		}
+		
+		void OpusEncodeService::removeStream(const Ref<OpusEncodeStream>& stream)
+		{
+			if (stream.isNull()) {
+				return;
+			}
+			if (!(Base::interlockedCompareExchange32(&(stream->m_flagRemoved), 1, 0))) {
+				return;
+			}
+			Ref<_OpusEncodeServiceWorker> worker = stream->m_worker;
+			if (worker.isNotNull()) {
+				Base::interlockedDecrement32(&(worker->countStreams));
+			}
+		}
+		
+		void OpusEncodeService::release()
+		{
+			Array< Ref<_OpusEncodeServiceWorker> > workers;
+			{
+				ObjectLocker lock(this);
+				if (m_flagReleased) {
+					return;
+				}
+				m_flagReleased = sl_true;
+				workers = m_workers;
+			}
+			Ref<_OpusEncodeServiceWorker>* data = workers.getData();
+			sl_size n = workers.getCount();
+			for (sl_size i = 0; i < n; i++) {
+				Ref<Thread> thread = data[i]->thread;
+				if (thread.isNotNull()) {
+					thread->finish();
+					data[i]->event->set();
+				}
+			}
+			for (sl_size i = 0; i < n; i++) {
+				Ref<Thread> thread = data[i]->thread;
+				if (thread.isNotNull()) {
+					thread->finishAndWait();
+				}
+				SpinLocker lock(&(data[i]->lock));
+				data[i]->jobs.clear();
+			}
+		}
+		
+		sl_uint32 OpusEncodeService::getThreadsCount()
+		{
+			return (sl_uint32)(m_workers.getCount());
+		}
+		
+		void OpusEncodeService::runWorker(Ref<_OpusEncodeServiceWorker> worker, sl_bool flagPin)
+		{
+			if (flagPin) {
+				_OpusEncodeService_setAffinity(worker->index);
+			}
+			Ref<Event> ev = worker->event;
+			_OpusEncodeServiceJobs batch;
+			PacketVector output;
+			while (!Thread::isStoppingCurrent()) {
+				{
+					SpinLocker lock(&(worker->lock));
+					batch.swap(worker->jobs);
+				}
+				if (!(batch.count)) {
+					// announces the idle state, and checks the queue again not to miss the job submitted meanwhile
+					Base::interlockedCompareExchange32(&(worker->flagIdle), 1, 0);
+					sl_bool flagEmpty;
+					{
+						SpinLocker lock(&(worker->lock));
+						flagEmpty = worker->jobs.count == 0;
+					}
+					if (flagEmpty) {
+						ev->wait();
+					}
+					Base::interlockedCompareExchange32(&(worker->flagIdle), 0, 1);
+					continue;
+				}
+				// links the jobs of each stream in the order of the submission
+				_OpusEncodeServiceJob* jobs = batch.data;
+				sl_size n = batch.count;
+				for (sl_size i = 0; i < n; i++) {
+					OpusEncodeStream* stream = jobs[i].stream.get();
+					jobs[i].next = ENCODE_SERVICE_NO_JOB;
+					if (stream->m_jobLast == ENCODE_SERVICE_NO_JOB) {
+						stream->m_jobFirst = i;
+					} else {
+						jobs[stream->m_jobLast].next = i;
+					}
+					stream->m_jobLast = i;
+				}
+				// encodes the frames of one stream back to back
+				for (sl_size i = 0; i < n; i++) {
+					OpusEncodeStream* stream = jobs[i].stream.get();
+					if (stream->m_jobFirst != i) {
+						continue;
+					}
+					for (sl_size k = i; k != ENCODE_SERVICE_NO_JOB; k = jobs[k].next) {
+						stream->encode(jobs[k].packet, output);
+					}
+					stream->m_jobFirst = ENCODE_SERVICE_NO_JOB;
+					stream->m_jobLast = ENCODE_SERVICE_NO_JOB;
+				}
+				batch.clear();
+			}
+		}
+		
+	}
+	
+}
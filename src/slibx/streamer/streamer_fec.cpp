@@ -0,0 +1,317 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#include "../../../inc/slibx/streamer/fec.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STREAMER_FEC_X86_DISPATCH
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define STREAMER_FEC_NEON
+#include <arm_neon.h>
+#endif
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class _GaloisField256_Tables
+		{
+		public:
+			sl_uint8 exp[512];
+			sl_uint8 log[256];
+			sl_uint8 mul[256][256];
+			
+		public:
+			_GaloisField256_Tables()
+			{
+				sl_uint32 x = 1;
+				for (sl_uint32 i = 0; i < 255; i++) {
+					exp[i] = (sl_uint8)x;
+					log[x] = (sl_uint8)i;
+					x <<= 1;
+					if (x & 0x100) {
+						x ^= 0x11D;
+					}
+				}
+				for (sl_uint32 i = 255; i < 512; i++) {
+					exp[i] = exp[i - 255];
+				}
+				log[0] = 0;
+				for (sl_uint32 a = 0; a < 256; a++) {
+					for (sl_uint32 b = 0; b < 256; b++) {
+						if (a && b) {
+							mul[a][b] = exp[log[a] + log[b]];
+						} else {
+							mul[a][b] = 0;
+						}
+					}
+				}
+			}
+			
+		};
+		
+		static const _GaloisField256_Tables& _GaloisField256_getTables()
+		{
+			static _GaloisField256_Tables tables;
+			return tables;
+		}
+		
+		static void _GaloisField256_multiplyAdd_Scalar(sl_uint8* dst, const sl_uint8* src, sl_uint8 c, sl_size size)
+		{
+			const sl_uint8* row = _GaloisField256_getTables().mul[c];
+			for (sl_size i = 0; i < size; i++) {
+				dst[i] ^= row[src[i]];
+			}
+		}
+		
+#if defined(STREAMER_FEC_X86_DISPATCH)
+		__attribute__((target("ssse3")))
+		static void _GaloisField256_multiplyAdd_SSSE3(sl_uint8* dst, const sl_uint8* src, sl_uint8 c, sl_size size)
+		{
+			const sl_uint8* row = _GaloisField256_getTables().mul[c];
+			sl_uint8 lo[16], hi[16];
+			for (sl_uint32 i = 0; i < 16; i++) {
+				lo[i] = row[i];
+				hi[i] = row[i << 4];
+			}
+			__m128i tableLow = _mm_loadu_si128((const __m128i*)lo);
+			__m128i tableHigh = _mm_loadu_si128((const __m128i*)hi);
+			__m128i mask = _mm_set1_epi8(0x0F);
+			sl_size i = 0;
+			for (; i + 16 <= size; i += 16) {
+				__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+				__m128i l = _mm_and_si128(s, mask);
+				__m128i h = _mm_and_si128(_mm_srli_epi64(s, 4), mask);
+				__m128i p = _mm_xor_si128(_mm_shuffle_epi8(tableLow, l), _mm_shuffle_epi8(tableHigh, h));
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(dst + i)), p));
+			}
+			for (; i < size; i++) {
+				dst[i] ^= row[src[i]];
+			}
+		}
+		
+		__attribute__((target("avx2")))
+		static void _GaloisField256_multiplyAdd_AVX2(sl_uint8* dst, const sl_uint8* src, sl_uint8 c, sl_size size)
+		{
+			const sl_uint8* row = _GaloisField256_getTables().mul[c];
+			sl_uint8 lo[16], hi[16];
+			for (sl_uint32 i = 0; i < 16; i++) {
+				lo[i] = row[i];
+				hi[i] = row[i << 4];
+			}
+			__m256i tableLow = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)lo));
+			__m256i tableHigh = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)hi));
+			__m256i mask = _mm256_set1_epi8(0x0F);
+			sl_size i = 0;
+			for (; i + 32 <= size; i += 32) {
+				__m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+				__m256i l = _mm256_and_si256(s, mask);
+				__m256i h = _mm256_and_si256(_mm256_srli_epi64(s, 4), mask);
+				__m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(tableLow, l), _mm256_shuffle_epi8(tableHigh, h));
+				_mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(dst + i)), p));
+			}
+			for (; i < size; i++) {
+				dst[i] ^= row[src[i]];
+			}
+		}
+#endif
+		
+#if defined(STREAMER_FEC_NEON)
+		static void _GaloisField256_multiplyAdd_NEON(sl_uint8* dst, const sl_uint8* src, sl_uint8 c, sl_size size)
+		{
+			const sl_uint8* row = _GaloisField256_getTables().mul[c];
+			sl_uint8 lo[16], hi[16];
+			for (sl_uint32 i = 0; i < 16; i++) {
+				lo[i] = row[i];
+				hi[i] = row[i << 4];
+			}
+			uint8x16_t tableLow = vld1q_u8(lo);
+			uint8x16_t tableHigh = vld1q_u8(hi);
+			uint8x16_t mask = vdupq_n_u8(0x0F);
+			sl_size i = 0;
+			for (; i + 16 <= size; i += 16) {
+				uint8x16_t s = vld1q_u8(src + i);
+				uint8x16_t p = veorq_u8(vqtbl1q_u8(tableLow, vandq_u8(s, mask)), vqtbl1q_u8(tableHigh, vshrq_n_u8(s, 4)));
+				vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), p));
+			}
+			for (; i < size; i++) {
+				dst[i] ^= row[src[i]];
+			}
+		}
+#endif
+		
+		typedef void (*_GaloisField256_MultiplyAddFunc)(sl_uint8* dst, const sl_uint8* src, sl_uint8 c, sl_size size);
+		
+		static _GaloisField256_MultiplyAddFunc _GaloisField256_selectMultiplyAdd()
+		{
+#if defined(STREAMER_FEC_X86_DISPATCH)
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2")) {
+				return _GaloisField256_multiplyAdd_AVX2;
+			}
+			if (__builtin_cpu_supports("ssse3")) {
+				return _GaloisField256_multiplyAdd_SSSE3;
+			}
+#elif defined(STREAMER_FEC_NEON)
+			return _GaloisField256_multiplyAdd_NEON;
+#endif
+			return _GaloisField256_multiplyAdd_Scalar;
+		}
+		
+		sl_uint8 GaloisField256::multiply(sl_uint8 a, sl_uint8 b)
+		{
+			return _GaloisField256_getTables().mul[a][b];
+		}
+		
+		sl_uint8 GaloisField256::inverse(sl_uint8 a)
+		{
+			if (!a) {
+				return 0;
+			}
+			const _GaloisField256_Tables& tables = _GaloisField256_getTables();
+			return tables.exp[255 - tables.log[a]];
+		}
+		
+		void GaloisField256::multiplyAdd(sl_uint8* dst, const sl_uint8* src, sl_uint8 c, sl_size size)
+		{
+			if (c == 0) {
+				return;
+			}
+			if (c == 1) {
+				add(dst, src, size);
+				return;
+			}
+			static _GaloisField256_MultiplyAddFunc func = _GaloisField256_selectMultiplyAdd();
+			func(dst, src, c, size);
+		}
+		
+		void GaloisField256::add(sl_uint8* dst, const sl_uint8* src, sl_size size)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= size; i += 8) {
+				sl_uint64 a, b;
+				Base::copyMemory(&a, dst + i, 8);
+				Base::copyMemory(&b, src + i, 8);
+				a ^= b;
+				Base::copyMemory(dst + i, &a, 8);
+			}
+			for (; i < size; i++) {
+				dst[i] ^= src[i];
+			}
+		}
+		
+		sl_bool GaloisField256::invertMatrix(sl_uint8* matrix, sl_uint32 n)
+		{
+			// Gauss-Jordan elimination on [matrix | identity]
+			sl_uint8 work[SLIB_STREAMER_FEC_MAX_PARITY * SLIB_STREAMER_FEC_MAX_PARITY * 2];
+			if (n > SLIB_STREAMER_FEC_MAX_PARITY) {
+				return sl_false;
+			}
+			sl_uint32 w = n * 2;
+			for (sl_uint32 r = 0; r < n; r++) {
+				for (sl_uint32 c = 0; c < n; c++) {
+					work[r * w + c] = matrix[r * n + c];
+					work[r * w + n + c] = (r == c) ? 1 : 0;
+				}
+			}
+			for (sl_uint32 col = 0; col < n; col++) {
+				sl_uint32 pivot = col;
+				while (pivot < n && !work[pivot * w + col]) {
+					pivot++;
+				}
+				if (pivot == n) {
+					return sl_false;
+				}
+				if (pivot != col) {
+					for (sl_uint32 c = 0; c < w; c++) {
+						sl_uint8 t = work[col * w + c];
+						work[col * w + c] = work[pivot * w + c];
+						work[pivot * w + c] = t;
+					}
+				}
+				sl_uint8 f = inverse(work[col * w + col]);
+				for (sl_uint32 c = 0; c < w; c++) {
+					work[col * w + c] = multiply(work[col * w + c], f);
+				}
+				for (sl_uint32 r = 0; r < n; r++) {
+					if (r != col) {
+						sl_uint8 g = work[r * w + col];
+						if (g) {
+							for (sl_uint32 c = 0; c < w; c++) {
+								work[r * w + c] ^= multiply(g, work[col * w + c]);
+							}
+						}
+					}
+				}
+			}
+			for (sl_uint32 r = 0; r < n; r++) {
+				for (sl_uint32 c = 0; c < n; c++) {
+					matrix[r * n + c] = work[r * w + n + c];
+				}
+			}
+			return sl_true;
+		}
+		
+		
+		ReedSolomonCode::ReedSolomonCode()
+		{
+			m_nData = 0;
+			m_nParity = 0;
+		}
+		
+		sl_bool ReedSolomonCode::initialize(sl_uint32 nData, sl_uint32 nParity)
+		{
+			if (nData < 1 || nData > SLIB_STREAMER_FEC_MAX_DATA) {
+				return sl_false;
+			}
+			if (nParity < 1 || nParity > SLIB_STREAMER_FEC_MAX_PARITY) {
+				return sl_false;
+			}
+			// Cauchy matrix: 1 / (x[row] + y[col]), x = { nData, nData + 1, ... }, y = { 0, 1, ... }
+			for (sl_uint32 row = 0; row < nParity; row++) {
+				for (sl_uint32 col = 0; col < nData; col++) {
+					m_matrix[row * SLIB_STREAMER_FEC_MAX_DATA + col] = GaloisField256::inverse((sl_uint8)((nData + row) ^ col));
+				}
+			}
+			// scales the columns to make the first row all ones; any square sub-matrix stays invertible
+			for (sl_uint32 col = 0; col < nData; col++) {
+				sl_uint8 f = GaloisField256::inverse(m_matrix[col]);
+				for (sl_uint32 row = 0; row < nParity; row++) {
+					sl_uint8& v = m_matrix[row * SLIB_STREAMER_FEC_MAX_DATA + col];
+					v = GaloisField256::multiply(v, f);
+				}
+			}
+			m_nData = nData;
+			m_nParity = nParity;
+			return sl_true;
+		}
+		
+		void ReedSolomonCode::encode(sl_uint8* parity, sl_uint32 row, const sl_uint8* data, sl_uint32 col, sl_size size) const
+		{
+			GaloisField256::multiplyAdd(parity, data, getCoefficient(row, col), size);
+		}
+		
+		sl_bool ReedSolomonCode::getRecoveryMatrix(const sl_uint32* missingColumns, const sl_uint32* parityRows, sl_uint32 n, sl_uint8* outMatrix) const
+		{
+			for (sl_uint32 i = 0; i < n; i++) {
+				for (sl_uint32 j = 0; j < n; j++) {
+					outMatrix[i * n + j] = getCoefficient(parityRows[i], missingColumns[j]);
+				}
+			}
+			return GaloisField256::invertMatrix(outMatrix, n);
+		}
+		
+	}
+	
+}
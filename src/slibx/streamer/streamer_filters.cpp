@@ -10,9 +10,9 @@
 
 #include "../../../inc/slibx/streamer/filters.h"
 
-#include <slib/core/io.h>
-#include <slib/core/scoped.h>
 #include <slib/crypto/sha2.h>
+#include <slib/core/math.h>
+#include <slib/core/time.h>
 
 namespace slib
 {
@@ -20,118 +20,772 @@ namespace slib
 	namespace streamer
 	{
 		
-		List<Packet> DatagramHashSHA256SendFilter::filter(const Packet& input)
+		void DatagramHashSHA256SendFilter::filter(const Packet& input, PacketEmitter& emitter)
 		{
 			Packet output = input;
-			MemoryBuffer buf;
-			buf.add(SHA256::hash(input.data));
-			buf.add(input.data);
-			output.data = buf.merge();
-			return List<Packet>::createFromElement(output);
+			// the hash is written in the headroom when the input has reserved it
+			sl_uint8* hash = output.data.prepend(32);
+			if (!hash) {
+				return;
+			}
+			SHA256::hash(input.data.getData(), input.data.getSize(), hash);
+			emitter.emit(output);
 		}
 		
-		List<Packet> DatagramHashSHA256ReceiveFilter::filter(const Packet& input)
+		void DatagramHashSHA256ReceiveFilter::filter(const Packet& input, PacketEmitter& emitter)
 		{
 			Packet output = input;
 			sl_uint8* buf = (sl_uint8*)(output.data.getData());
 			sl_uint32 size = (sl_uint32)(output.data.getSize());
 			if (size <= 32) {
-				return List<Packet>::null();
+				return;
 			}
 			sl_uint8 hash[32];
 			SHA256::hash(buf + 32, size - 32, hash);
 			if (Base::compareMemory(hash, buf, 32) != 0) {
-				return List<Packet>::null();
+				return;
+			}
+			output.data.removeFront(32);
+			emitter.emit(output);
+		}
+		
+#define AEAD_HEADER_SIZE 12
+#define AEAD_EPOCH_SIZE 4
+#define AEAD_REPLAY_WINDOW 64
+		
+		// the payload can be overwritten only when no other packet refers to its buffer
+		static sl_bool _DatagramAead_isExclusive(const PacketData& data, sl_reg nReferences)
+		{
+			const Ref<PacketBuffer>& buffer = data.getBuffer();
+			if (buffer.isNull()) {
+				return sl_false;
+			}
+			return buffer->getReferenceCount() <= nReferences;
+		}
+		
+		static sl_uint32 _DatagramAead_getTagSize(sl_uint32 size)
+		{
+			if (size < SLIB_STREAMER_AEAD_MIN_TAG_SIZE) {
+				return SLIB_STREAMER_AEAD_MIN_TAG_SIZE;
+			}
+			if (size > SLIB_STREAMER_AEAD_TAG_SIZE) {
+				return SLIB_STREAMER_AEAD_TAG_SIZE;
+			}
+			return size;
+		}
+		
+		DatagramAeadSendFilter::DatagramAeadSendFilter(const Ref<AeadCipher>& cipher)
+		{
+			m_cipher = cipher;
+			setTagSize(SLIB_STREAMER_AEAD_TAG_SIZE);
+			// a restarted sender starts a newer epoch, and the random counter keeps the nonces apart within a second
+			m_epoch = (sl_uint32)(Time::now().getSecondsCount());
+			Math::randomMemory(&m_counter, sizeof(m_counter));
+		}
+		
+		DatagramAeadSendFilter::~DatagramAeadSendFilter()
+		{
+		}
+		
+		void DatagramAeadSendFilter::filter(const Packet& input, PacketEmitter& emitter)
+		{
+			if (m_cipher.isNull()) {
+				return;
+			}
+			sl_uint32 sizeTag = _DatagramAead_getTagSize(getTagSize());
+			sl_size size = input.data.getSize();
+			Packet output = input;
+			const sl_uint8* src = (const sl_uint8*)(input.data.getData());
+			sl_uint8* header;
+			if (_DatagramAead_isExclusive(input.data, 2)) {
+				header = output.data.prepend(AEAD_HEADER_SIZE);
+				if (!header || !(output.data.append(sizeTag))) {
+					return;
+				}
+				// prepend() may have moved the payload to a new buffer
+				header = (sl_uint8*)(output.data.getData());
+				src = header + AEAD_HEADER_SIZE;
+			} else {
+				if (!(output.data.allocate(AEAD_HEADER_SIZE + size + sizeTag, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM))) {
+					return;
+				}
+				header = (sl_uint8*)(output.data.getData());
+			}
+			sl_uint64 counter = m_counter++;
+			for (sl_uint32 i = 0; i < AEAD_EPOCH_SIZE; i++) {
+				header[i] = (sl_uint8)(m_epoch >> ((AEAD_EPOCH_SIZE - 1 - i) << 3));
+			}
+			for (sl_uint32 i = AEAD_EPOCH_SIZE; i < AEAD_HEADER_SIZE; i++) {
+				header[i] = (sl_uint8)(counter >> ((AEAD_HEADER_SIZE - 1 - i) << 3));
+			}
+			sl_uint8 nonce[SLIB_STREAMER_AEAD_NONCE_SIZE];
+			Base::copyMemory(nonce, header, SLIB_STREAMER_AEAD_NONCE_SIZE);
+			sl_uint8* dst = header + AEAD_HEADER_SIZE;
+			m_cipher->encrypt(nonce, header, AEAD_HEADER_SIZE, src, dst, size, dst + size, sizeTag);
+			emitter.emit(output);
+		}
+		
+		DatagramAeadReceiveFilter::DatagramAeadReceiveFilter(const Ref<AeadCipher>& cipher)
+		{
+			m_cipher = cipher;
+			setTagSize(SLIB_STREAMER_AEAD_TAG_SIZE);
+			m_flagReceived = sl_false;
+			m_epoch = 0;
+			m_counterLast = 0;
+			m_maskReceived = 0;
+		}
+		
+		DatagramAeadReceiveFilter::~DatagramAeadReceiveFilter()
+		{
+		}
+		
+		void DatagramAeadReceiveFilter::filter(const Packet& input, PacketEmitter& emitter)
+		{
+			if (m_cipher.isNull()) {
+				return;
+			}
+			sl_uint32 sizeTag = _DatagramAead_getTagSize(getTagSize());
+			sl_size size = input.data.getSize();
+			if (size < AEAD_HEADER_SIZE + sizeTag) {
+				return;
+			}
+			const sl_uint8* buf = (const sl_uint8*)(input.data.getData());
+			sl_uint32 epoch = 0;
+			for (sl_uint32 i = 0; i < AEAD_EPOCH_SIZE; i++) {
+				epoch = (epoch << 8) | buf[i];
+			}
+			sl_uint64 counter = 0;
+			for (sl_uint32 i = AEAD_EPOCH_SIZE; i < AEAD_HEADER_SIZE; i++) {
+				counter = (counter << 8) | buf[i];
+			}
+			if (m_flagReceived) {
+				if (epoch < m_epoch) {
+					// the previous run of the sender
+					return;
+				}
+				if (epoch == m_epoch && counter <= m_counterLast) {
+					sl_uint64 distance = m_counterLast - counter;
+					if (distance >= AEAD_REPLAY_WINDOW || (m_maskReceived & ((sl_uint64)1 << distance))) {
+						return;
+					}
+				}
+			}
+			sl_size sizeText = size - AEAD_HEADER_SIZE - sizeTag;
+			sl_uint8 nonce[SLIB_STREAMER_AEAD_NONCE_SIZE];
+			Base::copyMemory(nonce, buf, SLIB_STREAMER_AEAD_NONCE_SIZE);
+			const sl_uint8* src = buf + AEAD_HEADER_SIZE;
+			Packet output = input;
+			sl_bool flagInPlace = _DatagramAead_isExclusive(input.data, 2);
+			sl_uint8* dst;
+			if (flagInPlace) {
+				dst = (sl_uint8*)src;
+			} else {
+				if (!(output.data.allocate(sizeText, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM))) {
+					return;
+				}
+				dst = (sl_uint8*)(output.data.getData());
+			}
+			if (!(m_cipher->decrypt(nonce, buf, AEAD_HEADER_SIZE, src, dst, sizeText, src + sizeText, sizeTag))) {
+				return;
+			}
+			// the replay window moves only for the authenticated packets
+			if (!m_flagReceived || epoch != m_epoch) {
+				m_flagReceived = sl_true;
+				m_epoch = epoch;
+				m_counterLast = counter;
+				m_maskReceived = 1;
+			} else if (counter > m_counterLast) {
+				sl_uint64 shift = counter - m_counterLast;
+				m_maskReceived = (shift >= AEAD_REPLAY_WINDOW ? 0 : (m_maskReceived << shift)) | 1;
+				m_counterLast = counter;
+			} else {
+				m_maskReceived |= (sl_uint64)1 << (m_counterLast - counter);
 			}
-			output.data = Memory::create(buf + 32, size - 32);
-			return List<Packet>::createFromElement(output);
+			if (flagInPlace) {
+				output.data.removeFront(AEAD_HEADER_SIZE);
+				output.data.removeBack(sizeTag);
+			}
+			emitter.emit(output);
+		}
+		
+		void DatagramMetadataSendFilter::filter(const Packet& input, PacketEmitter& emitter)
+		{
+			Packet output = input;
+			sl_uint8* header = output.data.prepend(input.getMetadataSize());
+			if (!header) {
+				return;
+			}
+			input.writeMetadata(header);
+			emitter.emit(output);
+		}
+		
+#define METADATA_OFFSET_WINDOW 10000000000LL
+		
+		DatagramSenderClock::DatagramSenderClock()
+		{
+			m_flagOffset = sl_false;
+			m_offsetWindow = 0;
+			m_offsetPrevious = 0;
+			m_timeWindow = 0;
+		}
+		
+		sl_int64 DatagramSenderClock::convert(sl_int64 timestamp, sl_int64 arrival)
+		{
+			sl_int64 now = arrival > 0 ? arrival : Packet::getCurrentTimestamp();
+			sl_int64 offset = now - timestamp;
+			if (!m_flagOffset || now - m_timeWindow >= METADATA_OFFSET_WINDOW) {
+				// the previous window keeps the estimate while the new window collects the samples;
+				// the estimate follows a drift or a restarted sender within two windows
+				m_offsetPrevious = m_flagOffset ? m_offsetWindow : offset;
+				m_offsetWindow = offset;
+				m_timeWindow = now;
+				m_flagOffset = sl_true;
+			} else if (offset < m_offsetWindow) {
+				m_offsetWindow = offset;
+			}
+			return timestamp + (m_offsetWindow < m_offsetPrevious ? m_offsetWindow : m_offsetPrevious);
+		}
+		
+		DatagramMetadataReceiveFilter::DatagramMetadataReceiveFilter()
+		{
+		}
+		
+		DatagramMetadataReceiveFilter::~DatagramMetadataReceiveFilter()
+		{
+		}
+		
+		void DatagramMetadataReceiveFilter::filter(const Packet& input, PacketEmitter& emitter)
+		{
+			Packet output = input;
+			const sl_uint8* buf = (const sl_uint8*)(input.data.getData());
+			const sl_uint8* p = output.readMetadata(buf, buf + input.data.getSize());
+			if (!p) {
+				return;
+			}
+			output.data.removeFront(p - buf);
+			if (output.timestamp > 0) {
+				output.timestamp = m_clock.convert(output.timestamp, input.timestamp);
+				output.flags |= Packet::flagSenderTime;
+			}
+			emitter.emit(output);
 		}
 
+#define FEC_HEADER_SIZE 8
+#define FEC_RECEIVE_WINDOW 32
+// the largest wire encoding of Packet metadata
+#define FEC_METADATA_SIZE_MAX 32
+		
+		static void _DatagramFec_writeHeader(sl_uint8* header, sl_uint32 nData, sl_uint32 nParity, sl_uint32 index, sl_uint32 interleave, sl_uint32 idBlock)
+		{
+			header[0] = (sl_uint8)nData;
+			header[1] = (sl_uint8)nParity;
+			header[2] = (sl_uint8)index;
+			header[3] = (sl_uint8)interleave;
+			header[4] = (sl_uint8)(idBlock);
+			header[5] = (sl_uint8)(idBlock >> 8);
+			header[6] = (sl_uint8)(idBlock >> 16);
+			header[7] = (sl_uint8)(idBlock >> 24);
+		}
+		
+		static sl_uint32 _DatagramFec_countBits(sl_uint64 n)
+		{
+			sl_uint32 count = 0;
+			while (n) {
+				n &= n - 1;
+				count++;
+			}
+			return count;
+		}
+		
+		DatagramFecSendFilter::DatagramFecSendFilter(sl_uint32 nData, sl_uint32 nParity, sl_uint32 interleave, sl_uint32 maxPacketSize)
+		{
+			if (!(m_code.initialize(nData, nParity))) {
+				m_code.initialize(4, 1);
+			}
+			if (interleave < 1) {
+				interleave = 1;
+			}
+			if (interleave > FEC_RECEIVE_WINDOW / 2) {
+				interleave = FEC_RECEIVE_WINDOW / 2;
+			}
+			m_interleave = interleave;
+			m_maxPacketSize = maxPacketSize;
+			m_position = 0;
+			m_idGroup = 0;
+			m_blocks = new Block[interleave];
+		}
+		
+		DatagramFecSendFilter::~DatagramFecSendFilter()
+		{
+			if (m_blocks) {
+				delete[] m_blocks;
+			}
+		}
+		
+		void DatagramFecSendFilter::filter(const Packet& input, PacketEmitter& emitter)
+		{
+			if (!m_blocks) {
+				return;
+			}
+			sl_size size = input.data.getSize();
+			if (size > m_maxPacketSize || size > 0xFFFF - 2 - FEC_METADATA_SIZE_MAX) {
+				return;
+			}
+			sl_uint32 nData = m_code.getDataCount();
+			sl_uint32 indexBlock = m_position % m_interleave;
+			sl_uint32 index = m_position / m_interleave;
+			Block& block = m_blocks[indexBlock];
+			if (index == 0) {
+				block.id = m_idGroup * m_interleave + indexBlock;
+				block.sizeSymbol = 0;
+			}
+			
+			// the metadata is sent and protected with the payload, so a recovered packet gets it back
+			sl_size sizeMetadata = input.getMetadataSize();
+			Packet output = input;
+			sl_uint8* header = output.data.prepend(FEC_HEADER_SIZE + sizeMetadata);
+			if (!header) {
+				return;
+			}
+			_DatagramFec_writeHeader(header, nData, m_code.getParityCount(), index, m_interleave, block.id);
+			input.writeMetadata(header + FEC_HEADER_SIZE);
+			emitter.emit(output);
+			
+			block.data[index] = output.data.sub(FEC_HEADER_SIZE);
+			size += sizeMetadata;
+			if (size + 2 > block.sizeSymbol) {
+				block.sizeSymbol = size + 2;
+			}
+			if (index + 1 == nData) {
+				emitParity(indexBlock, input, emitter);
+			}
+			m_position++;
+			if (m_position == nData * m_interleave) {
+				m_position = 0;
+				m_idGroup++;
+			}
+		}
+		
+		void DatagramFecSendFilter::emitParity(sl_uint32 indexBlock, const Packet& input, PacketEmitter& emitter)
+		{
+			Block& block = m_blocks[indexBlock];
+			sl_uint32 nData = m_code.getDataCount();
+			sl_uint32 nParity = m_code.getParityCount();
+			sl_size sizeSymbol = block.sizeSymbol;
+			for (sl_uint32 row = 0; row < nParity; row++) {
+				Packet output;
+				output.format = Packet::formatRaw;
+				// the parity follows the last data packet of the block, and has no sequence
+				output.copyMetadata(input);
+				output.flags &= ~((sl_uint32)(Packet::flagSequence));
+				if (!(output.data.allocate(FEC_HEADER_SIZE + sizeSymbol, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM))) {
+					break;
+				}
+				sl_uint8* header = (sl_uint8*)(output.data.getData());
+				_DatagramFec_writeHeader(header, nData, nParity, nData + row, m_interleave, block.id);
+				sl_uint8* parity = header + FEC_HEADER_SIZE;
+				Base::zeroMemory(parity, sizeSymbol);
+				// symbol of a data packet: 16-bit length + metadata + payload, padded with zeros to `sizeSymbol`
+				for (sl_uint32 col = 0; col < nData; col++) {
+					sl_size size = block.data[col].getSize();
+					sl_uint8 len[2] = {(sl_uint8)size, (sl_uint8)(size >> 8)};
+					m_code.encode(parity, row, len, col, 2);
+					m_code.encode(parity + 2, row, (const sl_uint8*)(block.data[col].getData()), col, size);
+				}
+				emitter.emit(output);
+			}
+			for (sl_uint32 col = 0; col < nData; col++) {
+				block.data[col].setNull();
+			}
+		}
+		
+		
+		DatagramFecReceiveFilter::DatagramFecReceiveFilter(sl_uint32 maxPacketSize)
+		{
+			m_maxPacketSize = maxPacketSize;
+			m_blocks = new Block[FEC_RECEIVE_WINDOW];
+			if (m_blocks) {
+				for (sl_uint32 i = 0; i < FEC_RECEIVE_WINDOW; i++) {
+					m_blocks[i].flagUsed = sl_false;
+				}
+			}
+			m_bufferSyndromes = Memory::create(SLIB_STREAMER_FEC_MAX_PARITY * (maxPacketSize + 2 + FEC_METADATA_SIZE_MAX));
+		}
+		
+		DatagramFecReceiveFilter::~DatagramFecReceiveFilter()
+		{
+			if (m_blocks) {
+				delete[] m_blocks;
+			}
+		}
+		
+		void DatagramFecReceiveFilter::filter(const Packet& input, PacketEmitter& emitter)
+		{
+			if (!m_blocks) {
+				return;
+			}
+			sl_size size = input.data.getSize();
+			if (size < FEC_HEADER_SIZE) {
+				return;
+			}
+			const sl_uint8* header = (const sl_uint8*)(input.data.getData());
+			sl_uint32 nData = header[0];
+			sl_uint32 nParity = header[1];
+			sl_uint32 index = header[2];
+			sl_uint32 id = (sl_uint32)(header[4]) | ((sl_uint32)(header[5]) << 8) | ((sl_uint32)(header[6]) << 16) | ((sl_uint32)(header[7]) << 24);
+			if (nData < 1 || nData > SLIB_STREAMER_FEC_MAX_DATA || nParity < 1 || nParity > SLIB_STREAMER_FEC_MAX_PARITY || index >= nData + nParity) {
+				return;
+			}
+			if (size - FEC_HEADER_SIZE > m_maxPacketSize + 2 + FEC_METADATA_SIZE_MAX) {
+				return;
+			}
+			
+			Block* block = m_blocks + (id % FEC_RECEIVE_WINDOW);
+			// the data packets of a block out of the window are still passed, only without the recovery
+			sl_bool flagStale = sl_false;
+			if (!(block->flagUsed) || block->id != id) {
+				sl_int32 age = (sl_int32)(block->id - id);
+				if (block->flagUsed && age > 0) {
+					if (age > FEC_RECEIVE_WINDOW) {
+						// the sender is restarted, and numbers the blocks from 0 again
+						for (sl_uint32 i = 0; i < FEC_RECEIVE_WINDOW; i++) {
+							m_blocks[i].flagUsed = sl_false;
+						}
+					} else {
+						// the slot is already used by a newer block
+						flagStale = sl_true;
+					}
+				}
+			}
+			if (!flagStale && (!(block->flagUsed) || block->id != id)) {
+				block->flagUsed = sl_true;
+				block->flagDone = sl_false;
+				block->id = id;
+				block->nData = nData;
+				block->nParity = nParity;
+				block->maskData = 0;
+				block->maskParity = 0;
+				for (sl_uint32 i = 0; i < SLIB_STREAMER_FEC_MAX_DATA; i++) {
+					block->data[i].setNull();
+				}
+				for (sl_uint32 i = 0; i < SLIB_STREAMER_FEC_MAX_PARITY; i++) {
+					block->parity[i].setNull();
+				}
+			}
+			if (block->nData != nData || block->nParity != nParity) {
+				flagStale = sl_true;
+			}
+			
+			PacketData payload = input.data.sub(FEC_HEADER_SIZE);
+			if (index < nData) {
+				sl_uint64 bit = ((sl_uint64)1) << index;
+				if (!flagStale && (block->maskData & bit)) {
+					return;
+				}
+				// the sequence, the stream id, the flags and the timestamp of the sender
+				Packet output;
+				output.format = Packet::formatRaw;
+				const sl_uint8* buf = (const sl_uint8*)(payload.getData());
+				const sl_uint8* p = output.readMetadata(buf, buf + payload.getSize());
+				if (!p) {
+					return;
+				}
+				setTimestamp(output, input);
+				output.data = payload.sub(p - buf);
+				if (flagStale) {
+					emitter.emit(output);
+					return;
+				}
+				block->maskData |= bit;
+				if (!(block->flagDone)) {
+					block->data[index] = payload;
+				}
+				emitter.emit(output);
+			} else {
+				if (flagStale) {
+					return;
+				}
+				sl_uint32 row = index - nData;
+				sl_uint32 bit = ((sl_uint32)1) << row;
+				if (block->maskParity & bit) {
+					return;
+				}
+				block->maskParity |= bit;
+				if (!(block->flagDone)) {
+					block->parity[row] = payload;
+				}
+			}
+			recover(block, input, emitter);
+		}
+		
+		void DatagramFecReceiveFilter::setTimestamp(Packet& output, const Packet& input)
+		{
+			if (output.timestamp > 0) {
+				output.timestamp = m_clock.convert(output.timestamp, input.timestamp);
+				output.flags |= Packet::flagSenderTime;
+			} else {
+				output.timestamp = input.timestamp;
+			}
+		}
+		
+		void DatagramFecReceiveFilter::recover(Block* block, const Packet& input, PacketEmitter& emitter)
+		{
+			if (block->flagDone) {
+				return;
+			}
+			sl_uint32 nData = block->nData;
+			sl_uint32 nParity = block->nParity;
+			sl_uint32 nMissing = nData - _DatagramFec_countBits(block->maskData);
+			if (nMissing > 0) {
+				if (_DatagramFec_countBits(block->maskParity) < nMissing) {
+					return;
+				}
+				if (m_code.getDataCount() != nData || m_code.getParityCount() != nParity) {
+					if (!(m_code.initialize(nData, nParity))) {
+						return;
+					}
+				}
+				sl_uint32 columns[SLIB_STREAMER_FEC_MAX_PARITY];
+				sl_uint32 rows[SLIB_STREAMER_FEC_MAX_PARITY];
+				sl_uint32 n = 0;
+				for (sl_uint32 col = 0; col < nData && n < nMissing; col++) {
+					if (!(block->maskData & (((sl_uint64)1) << col))) {
+						columns[n++] = col;
+					}
+				}
+				n = 0;
+				for (sl_uint32 row = 0; row < nParity && n < nMissing; row++) {
+					if (block->maskParity & (((sl_uint32)1) << row)) {
+						rows[n++] = row;
+					}
+				}
+				sl_size sizeSymbol = block->parity[rows[0]].getSize();
+				if (sizeSymbol < 2 || sizeSymbol > m_maxPacketSize + 2 + FEC_METADATA_SIZE_MAX || m_bufferSyndromes.isNull()) {
+					block->flagDone = sl_true;
+					return;
+				}
+				for (sl_uint32 i = 1; i < nMissing; i++) {
+					if (block->parity[rows[i]].getSize() != sizeSymbol) {
+						block->flagDone = sl_true;
+						return;
+					}
+				}
+				// syndromes: the parity without the contribution of the received data
+				sl_uint8* syndromes = (sl_uint8*)(m_bufferSyndromes.getData());
+				for (sl_uint32 i = 0; i < nMissing; i++) {
+					sl_uint8* s = syndromes + i * sizeSymbol;
+					Base::copyMemory(s, block->parity[rows[i]].getData(), sizeSymbol);
+					for (sl_uint32 col = 0; col < nData; col++) {
+						if (block->maskData & (((sl_uint64)1) << col)) {
+							sl_size size = block->data[col].getSize();
+							if (size + 2 > sizeSymbol) {
+								block->flagDone = sl_true;
+								return;
+							}
+							sl_uint8 len[2] = {(sl_uint8)size, (sl_uint8)(size >> 8)};
+							m_code.encode(s, rows[i], len, col, 2);
+							m_code.encode(s + 2, rows[i], (const sl_uint8*)(block->data[col].getData()), col, size);
+						}
+					}
+				}
+				sl_uint8 matrix[SLIB_STREAMER_FEC_MAX_PARITY * SLIB_STREAMER_FEC_MAX_PARITY];
+				if (m_code.getRecoveryMatrix(columns, rows, nMissing, matrix)) {
+					for (sl_uint32 j = 0; j < nMissing; j++) {
+						Ref<PacketBuffer> buffer = PacketBuffer::create(sizeSymbol, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM);
+						if (buffer.isNull()) {
+							break;
+						}
+						sl_uint8* symbol = buffer->getData() + SLIB_STREAMER_PACKET_HEADROOM;
+						Base::zeroMemory(symbol, sizeSymbol);
+						for (sl_uint32 i = 0; i < nMissing; i++) {
+							GaloisField256::multiplyAdd(symbol, syndromes + i * sizeSymbol, matrix[j * nMissing + i], sizeSymbol);
+						}
+						sl_size size = (sl_size)(symbol[0]) | ((sl_size)(symbol[1]) << 8);
+						if (size + 2 <= sizeSymbol) {
+							block->maskData |= ((sl_uint64)1) << columns[j];
+							Packet output;
+							output.format = Packet::formatRaw;
+							const sl_uint8* p = output.readMetadata(symbol + 2, symbol + 2 + size);
+							if (p) {
+								sl_size sizeMetadata = p - (symbol + 2);
+								setTimestamp(output, input);
+								output.flags |= Packet::flagConcealed;
+								output.data = PacketData(buffer, SLIB_STREAMER_PACKET_HEADROOM + 2 + sizeMetadata, size - sizeMetadata);
+								emitter.emit(output);
+							}
+						}
+					}
+				}
+			}
+			block->flagDone = sl_true;
+			for (sl_uint32 i = 0; i < nData; i++) {
+				block->data[i].setNull();
+			}
+			for (sl_uint32 i = 0; i < nParity; i++) {
+				block->parity[i].setNull();
+			}
+		}
+		
+		
+		// CVLI: 7 bits per byte from the lowest bits, with the highest bit set on every byte except the last one
+		static sl_uint32 _DatagramErrorCorrection_getCVLISize(sl_uint64 value)
+		{
+			sl_uint32 n = 1;
+			while (value >= 0x80) {
+				value >>= 7;
+				n++;
+			}
+			return n;
+		}
+		
+		static sl_uint8* _DatagramErrorCorrection_writeCVLI(sl_uint8* output, sl_uint64 value)
+		{
+			while (value >= 0x80) {
+				*(output++) = (sl_uint8)(value | 0x80);
+				value >>= 7;
+			}
+			*(output++) = (sl_uint8)value;
+			return output;
+		}
+		
+		static const sl_uint8* _DatagramErrorCorrection_readCVLI(const sl_uint8* input, const sl_uint8* end, sl_uint64* value)
+		{
+			sl_uint64 v = 0;
+			sl_uint32 shift = 0;
+			while (input < end && shift < 64) {
+				sl_uint8 n = *(input++);
+				v |= ((sl_uint64)(n & 0x7F)) << shift;
+				if (!(n & 0x80)) {
+					*value = v;
+					return input;
+				}
+				shift += 7;
+			}
+			return sl_null;
+		}
+		
 		DatagramErrorCorrectionSendFilter::DatagramErrorCorrectionSendFilter(sl_uint32 level, sl_uint32 maxPacketSize)
 		{
 			m_lastSentPacketNumber = 0;
 			m_level = level;
 			m_maxPacketSize = maxPacketSize;
+			m_countSlots = level + 1;
+			m_countFilled = 0;
+			m_indexNextSlot = 0;
+			m_slots = new Slot[m_countSlots];
 		}
 		
 		DatagramErrorCorrectionSendFilter::~DatagramErrorCorrectionSendFilter()
 		{
+			if (m_slots) {
+				delete[] m_slots;
+			}
 		}
 		
-		List<Packet> DatagramErrorCorrectionSendFilter::filter(const Packet& input)
+		void DatagramErrorCorrectionSendFilter::filter(const Packet& input, PacketEmitter& emitter)
 		{
-			void* buf = input.data.getData();
+			if (!m_slots) {
+				return;
+			}
 			sl_size size = input.data.getSize();
 			if (size > m_maxPacketSize) {
-				return List<Packet>::null();
-			}
-			SendPacket packetNew;
-			packetNew.num = m_lastSentPacketNumber++;
-			packetNew.mem = Memory::create(buf, size);
-			m_packetsSend.push(packetNew, m_level + 1);
-			MemoryWriter out;
-			Array<SendPacket> packets = m_packetsSend.toArray();
-			for (sl_size i = 0; i < packets.getCount(); i++) {
-				out.writeUint64CVLI(packets[i].num);
-				out.writeSizeCVLI(packets[i].mem.getSize());
-				out.write(packets[i].mem.getData(), packets[i].mem.getSize());
-			}
-			Memory data = out.getData();
+				return;
+			}
+			Slot& slot = m_slots[m_indexNextSlot];
+			slot.num = m_lastSentPacketNumber++;
+			slot.data = input.data;
+			m_indexNextSlot = (m_indexNextSlot + 1) % m_countSlots;
+			if (m_countFilled < m_countSlots) {
+				m_countFilled++;
+			}
+			// the oldest packet comes first
+			sl_uint32 indexFirst = (m_indexNextSlot + m_countSlots - m_countFilled) % m_countSlots;
+			sl_size sizeOutput = 0;
+			for (sl_uint32 i = 0; i < m_countFilled; i++) {
+				Slot& item = m_slots[(indexFirst + i) % m_countSlots];
+				sl_size n = item.data.getSize();
+				sizeOutput += _DatagramErrorCorrection_getCVLISize(item.num) + _DatagramErrorCorrection_getCVLISize(n) + n;
+			}
 			
-			List<Packet> ret;
 			Packet output;
 			output.format = Packet::formatRaw;
-			output.data = data;
-			ret.add(output);
-			return ret;
+			output.copyMetadata(input);
+			if (!(output.data.allocate(sizeOutput, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM))) {
+				return;
+			}
+			sl_uint8* p = (sl_uint8*)(output.data.getData());
+			for (sl_uint32 i = 0; i < m_countFilled; i++) {
+				Slot& item = m_slots[(indexFirst + i) % m_countSlots];
+				sl_size n = item.data.getSize();
+				p = _DatagramErrorCorrection_writeCVLI(p, item.num);
+				p = _DatagramErrorCorrection_writeCVLI(p, n);
+				Base::copyMemory(p, item.data.getData(), n);
+				p += n;
+			}
+			emitter.emit(output);
 		}
 		
 		DatagramErrorCorrectionReceiveFilter::DatagramErrorCorrectionReceiveFilter(sl_uint32 maxPacketSize)
 		{
 			m_maxPacketSize = maxPacketSize;
 			m_lastReceivedPacketNumber = 0;
+			m_maskReceived = 0;
 		}
 		
 		DatagramErrorCorrectionReceiveFilter::~DatagramErrorCorrectionReceiveFilter()
 		{
 		}
 		
-		List<Packet> DatagramErrorCorrectionReceiveFilter::filter(const Packet& input)
+		void DatagramErrorCorrectionReceiveFilter::filter(const Packet& input, PacketEmitter& emitter)
 		{
-			List<Packet> ret;
-			void* buf = input.data.getData();
-			sl_size packetSize = input.data.getSize();
-			MemoryReader in(buf, packetSize);
-			SLIB_SCOPED_BUFFER(char, 4096, buffer, m_maxPacketSize);
-			if (!buffer) {
-				return List<Packet>::null();
-			}
-			while (1) {
+			const sl_uint8* buf = (const sl_uint8*)(input.data.getData());
+			const sl_uint8* end = buf + input.data.getSize();
+			const sl_uint8* p = buf;
+			while (p < end) {
 				sl_uint64 num;
-				sl_size size;
-				if (!in.readUint64CVLI(&num)) {
+				sl_uint64 size;
+				p = _DatagramErrorCorrection_readCVLI(p, end, &num);
+				if (!p) {
 					break;
 				}
-				if (!in.readSizeCVLI(&size)) {
+				p = _DatagramErrorCorrection_readCVLI(p, end, &size);
+				if (!p) {
 					break;
 				}
-				if (size == 0 || size > m_maxPacketSize) {
+				if (size == 0 || size > m_maxPacketSize || size > (sl_uint64)(end - p)) {
 					break;
 				}
-				sl_size sizeRead = in.read(buffer, size);
-				if (size == sizeRead) {
-					if (num > m_lastReceivedPacketNumber || num + 100 < m_lastReceivedPacketNumber || m_lastReceivedPacketNumber == 0) {
-						m_lastReceivedPacketNumber = num;
-						Packet packet;
-						packet.format = Packet::formatRaw;
-						packet.data = Memory::create(buffer, size);
-						ret.add(packet);
+				sl_bool flagNew = sl_false;
+				if (num > m_lastReceivedPacketNumber || num + 100 < m_lastReceivedPacketNumber || m_maskReceived == 0) {
+					sl_uint64 shift = num - m_lastReceivedPacketNumber;
+					if (m_maskReceived == 0 || num < m_lastReceivedPacketNumber || shift >= 64) {
+						m_maskReceived = 1;
+					} else {
+						m_maskReceived = (m_maskReceived << shift) | 1;
 					}
+					m_lastReceivedPacketNumber = num;
+					flagNew = sl_true;
 				} else {
-					break;
+					// the reordered packets are passed to the jitter buffer, only the duplicates are dropped
+					sl_uint64 age = m_lastReceivedPacketNumber - num;
+					if (age < 64 && !(m_maskReceived & ((sl_uint64)1 << age))) {
+						m_maskReceived |= (sl_uint64)1 << age;
+						flagNew = sl_true;
+					}
+				}
+				if (flagNew) {
+					// refers to the received datagram without copying
+					Packet packet;
+					packet.format = Packet::formatRaw;
+					packet.timestamp = input.timestamp;
+					packet.streamId = input.streamId;
+					packet.flags = Packet::flagSequence;
+					packet.sequence = num;
+					packet.data = input.data.sub(p - buf, (sl_size)size);
+					emitter.emit(packet);
 				}
+				p += size;
 			}
-			return ret;
 		}
 
 		
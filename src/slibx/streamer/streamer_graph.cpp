@@ -10,6 +10,12 @@
 
 #include "../../../inc/slibx/streamer/graph.h"
 
+#include <slib/core/log.h>
+
+#if defined(SLIB_STREAMER_SUPPORT_STATISTICS)
+#include <chrono>
+#endif
+
 namespace slib
 {
 	
@@ -26,6 +32,42 @@ namespace slib
 		{
 		}
 		
+		sl_bool Source::isReadyListenerSupported()
+		{
+			return sl_false;
+		}
+		
+		void Source::setReadyListener(const Function<void()>& listener)
+		{
+			SpinLocker lock(&m_lockListenerReady);
+			m_listenerReady = listener;
+		}
+		
+		sl_int64 Source::attachPoller()
+		{
+			return -1;
+		}
+		
+		void Source::detachPoller()
+		{
+		}
+		
+		void Source::notifyPacketReady()
+		{
+			Ref<Event> ev = getEvent();
+			if (ev.isNotNull()) {
+				ev->set();
+			}
+			Function<void()> listener;
+			{
+				SpinLocker lock(&m_lockListenerReady);
+				listener = m_listenerReady;
+			}
+			if (listener.isNotNull()) {
+				listener();
+			}
+		}
+		
 		
 		SLIB_DEFINE_OBJECT(Sink, Object)
 		
@@ -37,6 +79,65 @@ namespace slib
 		{
 		}
 		
+		void Sink::flush()
+		{
+		}
+		
+		sl_uint32 Sink::getTimerInterval()
+		{
+			return 0;
+		}
+		
+		
+		PacketVector::PacketVector()
+		{
+			m_data = sl_null;
+			m_count = 0;
+			m_capacity = 0;
+		}
+		
+		PacketVector::~PacketVector()
+		{
+			if (m_data) {
+				delete[] m_data;
+			}
+		}
+		
+		void PacketVector::emit(const Packet& packet)
+		{
+			add(packet);
+		}
+		
+		sl_bool PacketVector::add(const Packet& packet)
+		{
+			if (m_count >= m_capacity) {
+				sl_size n = m_capacity ? m_capacity * 2 : 16;
+				Packet* data = new Packet[n];
+				if (!data) {
+					return sl_false;
+				}
+				for (sl_size i = 0; i < m_count; i++) {
+					data[i] = m_data[i];
+				}
+				if (m_data) {
+					delete[] m_data;
+				}
+				m_data = data;
+				m_capacity = n;
+			}
+			m_data[m_count] = packet;
+			m_count++;
+			return sl_true;
+		}
+		
+		void PacketVector::clear()
+		{
+			for (sl_size i = 0; i < m_count; i++) {
+				m_data[i] = Packet();
+			}
+			m_count = 0;
+		}
+		
 		
 		SLIB_DEFINE_OBJECT(Filter, Object)
 		
@@ -47,17 +148,322 @@ namespace slib
 		Filter::~Filter()
 		{
 		}
+		
+		class _Filter_ListEmitter : public PacketEmitter
+		{
+		public:
+			List<Packet> list;
+			
+		public:
+			// override
+			void emit(const Packet& packet)
+			{
+				list.add(packet);
+			}
+			
+		};
+		
+		// the filter whose default filter() is adapting to the other one on this thread
+		static thread_local Filter* _t_Filter_adapting = sl_null;
+		
+		static sl_bool _Filter_beginAdapting(Filter* filter, Filter*& previous)
+		{
+			if (_t_Filter_adapting == filter) {
+				// neither of the filter() methods is overridden, and the defaults would call each other forever
+				LogError("Streamer", "Filter overrides neither of the filter() methods");
+				return sl_false;
+			}
+			previous = _t_Filter_adapting;
+			_t_Filter_adapting = filter;
+			return sl_true;
+		}
+		
+		List<Packet> Filter::filter(const Packet& input)
+		{
+			Filter* previous;
+			if (!(_Filter_beginAdapting(this, previous))) {
+				return sl_null;
+			}
+			_Filter_ListEmitter emitter;
+			filter(input, emitter);
+			_t_Filter_adapting = previous;
+			return emitter.list;
+		}
+		
+		void Filter::filter(const Packet& input, PacketEmitter& output)
+		{
+			Filter* previous;
+			if (!(_Filter_beginAdapting(this, previous))) {
+				return;
+			}
+			List<Packet> list = filter(input);
+			_t_Filter_adapting = previous;
+			ListLocker<Packet> packets(list);
+			for (sl_size i = 0; i < packets.count; i++) {
+				output.emit(packets[i]);
+			}
+		}
+		
+		void Filter::process(PacketEmitter& output)
+		{
+		}
+		
+		sl_uint32 Filter::getTimerInterval()
+		{
+			return 0;
+		}
+
+		
+		class _GraphStage : public Referable
+		{
+		public:
+			Array< Ref<Filter> > filters;
+			PacketVector buffers[2];
+			Ref<PacketQueue> queue;
+			Ref<_GraphStage> next;
+			sl_size indexFirstFilter;
+			sl_bool flagSink;
+			Ref<Thread> thread;
+			
+			PacketVector buffersTimer[2];
+			// the shortest timer interval of the filters (and the sink on the last stage)
+			sl_uint32 timerInterval;
+			sl_int64 timeLastTimer;
+
+		public:
+			_GraphStage()
+			{
+				indexFirstFilter = 0;
+				flagSink = sl_false;
+				timerInterval = 0;
+				timeLastTimer = 0;
+			}
 
+		};
+
+		// keeps the shortest non-zero interval
+		SLIB_INLINE static void _Graph_updateTimerInterval(sl_uint32& interval, sl_uint32 n)
+		{
+			if (n && (!interval || n < interval)) {
+				interval = n;
+			}
+		}
+
+#if defined(SLIB_STREAMER_SUPPORT_STATISTICS)
+
+#define STATISTICS_NODE_SOURCE 0
+#define STATISTICS_NODE_SINK 1
+#define STATISTICS_NODE_OTHER_FILTERS 2
+#define STATISTICS_NODE_FILTER 3
+#define STATISTICS_NODES_MAX (STATISTICS_NODE_FILTER + SLIB_STREAMER_STATISTICS_FILTERS_MAX)
+#define STATISTICS_CACHE_SIZE 16
+
+		struct _GraphStatisticsNode
+		{
+			sl_uint64 countCalls;
+			sl_uint64 countPacketsIn;
+			sl_uint64 countPacketsOut;
+			sl_uint64 sizeBytesIn;
+			sl_uint64 sizeBytesOut;
+			sl_uint64 timeTotal;
+			LatencyHistogram latency;
+			LatencyHistogram age;
+			
+			_GraphStatisticsNode()
+			{
+				countCalls = 0;
+				countPacketsIn = 0;
+				countPacketsOut = 0;
+				sizeBytesIn = 0;
+				sizeBytesOut = 0;
+				timeTotal = 0;
+			}
+			
+			SLIB_INLINE void record(sl_uint64 nIn, sl_uint64 sizeIn, sl_uint64 nOut, sl_uint64 sizeOut, sl_uint64 time)
+			{
+				countCalls++;
+				countPacketsIn += nIn;
+				countPacketsOut += nOut;
+				sizeBytesIn += sizeIn;
+				sizeBytesOut += sizeOut;
+				timeTotal += time;
+				latency.add(time);
+			}
+		};
 		
+		// counters written only by one thread; the other threads only read them for the snapshot
+		class _GraphStatisticsBlock
+		{
+		public:
+			_GraphStatisticsBlock* next;
+			sl_uint64 idThread;
+			_GraphStatisticsNode* nodes[STATISTICS_NODES_MAX];
+			
+		public:
+			_GraphStatisticsBlock()
+			{
+				next = sl_null;
+				idThread = 0;
+				Base::zeroMemory(nodes, sizeof(nodes));
+			}
+			
+			~_GraphStatisticsBlock()
+			{
+				for (sl_uint32 i = 0; i < STATISTICS_NODES_MAX; i++) {
+					if (nodes[i]) {
+						delete nodes[i];
+					}
+				}
+			}
+			
+		public:
+			_GraphStatisticsNode* getNode(sl_size index)
+			{
+				if (index >= STATISTICS_NODES_MAX) {
+					return sl_null;
+				}
+				_GraphStatisticsNode* node = nodes[index];
+				if (!node) {
+					node = new _GraphStatisticsNode;
+					if (!node) {
+						return sl_null;
+					}
+					// publishes the initialized node to the readers
+					Base::interlockedCompareExchangePtr((void**)&(nodes[index]), node, sl_null);
+				}
+				return node;
+			}
+			
+		};
+		
+		struct _GraphStatisticsCacheEntry
+		{
+			sl_int64 idGraph;
+			_GraphStatisticsBlock* block;
+		};
+		
+		static sl_int64 _g_GraphStatistics_lastId = 0;
+		// the blocks of the graphs recently run by the thread, indexed by the graph id, so a worker switching between graphs does not search the lists
+		static thread_local _GraphStatisticsCacheEntry _t_GraphStatistics_cache[STATISTICS_CACHE_SIZE];
+		
+		SLIB_INLINE static sl_uint64 _GraphStatistics_getTime()
+		{
+			return (sl_uint64)(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+		
+		SLIB_INLINE static sl_bool _Graph_receivePacket(Source* source, Packet* out, _GraphStatisticsBlock* statistics)
+		{
+			if (statistics) {
+				_GraphStatisticsNode* node = statistics->getNode(STATISTICS_NODE_SOURCE);
+				if (node) {
+					sl_uint64 t = _GraphStatistics_getTime();
+					sl_bool flagReceived = source->receivePacket(out);
+					t = _GraphStatistics_getTime() - t;
+					if (flagReceived) {
+						node->record(0, 0, 1, out->data.getSize(), t);
+					} else {
+						node->record(0, 0, 0, 0, t);
+					}
+					return flagReceived;
+				}
+			}
+			return source->receivePacket(out);
+		}
+		
+		SLIB_INLINE static void _Graph_sendPacket(Sink* sink, const Packet& packet, _GraphStatisticsBlock* statistics)
+		{
+			if (statistics) {
+				_GraphStatisticsNode* node = statistics->getNode(STATISTICS_NODE_SINK);
+				if (node) {
+					sl_uint64 t = _GraphStatistics_getTime();
+					if (packet.timestamp > 0 && (sl_uint64)(packet.timestamp) <= t) {
+						// Packet::timestamp is on the same monotonic clock
+						node->age.add(t - (sl_uint64)(packet.timestamp));
+					}
+					sl_bool flagSent = sink->sendPacket(packet);
+					t = _GraphStatistics_getTime() - t;
+					sl_uint64 size = packet.data.getSize();
+					node->record(1, size, flagSent ? 1 : 0, flagSent ? size : 0, t);
+					return;
+				}
+			}
+			sink->sendPacket(packet);
+		}
+		
+		SLIB_INLINE static void _Graph_filterPacket(Filter* filter, const Packet& input, PacketVector& output, _GraphStatisticsBlock* statistics, sl_size indexFilter)
+		{
+			if (statistics) {
+				_GraphStatisticsNode* node;
+				if (indexFilter < SLIB_STREAMER_STATISTICS_FILTERS_MAX) {
+					node = statistics->getNode(STATISTICS_NODE_FILTER + indexFilter);
+				} else {
+					node = statistics->getNode(STATISTICS_NODE_OTHER_FILTERS);
+				}
+				if (node) {
+					sl_size nBefore = output.getCount();
+					sl_uint64 t = _GraphStatistics_getTime();
+					filter->filter(input, output);
+					t = _GraphStatistics_getTime() - t;
+					sl_size nAfter = output.getCount();
+					sl_uint64 sizeOut = 0;
+					for (sl_size i = nBefore; i < nAfter; i++) {
+						sizeOut += output[i].data.getSize();
+					}
+					node->record(1, input.data.getSize(), nAfter - nBefore, sizeOut, t);
+					return;
+				}
+			}
+			filter->filter(input, output);
+		}
+
+#else
+
+		SLIB_INLINE static sl_bool _Graph_receivePacket(Source* source, Packet* out, _GraphStatisticsBlock* statistics)
+		{
+			return source->receivePacket(out);
+		}
+		
+		SLIB_INLINE static void _Graph_sendPacket(Sink* sink, const Packet& packet, _GraphStatisticsBlock* statistics)
+		{
+			sink->sendPacket(packet);
+		}
+		
+		SLIB_INLINE static void _Graph_filterPacket(Filter* filter, const Packet& input, PacketVector& output, _GraphStatisticsBlock* statistics, sl_size indexFilter)
+		{
+			filter->filter(input, output);
+		}
+
+#endif
+
 		SLIB_DEFINE_OBJECT(Graph, Object)
 		
 		Graph::Graph()
 		{
+			setPipelined(sl_false);
+			setStageQueueSize(256);
+			setStageOverflowPolicy(PacketQueue::overflowBlock);
+			setStatisticsEnabled(sl_false);
+			m_timerInterval = 0;
+			m_timeLastTimer = 0;
+			m_statisticsBlocks = sl_null;
+#if defined(SLIB_STREAMER_SUPPORT_STATISTICS)
+			m_idStatistics = Base::interlockedIncrement64(&_g_GraphStatistics_lastId);
+#else
+			m_idStatistics = 0;
+#endif
 		}
 
 		Graph::~Graph()
 		{
 			release();
+#if defined(SLIB_STREAMER_SUPPORT_STATISTICS)
+			_GraphStatisticsBlock* block = m_statisticsBlocks;
+			while (block) {
+				_GraphStatisticsBlock* next = block->next;
+				delete block;
+				block = next;
+			}
+#endif
 		}
 
 		sl_bool Graph::start()
@@ -68,10 +474,17 @@ namespace slib
 			if (m_sink.isNull()) {
 				return sl_false;
 			}
+			startTimers();
+			if (getPipelined()) {
+				if (!startStages()) {
+					return sl_false;
+				}
+			}
 			m_thread = Thread::start(SLIB_FUNCTION_REF(Graph, run, this));
 			if (m_thread.isNotNull()) {
 				return sl_true;
 			}
+			releaseStages();
 			return sl_false;
 		}
 
@@ -81,10 +494,156 @@ namespace slib
 			m_sink.setNull();
 			m_filters.removeAll();
 			m_filters.setNull();
+			{
+				SpinLocker lock(&m_lockChain);
+				m_chain.setNull();
+			}
 			Ref<Thread> thread = m_thread;
 			if (thread.isNotNull()) {
 				thread->finishAndWait();
 			}
+			releaseStages();
+		}
+
+		void Graph::addFilter(const Ref<Filter>& filter)
+		{
+			if (filter.isNull()) {
+				return;
+			}
+			ObjectLocker lock(this);
+			m_filters.add(filter);
+			ListLocker< Ref<Filter> > filters(m_filters);
+			Array< Ref<Filter> > chain = Array< Ref<Filter> >::create(filters.data, filters.count);
+			SpinLocker lockChain(&m_lockChain);
+			m_chain = chain;
+		}
+
+		void Graph::addStageBreak()
+		{
+			m_stageBreaks.add(m_filters.getCount());
+		}
+
+		sl_bool Graph::startStages()
+		{
+			ListLocker< Ref<Filter> > filters(m_filters);
+			ListLocker<sl_size> breaks(m_stageBreaks);
+			
+			// stage boundaries as indices into the filter chain; the last one is always the end of chain
+			List<sl_size> boundaries;
+			if (breaks.count > 0) {
+				for (sl_size i = 0; i < breaks.count; i++) {
+					sl_size pos = breaks[i];
+					if (pos > 0 && pos <= filters.count) {
+						sl_size nBoundaries = boundaries.getCount();
+						if (nBoundaries == 0 || boundaries.getValueAt(nBoundaries - 1) < pos) {
+							boundaries.add(pos);
+						}
+					}
+				}
+			} else {
+				for (sl_size i = 1; i < filters.count; i++) {
+					boundaries.add(i);
+				}
+			}
+			if (filters.count > 0) {
+				sl_size nBoundaries = boundaries.getCount();
+				if (nBoundaries == 0 || boundaries.getValueAt(nBoundaries - 1) < filters.count) {
+					boundaries.add(filters.count);
+				}
+			}
+			
+			PacketQueue::OverflowPolicy policy = getStageOverflowPolicy();
+			sl_uint32 sizeQueue = getStageQueueSize();
+			
+			List< Ref<_GraphStage> > stages;
+			sl_size posStart = 0;
+			ListLocker<sl_size> ends(boundaries);
+			for (sl_size i = 0; i < ends.count; i++) {
+				Ref<_GraphStage> stage = new _GraphStage;
+				if (stage.isNull()) {
+					return sl_false;
+				}
+				stage->filters = Array< Ref<Filter> >::create(filters.data + posStart, ends[i] - posStart);
+				stage->indexFirstFilter = posStart;
+				stage->queue = PacketQueue::create(sizeQueue, policy);
+				if (stage->queue.isNull()) {
+					return sl_false;
+				}
+				stages.add(stage);
+				posStart = ends[i];
+			}
+			if (stages.getCount() == 0) {
+				// no filter, so the sink runs on its own stage
+				Ref<_GraphStage> stage = new _GraphStage;
+				if (stage.isNull()) {
+					return sl_false;
+				}
+				stage->queue = PacketQueue::create(sizeQueue, policy);
+				if (stage->queue.isNull()) {
+					return sl_false;
+				}
+				stages.add(stage);
+			}
+			
+			ListLocker< Ref<_GraphStage> > list(stages);
+			for (sl_size i = 0; i + 1 < list.count; i++) {
+				list[i]->next = list[i + 1];
+			}
+			list[list.count - 1]->flagSink = sl_true;
+			sl_int64 now = Packet::getCurrentTimestamp();
+			for (sl_size i = 0; i < list.count; i++) {
+				_GraphStage* stage = list[i].get();
+				sl_uint32 interval = 0;
+				Ref<Filter>* stageFilters = stage->filters.getData();
+				sl_size nStageFilters = stage->filters.getCount();
+				for (sl_size k = 0; k < nStageFilters; k++) {
+					if (stageFilters[k].isNotNull()) {
+						_Graph_updateTimerInterval(interval, stageFilters[k]->getTimerInterval());
+					}
+				}
+				if (stage->flagSink && m_sink.isNotNull()) {
+					_Graph_updateTimerInterval(interval, m_sink->getTimerInterval());
+				}
+				stage->timerInterval = interval;
+				stage->timeLastTimer = now;
+			}
+			
+			for (sl_size i = 0; i < list.count; i++) {
+				_GraphStage* stage = list[i].get();
+				stage->thread = Thread::start(SLIB_BIND_REF(void(), Graph, runStage, this, list[i]));
+				if (stage->thread.isNull()) {
+					m_stages = stages;
+					releaseStages();
+					return sl_false;
+				}
+			}
+			m_stages = stages;
+			SpinLocker lockChain(&m_lockChain);
+			m_stageFirst = list[0];
+			return sl_true;
+		}
+
+		void Graph::releaseStages()
+		{
+			{
+				SpinLocker lock(&m_lockChain);
+				m_stageFirst.setNull();
+			}
+			ListLocker< Ref<_GraphStage> > stages(m_stages);
+			for (sl_size i = 0; i < stages.count; i++) {
+				Ref<Thread> thread = stages[i]->thread;
+				if (thread.isNotNull()) {
+					thread->finish();
+				}
+				stages[i]->queue->close();
+			}
+			for (sl_size i = 0; i < stages.count; i++) {
+				Ref<Thread> thread = stages[i]->thread;
+				if (thread.isNotNull()) {
+					thread->finishAndWait();
+				}
+			}
+			m_stages.setNull();
 		}
 
 		void Graph::run()
@@ -99,16 +658,83 @@ namespace slib
 				return;
 			}
 
+			sl_uint32 interval = m_timerInterval;
 			while (! Thread::isStoppingCurrent()) {
 				Packet packet;
-				if (ev->wait()) {
-					while (!Thread::isStoppingCurrent() && source->receivePacket(&packet)) {
+				if (ev->wait(interval ? (sl_int32)interval : -1)) {
+					while (!Thread::isStoppingCurrent() && _Graph_receivePacket(source.get(), &packet, getStatisticsBlock())) {
 						feedPacket(packet);
 					}
-				} else {
+				} else if (!interval) {
 					Thread::sleep(50);
 				}
+				processTimers();
+			}
+		}
+
+		void Graph::runStage(Ref<_GraphStage> stage)
+		{
+			Ref<PacketQueue> queue = stage->queue;
+			sl_uint32 interval = stage->timerInterval;
+			while (!Thread::isStoppingCurrent()) {
+				if (!(queue->waitPacket(interval ? interval : 100))) {
+					if (queue->isClosed()) {
+						return;
+					}
+					processStageTimers(stage.get());
+					continue;
+				}
+				Packet packet;
+				while (!Thread::isStoppingCurrent() && queue->pop(&packet)) {
+					PacketVector* outputs = processFilters(stage->filters.getData(), stage->filters.getCount(), packet, stage->buffers, stage->indexFirstFilter);
+					sendStageOutputs(stage.get(), *outputs);
+				}
+				processStageTimers(stage.get());
+			}
+		}
+
+		void Graph::processStageTimers(_GraphStage* stage)
+		{
+			sl_uint32 interval = stage->timerInterval;
+			if (!interval) {
+				return;
+			}
+			sl_int64 now = Packet::getCurrentTimestamp();
+			if (now - stage->timeLastTimer < (sl_int64)interval * 1000000) {
+				return;
+			}
+			stage->timeLastTimer = now;
+			PacketVector& outputs = stage->buffersTimer[1];
+			processFilterTimers(stage->filters.getData(), stage->filters.getCount(), stage->buffers, stage->buffersTimer[0], outputs, stage->indexFirstFilter);
+			sendStageOutputs(stage, outputs);
+		}
+
+		void Graph::sendStageOutputs(_GraphStage* stage, PacketVector& outputs)
+		{
+			if (stage->flagSink) {
+				Ref<Sink> sink = m_sink;
+				if (sink.isNotNull()) {
+					sendOutputs(sink.get(), outputs);
+					sink->flush();
+				}
+			} else {
+				PacketQueue* queueNext = stage->next->queue.get();
+				sl_size n = outputs.getCount();
+				for (sl_size i = 0; i < n; i++) {
+					queueNext->push(outputs[i]);
+				}
 			}
+			outputs.clear();
+		}
+
+		void Graph::sendOutputs(Sink* sink, PacketVector& outputs)
+		{
+			_GraphStatisticsBlock* statistics = getStatisticsBlock();
+			sl_size n = outputs.getCount();
+			for (sl_size i = 0; i < n; i++) {
+				_Graph_sendPacket(sink, outputs[i], statistics);
+			}
+			outputs.clear();
 		}
 
 		void Graph::feedPacket(const Packet& packet)
@@ -117,29 +743,253 @@ namespace slib
 			if (sink.isNull()) {
 				return;
 			}
-			List<Packet> packets;
+			Ref<_GraphStage> stage;
+			Array< Ref<Filter> > chain;
+			{
+				SpinLocker lock(&m_lockChain);
+				stage = m_stageFirst;
+				chain = m_chain;
+			}
+			if (stage.isNotNull()) {
+				// the push may wait for the queue (overflowBlock), so it is out of the lock
+				stage->queue->push(packet);
+				return;
+			}
+			// filters keep state between packets, so the chain is fed by one thread at a time
+			MutexLocker lock(&m_lockFeed);
+			PacketVector* outputs = processFilters(chain.getData(), chain.getCount(), packet, m_buffers);
+			sendOutputs(sink.get(), *outputs);
+			sink->flush();
+		}
+
+		sl_uint32 Graph::processSourcePackets(sl_uint32 nMaxPackets)
+		{
+			Ref<Source> source = m_source;
+			if (source.isNull()) {
+				return 0;
+			}
+			sl_uint32 n = 0;
+			Packet packet;
+			_GraphStatisticsBlock* statistics = getStatisticsBlock();
+			while (n < nMaxPackets && _Graph_receivePacket(source.get(), &packet, statistics)) {
+				feedPacket(packet);
+				n++;
+			}
+			return n;
+		}
+
+		void Graph::processTimers()
+		{
+			sl_uint32 interval = m_timerInterval;
+			if (!interval) {
+				return;
+			}
+			Ref<Sink> sink = m_sink;
+			if (sink.isNull()) {
+				return;
+			}
+			sl_int64 now = Packet::getCurrentTimestamp();
+			Array< Ref<Filter> > chain;
 			{
-				packets.add(packet);
-				ListLocker< Ref<Filter> > filters(m_filters.duplicate());
+				SpinLocker lock(&m_lockChain);
+				if (m_stageFirst.isNotNull()) {
+					// the stage threads run their own timers
+					return;
+				}
+				chain = m_chain;
+			}
+			MutexLocker lock(&m_lockFeed);
+			if (now - m_timeLastTimer < (sl_int64)interval * 1000000) {
+				return;
+			}
+			m_timeLastTimer = now;
+			PacketVector& outputs = m_buffersTimer[1];
+			processFilterTimers(chain.getData(), chain.getCount(), m_buffers, m_buffersTimer[0], outputs);
+			sendOutputs(sink.get(), outputs);
+			sink->flush();
+		}
+
+		sl_uint32 Graph::getTimerInterval()
+		{
+			sl_uint32 interval = 0;
+			{
+				ListLocker< Ref<Filter> > filters(m_filters);
 				for (sl_size i = 0; i < filters.count; i++) {
-					Ref<Filter> filter = filters[i];
-					if (filter.isNotNull()) {
-						List<Packet> outs;
-						ListLocker<Packet> ins(packets);
-						for (sl_size k = 0; k < ins.count; k++) {
-							List<Packet> out = filter->filter(ins[k]);
-							outs.addAll(out);
-						}
-						packets = outs;
+					if (filters[i].isNotNull()) {
+						_Graph_updateTimerInterval(interval, filters[i]->getTimerInterval());
 					}
 				}
 			}
-			{
-				ListLocker<Packet> outs(packets);
-				for (sl_size i = 0; i < outs.count; i++) {
-					sink->sendPacket(outs[i]);
+			Ref<Sink> sink = m_sink;
+			if (sink.isNotNull()) {
+				_Graph_updateTimerInterval(interval, sink->getTimerInterval());
+			}
+			return interval;
+		}
+
+		void Graph::startTimers()
+		{
+			m_timerInterval = getTimerInterval();
+			m_timeLastTimer = Packet::getCurrentTimestamp();
+		}
+
+		PacketVector* Graph::processFilters(const Ref<Filter>* filters, sl_size nFilters, const Packet& packet, PacketVector* buffers, sl_size indexFirstFilter)
+		{
+			_GraphStatisticsBlock* statistics = getStatisticsBlock();
+			PacketVector* input = buffers;
+			PacketVector* output = buffers + 1;
+			input->clear();
+			input->add(packet);
+			for (sl_size i = 0; i < nFilters; i++) {
+				Filter* filter = filters[i].get();
+				if (filter) {
+					output->clear();
+					sl_size n = input->getCount();
+					for (sl_size k = 0; k < n; k++) {
+						_Graph_filterPacket(filter, (*input)[k], *output, statistics, indexFirstFilter + i);
+					}
+					PacketVector* t = input;
+					input = output;
+					output = t;
 				}
 			}
+			output->clear();
+			return input;
+		}
+
+		void Graph::processFilterTimers(const Ref<Filter>* filters, sl_size nFilters, PacketVector* buffers, PacketVector& released, PacketVector& outputs, sl_size indexFirstFilter)
+		{
+			for (sl_size i = 0; i < nFilters; i++) {
+				Filter* filter = filters[i].get();
+				if (!filter) {
+					continue;
+				}
+				released.clear();
+				filter->process(released);
+				sl_size n = released.getCount();
+				for (sl_size k = 0; k < n; k++) {
+					PacketVector* result = processFilters(filters + i + 1, nFilters - i - 1, released[k], buffers, indexFirstFilter + i + 1);
+					sl_size m = result->getCount();
+					for (sl_size j = 0; j < m; j++) {
+						outputs.add((*result)[j]);
+					}
+					result->clear();
+				}
+				released.clear();
+			}
+		}
+
+		List<GraphStageStatus> Graph::getStageStatus()
+		{
+			List<GraphStageStatus> ret;
+			ListLocker< Ref<_GraphStage> > stages(m_stages);
+			for (sl_size i = 0; i < stages.count; i++) {
+				_GraphStage* stage = stages[i].get();
+				GraphStageStatus status;
+				status.filtersCount = (sl_uint32)(stage->filters.getCount());
+				status.flagSink = stage->flagSink;
+				status.queueDepth = stage->queue->getCount();
+				status.queueCapacity = stage->queue->getCapacity();
+				status.countDroppedPackets = stage->queue->getDroppedCount();
+				ret.add(status);
+			}
+			return ret;
+		}
+
+		_GraphStatisticsBlock* Graph::getStatisticsBlock()
+		{
+#if defined(SLIB_STREAMER_SUPPORT_STATISTICS)
+			if (!(getStatisticsEnabled())) {
+				return sl_null;
+			}
+			_GraphStatisticsCacheEntry& cache = _t_GraphStatistics_cache[(sl_size)m_idStatistics & (STATISTICS_CACHE_SIZE - 1)];
+			if (cache.idGraph == m_idStatistics) {
+				return cache.block;
+			}
+			sl_uint64 idThread = Thread::getCurrentThreadUniqueId();
+			_GraphStatisticsBlock* block = m_statisticsBlocks;
+			while (block) {
+				if (block->idThread == idThread) {
+					break;
+				}
+				block = block->next;
+			}
+			if (!block) {
+				block = new _GraphStatisticsBlock;
+				if (!block) {
+					return sl_null;
+				}
+				block->idThread = idThread;
+				do {
+					block->next = m_statisticsBlocks;
+				} while (!(Base::interlockedCompareExchangePtr((void**)&m_statisticsBlocks, block, block->next)));
+			}
+			cache.idGraph = m_idStatistics;
+			cache.block = block;
+			return block;
+#else
+			return sl_null;
+#endif
+		}
+
+		List<GraphNodeStatistics> Graph::getStatistics()
+		{
+			List<GraphNodeStatistics> ret;
+#if defined(SLIB_STREAMER_SUPPORT_STATISTICS)
+			_GraphStatisticsBlock* blocks = (_GraphStatisticsBlock*)(m_statisticsBlocks);
+			// source, filters, the other filters, and then sink
+			for (sl_uint32 k = 0; k < STATISTICS_NODES_MAX; k++) {
+				sl_uint32 index;
+				if (k == 0) {
+					index = STATISTICS_NODE_SOURCE;
+				} else if (k < 1 + SLIB_STREAMER_STATISTICS_FILTERS_MAX) {
+					index = STATISTICS_NODE_FILTER + k - 1;
+				} else if (k == 1 + SLIB_STREAMER_STATISTICS_FILTERS_MAX) {
+					index = STATISTICS_NODE_OTHER_FILTERS;
+				} else {
+					index = STATISTICS_NODE_SINK;
+				}
+				GraphNodeStatistics item;
+				item.countCalls = 0;
+				item.countPacketsIn = 0;
+				item.countPacketsOut = 0;
+				item.sizeBytesIn = 0;
+				item.sizeBytesOut = 0;
+				item.timeTotal = 0;
+				sl_bool flagFound = sl_false;
+				for (_GraphStatisticsBlock* block = blocks; block; block = block->next) {
+					_GraphStatisticsNode* node = block->nodes[index];
+					if (node) {
+						flagFound = sl_true;
+						item.countCalls += node->countCalls;
+						item.countPacketsIn += node->countPacketsIn;
+						item.countPacketsOut += node->countPacketsOut;
+						item.sizeBytesIn += node->sizeBytesIn;
+						item.sizeBytesOut += node->sizeBytesOut;
+						item.timeTotal += node->timeTotal;
+						item.latency.add(node->latency);
+						item.age.add(node->age);
+					}
+				}
+				if (flagFound) {
+					if (index == STATISTICS_NODE_SOURCE) {
+						item.type = GraphNodeStatistics::nodeSource;
+						item.index = 0;
+					} else if (index == STATISTICS_NODE_SINK) {
+						item.type = GraphNodeStatistics::nodeSink;
+						item.index = 0;
+					} else if (index == STATISTICS_NODE_OTHER_FILTERS) {
+						item.type = GraphNodeStatistics::nodeOtherFilters;
+						item.index = SLIB_STREAMER_STATISTICS_FILTERS_MAX;
+					} else {
+						item.type = GraphNodeStatistics::nodeFilter;
+						item.index = index - STATISTICS_NODE_FILTER;
+					}
+					ret.add(item);
+				}
+			}
+#endif
+			return ret;
 		}
 
 		Ref<Graph> Graph::create()
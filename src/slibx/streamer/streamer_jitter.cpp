@@ -0,0 +1,296 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#include "../../../inc/slibx/streamer/jitter.h"
+
+#include <chrono>
+
+#define _JITTER_BUFFER_BASE_WINDOW 256
+#define _JITTER_BUFFER_RESET_DISTANCE 1000
+// the frame duration is learned from the timestamps of the packets at most this far apart
+#define _JITTER_BUFFER_MAX_LEARN_DISTANCE 8
+// microseconds, the longest Opus frame
+#define _JITTER_BUFFER_MAX_FRAME_DURATION 120000
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		SLIB_INLINE static sl_int64 _JitterBuffer_getTime()
+		{
+			return (sl_int64)(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+		
+		JitterBufferFilter::JitterBufferFilter(sl_uint32 capacity)
+		{
+			setFrameDuration(20000);
+			setMinDelay(20000);
+			setMaxDelay(400000);
+			
+			sl_uint32 n = 2;
+			while (n < capacity && n < 0x10000) {
+				n <<= 1;
+			}
+			m_slots = new Slot[n];
+			m_mask = m_slots ? n - 1 : 0;
+			Base::zeroMemory(&m_statistics, sizeof(m_statistics));
+			_reset();
+		}
+		
+		JitterBufferFilter::~JitterBufferFilter()
+		{
+			if (m_slots) {
+				delete[] m_slots;
+			}
+		}
+		
+		void JitterBufferFilter::filter(const Packet& input, PacketEmitter& emitter)
+		{
+			if (!(input.flags & Packet::flagSequence) || (input.flags & Packet::flagLost) || !m_slots) {
+				emitter.emit(input);
+				return;
+			}
+			ObjectLocker lock(this);
+			sl_int64 now = _JitterBuffer_getTime();
+			sl_uint64 sequence = input.sequence;
+			m_statistics.countReceived++;
+			if (m_flagStarted) {
+				sl_int64 distance = (sl_int64)(sequence - m_sequenceNext);
+				if (distance > (sl_int64)m_mask || distance <= -_JITTER_BUFFER_RESET_DISTANCE) {
+					// the sender is restarted, or the gap is longer than the buffer; resynchronizes instead of releasing the gap as lost
+					_reset();
+					m_statistics.countResets++;
+				} else if (distance < 0) {
+					// still tells how late the packets are
+					_measure(_getPosition(input), now);
+					m_statistics.countLate++;
+					_release(now, emitter);
+					return;
+				}
+			}
+			if (!m_flagStarted) {
+				m_flagStarted = sl_true;
+				m_sequenceNext = sequence;
+				m_sequenceLast = sequence;
+				m_positionLast = 0;
+				m_durationFrame = getFrameDuration();
+				m_positionReleased = -m_durationFrame;
+				m_timeBase = now;
+			}
+			Slot& slot = m_slots[sequence & m_mask];
+			if (slot.flagUsed) {
+				m_statistics.countDuplicated++;
+				return;
+			}
+			sl_int64 position = _getPosition(input);
+			_measure(position, now);
+			slot.flagUsed = sl_true;
+			slot.position = position;
+			slot.packet = input;
+			m_countBuffered++;
+			m_packetLast.format = input.format;
+			m_packetLast.audioParam = input.audioParam;
+			m_packetLast.networkParam = input.networkParam;
+			_release(now, emitter);
+		}
+		
+		void JitterBufferFilter::process(PacketEmitter& emitter)
+		{
+			ObjectLocker lock(this);
+			if (m_flagStarted) {
+				_release(_JitterBuffer_getTime(), emitter);
+			}
+		}
+		
+		sl_uint32 JitterBufferFilter::getTimerInterval()
+		{
+			sl_uint32 interval = getFrameDuration() / 2000;
+			return interval ? interval : 1;
+		}
+		
+		void JitterBufferFilter::reset()
+		{
+			ObjectLocker lock(this);
+			_reset();
+		}
+		
+		void JitterBufferFilter::getStatistics(JitterBufferStatistics& _out)
+		{
+			ObjectLocker lock(this);
+			_out = m_statistics;
+			_out.jitter = (sl_uint32)(m_jitter / 16);
+			_out.delayTarget = (sl_uint32)(_getDelayTarget());
+		}
+		
+		sl_int64 JitterBufferFilter::_getPosition(const Packet& input)
+		{
+			sl_uint64 sequence = input.sequence;
+			sl_int64 distance = (sl_int64)(sequence - m_sequenceLast);
+			// follows the previous packets when the sender time is unknown
+			sl_int64 position = m_positionLast + distance * m_durationFrame;
+			if (input.timestamp > 0 && (input.flags & Packet::flagSenderTime)) {
+				if (m_flagTimestamp) {
+					position = (input.timestamp - m_timestampBase) / 1000;
+					if (distance > 0 && distance <= _JITTER_BUFFER_MAX_LEARN_DISTANCE && position > m_positionLast) {
+						sl_int64 duration = (position - m_positionLast) / distance;
+						if (duration > 0 && duration <= _JITTER_BUFFER_MAX_FRAME_DURATION) {
+							m_durationFrame = duration;
+						}
+					}
+				} else {
+					m_flagTimestamp = sl_true;
+					m_timestampBase = input.timestamp - position * 1000;
+				}
+			}
+			if (distance > 0) {
+				m_sequenceLast = sequence;
+				m_positionLast = position;
+			}
+			return position;
+		}
+		
+		void JitterBufferFilter::_measure(sl_int64 position, sl_int64 now)
+		{
+			// arrival time on the least delayed path
+			sl_int64 timeExpected = position;
+			sl_int64 timeBase = now - timeExpected;
+			if (m_countWindow == 0 || timeBase < m_timeBaseWindow) {
+				m_timeBaseWindow = timeBase;
+			}
+			m_countWindow++;
+			if (timeBase < m_timeBase) {
+				// the path became faster
+				sl_int64 shift = m_timeBase - timeBase;
+				m_timeBase = timeBase;
+				m_delayLast += shift;
+				m_delayPeak += shift;
+			} else if (m_countWindow >= _JITTER_BUFFER_BASE_WINDOW) {
+				// follows the slower path and the clock drift of the sender
+				sl_int64 shift = m_timeBaseWindow - m_timeBase;
+				m_timeBase = m_timeBaseWindow;
+				m_delayLast -= shift;
+				m_delayPeak -= shift;
+				if (m_delayPeak < 0) {
+					m_delayPeak = 0;
+				}
+				m_countWindow = 0;
+			}
+			sl_int64 delay = now - (m_timeBase + timeExpected);
+			// RFC 3550 inter-arrival jitter, scaled by 16
+			sl_int64 d = delay - m_delayLast;
+			if (d < 0) {
+				d = -d;
+			}
+			m_jitter += d - (m_jitter + 8) / 16;
+			m_delayLast = delay;
+			if (delay > m_delayPeak) {
+				m_delayPeak = delay;
+			} else {
+				// forgets a burst in about 500 packets
+				m_delayPeak -= m_delayPeak / 512;
+			}
+		}
+		
+		void JitterBufferFilter::_release(sl_int64 now, PacketEmitter& emitter)
+		{
+			sl_int64 delay = _getDelayTarget();
+			while (m_countBuffered > 0 || m_flagSilence) {
+				// the missing packet follows the last released one
+				Slot& slot = m_slots[m_sequenceNext & m_mask];
+				sl_int64 position = slot.flagUsed ? slot.position : m_positionReleased + m_durationFrame;
+				if (now < m_timeBase + position + delay) {
+					break;
+				}
+				_releaseFirst(emitter);
+				m_positionReleased = position;
+			}
+		}
+		
+		void JitterBufferFilter::_releaseFirst(PacketEmitter& emitter)
+		{
+			Slot& slot = m_slots[m_sequenceNext & m_mask];
+			if (slot.flagUsed) {
+				emitter.emit(slot.packet);
+				m_flagSilence = (slot.packet.flags & Packet::flagSilence) != 0;
+				slot.flagUsed = sl_false;
+				slot.packet = Packet();
+				m_countBuffered--;
+				m_statistics.countReleased++;
+			} else if (m_flagSilence) {
+				Packet packet = m_packetLast;
+				packet.flags = Packet::flagSequence | Packet::flagSilence;
+				packet.sequence = m_sequenceNext;
+				emitter.emit(packet);
+				m_statistics.countSilence++;
+			} else {
+				Packet packet = m_packetLast;
+				packet.flags = Packet::flagSequence | Packet::flagLost;
+				packet.sequence = m_sequenceNext;
+				// the next packet may carry the redundant copy of the lost frame
+				Slot& next = m_slots[(m_sequenceNext + 1) & m_mask];
+				if (next.flagUsed && next.packet.sequence == m_sequenceNext + 1) {
+					packet.format = next.packet.format;
+					packet.audioParam = next.packet.audioParam;
+					packet.data = next.packet.data;
+				}
+				emitter.emit(packet);
+				m_statistics.countLost++;
+			}
+			m_sequenceNext++;
+		}
+		
+		void JitterBufferFilter::_reset()
+		{
+			for (sl_uint32 i = 0; m_slots && i <= m_mask; i++) {
+				m_slots[i].flagUsed = sl_false;
+				m_slots[i].packet = Packet();
+			}
+			m_countBuffered = 0;
+			m_flagStarted = sl_false;
+			m_sequenceNext = 0;
+			m_flagTimestamp = sl_false;
+			m_timestampBase = 0;
+			m_sequenceLast = 0;
+			m_positionLast = 0;
+			m_positionReleased = 0;
+			m_durationFrame = getFrameDuration();
+			m_timeBase = 0;
+			m_timeBaseWindow = 0;
+			m_countWindow = 0;
+			m_delayLast = 0;
+			m_jitter = 0;
+			m_delayPeak = 0;
+			m_flagSilence = sl_false;
+		}
+		
+		sl_int64 JitterBufferFilter::_getDelayTarget()
+		{
+			// covers the recent peak delay, and 4 times of the average jitter
+			sl_int64 delay = m_jitter / 4;
+			if (delay < m_delayPeak) {
+				delay = m_delayPeak;
+			}
+			sl_int64 delayMin = getMinDelay();
+			sl_int64 delayMax = getMaxDelay();
+			if (delay < delayMin) {
+				delay = delayMin;
+			}
+			if (delay > delayMax) {
+				delay = delayMax;
+			}
+			return delay;
+		}
+		
+	}
+	
+}
@@ -0,0 +1,456 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#include "../../../inc/slibx/streamer/mixer.h"
+
+#include "../../../inc/slibx/streamer/pcm.h"
+
+#include <chrono>
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class _AudioMixInput : public Sink
+		{
+		public:
+			Ref<PacketQueue> queue;
+			AudioMixStationParam param;
+			
+			// accessed only by the mixing thread
+			sl_int16* frame;
+			Packet pending;
+			// mix time of the first sample of `pending`, and the samples per channel already read
+			sl_int64 timePending;
+			sl_size offsetPending;
+			// mix time following the last read sample
+			sl_int64 timeNext;
+			sl_bool flagNext;
+			// added to the timestamps to place them on the mix clock
+			sl_int64 offsetTime;
+			sl_int64 timestampLast;
+			sl_bool flagActive;
+			
+		public:
+			_AudioMixInput()
+			{
+				frame = sl_null;
+				timePending = 0;
+				offsetPending = 0;
+				timeNext = 0;
+				flagNext = sl_false;
+				offsetTime = 0;
+				timestampLast = 0;
+				flagActive = sl_false;
+			}
+			
+			~_AudioMixInput()
+			{
+				if (frame) {
+					delete[] frame;
+				}
+			}
+			
+		public:
+			// override
+			sl_bool sendPacket(const Packet& input)
+			{
+				if (input.format != Packet::formatAudio_PCM_S16
+					|| input.audioParam.nSamplesPerSecond != param.nSamplesPerSecond
+					|| input.audioParam.nChannels != param.nChannels
+					|| input.data.getSize() < 2) {
+					return sl_false;
+				}
+				return queue->push(input);
+			}
+			
+			/*
+				Collects the samples falling in the tick [timeMix, timeMix + nSamplesPerFrame), and returns sl_true when any sample is collected.
+				The samples continuing the previous packet within `tolerance` are placed right after it, and an input later than the
+				tick or ahead of it by more than `durationAhead` is moved to the tick, keeping its following packets in order.
+			*/
+			sl_bool fillFrame(sl_int64 timeMix, sl_uint32 nSamplesPerFrame, sl_int64 tolerance, sl_int64 durationAhead)
+			{
+				sl_uint32 nChannels = param.nChannels;
+				sl_int64 nSamplesPerSecond = param.nSamplesPerSecond;
+				// end of the collected samples in the frame
+				sl_uint32 posEnd = 0;
+				sl_bool flagFilled = sl_false;
+				for (;;) {
+					sl_size nPending = pending.data.getSize() / 2 / nChannels;
+					if (offsetPending >= nPending) {
+						pending = Packet();
+						offsetPending = 0;
+						if (!(queue->pop(&pending))) {
+							break;
+						}
+						if (pending.timestamp != 0) {
+							if (pending.timestamp <= timestampLast) {
+								// late or duplicated
+								pending = Packet();
+								continue;
+							}
+							timestampLast = pending.timestamp;
+						}
+						timePending = _getPacketTime(timeMix + (sl_int64)posEnd * 1000000000 / nSamplesPerSecond, tolerance);
+						continue;
+					}
+					sl_int64 t = timePending + (sl_int64)offsetPending * 1000000000 / nSamplesPerSecond;
+					sl_int64 d = t - timeMix;
+					if (d < 0 || d > durationAhead) {
+						// the input has fallen behind the mix clock, or the clock of its timestamps has jumped
+						sl_int64 shift = timeMix + (sl_int64)posEnd * 1000000000 / nSamplesPerSecond - t;
+						offsetTime += shift;
+						timePending += shift;
+						t += shift;
+						d = t - timeMix;
+					}
+					sl_uint32 pos = (sl_uint32)((d * nSamplesPerSecond + 500000000) / 1000000000);
+					if (pos >= nSamplesPerFrame) {
+						// belongs to the following ticks
+						break;
+					}
+					if (pos > posEnd) {
+						Base::zeroMemory(frame + posEnd * nChannels, (pos - posEnd) * nChannels * 2);
+					}
+					sl_size n = nPending - offsetPending;
+					if (n > nSamplesPerFrame - pos) {
+						n = nSamplesPerFrame - pos;
+					}
+					Base::copyMemory(frame + pos * nChannels, (sl_int16*)(pending.data.getData()) + offsetPending * nChannels, n * nChannels * 2);
+					offsetPending += n;
+					pos += (sl_uint32)n;
+					if (pos > posEnd) {
+						posEnd = pos;
+					}
+					timeNext = t + (sl_int64)n * 1000000000 / nSamplesPerSecond;
+					flagNext = sl_true;
+					flagFilled = sl_true;
+					if (posEnd >= nSamplesPerFrame) {
+						break;
+					}
+				}
+				if (flagFilled && posEnd < nSamplesPerFrame) {
+					Base::zeroMemory(frame + posEnd * nChannels, (nSamplesPerFrame - posEnd) * nChannels * 2);
+				}
+				return flagFilled;
+			}
+			
+		private:
+			// mix time of the first sample of `pending`
+			sl_int64 _getPacketTime(sl_int64 timeDefault, sl_int64 tolerance)
+			{
+				if (pending.timestamp == 0) {
+					// continues the previous packet
+					return flagNext ? timeNext : timeDefault;
+				}
+				sl_int64 t = pending.timestamp + offsetTime;
+				if (flagNext) {
+					sl_int64 d = t - timeNext;
+					if (d <= tolerance && d >= -tolerance) {
+						// the jitter of the timestamps is not mixed as the gaps or overlaps
+						return timeNext;
+					}
+				}
+				return t;
+			}
+			
+		};
+		
+		class _AudioMixOutput : public Source
+		{
+		public:
+			Ref<PacketQueue> queue;
+			Ref<Event> event;
+			Ref<_AudioMixInput> inputExcluded;
+			
+		public:
+			// override
+			Ref<Event> getEvent()
+			{
+				return event;
+			}
+			
+			// override
+			sl_bool receivePacket(Packet* out)
+			{
+				return queue->pop(out);
+			}
+			
+			// override
+			sl_bool isReadyListenerSupported()
+			{
+				return sl_true;
+			}
+			
+			void signal()
+			{
+				notifyPacketReady();
+			}
+			
+		};
+		
+		
+		SLIB_DEFINE_OBJECT(AudioMixStation, Object)
+		
+		AudioMixStation::AudioMixStation()
+		{
+			setMaxQueuedFrames(5);
+			setMixDelay(40000);
+			setQueueSize(64);
+			m_nSamplesPerFrame = 0;
+			m_accumulator = sl_null;
+			m_sequence = 0;
+			m_timeMixBase = 0;
+			m_countTicks = 0;
+		}
+		
+		AudioMixStation::~AudioMixStation()
+		{
+			// the last reference may be released by the mixing thread itself, so it is not waited here
+			if (m_thread.isNotNull()) {
+				m_thread->finish();
+				m_event->set();
+			}
+			if (m_accumulator) {
+				delete[] m_accumulator;
+			}
+		}
+		
+		Ref<AudioMixStation> AudioMixStation::create(const AudioMixStationParam& param)
+		{
+			if (!(param.nSamplesPerSecond) || !(param.nChannels) || !(param.nSamplesPerFrame)) {
+				return sl_null;
+			}
+			Ref<Event> ev = Event::create();
+			if (ev.isNull()) {
+				return sl_null;
+			}
+			Ref<AudioMixStation> ret = new AudioMixStation;
+			if (ret.isNotNull()) {
+				ret->m_param = param;
+				ret->m_nSamplesPerFrame = param.nSamplesPerFrame * param.nChannels;
+				ret->m_accumulator = new sl_int32[ret->m_nSamplesPerFrame];
+				if (ret->m_accumulator) {
+					ret->m_event = ev;
+					sl_int64 durationFrame = (sl_int64)(param.nSamplesPerFrame) * 1000000 / param.nSamplesPerSecond;
+					WeakRef<AudioMixStation> station = ret;
+					ret->m_thread = Thread::start(Function<void()>::bind(&AudioMixStation::run, ev, station, durationFrame));
+					if (ret->m_thread.isNotNull()) {
+						return ret;
+					}
+				}
+			}
+			return sl_null;
+		}
+		
+		Ref<Sink> AudioMixStation::createInput()
+		{
+			// the packets wait for the mix delay, and may be shorter than a frame
+			sl_uint32 nDelayFrames = (sl_uint32)((sl_uint64)(getMixDelay()) * m_param.nSamplesPerSecond / 1000000 / m_param.nSamplesPerFrame) + 1;
+			Ref<PacketQueue> queue = PacketQueue::create((nDelayFrames + getMaxQueuedFrames()) * 2 + 1, PacketQueue::overflowDropOldest);
+			if (queue.isNull()) {
+				return sl_null;
+			}
+			Ref<_AudioMixInput> input = new _AudioMixInput;
+			if (input.isNull()) {
+				return sl_null;
+			}
+			input->frame = new sl_int16[m_nSamplesPerFrame];
+			if (!(input->frame)) {
+				return sl_null;
+			}
+			input->queue = queue;
+			input->param = m_param;
+			ObjectLocker lock(this);
+			m_inputs.add(input);
+			updateSnapshots();
+			return Ref<Sink>::from(input);
+		}
+		
+		void AudioMixStation::removeInput(const Ref<Sink>& input)
+		{
+			ObjectLocker lock(this);
+			Ref<_AudioMixInput> _input = Ref<_AudioMixInput>::from(input);
+			if (!(m_inputs.removeValue(_input))) {
+				return;
+			}
+			_input->queue->close();
+			updateSnapshots();
+		}
+		
+		Ref<Source> AudioMixStation::createOutput(const Ref<Sink>& inputExcluded)
+		{
+			Ref<PacketQueue> queue = PacketQueue::create(getQueueSize(), PacketQueue::overflowDropOldest);
+			if (queue.isNull()) {
+				return sl_null;
+			}
+			Ref<Event> ev = Event::create();
+			if (ev.isNull()) {
+				return sl_null;
+			}
+			Ref<_AudioMixOutput> output = new _AudioMixOutput;
+			if (output.isNull()) {
+				return sl_null;
+			}
+			output->queue = queue;
+			output->event = ev;
+			output->inputExcluded = Ref<_AudioMixInput>::from(inputExcluded);
+			ObjectLocker lock(this);
+			m_outputs.add(output);
+			updateSnapshots();
+			return Ref<Source>::from(output);
+		}
+		
+		void AudioMixStation::removeOutput(const Ref<Source>& output)
+		{
+			ObjectLocker lock(this);
+			Ref<_AudioMixOutput> _output = Ref<_AudioMixOutput>::from(output);
+			if (!(m_outputs.removeValue(_output))) {
+				return;
+			}
+			_output->queue->close();
+			updateSnapshots();
+		}
+		
+		void AudioMixStation::release()
+		{
+			Ref<Thread> thread = m_thread;
+			if (thread.isNotNull()) {
+				thread->finish();
+				m_event->set();
+				thread->finishAndWait();
+				m_thread.setNull();
+			}
+			ObjectLocker lock(this);
+			m_inputs.removeAll();
+			m_outputs.removeAll();
+			SpinLocker lockSnapshot(&m_lockSnapshot);
+			m_snapshotInputs.setNull();
+			m_snapshotOutputs.setNull();
+		}
+		
+		void AudioMixStation::updateSnapshots()
+		{
+			ListLocker< Ref<_AudioMixInput> > inputs(m_inputs);
+			Array< Ref<_AudioMixInput> > snapshotInputs = Array< Ref<_AudioMixInput> >::create(inputs.data, inputs.count);
+			ListLocker< Ref<_AudioMixOutput> > outputs(m_outputs);
+			Array< Ref<_AudioMixOutput> > snapshotOutputs = Array< Ref<_AudioMixOutput> >::create(outputs.data, outputs.count);
+			SpinLocker lockSnapshot(&m_lockSnapshot);
+			m_snapshotInputs = snapshotInputs;
+			m_snapshotOutputs = snapshotOutputs;
+		}
+		
+		void AudioMixStation::mix()
+		{
+			Array< Ref<_AudioMixInput> > arrInputs;
+			Array< Ref<_AudioMixOutput> > arrOutputs;
+			{
+				SpinLocker lock(&m_lockSnapshot);
+				arrInputs = m_snapshotInputs;
+				arrOutputs = m_snapshotOutputs;
+			}
+			Ref<_AudioMixInput>* inputs = arrInputs.getData();
+			sl_size nInputs = arrInputs.getCount();
+			Ref<_AudioMixOutput>* outputs = arrOutputs.getData();
+			sl_size nOutputs = arrOutputs.getCount();
+			
+			// the mix clock follows the timestamps by MixDelay, and advances by exactly one frame per tick
+			sl_int64 nSamplesPerSecond = m_param.nSamplesPerSecond;
+			sl_int64 durationFrame = (sl_int64)(m_param.nSamplesPerFrame) * 1000000000 / nSamplesPerSecond;
+			sl_int64 timeClock = Packet::getCurrentTimestamp() - (sl_int64)(getMixDelay()) * 1000;
+			sl_int64 timeMix = m_timeMixBase + (sl_int64)(m_countTicks * m_param.nSamplesPerFrame) * 1000000000 / nSamplesPerSecond;
+			if (!m_countTicks || timeClock - timeMix > durationFrame * 5 || timeMix - timeClock > durationFrame * 5) {
+				// started, or the ticks were missed during a long stall
+				m_timeMixBase = timeClock;
+				m_countTicks = 0;
+				timeMix = timeClock;
+			}
+			m_countTicks++;
+			sl_int64 durationAhead = (sl_int64)(getMixDelay()) * 1000 + durationFrame * getMaxQueuedFrames();
+			
+			sl_uint32 nSamples = m_nSamplesPerFrame;
+			sl_int32* acc = m_accumulator;
+			Base::zeroMemory(acc, nSamples * sizeof(sl_int32));
+			for (sl_size i = 0; i < nInputs; i++) {
+				_AudioMixInput* input = inputs[i].get();
+				input->flagActive = input->fillFrame(timeMix, m_param.nSamplesPerFrame, durationFrame / 2, durationAhead);
+				if (input->flagActive) {
+					PcmKernels::accumulate(acc, input->frame, nSamples);
+				}
+			}
+			if (!nOutputs) {
+				return;
+			}
+			
+			Packet packet;
+			packet.format = Packet::formatAudio_PCM_S16;
+			packet.audioParam.nSamplesPerSecond = m_param.nSamplesPerSecond;
+			packet.audioParam.nChannels = m_param.nChannels;
+			packet.timestamp = timeMix;
+			packet.flags = Packet::flagSequence;
+			packet.sequence = m_sequence++;
+			
+			// shared by the outputs whose excluded input is silent
+			PacketData dataTotal;
+			for (sl_size i = 0; i < nOutputs; i++) {
+				_AudioMixOutput* output = outputs[i].get();
+				_AudioMixInput* excluded = output->inputExcluded.get();
+				if (excluded && excluded->flagActive) {
+					if (!(packet.data.allocate(nSamples * 2))) {
+						continue;
+					}
+					PcmKernels::packExcluding((sl_int16*)(packet.data.getData()), acc, excluded->frame, nSamples);
+				} else {
+					if (dataTotal.isNull()) {
+						if (!(dataTotal.allocate(nSamples * 2))) {
+							continue;
+						}
+						PcmKernels::pack((sl_int16*)(dataTotal.getData()), acc, nSamples);
+					}
+					packet.data = dataTotal;
+				}
+				output->queue->push(packet);
+			}
+			for (sl_size i = 0; i < nOutputs; i++) {
+				outputs[i]->signal();
+			}
+		}
+		
+		void AudioMixStation::run(Ref<Event> ev, WeakRef<AudioMixStation> _station, sl_int64 durationFrame)
+		{
+			typedef std::chrono::steady_clock Clock;
+			Clock::time_point timeNext = Clock::now();
+			while (!Thread::isStoppingCurrent()) {
+				timeNext += std::chrono::microseconds(durationFrame);
+				Clock::time_point now = Clock::now();
+				if (now < timeNext) {
+					sl_int64 ms = (sl_int64)(std::chrono::duration_cast<std::chrono::milliseconds>(timeNext - now).count());
+					if (ms > 0) {
+						ev->wait((sl_int32)ms);
+					}
+				} else if (now - timeNext > std::chrono::microseconds(durationFrame * 5)) {
+					// skips the ticks missed during a long stall
+					timeNext = now;
+				}
+				Ref<AudioMixStation> station = _station;
+				if (station.isNull()) {
+					return;
+				}
+				station->mix();
+			}
+		}
+		
+	}
+	
+}
@@ -10,7 +10,24 @@
 
 #include "../../../inc/slibx/streamer/network.h"
 
-#include <slib/core/loop_queue.h>
+
+#if defined(SLIB_PLATFORM_IS_LINUX)
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#endif
+
+#define SIZE_MAX_SEGMENTED 65000
 
 namespace slib
 {
@@ -50,26 +67,401 @@ namespace slib
 		}
 		
 		
-		sl_bool NetworkUdpSink::sendPacket(const Packet& packet)
+#define FEEDBACK_TYPE_DATA 0xF0
+#define FEEDBACK_TYPE_REPORT 0xF1
+#define FEEDBACK_REPORT_POLL_INTERVAL 10
+// a transport sequence going back further restarts the statistics of the receiver (the sender or its counter is restarted)
+#define FEEDBACK_RESTART_DISTANCE 1000
+		
+		static void _StreamerNetwork_writeBE32(sl_uint8* p, sl_uint32 v)
+		{
+			p[0] = (sl_uint8)(v >> 24);
+			p[1] = (sl_uint8)(v >> 16);
+			p[2] = (sl_uint8)(v >> 8);
+			p[3] = (sl_uint8)v;
+		}
+		
+		static sl_uint32 _StreamerNetwork_readBE32(const sl_uint8* p)
+		{
+			return ((sl_uint32)(p[0]) << 24) | ((sl_uint32)(p[1]) << 16) | ((sl_uint32)(p[2]) << 8) | (sl_uint32)(p[3]);
+		}
+		
+		// wrapping 32-bit milliseconds of the monotonic clock, used only for the differences
+		static sl_uint32 _StreamerNetwork_getFeedbackTime()
+		{
+			return (sl_uint32)(Packet::getCurrentTimestamp() / 1000000);
+		}
+		
+		NetworkUdpSink::NetworkUdpSink()
+		{
+			setBatchMode(sl_false);
+			setSegmentationOffload(sl_true);
+			setFlushDelay(0);
+			setFeedback(sl_false);
+			m_countBatch = 0;
+			m_timeBatchStarted = 0;
+			m_stateSegmentation = 0;
+			m_flagFeedbackStarted = sl_false;
+			m_countFeedbackTargets = 0;
+			m_indexFeedbackTargetLast = 0;
+			m_timeLastReportPoll = 0;
+		}
+		
+		sl_bool NetworkUdpSink::sendPacket(const Packet& input)
 		{
 			Ref<Socket> socket = getSocket();
 			if (socket.isNull()) {
 				return sl_false;
 			}
+			if (input.data.isEmpty()) {
+				return sl_false;
+			}
+			ObjectLocker lock(this);
 			SocketAddress target;
-			if (! resolveTarget(packet, target)) {
+			if (! resolveTarget(input, target)) {
 				return sl_false;
 			}
+			Packet packet = input;
+			if (getFeedback()) {
+				if (!m_flagFeedbackStarted) {
+#if defined(SLIB_PLATFORM_IS_LINUX)
+					// the kernel stamps the arrival of the reports, so the time waited in the socket is not counted in the round trip
+					int flagTimestamp = 1;
+					setsockopt((int)(socket->getHandle()), SOL_SOCKET, SO_TIMESTAMPNS, &flagTimestamp, sizeof(flagTimestamp));
+#endif
+					m_flagFeedbackStarted = sl_true;
+				}
+				sl_int64 now = Packet::getCurrentTimestamp();
+				if (now - m_timeLastReportPoll >= (sl_int64)FEEDBACK_REPORT_POLL_INTERVAL * 1000000) {
+					m_timeLastReportPoll = now;
+					_receiveReports(socket.get());
+				}
+				sl_uint8* header = packet.data.prepend(SLIB_STREAMER_UDP_FEEDBACK_HEADER_SIZE);
+				if (!header) {
+					return sl_false;
+				}
+				header[0] = FEEDBACK_TYPE_DATA;
+				_StreamerNetwork_writeBE32(header + 1, _getFeedbackSequence(target, now));
+				_StreamerNetwork_writeBE32(header + 5, (sl_uint32)(now / 1000000));
+			}
+			if (getBatchMode()) {
+				if (m_countBatch >= SLIB_STREAMER_UDP_SEND_BATCH_MAX) {
+					_sendBatch(socket.get(), m_countBatch);
+					for (sl_uint32 i = 0; i < m_countBatch; i++) {
+						m_batchPackets[i].data.setNull();
+					}
+					m_countBatch = 0;
+				}
+				if (m_countBatch == 0) {
+					m_timeBatchStarted = Packet::getCurrentTimestamp();
+				}
+				m_batchPackets[m_countBatch] = packet;
+				m_batchTargets[m_countBatch] = target;
+				m_countBatch++;
+				return sl_true;
+			}
 			sl_int32 n = (sl_int32)(packet.data.getSize());
 			sl_int32 nSend = socket->sendTo(target, packet.data.getData(), n);
 			return n == nSend;
 		}
 		
+		void NetworkUdpSink::flush()
+		{
+			ObjectLocker lock(this);
+			sl_uint32 n = m_countBatch;
+			if (n == 0) {
+				return;
+			}
+			sl_uint32 delay = getFlushDelay();
+			if (delay) {
+				if (Packet::getCurrentTimestamp() - m_timeBatchStarted < (sl_int64)delay * 1000) {
+					return;
+				}
+			}
+			Ref<Socket> socket = getSocket();
+			if (socket.isNotNull()) {
+				_sendBatch(socket.get(), n);
+			}
+			for (sl_uint32 i = 0; i < n; i++) {
+				m_batchPackets[i].data.setNull();
+			}
+			m_countBatch = 0;
+		}
+		
+		sl_uint32 NetworkUdpSink::getTimerInterval()
+		{
+			if (getBatchMode()) {
+				sl_uint32 delay = getFlushDelay();
+				if (delay) {
+					return (delay + 999) / 1000;
+				}
+			}
+			return 0;
+		}
+		
+		sl_bool NetworkUdpSink::_sendBatch(Socket* socket, sl_uint32 n)
+		{
+#if defined(SLIB_PLATFORM_IS_LINUX)
+			if (n > 1 && getSegmentationOffload() && _probeSegmentation(socket)) {
+				// a batch rejected by GSO (such as the segments exceeding the MTU) is sent again below
+				if (_sendSegmented(socket, n)) {
+					return sl_true;
+				}
+			}
+			int fd = (int)(socket->getHandle());
+			mmsghdr msgs[SLIB_STREAMER_UDP_SEND_BATCH_MAX];
+			iovec iovs[SLIB_STREAMER_UDP_SEND_BATCH_MAX];
+			sockaddr_storage addrs[SLIB_STREAMER_UDP_SEND_BATCH_MAX];
+			for (sl_uint32 i = 0; i < n; i++) {
+				iovs[i].iov_base = m_batchPackets[i].data.getData();
+				iovs[i].iov_len = m_batchPackets[i].data.getSize();
+				Base::zeroMemory(&(msgs[i]), sizeof(mmsghdr));
+				msgs[i].msg_hdr.msg_name = &(addrs[i]);
+				msgs[i].msg_hdr.msg_namelen = m_batchTargets[i].getSystemSocketAddress(&(addrs[i]));
+				msgs[i].msg_hdr.msg_iov = &(iovs[i]);
+				msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+			sl_uint32 nSent = 0;
+			while (nSent < n) {
+				int ret = sendmmsg(fd, msgs + nSent, n - nSent, 0);
+				if (ret > 0) {
+					nSent += ret;
+				} else if (ret < 0 && errno == EINTR) {
+					continue;
+				} else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+					return sl_false;
+				} else {
+					// skips the datagram rejected by the system
+					nSent++;
+				}
+			}
+			return sl_true;
+#else
+			sl_bool flagSuccess = sl_true;
+			for (sl_uint32 i = 0; i < n; i++) {
+				sl_int32 size = (sl_int32)(m_batchPackets[i].data.getSize());
+				if (socket->sendTo(m_batchTargets[i], m_batchPackets[i].data.getData(), size) != size) {
+					flagSuccess = sl_false;
+				}
+			}
+			return flagSuccess;
+#endif
+		}
+		
+		sl_bool NetworkUdpSink::_sendSegmented(Socket* socket, sl_uint32 n)
+		{
+#if defined(SLIB_PLATFORM_IS_LINUX)
+			// all segments except the last one should have the same size, and the last one should not be larger
+			const SocketAddress& target = m_batchTargets[0];
+			sl_size sizeSegment = m_batchPackets[0].data.getSize();
+			sl_size sizeTotal = 0;
+			for (sl_uint32 i = 0; i < n; i++) {
+				sl_size size = m_batchPackets[i].data.getSize();
+				if (m_batchTargets[i] != target) {
+					return sl_false;
+				}
+				if (i + 1 < n ? size != sizeSegment : size > sizeSegment) {
+					return sl_false;
+				}
+				sizeTotal += size;
+			}
+			if (sizeTotal > SIZE_MAX_SEGMENTED) {
+				return sl_false;
+			}
+			if (m_bufferSegments.isNull()) {
+				m_bufferSegments = Memory::create(SIZE_MAX_SEGMENTED);
+				if (m_bufferSegments.isNull()) {
+					return sl_false;
+				}
+			}
+			sl_uint8* buf = (sl_uint8*)(m_bufferSegments.getData());
+			sl_size offset = 0;
+			for (sl_uint32 i = 0; i < n; i++) {
+				sl_size size = m_batchPackets[i].data.getSize();
+				Base::copyMemory(buf + offset, m_batchPackets[i].data.getData(), size);
+				offset += size;
+			}
+			
+			sockaddr_storage addr;
+			iovec iov;
+			iov.iov_base = buf;
+			iov.iov_len = sizeTotal;
+			char control[CMSG_SPACE(sizeof(sl_uint16))];
+			Base::zeroMemory(control, sizeof(control));
+			msghdr msg;
+			Base::zeroMemory(&msg, sizeof(msg));
+			msg.msg_name = &addr;
+			msg.msg_namelen = target.getSystemSocketAddress(&addr);
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+			cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+			cm->cmsg_level = SOL_UDP;
+			cm->cmsg_type = UDP_SEGMENT;
+			cm->cmsg_len = CMSG_LEN(sizeof(sl_uint16));
+			sl_uint16 gso = (sl_uint16)sizeSegment;
+			Base::copyMemory(CMSG_DATA(cm), &gso, sizeof(gso));
+			
+			int fd = (int)(socket->getHandle());
+			ssize_t ret;
+			do {
+				ret = sendmsg(fd, &msg, 0);
+			} while (ret < 0 && errno == EINTR);
+			return ret == (ssize_t)sizeTotal;
+#else
+			return sl_false;
+#endif
+		}
+		
+		sl_bool NetworkUdpSink::_probeSegmentation(Socket* socket)
+		{
+#if defined(SLIB_PLATFORM_IS_LINUX)
+			if (m_stateSegmentation == 0) {
+				// the kernels without UDP_SEGMENT reject the option; 0 keeps the default of the socket unchanged
+				int size = 0;
+				if (setsockopt((int)(socket->getHandle()), SOL_UDP, UDP_SEGMENT, &size, sizeof(size)) == 0) {
+					m_stateSegmentation = 1;
+				} else {
+					m_stateSegmentation = 2;
+				}
+			}
+			return m_stateSegmentation == 1;
+#else
+			return sl_false;
+#endif
+		}
+		
+#if defined(SLIB_PLATFORM_IS_LINUX)
+		// milliseconds since the arrival stamped by SO_TIMESTAMPNS
+		static sl_uint32 _NetworkUdpSink_getReceiveAge(msghdr* msg)
+		{
+			for (cmsghdr* cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+				if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+					timespec arrival;
+					Base::copyMemory(&arrival, CMSG_DATA(cmsg), sizeof(arrival));
+					timespec now;
+					clock_gettime(CLOCK_REALTIME, &now);
+					sl_int64 age = ((sl_int64)(now.tv_sec) - (sl_int64)(arrival.tv_sec)) * 1000 + ((sl_int64)(now.tv_nsec) - (sl_int64)(arrival.tv_nsec)) / 1000000;
+					// ignores the steps of the wall clock
+					if (age > 0 && age < 10000) {
+						return (sl_uint32)age;
+					}
+					return 0;
+				}
+			}
+			return 0;
+		}
+#endif
+		
+		sl_uint32 NetworkUdpSink::_getFeedbackSequence(const SocketAddress& target, sl_int64 now)
+		{
+			FeedbackTarget* entry = sl_null;
+			if (m_countFeedbackTargets && m_feedbackTargets[m_indexFeedbackTargetLast].address == target) {
+				entry = m_feedbackTargets + m_indexFeedbackTargetLast;
+			} else {
+				sl_uint32 index = 0;
+				for (; index < m_countFeedbackTargets; index++) {
+					if (m_feedbackTargets[index].address == target) {
+						break;
+					}
+				}
+				if (index == m_countFeedbackTargets) {
+					if (m_countFeedbackTargets < SLIB_STREAMER_UDP_FEEDBACK_MAX_TARGETS) {
+						m_countFeedbackTargets++;
+					} else {
+						// replaces the least recently used destination
+						index = 0;
+						for (sl_uint32 i = 1; i < m_countFeedbackTargets; i++) {
+							if (m_feedbackTargets[i].timeLastSent < m_feedbackTargets[index].timeLastSent) {
+								index = i;
+							}
+						}
+					}
+					m_feedbackTargets[index].address = target;
+					m_feedbackTargets[index].sequence = 0;
+				}
+				m_indexFeedbackTargetLast = index;
+				entry = m_feedbackTargets + index;
+			}
+			entry->timeLastSent = now;
+			return entry->sequence++;
+		}
+		
+		void NetworkUdpSink::_receiveReports(Socket* socket)
+		{
+			Function<void(const NetworkUdpReport&)> listener = getReportListener();
+			sl_uint8 buf[64];
+#if defined(SLIB_PLATFORM_IS_LINUX)
+			int fd = (int)(socket->getHandle());
+#endif
+			for (;;) {
+				NetworkUdpReport report;
+				// milliseconds the report has waited in the socket
+				sl_uint32 age = 0;
+#if defined(SLIB_PLATFORM_IS_LINUX)
+				sockaddr_storage addr;
+				iovec iov;
+				iov.iov_base = buf;
+				iov.iov_len = sizeof(buf);
+				char control[CMSG_SPACE(sizeof(timespec))];
+				msghdr msg;
+				Base::zeroMemory(&msg, sizeof(msg));
+				msg.msg_name = &addr;
+				msg.msg_namelen = sizeof(addr);
+				msg.msg_iov = &iov;
+				msg.msg_iovlen = 1;
+				msg.msg_control = control;
+				msg.msg_controllen = sizeof(control);
+				sl_int32 n = (sl_int32)(recvmsg(fd, &msg, MSG_DONTWAIT));
+				if (n <= 0) {
+					break;
+				}
+				report.from.setSystemSocketAddress(&addr, msg.msg_namelen);
+				age = _NetworkUdpSink_getReceiveAge(&msg);
+#else
+				// the socket is expected to be non-blocking (see Feedback in network.h)
+				sl_int32 n = socket->receiveFrom(report.from, buf, sizeof(buf));
+				if (n <= 0) {
+					break;
+				}
+#endif
+				if (n < SLIB_STREAMER_UDP_REPORT_SIZE || buf[0] != FEEDBACK_TYPE_REPORT) {
+					continue;
+				}
+				report.sequenceHighest = _StreamerNetwork_readBE32(buf + 1);
+				report.countLost = _StreamerNetwork_readBE32(buf + 5);
+				report.fractionLost = (float)(buf[9]) / 256.0f;
+				sl_uint32 timeEchoed = _StreamerNetwork_readBE32(buf + 10);
+				sl_uint32 delay = _StreamerNetwork_readBE32(buf + 14);
+				report.rtt = -1;
+				if (timeEchoed) {
+					sl_int32 rtt = (sl_int32)(_StreamerNetwork_getFeedbackTime() - timeEchoed - delay - age);
+					report.rtt = rtt < 0 ? 0 : rtt;
+				}
+				if (listener.isNotNull()) {
+					listener(report);
+				}
+			}
+		}
+		
 		sl_bool NetworkUdpSink::resolveTarget(const Packet& packet, SocketAddress& target)
 		{
-			if (packet.networkParam.addressTo.isNotEmpty()) {
+			if (packet.networkParam.to.isValid()) {
+				target = packet.networkParam.to;
+				return sl_true;
+			}
+			const String& str = packet.networkParam.addressTo;
+			if (str.isNotEmpty()) {
+				// the packets of a stream usually have the same destination, so the last parsed address is reused
+				if (m_lastTargetString.isNotEmpty() && m_lastTargetString == str) {
+					target = m_lastTarget;
+					return sl_true;
+				}
 				SocketAddress address;
-				if (address.parse(packet.networkParam.addressTo)) {
+				if (address.parse(str)) {
+					m_lastTargetString = str;
+					m_lastTarget = address;
 					target = address;
 					return sl_true;
 				}
@@ -122,13 +514,55 @@ namespace slib
 		{
 		public:
 			Ref<Thread> m_thread;
-			LoopQueue<Packet> m_queue;
+			// set when the receiving thread is started, and then the poller is not accepted
+			sl_int32 m_flagThreadStarted;
+			// receives on the threads of the poller (GraphScheduler) instead of `m_thread`
+			sl_bool m_flagPolled;
 			Ref<Event> m_event;
+			// created and pushed only by the receiving thread, and published by `m_flagQueueCreated`
+			Ref<PacketQueue> m_queue;
+			sl_int32 m_flagQueueCreated;
+			// set when the graph is woken, and cleared when the graph finds the queue empty
+			sl_int32 m_flagNotified;
+			// written only by the receiving thread
+			sl_uint64 m_sequence;
+			// the datagrams of a stream usually come from one sender, so the last formatted address is reused
+			SocketAddress m_lastFrom;
+			String m_lastFromString;
+#if defined(SLIB_PLATFORM_IS_LINUX)
+			// receiving buffers of the polled mode, accessed by one caller of receivePacket() at a time
+			Ref<PacketBuffer> m_buffersPolled[SLIB_STREAMER_UDP_RECEIVE_BATCH_MAX];
+#endif
+			
+			// reception of the feedback sender, accessed only by the receiving thread
+			sl_bool m_flagFeedbackStarted;
+			SocketAddress m_feedbackFrom;
+			sl_uint32 m_feedbackSequenceBase;
+			sl_uint64 m_feedbackSequenceHighest;
+			sl_uint64 m_feedbackReceived;
+			sl_uint64 m_feedbackExpectedPrior;
+			sl_uint64 m_feedbackReceivedPrior;
+			sl_uint32 m_feedbackTimeLastSent;
+			sl_uint32 m_feedbackTimeLastArrival;
+			sl_uint32 m_feedbackTimeLastReport;
 			
 			_NetworkUdpSourceImpl()
 			{
-				m_queue.setQueueSize(1000);
+				m_flagThreadStarted = 0;
+				m_flagPolled = sl_false;
+				m_flagQueueCreated = 0;
+				m_flagNotified = 0;
+				m_sequence = 0;
 				m_event = Event::create();
+				m_flagFeedbackStarted = sl_false;
+				m_feedbackSequenceBase = 0;
+				m_feedbackSequenceHighest = 0;
+				m_feedbackReceived = 0;
+				m_feedbackExpectedPrior = 0;
+				m_feedbackReceivedPrior = 0;
+				m_feedbackTimeLastSent = 0;
+				m_feedbackTimeLastArrival = 0;
+				m_feedbackTimeLastReport = 0;
 			}
 			
 			~_NetworkUdpSourceImpl()
@@ -136,50 +570,400 @@ namespace slib
 				if (m_thread.isNotNull()) {
 					m_thread->finish();
 				}
+				PacketQueue* queue = getQueue();
+				if (queue) {
+					// releases the receiving thread blocked by overflowBlock
+					queue->close();
+				}
+			}
+			
+			PacketQueue* getQueue()
+			{
+				if (Base::interlockedAdd32(&m_flagQueueCreated, 0)) {
+					return m_queue.get();
+				}
+				return sl_null;
+			}
+			
+			// the thread is started when the source is used without the poller
+			void startReceiving()
+			{
+				if (Base::interlockedAdd32(&m_flagThreadStarted, 0)) {
+					return;
+				}
+				ObjectLocker lock(this);
+				if (m_flagPolled || m_thread.isNotNull()) {
+					return;
+				}
+				Ref<Socket> socket = getSocket();
+				if (socket.isNull()) {
+					return;
+				}
+				m_thread = Thread::start(Function<void()>::bind(&_NetworkUdpSourceImpl::run, socket, WeakRef<_NetworkUdpSourceImpl>(this)));
+				if (m_thread.isNotNull()) {
+					Base::interlockedIncrement32(&m_flagThreadStarted);
+				}
 			}
 			
 			// override
 			sl_bool receivePacket(Packet* out)
 			{
-				return m_queue.get(*out);
+#if defined(SLIB_PLATFORM_IS_LINUX)
+				if (m_flagPolled) {
+					// receives on the calling thread only when the queued packets are consumed
+					PacketQueue* queue = getQueue();
+					if (queue && queue->pop(out)) {
+						return sl_true;
+					}
+					Ref<Socket> socket = getSocket();
+					if (socket.isNotNull() && receiveBatch((int)(socket->getHandle()), m_buffersPolled, sl_false, sl_null)) {
+						queue = getQueue();
+						if (queue) {
+							return queue->pop(out);
+						}
+					}
+					return sl_false;
+				}
+#endif
+				PacketQueue* queue = getQueue();
+				if (!queue) {
+					Base::interlockedCompareExchange32(&m_flagNotified, 0, 1);
+					return sl_false;
+				}
+				if (queue->pop(out)) {
+					return sl_true;
+				}
+				Base::interlockedCompareExchange32(&m_flagNotified, 0, 1);
+				// checks again not to miss the packet pushed before the flag is cleared
+				return queue->pop(out);
 			}
 			
 			// override
 			Ref<Event> getEvent()
 			{
+				startReceiving();
 				return m_event;
 			}
 			
-			void onPacket(char* buf, sl_int32 n, SocketAddress& address)
+			// override
+			void setReadyListener(const Function<void()>& listener)
+			{
+				NetworkUdpSource::setReadyListener(listener);
+				if (listener.isNotNull()) {
+					startReceiving();
+				}
+			}
+			
+			// override
+			sl_int64 attachPoller()
+			{
+#if defined(SLIB_PLATFORM_IS_LINUX)
+				ObjectLocker lock(this);
+				if (m_thread.isNotNull()) {
+					// already receiving on its own thread
+					return -1;
+				}
+				Ref<Socket> socket = getSocket();
+				if (socket.isNull()) {
+					return -1;
+				}
+				m_flagPolled = sl_true;
+				return (sl_int64)(socket->getHandle());
+#else
+				return -1;
+#endif
+			}
+			
+			// override
+			void detachPoller()
+			{
+				ObjectLocker lock(this);
+				m_flagPolled = sl_false;
+			}
+			
+			// override
+			sl_bool isReadyListenerSupported()
+			{
+				return sl_true;
+			}
+			
+			// override
+			sl_uint64 getDroppedCount()
+			{
+				PacketQueue* queue = getQueue();
+				if (queue) {
+					return queue->getDroppedCount();
+				}
+				return 0;
+			}
+			
+			// override
+			sl_uint32 getQueuedCount()
 			{
+				PacketQueue* queue = getQueue();
+				if (queue) {
+					return queue->getCount();
+				}
+				return 0;
+			}
+			
+			void onPacket(const PacketData& _data, const SocketAddress& address)
+			{
+				PacketData data = _data;
+				if (getFeedback()) {
+					const sl_uint8* header = (const sl_uint8*)(data.getData());
+					if (data.getSize() <= SLIB_STREAMER_UDP_FEEDBACK_HEADER_SIZE || header[0] != FEEDBACK_TYPE_DATA) {
+						return;
+					}
+					onFeedback(_StreamerNetwork_readBE32(header + 1), _StreamerNetwork_readBE32(header + 5), address);
+					data.removeFront(SLIB_STREAMER_UDP_FEEDBACK_HEADER_SIZE);
+				}
+				if (m_queue.isNull()) {
+					m_queue = PacketQueue::create(getQueueSize(), getOverflowPolicy());
+					if (m_queue.isNull()) {
+						return;
+					}
+					Base::interlockedIncrement32(&m_flagQueueCreated);
+				}
 				Packet packet;
 				packet.format = Packet::formatRaw;
-				packet.networkParam.addressFrom = address.toString();
-				packet.data = Memory::create(buf, n);
-				m_queue.add(packet, sl_true);
-				m_event->set();
+				packet.networkParam.from = address;
+				if (m_lastFromString.isEmpty() || m_lastFrom != address) {
+					m_lastFrom = address;
+					m_lastFromString = address.toString();
+				}
+				packet.networkParam.addressFrom = m_lastFromString;
+				packet.timestamp = Packet::getCurrentTimestamp();
+				packet.flags = Packet::flagSequence;
+				packet.sequence = m_sequence++;
+				packet.streamId = getStreamId();
+				packet.data = data;
+				m_queue->push(packet);
+			}
+			
+			void onFeedback(sl_uint32 sequence, sl_uint32 timeSent, const SocketAddress& address)
+			{
+				sl_uint32 now = _StreamerNetwork_getFeedbackTime();
+				// extends the 32-bit sequence
+				sl_int32 d = m_flagFeedbackStarted ? (sl_int32)(sequence - (sl_uint32)m_feedbackSequenceHighest) : 0;
+				if (!m_flagFeedbackStarted || m_feedbackFrom != address || d < -FEEDBACK_RESTART_DISTANCE) {
+					m_flagFeedbackStarted = sl_true;
+					m_feedbackFrom = address;
+					m_feedbackSequenceBase = sequence;
+					m_feedbackSequenceHighest = sequence;
+					m_feedbackReceived = 0;
+					m_feedbackExpectedPrior = 0;
+					m_feedbackReceivedPrior = 0;
+					m_feedbackTimeLastReport = now;
+				} else if (d > 0) {
+					m_feedbackSequenceHighest += d;
+				}
+				m_feedbackReceived++;
+				m_feedbackTimeLastSent = timeSent;
+				m_feedbackTimeLastArrival = now;
+				if (now - m_feedbackTimeLastReport >= getReportInterval()) {
+					m_feedbackTimeLastReport = now;
+					sendReport(now);
+				}
+			}
+			
+			void sendReport(sl_uint32 now)
+			{
+				Ref<Socket> socket = getSocket();
+				if (socket.isNull()) {
+					return;
+				}
+				sl_uint64 expected = m_feedbackSequenceHighest - m_feedbackSequenceBase + 1;
+				sl_uint64 lost = expected > m_feedbackReceived ? expected - m_feedbackReceived : 0;
+				sl_int64 expectedInterval = (sl_int64)(expected - m_feedbackExpectedPrior);
+				sl_int64 lostInterval = expectedInterval - (sl_int64)(m_feedbackReceived - m_feedbackReceivedPrior);
+				m_feedbackExpectedPrior = expected;
+				m_feedbackReceivedPrior = m_feedbackReceived;
+				sl_uint32 fraction = 0;
+				if (expectedInterval > 0 && lostInterval > 0) {
+					fraction = (sl_uint32)((lostInterval << 8) / expectedInterval);
+					if (fraction > 255) {
+						fraction = 255;
+					}
+				}
+				sl_uint8 report[SLIB_STREAMER_UDP_REPORT_SIZE];
+				report[0] = FEEDBACK_TYPE_REPORT;
+				_StreamerNetwork_writeBE32(report + 1, (sl_uint32)m_feedbackSequenceHighest);
+				_StreamerNetwork_writeBE32(report + 5, lost > 0xFFFFFFFF ? 0xFFFFFFFF : (sl_uint32)lost);
+				report[9] = (sl_uint8)fraction;
+				_StreamerNetwork_writeBE32(report + 10, m_feedbackTimeLastSent);
+				_StreamerNetwork_writeBE32(report + 14, now - m_feedbackTimeLastArrival);
+				socket->sendTo(m_feedbackFrom, report, SLIB_STREAMER_UDP_REPORT_SIZE);
+			}
+			
+			// called after a batch of datagrams is pushed
+			void notify()
+			{
+				if (Base::interlockedCompareExchange32(&m_flagNotified, 1, 0)) {
+					notifyPacketReady();
+				}
+			}
+			
+			void onPacket(char* buf, sl_int32 n, const SocketAddress& address)
+			{
+				PacketData data;
+				if (data.copyFrom(buf, n, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM)) {
+					onPacket(data, address);
+				}
 			}
 			
 #define SIZE_BUF 2000
+#define WAIT_TIMEOUT 100
 			static void run(Ref<Socket> socket, WeakRef<_NetworkUdpSourceImpl> wr)
 			{
+#if defined(SLIB_PLATFORM_IS_LINUX)
+				if (runBatch(socket, wr)) {
+					return;
+				}
+#endif
+				Ref<SocketEvent> ev = SocketEvent::createRead(socket);
 				char buf[SIZE_BUF];
 				while (!Thread::isStoppingCurrent()) {
-					
-					SocketAddress address;
-					sl_int32 n = socket->receiveFrom(address, buf, SIZE_BUF);
-					if (n > 0) {
-						Ref<_NetworkUdpSourceImpl> object = wr;
-						if (object.isNotNull()) {
+					Ref<_NetworkUdpSourceImpl> object = wr;
+					if (object.isNull()) {
+						return;
+					}
+					sl_bool flagReceived = sl_false;
+					for (;;) {
+						SocketAddress address;
+						sl_int32 n = socket->receiveFrom(address, buf, SIZE_BUF);
+						if (n > 0) {
 							object->onPacket(buf, n, address);
+							flagReceived = sl_true;
 						} else {
-							return;
+							break;
 						}
+					}
+					if (flagReceived) {
+						object->notify();
+					}
+					object.setNull();
+					if (ev.isNotNull()) {
+						ev->waitEvents(WAIT_TIMEOUT);
 					} else {
 						Thread::sleep(5);
 					}
 				}
 			}
+			
+#if defined(SLIB_PLATFORM_IS_LINUX)
+			// receives the pending datagrams into `buffers` and pushes them to the queue, and returns sl_true when any is received.
+			// `pFlagError` is set when the socket fails, or no buffer is available for the pending datagrams
+			sl_bool receiveBatch(int fd, Ref<PacketBuffer>* buffers, sl_bool flagDrain, sl_bool* pFlagError)
+			{
+				sl_uint32 nBatch = getReceiveBatchSize();
+				if (nBatch < 1) {
+					nBatch = 1;
+				}
+				if (nBatch > SLIB_STREAMER_UDP_RECEIVE_BATCH_MAX) {
+					nBatch = SLIB_STREAMER_UDP_RECEIVE_BATCH_MAX;
+				}
+				if (!flagDrain && nBatch > getQueueSize() && getQueueSize() > 0) {
+					// the queue is consumed by the caller itself, so one batch should not overflow it
+					nBatch = getQueueSize();
+				}
+				mmsghdr msgs[SLIB_STREAMER_UDP_RECEIVE_BATCH_MAX];
+				iovec iovs[SLIB_STREAMER_UDP_RECEIVE_BATCH_MAX];
+				sockaddr_storage addrs[SLIB_STREAMER_UDP_RECEIVE_BATCH_MAX];
+				sl_bool flagReceived = sl_false;
+				for (;;) {
+					sl_uint32 i;
+					for (i = 0; i < nBatch; i++) {
+						if (buffers[i].isNull()) {
+							// nothing is claimed yet, and the datagram is claimed after it is received
+							buffers[i] = PacketBuffer::create(0, SLIB_STREAMER_PACKET_HEADROOM, SIZE_BUF + SLIB_STREAMER_PACKET_TAILROOM);
+							if (buffers[i].isNull()) {
+								break;
+							}
+						}
+						iovs[i].iov_base = buffers[i]->getData() + SLIB_STREAMER_PACKET_HEADROOM;
+						iovs[i].iov_len = SIZE_BUF;
+						Base::zeroMemory(&(msgs[i]), sizeof(mmsghdr));
+						msgs[i].msg_hdr.msg_name = &(addrs[i]);
+						msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+						msgs[i].msg_hdr.msg_iov = &(iovs[i]);
+						msgs[i].msg_hdr.msg_iovlen = 1;
+					}
+					if (i == 0) {
+						// the datagrams stay in the socket buffer (or are dropped by the kernel) until the caller backs off
+						if (pFlagError) {
+							*pFlagError = sl_true;
+						}
+						break;
+					}
+					int n = recvmmsg(fd, msgs, i, MSG_DONTWAIT, sl_null);
+					if (n <= 0) {
+						if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNREFUSED) {
+							if (pFlagError) {
+								*pFlagError = sl_true;
+							}
+						}
+						break;
+					}
+					for (int k = 0; k < n; k++) {
+						sl_size size = msgs[k].msg_len;
+						if (size > 0 && buffers[k]->claimBack(SLIB_STREAMER_PACKET_HEADROOM, size)) {
+							SocketAddress address;
+							address.setSystemSocketAddress(&(addrs[k]), msgs[k].msg_hdr.msg_namelen);
+							onPacket(PacketData(buffers[k], SLIB_STREAMER_PACKET_HEADROOM, size), address);
+							flagReceived = sl_true;
+							buffers[k].setNull();
+						}
+					}
+					if (!flagDrain || (sl_uint32)n < i) {
+						break;
+					}
+				}
+				return flagReceived;
+			}
+			
+			// returns sl_false when epoll is not available, and then the caller runs the portable loop
+			static sl_bool runBatch(const Ref<Socket>& socket, const WeakRef<_NetworkUdpSourceImpl>& wr)
+			{
+				int fd = (int)(socket->getHandle());
+				int epfd = epoll_create1(EPOLL_CLOEXEC);
+				if (epfd < 0) {
+					return sl_false;
+				}
+				epoll_event ev;
+				Base::zeroMemory(&ev, sizeof(ev));
+				ev.events = EPOLLIN;
+				ev.data.fd = fd;
+				if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+					::close(epfd);
+					return sl_false;
+				}
+				
+				Ref<PacketBuffer> buffers[SLIB_STREAMER_UDP_RECEIVE_BATCH_MAX];
+				
+				while (!Thread::isStoppingCurrent()) {
+					Ref<_NetworkUdpSourceImpl> object = wr;
+					if (object.isNull()) {
+						break;
+					}
+					sl_bool flagError = sl_false;
+					sl_bool flagReceived = object->receiveBatch(fd, buffers, sl_true, &flagError);
+					if (flagReceived) {
+						object->notify();
+					}
+					object.setNull();
+					if (flagError) {
+						// the socket is closed or broken, or the buffers are exhausted; avoids spinning on the readable socket
+						Thread::sleep(WAIT_TIMEOUT);
+						continue;
+					}
+					epoll_event events[1];
+					epoll_wait(epfd, events, 1, WAIT_TIMEOUT);
+				}
+				::close(epfd);
+				return sl_true;
+			}
+#endif
 		};
 		
 		Ref<NetworkUdpSource> NetworkUdpSource::create(const Ref<Socket>& _socket)
@@ -187,9 +971,8 @@ namespace slib
 			Ref<Socket> socket = _socket;
 			Ref<_NetworkUdpSourceImpl> ret = new _NetworkUdpSourceImpl();
 			if (ret.isNotNull()) {
+				// the receiving thread is started by getEvent() or setReadyListener(), unless a poller is attached
 				ret->setSocket(socket);
-				WeakRef<_NetworkUdpSourceImpl> wr = ret;
-				ret->m_thread = Thread::start(Function<void()>::bind(&_NetworkUdpSourceImpl::run, socket, wr));
 			}
 			return Ref<NetworkUdpSource>::from(ret);
 		}
@@ -0,0 +1,174 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#include "../../../inc/slibx/streamer/packet.h"
+
+#include <chrono>
+
+/*
+	Metadata wire encoding:
+	
+		[fields:1] [sequence] [stream id] [timestamp] [flags]
+	
+	`fields` has a bit for every field following it, and the fields are
+	written in LEB128 only when they are present.
+*/
+
+#define METADATA_SEQUENCE 0x01
+#define METADATA_STREAM_ID 0x02
+#define METADATA_TIMESTAMP 0x04
+#define METADATA_FLAGS 0x08
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		SLIB_INLINE static sl_size _Packet_getVarintSize(sl_uint64 value)
+		{
+			sl_size n = 1;
+			while (value >= 0x80) {
+				value >>= 7;
+				n++;
+			}
+			return n;
+		}
+		
+		SLIB_INLINE static sl_uint8* _Packet_writeVarint(sl_uint8* p, sl_uint64 value)
+		{
+			while (value >= 0x80) {
+				*(p++) = (sl_uint8)(value | 0x80);
+				value >>= 7;
+			}
+			*(p++) = (sl_uint8)value;
+			return p;
+		}
+		
+		static const sl_uint8* _Packet_readVarint(const sl_uint8* p, const sl_uint8* end, sl_uint64* value)
+		{
+			sl_uint64 v = 0;
+			sl_uint32 shift = 0;
+			while (p < end && shift < 64) {
+				sl_uint8 n = *(p++);
+				v |= ((sl_uint64)(n & 0x7F)) << shift;
+				if (!(n & 0x80)) {
+					*value = v;
+					return p;
+				}
+				shift += 7;
+			}
+			return sl_null;
+		}
+		
+		sl_int64 Packet::getCurrentTimestamp()
+		{
+			return (sl_int64)(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+		
+		sl_size Packet::getMetadataSize() const
+		{
+			sl_size size = 1;
+			if (flags & flagSequence) {
+				size += _Packet_getVarintSize(sequence);
+			}
+			if (streamId) {
+				size += _Packet_getVarintSize(streamId);
+			}
+			if (timestamp > 0) {
+				size += _Packet_getVarintSize((sl_uint64)timestamp);
+			}
+			sl_uint32 f = flags & ~((sl_uint32)(flagSequence | flagSenderTime));
+			if (f) {
+				size += _Packet_getVarintSize(f);
+			}
+			return size;
+		}
+		
+		sl_uint8* Packet::writeMetadata(sl_uint8* buf) const
+		{
+			sl_uint8* p = buf + 1;
+			sl_uint8 fields = 0;
+			if (flags & flagSequence) {
+				fields |= METADATA_SEQUENCE;
+				p = _Packet_writeVarint(p, sequence);
+			}
+			if (streamId) {
+				fields |= METADATA_STREAM_ID;
+				p = _Packet_writeVarint(p, streamId);
+			}
+			if (timestamp > 0) {
+				fields |= METADATA_TIMESTAMP;
+				p = _Packet_writeVarint(p, (sl_uint64)timestamp);
+			}
+			sl_uint32 f = flags & ~((sl_uint32)(flagSequence | flagSenderTime));
+			if (f) {
+				fields |= METADATA_FLAGS;
+				p = _Packet_writeVarint(p, f);
+			}
+			buf[0] = fields;
+			return p;
+		}
+		
+		const sl_uint8* Packet::readMetadata(const sl_uint8* buf, const sl_uint8* end)
+		{
+			if (buf >= end) {
+				return sl_null;
+			}
+			sl_uint8 fields = *buf;
+			if (fields & ~(METADATA_SEQUENCE | METADATA_STREAM_ID | METADATA_TIMESTAMP | METADATA_FLAGS)) {
+				return sl_null;
+			}
+			const sl_uint8* p = buf + 1;
+			sl_uint64 v;
+			sl_uint32 _flags = 0;
+			sl_uint64 _sequence = 0;
+			sl_uint32 _streamId = 0;
+			sl_int64 _timestamp = 0;
+			if (fields & METADATA_SEQUENCE) {
+				p = _Packet_readVarint(p, end, &v);
+				if (!p) {
+					return sl_null;
+				}
+				_sequence = v;
+				_flags |= flagSequence;
+			}
+			if (fields & METADATA_STREAM_ID) {
+				p = _Packet_readVarint(p, end, &v);
+				if (!p) {
+					return sl_null;
+				}
+				_streamId = (sl_uint32)v;
+			}
+			if (fields & METADATA_TIMESTAMP) {
+				p = _Packet_readVarint(p, end, &v);
+				if (!p) {
+					return sl_null;
+				}
+				_timestamp = (sl_int64)v;
+			}
+			if (fields & METADATA_FLAGS) {
+				p = _Packet_readVarint(p, end, &v);
+				if (!p) {
+					return sl_null;
+				}
+				_flags |= (sl_uint32)v & ~((sl_uint32)(flagSequence | flagSenderTime));
+			}
+			flags = _flags;
+			sequence = _sequence;
+			streamId = _streamId;
+			timestamp = _timestamp;
+			return p;
+		}
+		
+	}
+	
+}
@@ -0,0 +1,739 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#include "../../../inc/slibx/streamer/pcm.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STREAMER_PCM_X86_DISPATCH
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define STREAMER_PCM_NEON
+#include <arm_neon.h>
+#endif
+
+#define _PCM_MIX_BLOCK 256
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		SLIB_INLINE static sl_int16 _PcmKernels_saturate(sl_int32 v)
+		{
+			if (v > 32767) {
+				return 32767;
+			}
+			if (v < -32768) {
+				return -32768;
+			}
+			return (sl_int16)v;
+		}
+		
+		SLIB_INLINE static sl_int16 _PcmKernels_saturate(float v)
+		{
+			if (v >= 32767.0f) {
+				return 32767;
+			}
+			if (v <= -32768.0f) {
+				return -32768;
+			}
+			return (sl_int16)(v >= 0 ? v + 0.5f : v - 0.5f);
+		}
+		
+		struct _PcmKernels_Funcs
+		{
+			void (*applyGain)(sl_int16* samples, sl_size count, float gain);
+			void (*accumulate)(sl_int32* acc, const sl_int16* src, sl_size count);
+			void (*pack)(sl_int16* dst, const sl_int32* acc, sl_size count);
+			void (*packExcluding)(sl_int16* dst, const sl_int32* acc, const sl_int16* exclude, sl_size count);
+			void (*convertMonoToStereo)(sl_int16* dst, const sl_int16* src, sl_size nFrames);
+			void (*convertStereoToMono)(sl_int16* dst, const sl_int16* src, sl_size nFrames);
+			void (*convertInt16ToFloat)(float* dst, const sl_int16* src, sl_size count);
+			void (*convertFloatToInt16)(sl_int16* dst, const float* src, sl_size count);
+			float (*dotProduct)(const float* a, const float* b, sl_size count);
+			sl_uint64 (*getEnergy)(const sl_int16* samples, sl_size count, sl_size* pZeroCrossings);
+		};
+		
+		static void _PcmKernels_applyGain_Scalar(sl_int16* samples, sl_size count, float gain)
+		{
+			for (sl_size i = 0; i < count; i++) {
+				samples[i] = _PcmKernels_saturate(samples[i] * gain);
+			}
+		}
+		
+		static void _PcmKernels_accumulate_Scalar(sl_int32* acc, const sl_int16* src, sl_size count)
+		{
+			for (sl_size i = 0; i < count; i++) {
+				acc[i] += src[i];
+			}
+		}
+		
+		static void _PcmKernels_pack_Scalar(sl_int16* dst, const sl_int32* acc, sl_size count)
+		{
+			for (sl_size i = 0; i < count; i++) {
+				dst[i] = _PcmKernels_saturate(acc[i]);
+			}
+		}
+		
+		static void _PcmKernels_packExcluding_Scalar(sl_int16* dst, const sl_int32* acc, const sl_int16* exclude, sl_size count)
+		{
+			for (sl_size i = 0; i < count; i++) {
+				dst[i] = _PcmKernels_saturate(acc[i] - exclude[i]);
+			}
+		}
+		
+		static void _PcmKernels_convertMonoToStereo_Scalar(sl_int16* dst, const sl_int16* src, sl_size nFrames)
+		{
+			for (sl_size i = 0; i < nFrames; i++) {
+				sl_int16 s = src[i];
+				dst[i << 1] = s;
+				dst[(i << 1) + 1] = s;
+			}
+		}
+		
+		static void _PcmKernels_convertStereoToMono_Scalar(sl_int16* dst, const sl_int16* src, sl_size nFrames)
+		{
+			for (sl_size i = 0; i < nFrames; i++) {
+				dst[i] = (sl_int16)(((sl_int32)(src[i << 1]) + (sl_int32)(src[(i << 1) + 1])) >> 1);
+			}
+		}
+		
+		static void _PcmKernels_convertInt16ToFloat_Scalar(float* dst, const sl_int16* src, sl_size count)
+		{
+			for (sl_size i = 0; i < count; i++) {
+				dst[i] = src[i] * (1.0f / 32768.0f);
+			}
+		}
+		
+		static void _PcmKernels_convertFloatToInt16_Scalar(sl_int16* dst, const float* src, sl_size count)
+		{
+			for (sl_size i = 0; i < count; i++) {
+				dst[i] = _PcmKernels_saturate(src[i] * 32768.0f);
+			}
+		}
+		
+		static float _PcmKernels_dotProduct_Scalar(const float* a, const float* b, sl_size count)
+		{
+			float sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+			sl_size i = 0;
+			for (; i + 4 <= count; i += 4) {
+				sum0 += a[i] * b[i];
+				sum1 += a[i + 1] * b[i + 1];
+				sum2 += a[i + 2] * b[i + 2];
+				sum3 += a[i + 3] * b[i + 3];
+			}
+			for (; i < count; i++) {
+				sum0 += a[i] * b[i];
+			}
+			return (sum0 + sum1) + (sum2 + sum3);
+		}
+		
+		// the crossings are counted between samples[start - 1] and samples[start], ...
+		static sl_uint64 _PcmKernels_getEnergy_Scalar(const sl_int16* samples, sl_size start, sl_size count, sl_size& nCrossings)
+		{
+			sl_uint64 energy = 0;
+			sl_size n = 0;
+			for (sl_size i = start; i < count; i++) {
+				sl_int32 s = samples[i];
+				energy += (sl_uint64)(s * s);
+				if (i && ((samples[i - 1] ^ s) < 0)) {
+					n++;
+				}
+			}
+			nCrossings += n;
+			return energy;
+		}
+		
+		static sl_uint64 _PcmKernels_getEnergy_Scalar(const sl_int16* samples, sl_size count, sl_size* pZeroCrossings)
+		{
+			sl_size n = 0;
+			sl_uint64 energy = _PcmKernels_getEnergy_Scalar(samples, 0, count, n);
+			if (pZeroCrossings) {
+				*pZeroCrossings = n;
+			}
+			return energy;
+		}
+		
+#if defined(STREAMER_PCM_X86_DISPATCH)
+		__attribute__((target("sse2")))
+		SLIB_INLINE static __m128i _PcmKernels_unpackLow_SSE2(__m128i x)
+		{
+			return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		}
+		
+		__attribute__((target("sse2")))
+		SLIB_INLINE static __m128i _PcmKernels_unpackHigh_SSE2(__m128i x)
+		{
+			return _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		}
+		
+		__attribute__((target("sse2")))
+		static void _PcmKernels_applyGain_SSE2(sl_int16* samples, sl_size count, float gain)
+		{
+			__m128 g = _mm_set1_ps(gain);
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				__m128i x = _mm_loadu_si128((const __m128i*)(samples + i));
+				__m128i l = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_PcmKernels_unpackLow_SSE2(x)), g));
+				__m128i h = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_PcmKernels_unpackHigh_SSE2(x)), g));
+				_mm_storeu_si128((__m128i*)(samples + i), _mm_packs_epi32(l, h));
+			}
+			_PcmKernels_applyGain_Scalar(samples + i, count - i, gain);
+		}
+		
+		__attribute__((target("sse2")))
+		static void _PcmKernels_accumulate_SSE2(sl_int32* acc, const sl_int16* src, sl_size count)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				__m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+				_mm_storeu_si128((__m128i*)(acc + i), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc + i)), _PcmKernels_unpackLow_SSE2(x)));
+				_mm_storeu_si128((__m128i*)(acc + i + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc + i + 4)), _PcmKernels_unpackHigh_SSE2(x)));
+			}
+			_PcmKernels_accumulate_Scalar(acc + i, src + i, count - i);
+		}
+		
+		__attribute__((target("sse2")))
+		static void _PcmKernels_pack_SSE2(sl_int16* dst, const sl_int32* acc, sl_size count)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				__m128i l = _mm_loadu_si128((const __m128i*)(acc + i));
+				__m128i h = _mm_loadu_si128((const __m128i*)(acc + i + 4));
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(l, h));
+			}
+			_PcmKernels_pack_Scalar(dst + i, acc + i, count - i);
+		}
+		
+		__attribute__((target("sse2")))
+		static void _PcmKernels_packExcluding_SSE2(sl_int16* dst, const sl_int32* acc, const sl_int16* exclude, sl_size count)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				__m128i x = _mm_loadu_si128((const __m128i*)(exclude + i));
+				__m128i l = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(acc + i)), _PcmKernels_unpackLow_SSE2(x));
+				__m128i h = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(acc + i + 4)), _PcmKernels_unpackHigh_SSE2(x));
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(l, h));
+			}
+			_PcmKernels_packExcluding_Scalar(dst + i, acc + i, exclude + i, count - i);
+		}
+		
+		__attribute__((target("sse2")))
+		static void _PcmKernels_convertMonoToStereo_SSE2(sl_int16* dst, const sl_int16* src, sl_size nFrames)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= nFrames; i += 8) {
+				__m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+				_mm_storeu_si128((__m128i*)(dst + (i << 1)), _mm_unpacklo_epi16(x, x));
+				_mm_storeu_si128((__m128i*)(dst + (i << 1) + 8), _mm_unpackhi_epi16(x, x));
+			}
+			_PcmKernels_convertMonoToStereo_Scalar(dst + (i << 1), src + i, nFrames - i);
+		}
+		
+		__attribute__((target("sse2")))
+		static void _PcmKernels_convertStereoToMono_SSE2(sl_int16* dst, const sl_int16* src, sl_size nFrames)
+		{
+			__m128i one = _mm_set1_epi16(1);
+			sl_size i = 0;
+			for (; i + 8 <= nFrames; i += 8) {
+				// left + right of every frame in 32 bits
+				__m128i l = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(src + (i << 1))), one), 1);
+				__m128i h = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(src + (i << 1) + 8)), one), 1);
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(l, h));
+			}
+			_PcmKernels_convertStereoToMono_Scalar(dst + i, src + (i << 1), nFrames - i);
+		}
+		
+		__attribute__((target("sse2")))
+		static void _PcmKernels_convertInt16ToFloat_SSE2(float* dst, const sl_int16* src, sl_size count)
+		{
+			__m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				__m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+				_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_PcmKernels_unpackLow_SSE2(x)), scale));
+				_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_PcmKernels_unpackHigh_SSE2(x)), scale));
+			}
+			_PcmKernels_convertInt16ToFloat_Scalar(dst + i, src + i, count - i);
+		}
+		
+		__attribute__((target("sse2")))
+		static void _PcmKernels_convertFloatToInt16_SSE2(sl_int16* dst, const float* src, sl_size count)
+		{
+			__m128 scale = _mm_set1_ps(32768.0f);
+			// clamped before the conversion, which overflows to INT_MIN
+			__m128 vmin = _mm_set1_ps(-32768.0f);
+			__m128 vmax = _mm_set1_ps(32767.0f);
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				__m128 l = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), vmin), vmax);
+				__m128 h = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), vmin), vmax);
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(_mm_cvtps_epi32(l), _mm_cvtps_epi32(h)));
+			}
+			_PcmKernels_convertFloatToInt16_Scalar(dst + i, src + i, count - i);
+		}
+		
+		__attribute__((target("sse2")))
+		static float _PcmKernels_dotProduct_SSE2(const float* a, const float* b, sl_size count)
+		{
+			__m128 sum0 = _mm_setzero_ps();
+			__m128 sum1 = _mm_setzero_ps();
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+				sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+			}
+			float t[4];
+			_mm_storeu_ps(t, _mm_add_ps(sum0, sum1));
+			return (t[0] + t[1]) + (t[2] + t[3]) + _PcmKernels_dotProduct_Scalar(a + i, b + i, count - i);
+		}
+		
+		__attribute__((target("sse2")))
+		static sl_uint64 _PcmKernels_getEnergy_SSE2(const sl_int16* samples, sl_size count, sl_size* pZeroCrossings)
+		{
+			__m128i zero = _mm_setzero_si128();
+			__m128i one = _mm_set1_epi16(1);
+			__m128i energy = zero;
+			__m128i crossings = zero;
+			// the first sample has no neighbor
+			sl_size i = 1;
+			for (; i + 8 <= count; i += 8) {
+				__m128i x = _mm_loadu_si128((const __m128i*)(samples + i));
+				__m128i p = _mm_loadu_si128((const __m128i*)(samples + i - 1));
+				// a pair of the squares fits in 32 bits only as unsigned (2 * 32768^2 = 2^31)
+				__m128i sq = _mm_madd_epi16(x, x);
+				energy = _mm_add_epi64(energy, _mm_add_epi64(_mm_unpacklo_epi32(sq, zero), _mm_unpackhi_epi32(sq, zero)));
+				// -1 at the sign changes
+				__m128i c = _mm_srai_epi16(_mm_xor_si128(x, p), 15);
+				crossings = _mm_sub_epi32(crossings, _mm_madd_epi16(c, one));
+			}
+			sl_uint64 e[2];
+			_mm_storeu_si128((__m128i*)e, energy);
+			sl_uint32 c[4];
+			_mm_storeu_si128((__m128i*)c, crossings);
+			sl_size n = (sl_size)(c[0]) + c[1] + c[2] + c[3];
+			sl_uint64 sum = e[0] + e[1];
+			if (count) {
+				sum += _PcmKernels_getEnergy_Scalar(samples, 0, 1, n);
+				sum += _PcmKernels_getEnergy_Scalar(samples, i, count, n);
+			}
+			if (pZeroCrossings) {
+				*pZeroCrossings = n;
+			}
+			return sum;
+		}
+		
+		// packs 16 lanes of 32 bits into 16 saturated samples in order
+		__attribute__((target("avx2")))
+		SLIB_INLINE static __m256i _PcmKernels_pack_AVX2(__m256i l, __m256i h)
+		{
+			return _mm256_permute4x64_epi64(_mm256_packs_epi32(l, h), 0xD8);
+		}
+		
+		__attribute__((target("avx2")))
+		static void _PcmKernels_applyGain_AVX2(sl_int16* samples, sl_size count, float gain)
+		{
+			__m256 g = _mm256_set1_ps(gain);
+			sl_size i = 0;
+			for (; i + 16 <= count; i += 16) {
+				__m256i l = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(samples + i)));
+				__m256i h = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(samples + i + 8)));
+				l = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(l), g));
+				h = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(h), g));
+				_mm256_storeu_si256((__m256i*)(samples + i), _PcmKernels_pack_AVX2(l, h));
+			}
+			_PcmKernels_applyGain_SSE2(samples + i, count - i, gain);
+		}
+		
+		__attribute__((target("avx2")))
+		static void _PcmKernels_accumulate_AVX2(sl_int32* acc, const sl_int16* src, sl_size count)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				__m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+				_mm256_storeu_si256((__m256i*)(acc + i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(acc + i)), x));
+			}
+			_PcmKernels_accumulate_Scalar(acc + i, src + i, count - i);
+		}
+		
+		__attribute__((target("avx2")))
+		static void _PcmKernels_pack_AVX2(sl_int16* dst, const sl_int32* acc, sl_size count)
+		{
+			sl_size i = 0;
+			for (; i + 16 <= count; i += 16) {
+				__m256i l = _mm256_loadu_si256((const __m256i*)(acc + i));
+				__m256i h = _mm256_loadu_si256((const __m256i*)(acc + i + 8));
+				_mm256_storeu_si256((__m256i*)(dst + i), _PcmKernels_pack_AVX2(l, h));
+			}
+			_PcmKernels_pack_SSE2(dst + i, acc + i, count - i);
+		}
+		
+		__attribute__((target("avx2")))
+		static void _PcmKernels_packExcluding_AVX2(sl_int16* dst, const sl_int32* acc, const sl_int16* exclude, sl_size count)
+		{
+			sl_size i = 0;
+			for (; i + 16 <= count; i += 16) {
+				__m256i l = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(exclude + i)));
+				__m256i h = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(exclude + i + 8)));
+				l = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(acc + i)), l);
+				h = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(acc + i + 8)), h);
+				_mm256_storeu_si256((__m256i*)(dst + i), _PcmKernels_pack_AVX2(l, h));
+			}
+			_PcmKernels_packExcluding_SSE2(dst + i, acc + i, exclude + i, count - i);
+		}
+		
+		__attribute__((target("avx2")))
+		static void _PcmKernels_convertInt16ToFloat_AVX2(float* dst, const sl_int16* src, sl_size count)
+		{
+			__m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				__m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+				_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+			}
+			_PcmKernels_convertInt16ToFloat_Scalar(dst + i, src + i, count - i);
+		}
+		
+		__attribute__((target("avx2")))
+		static void _PcmKernels_convertFloatToInt16_AVX2(sl_int16* dst, const float* src, sl_size count)
+		{
+			__m256 scale = _mm256_set1_ps(32768.0f);
+			__m256 vmin = _mm256_set1_ps(-32768.0f);
+			__m256 vmax = _mm256_set1_ps(32767.0f);
+			sl_size i = 0;
+			for (; i + 16 <= count; i += 16) {
+				__m256 l = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), vmin), vmax);
+				__m256 h = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), vmin), vmax);
+				_mm256_storeu_si256((__m256i*)(dst + i), _PcmKernels_pack_AVX2(_mm256_cvtps_epi32(l), _mm256_cvtps_epi32(h)));
+			}
+			_PcmKernels_convertFloatToInt16_SSE2(dst + i, src + i, count - i);
+		}
+		
+		__attribute__((target("avx2")))
+		static float _PcmKernels_dotProduct_AVX2(const float* a, const float* b, sl_size count)
+		{
+			__m256 sum0 = _mm256_setzero_ps();
+			__m256 sum1 = _mm256_setzero_ps();
+			sl_size i = 0;
+			for (; i + 16 <= count; i += 16) {
+				sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+				sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+			}
+			__m256 sum = _mm256_add_ps(sum0, sum1);
+			__m128 s = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+			float t[4];
+			_mm_storeu_ps(t, s);
+			return (t[0] + t[1]) + (t[2] + t[3]) + _PcmKernels_dotProduct_SSE2(a + i, b + i, count - i);
+		}
+		
+		__attribute__((target("avx2")))
+		static sl_uint64 _PcmKernels_getEnergy_AVX2(const sl_int16* samples, sl_size count, sl_size* pZeroCrossings)
+		{
+			__m256i zero = _mm256_setzero_si256();
+			__m256i one = _mm256_set1_epi16(1);
+			__m256i energy = zero;
+			__m256i crossings = zero;
+			sl_size i = 1;
+			for (; i + 16 <= count; i += 16) {
+				__m256i x = _mm256_loadu_si256((const __m256i*)(samples + i));
+				__m256i p = _mm256_loadu_si256((const __m256i*)(samples + i - 1));
+				__m256i sq = _mm256_madd_epi16(x, x);
+				energy = _mm256_add_epi64(energy, _mm256_add_epi64(_mm256_unpacklo_epi32(sq, zero), _mm256_unpackhi_epi32(sq, zero)));
+				__m256i c = _mm256_srai_epi16(_mm256_xor_si256(x, p), 15);
+				crossings = _mm256_sub_epi32(crossings, _mm256_madd_epi16(c, one));
+			}
+			sl_uint64 e[4];
+			_mm256_storeu_si256((__m256i*)e, energy);
+			sl_uint32 c[8];
+			_mm256_storeu_si256((__m256i*)c, crossings);
+			sl_size n = 0;
+			for (sl_uint32 k = 0; k < 8; k++) {
+				n += c[k];
+			}
+			sl_uint64 sum = (e[0] + e[1]) + (e[2] + e[3]);
+			if (count) {
+				sum += _PcmKernels_getEnergy_Scalar(samples, 0, 1, n);
+				sum += _PcmKernels_getEnergy_Scalar(samples, i, count, n);
+			}
+			if (pZeroCrossings) {
+				*pZeroCrossings = n;
+			}
+			return sum;
+		}
+#endif
+		
+#if defined(STREAMER_PCM_NEON)
+		static void _PcmKernels_applyGain_NEON(sl_int16* samples, sl_size count, float gain)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				int16x8_t x = vld1q_s16(samples + i);
+				int32x4_t l = vcvtnq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), gain));
+				int32x4_t h = vcvtnq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(vmovl_high_s16(x)), gain));
+				vst1q_s16(samples + i, vcombine_s16(vqmovn_s32(l), vqmovn_s32(h)));
+			}
+			_PcmKernels_applyGain_Scalar(samples + i, count - i, gain);
+		}
+		
+		static void _PcmKernels_accumulate_NEON(sl_int32* acc, const sl_int16* src, sl_size count)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				int16x8_t x = vld1q_s16(src + i);
+				vst1q_s32(acc + i, vaddw_s16(vld1q_s32(acc + i), vget_low_s16(x)));
+				vst1q_s32(acc + i + 4, vaddw_high_s16(vld1q_s32(acc + i + 4), x));
+			}
+			_PcmKernels_accumulate_Scalar(acc + i, src + i, count - i);
+		}
+		
+		static void _PcmKernels_pack_NEON(sl_int16* dst, const sl_int32* acc, sl_size count)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(vld1q_s32(acc + i)), vqmovn_s32(vld1q_s32(acc + i + 4))));
+			}
+			_PcmKernels_pack_Scalar(dst + i, acc + i, count - i);
+		}
+		
+		static void _PcmKernels_packExcluding_NEON(sl_int16* dst, const sl_int32* acc, const sl_int16* exclude, sl_size count)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				int16x8_t x = vld1q_s16(exclude + i);
+				int32x4_t l = vsubw_s16(vld1q_s32(acc + i), vget_low_s16(x));
+				int32x4_t h = vsubw_high_s16(vld1q_s32(acc + i + 4), x);
+				vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(l), vqmovn_s32(h)));
+			}
+			_PcmKernels_packExcluding_Scalar(dst + i, acc + i, exclude + i, count - i);
+		}
+		
+		static void _PcmKernels_convertMonoToStereo_NEON(sl_int16* dst, const sl_int16* src, sl_size nFrames)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= nFrames; i += 8) {
+				int16x8x2_t x;
+				x.val[0] = x.val[1] = vld1q_s16(src + i);
+				vst2q_s16(dst + (i << 1), x);
+			}
+			_PcmKernels_convertMonoToStereo_Scalar(dst + (i << 1), src + i, nFrames - i);
+		}
+		
+		static void _PcmKernels_convertStereoToMono_NEON(sl_int16* dst, const sl_int16* src, sl_size nFrames)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= nFrames; i += 8) {
+				int16x8x2_t x = vld2q_s16(src + (i << 1));
+				vst1q_s16(dst + i, vhaddq_s16(x.val[0], x.val[1]));
+			}
+			_PcmKernels_convertStereoToMono_Scalar(dst + i, src + (i << 1), nFrames - i);
+		}
+		
+		static void _PcmKernels_convertInt16ToFloat_NEON(float* dst, const sl_int16* src, sl_size count)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				int16x8_t x = vld1q_s16(src + i);
+				vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), 1.0f / 32768.0f));
+				vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_high_s16(x)), 1.0f / 32768.0f));
+			}
+			_PcmKernels_convertInt16ToFloat_Scalar(dst + i, src + i, count - i);
+		}
+		
+		static void _PcmKernels_convertFloatToInt16_NEON(sl_int16* dst, const float* src, sl_size count)
+		{
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				// the conversion saturates to 32 bits, and the narrowing to 16 bits
+				int32x4_t l = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i), 32768.0f));
+				int32x4_t h = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i + 4), 32768.0f));
+				vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(l), vqmovn_s32(h)));
+			}
+			_PcmKernels_convertFloatToInt16_Scalar(dst + i, src + i, count - i);
+		}
+		
+		static float _PcmKernels_dotProduct_NEON(const float* a, const float* b, sl_size count)
+		{
+			float32x4_t sum0 = vdupq_n_f32(0);
+			float32x4_t sum1 = vdupq_n_f32(0);
+			sl_size i = 0;
+			for (; i + 8 <= count; i += 8) {
+				sum0 = vfmaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+				sum1 = vfmaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+			}
+			return vaddvq_f32(vaddq_f32(sum0, sum1)) + _PcmKernels_dotProduct_Scalar(a + i, b + i, count - i);
+		}
+		
+		static sl_uint64 _PcmKernels_getEnergy_NEON(const sl_int16* samples, sl_size count, sl_size* pZeroCrossings)
+		{
+			uint64x2_t energy = vdupq_n_u64(0);
+			int32x4_t crossings = vdupq_n_s32(0);
+			sl_size i = 1;
+			for (; i + 8 <= count; i += 8) {
+				int16x8_t x = vld1q_s16(samples + i);
+				int16x8_t p = vld1q_s16(samples + i - 1);
+				// a square fits in 31 bits
+				uint32x4_t l = vreinterpretq_u32_s32(vmull_s16(vget_low_s16(x), vget_low_s16(x)));
+				uint32x4_t h = vreinterpretq_u32_s32(vmull_high_s16(x, x));
+				energy = vpadalq_u32(vpadalq_u32(energy, l), h);
+				crossings = vpadalq_s16(crossings, vshrq_n_s16(veorq_s16(x, p), 15));
+			}
+			sl_size n = (sl_size)(-vaddvq_s32(crossings));
+			sl_uint64 sum = vaddvq_u64(energy);
+			if (count) {
+				sum += _PcmKernels_getEnergy_Scalar(samples, 0, 1, n);
+				sum += _PcmKernels_getEnergy_Scalar(samples, i, count, n);
+			}
+			if (pZeroCrossings) {
+				*pZeroCrossings = n;
+			}
+			return sum;
+		}
+#endif
+		
+		static _PcmKernels_Funcs _PcmKernels_selectFuncs()
+		{
+			_PcmKernels_Funcs funcs;
+			funcs.applyGain = _PcmKernels_applyGain_Scalar;
+			funcs.accumulate = _PcmKernels_accumulate_Scalar;
+			funcs.pack = _PcmKernels_pack_Scalar;
+			funcs.packExcluding = _PcmKernels_packExcluding_Scalar;
+			funcs.convertMonoToStereo = _PcmKernels_convertMonoToStereo_Scalar;
+			funcs.convertStereoToMono = _PcmKernels_convertStereoToMono_Scalar;
+			funcs.convertInt16ToFloat = _PcmKernels_convertInt16ToFloat_Scalar;
+			funcs.convertFloatToInt16 = _PcmKernels_convertFloatToInt16_Scalar;
+			funcs.dotProduct = _PcmKernels_dotProduct_Scalar;
+			funcs.getEnergy = _PcmKernels_getEnergy_Scalar;
+#if defined(STREAMER_PCM_X86_DISPATCH)
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("sse2")) {
+				funcs.applyGain = _PcmKernels_applyGain_SSE2;
+				funcs.accumulate = _PcmKernels_accumulate_SSE2;
+				funcs.pack = _PcmKernels_pack_SSE2;
+				funcs.packExcluding = _PcmKernels_packExcluding_SSE2;
+				funcs.convertMonoToStereo = _PcmKernels_convertMonoToStereo_SSE2;
+				funcs.convertStereoToMono = _PcmKernels_convertStereoToMono_SSE2;
+				funcs.convertInt16ToFloat = _PcmKernels_convertInt16ToFloat_SSE2;
+				funcs.convertFloatToInt16 = _PcmKernels_convertFloatToInt16_SSE2;
+				funcs.dotProduct = _PcmKernels_dotProduct_SSE2;
+				funcs.getEnergy = _PcmKernels_getEnergy_SSE2;
+				// the channel conversions are bound by the memory, and stay on SSE2
+				if (__builtin_cpu_supports("avx2")) {
+					funcs.applyGain = _PcmKernels_applyGain_AVX2;
+					funcs.accumulate = _PcmKernels_accumulate_AVX2;
+					funcs.pack = _PcmKernels_pack_AVX2;
+					funcs.packExcluding = _PcmKernels_packExcluding_AVX2;
+					funcs.convertInt16ToFloat = _PcmKernels_convertInt16ToFloat_AVX2;
+					funcs.convertFloatToInt16 = _PcmKernels_convertFloatToInt16_AVX2;
+					funcs.dotProduct = _PcmKernels_dotProduct_AVX2;
+					funcs.getEnergy = _PcmKernels_getEnergy_AVX2;
+				}
+			}
+#elif defined(STREAMER_PCM_NEON)
+			funcs.applyGain = _PcmKernels_applyGain_NEON;
+			funcs.accumulate = _PcmKernels_accumulate_NEON;
+			funcs.pack = _PcmKernels_pack_NEON;
+			funcs.packExcluding = _PcmKernels_packExcluding_NEON;
+			funcs.convertMonoToStereo = _PcmKernels_convertMonoToStereo_NEON;
+			funcs.convertStereoToMono = _PcmKernels_convertStereoToMono_NEON;
+			funcs.convertInt16ToFloat = _PcmKernels_convertInt16ToFloat_NEON;
+			funcs.convertFloatToInt16 = _PcmKernels_convertFloatToInt16_NEON;
+			funcs.dotProduct = _PcmKernels_dotProduct_NEON;
+			funcs.getEnergy = _PcmKernels_getEnergy_NEON;
+#endif
+			return funcs;
+		}
+		
+		static const _PcmKernels_Funcs& _PcmKernels_getFuncs()
+		{
+			static _PcmKernels_Funcs funcs = _PcmKernels_selectFuncs();
+			return funcs;
+		}
+		
+		void PcmKernels::applyGain(sl_int16* samples, sl_size count, float gain)
+		{
+			if (gain == 1.0f) {
+				return;
+			}
+			// keeps the products in 32 bits
+			if (gain > 32768.0f) {
+				gain = 32768.0f;
+			} else if (gain < -32768.0f) {
+				gain = -32768.0f;
+			}
+			_PcmKernels_getFuncs().applyGain(samples, count, gain);
+		}
+		
+		void PcmKernels::mix(sl_int16* dst, const sl_int16* const* sources, sl_uint32 nSources, sl_size count)
+		{
+			const _PcmKernels_Funcs& funcs = _PcmKernels_getFuncs();
+			sl_int32 acc[_PCM_MIX_BLOCK];
+			for (sl_size offset = 0; offset < count; offset += _PCM_MIX_BLOCK) {
+				sl_size n = count - offset;
+				if (n > _PCM_MIX_BLOCK) {
+					n = _PCM_MIX_BLOCK;
+				}
+				Base::zeroMemory(acc, n * sizeof(sl_int32));
+				for (sl_uint32 k = 0; k < nSources; k++) {
+					funcs.accumulate(acc, sources[k] + offset, n);
+				}
+				funcs.pack(dst + offset, acc, n);
+			}
+		}
+		
+		void PcmKernels::accumulate(sl_int32* acc, const sl_int16* src, sl_size count)
+		{
+			_PcmKernels_getFuncs().accumulate(acc, src, count);
+		}
+		
+		void PcmKernels::pack(sl_int16* dst, const sl_int32* acc, sl_size count)
+		{
+			_PcmKernels_getFuncs().pack(dst, acc, count);
+		}
+		
+		void PcmKernels::packExcluding(sl_int16* dst, const sl_int32* acc, const sl_int16* exclude, sl_size count)
+		{
+			_PcmKernels_getFuncs().packExcluding(dst, acc, exclude, count);
+		}
+		
+		void PcmKernels::convertMonoToStereo(sl_int16* dst, const sl_int16* src, sl_size nFrames)
+		{
+			_PcmKernels_getFuncs().convertMonoToStereo(dst, src, nFrames);
+		}
+		
+		void PcmKernels::convertStereoToMono(sl_int16* dst, const sl_int16* src, sl_size nFrames)
+		{
+			_PcmKernels_getFuncs().convertStereoToMono(dst, src, nFrames);
+		}
+		
+		void PcmKernels::convertInt16ToFloat(float* dst, const sl_int16* src, sl_size count)
+		{
+			_PcmKernels_getFuncs().convertInt16ToFloat(dst, src, count);
+		}
+		
+		void PcmKernels::convertFloatToInt16(sl_int16* dst, const float* src, sl_size count)
+		{
+			_PcmKernels_getFuncs().convertFloatToInt16(dst, src, count);
+		}
+		
+		float PcmKernels::dotProduct(const float* a, const float* b, sl_size count)
+		{
+			return _PcmKernels_getFuncs().dotProduct(a, b, count);
+		}
+		
+		sl_uint64 PcmKernels::getEnergy(const sl_int16* samples, sl_size count, sl_size* pZeroCrossings)
+		{
+			return _PcmKernels_getFuncs().getEnergy(samples, count, pZeroCrossings);
+		}
+		
+	}
+	
+}
@@ -0,0 +1,202 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "../../../inc/slibx/streamer/queue.h"
+
+namespace slib
+{
+
+	namespace streamer
+	{
+
+		SLIB_DEFINE_OBJECT(PacketQueue, Object)
+
+		PacketQueue::PacketQueue()
+		{
+			m_cells = sl_null;
+			m_mask = 0;
+			m_policy = overflowBlock;
+			m_posEnqueue = 0;
+			m_posDequeue = 0;
+			m_countDropped = 0;
+			m_flagClosed = 0;
+			m_flagWaitingConsumer = 0;
+			m_flagWaitingProducer = 0;
+		}
+
+		PacketQueue::~PacketQueue()
+		{
+			if (m_cells) {
+				delete[] m_cells;
+			}
+		}
+
+		Ref<PacketQueue> PacketQueue::create(sl_uint32 capacity, OverflowPolicy policy)
+		{
+			sl_uint32 n = 2;
+			while (n < capacity && n < 0x40000000) {
+				n <<= 1;
+			}
+			Ref<Event> eventNotEmpty = Event::create();
+			Ref<Event> eventNotFull = Event::create();
+			if (eventNotEmpty.isNull() || eventNotFull.isNull()) {
+				return sl_null;
+			}
+			Ref<PacketQueue> ret = new PacketQueue;
+			if (ret.isNotNull()) {
+				Cell* cells = new Cell[n];
+				if (cells) {
+					for (sl_uint32 i = 0; i < n; i++) {
+						cells[i].sequence = i;
+					}
+					ret->m_cells = cells;
+					ret->m_mask = n - 1;
+					ret->m_policy = policy;
+					ret->m_eventNotEmpty = eventNotEmpty;
+					ret->m_eventNotFull = eventNotFull;
+					return ret;
+				}
+			}
+			return sl_null;
+		}
+
+		sl_bool PacketQueue::_tryPush(const Packet& packet)
+		{
+			sl_reg pos = m_posEnqueue;
+			Cell& cell = m_cells[pos & m_mask];
+			sl_reg seq = Base::interlockedAdd(&(cell.sequence), 0);
+			if (seq != pos) {
+				return sl_false;
+			}
+			cell.packet = packet;
+			Base::interlockedIncrement(&m_posEnqueue);
+			// publishes the slot to the consumer
+			Base::interlockedIncrement(&(cell.sequence));
+			return sl_true;
+		}
+
+		sl_bool PacketQueue::_tryPop(Packet* out)
+		{
+			// the producer also pops here when dropping the oldest packet, so the position is claimed by CAS
+			sl_reg pos = Base::interlockedAdd(&m_posDequeue, 0);
+			for (;;) {
+				Cell& cell = m_cells[pos & m_mask];
+				sl_reg seq = Base::interlockedAdd(&(cell.sequence), 0);
+				sl_reg dif = seq - (pos + 1);
+				if (dif == 0) {
+					if (Base::interlockedCompareExchange(&m_posDequeue, pos + 1, pos)) {
+						if (out) {
+							*out = cell.packet;
+						}
+						cell.packet = Packet();
+						// returns the slot to the producer
+						Base::interlockedAdd(&(cell.sequence), m_mask);
+						return sl_true;
+					}
+					pos = Base::interlockedAdd(&m_posDequeue, 0);
+				} else if (dif < 0) {
+					return sl_false;
+				} else {
+					pos = Base::interlockedAdd(&m_posDequeue, 0);
+				}
+			}
+		}
+
+		sl_bool PacketQueue::push(const Packet& packet)
+		{
+			for (;;) {
+				if (m_flagClosed) {
+					return sl_false;
+				}
+				if (_tryPush(packet)) {
+					if (Base::interlockedCompareExchange32(&m_flagWaitingConsumer, 0, 1)) {
+						m_eventNotEmpty->set();
+					}
+					return sl_true;
+				}
+				if (m_policy == overflowDropNewest) {
+					Base::interlockedIncrement64(&m_countDropped);
+					return sl_false;
+				} else if (m_policy == overflowDropOldest) {
+					if (_tryPop(sl_null)) {
+						Base::interlockedIncrement64(&m_countDropped);
+					}
+				} else {
+					// the consumer may be stopped before the queue is closed
+					if (Thread::isStoppingCurrent()) {
+						return sl_false;
+					}
+					Base::interlockedCompareExchange32(&m_flagWaitingProducer, 1, 0);
+					if (getCount() > m_mask) {
+						m_eventNotFull->wait(10);
+					}
+				}
+			}
+		}
+
+		sl_bool PacketQueue::pop(Packet* out)
+		{
+			if (_tryPop(out)) {
+				if (Base::interlockedCompareExchange32(&m_flagWaitingProducer, 0, 1)) {
+					m_eventNotFull->set();
+				}
+				return sl_true;
+			}
+			return sl_false;
+		}
+
+		sl_bool PacketQueue::waitPacket(sl_int32 timeout)
+		{
+			if (getCount() > 0) {
+				return sl_true;
+			}
+			if (m_flagClosed) {
+				return sl_false;
+			}
+			Base::interlockedCompareExchange32(&m_flagWaitingConsumer, 1, 0);
+			if (getCount() > 0) {
+				Base::interlockedCompareExchange32(&m_flagWaitingConsumer, 0, 1);
+				return sl_true;
+			}
+			m_eventNotEmpty->wait(timeout);
+			return getCount() > 0;
+		}
+
+		void PacketQueue::close()
+		{
+			Base::interlockedCompareExchange32(&m_flagClosed, 1, 0);
+			m_eventNotEmpty->set();
+			m_eventNotFull->set();
+		}
+
+		sl_bool PacketQueue::isClosed()
+		{
+			return m_flagClosed != 0;
+		}
+
+		sl_uint32 PacketQueue::getCount()
+		{
+			sl_reg posDequeue = Base::interlockedAdd(&m_posDequeue, 0);
+			sl_reg posEnqueue = Base::interlockedAdd(&m_posEnqueue, 0);
+			sl_reg n = posEnqueue - posDequeue;
+			if (n < 0) {
+				return 0;
+			}
+			return (sl_uint32)n;
+		}
+
+		sl_uint64 PacketQueue::getDroppedCount()
+		{
+			return (sl_uint64)(Base::interlockedAdd64(&m_countDropped, 0));
+		}
+
+	}
+
+}
@@ -0,0 +1,412 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#include "../../../inc/slibx/streamer/resampler.h"
+
+#include "../../../inc/slibx/streamer/pcm.h"
+
+#include <slib/core/spin_lock.h>
+
+#include <math.h>
+
+#define _RESAMPLER_MAX_PHASES 4096
+#define _RESAMPLER_KAISER_BETA 8.0
+#define _RESAMPLER_ROLLOFF 0.92
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class _AudioResamplerTable : public Referable
+		{
+		public:
+			sl_uint32 L; // interpolation
+			sl_uint32 M; // decimation
+			sl_uint32 nTapsRequested;
+			sl_uint32 nTaps; // per phase
+			// L phases of `nTaps` coefficients, reversed to be applied to the input window in order
+			float* coefficients;
+			
+		public:
+			_AudioResamplerTable()
+			{
+				coefficients = sl_null;
+			}
+			
+			~_AudioResamplerTable()
+			{
+				if (coefficients) {
+					delete[] coefficients;
+				}
+			}
+			
+		};
+		
+		static double _AudioResampler_besselI0(double x)
+		{
+			double sum = 1;
+			double term = 1;
+			double q = x * x / 4;
+			for (sl_uint32 k = 1; k < 50; k++) {
+				term *= q / ((double)k * (double)k);
+				sum += term;
+				if (term < sum * 1e-12) {
+					break;
+				}
+			}
+			return sum;
+		}
+		
+		static Ref<_AudioResamplerTable> _AudioResampler_createTable(sl_uint32 L, sl_uint32 M, sl_uint32 nTapsRequested)
+		{
+			sl_uint32 nTaps = nTapsRequested;
+			if (M > L) {
+				// the transition band becomes narrower when decimating
+				nTaps = (sl_uint32)(((sl_uint64)nTapsRequested * M + L - 1) / L);
+			}
+			Ref<_AudioResamplerTable> table = new _AudioResamplerTable;
+			if (table.isNull()) {
+				return sl_null;
+			}
+			table->coefficients = new float[(sl_size)L * nTaps];
+			if (!(table->coefficients)) {
+				return sl_null;
+			}
+			table->L = L;
+			table->M = M;
+			table->nTapsRequested = nTapsRequested;
+			table->nTaps = nTaps;
+			
+			// prototype low-pass filter at the interpolated rate (L * input rate)
+			sl_uint32 length = L * nTaps;
+			double cutoff = 0.5 / (L > M ? L : M) * _RESAMPLER_ROLLOFF;
+			double center = (length - 1) / 2.0;
+			double i0Beta = _AudioResampler_besselI0(_RESAMPLER_KAISER_BETA);
+			for (sl_uint32 p = 0; p < L; p++) {
+				float* c = table->coefficients + (sl_size)p * nTaps;
+				double sum = 0;
+				for (sl_uint32 k = 0; k < nTaps; k++) {
+					double t = (double)(p + k * L) - center;
+					double x = 2 * cutoff * t;
+					double sinc = x == 0 ? 1 : sin(3.14159265358979323846 * x) / (3.14159265358979323846 * x);
+					double r = length > 1 ? 2 * t / (length - 1) : 0;
+					double w = 1 - r * r;
+					w = w > 0 ? _AudioResampler_besselI0(_RESAMPLER_KAISER_BETA * sqrt(w)) / i0Beta : 0;
+					double h = sinc * w;
+					c[nTaps - 1 - k] = (float)h;
+					sum += h;
+				}
+				// unity gain at DC for every phase
+				if (sum != 0) {
+					for (sl_uint32 k = 0; k < nTaps; k++) {
+						c[k] = (float)(c[k] / sum);
+					}
+				}
+			}
+			return table;
+		}
+		
+		static Ref<_AudioResamplerTable> _AudioResampler_getTable(sl_uint32 L, sl_uint32 M, sl_uint32 nTaps)
+		{
+			static SpinLock lock;
+			static List< Ref<_AudioResamplerTable> > tables;
+			{
+				SpinLocker locker(&lock);
+				ListLocker< Ref<_AudioResamplerTable> > items(tables);
+				for (sl_size i = 0; i < items.count; i++) {
+					_AudioResamplerTable* table = items[i].get();
+					if (table->L == L && table->M == M && table->nTapsRequested == nTaps) {
+						return items[i];
+					}
+				}
+			}
+			Ref<_AudioResamplerTable> table = _AudioResampler_createTable(L, M, nTaps);
+			if (table.isNotNull()) {
+				SpinLocker locker(&lock);
+				tables.add(table);
+			}
+			return table;
+		}
+		
+		static sl_uint32 _AudioResampler_gcd(sl_uint32 a, sl_uint32 b)
+		{
+			while (b) {
+				sl_uint32 t = a % b;
+				a = b;
+				b = t;
+			}
+			return a;
+		}
+		
+		
+		SLIB_DEFINE_OBJECT(AudioResampler, Object)
+		
+		AudioResampler::AudioResampler()
+		{
+			m_nSamplesPerSecondInput = 0;
+			m_nSamplesPerSecondOutput = 0;
+			m_nChannels = 0;
+			m_history = sl_null;
+			m_nCapacity = 0;
+			m_output = sl_null;
+			m_nCapacityOutput = 0;
+			m_position = 0;
+			m_phase = 0;
+		}
+		
+		AudioResampler::~AudioResampler()
+		{
+			if (m_history) {
+				delete[] m_history;
+			}
+			if (m_output) {
+				delete[] m_output;
+			}
+		}
+		
+		Ref<AudioResampler> AudioResampler::create(sl_uint32 nSamplesPerSecondInput, sl_uint32 nSamplesPerSecondOutput, sl_uint32 nChannels, sl_uint32 nTaps)
+		{
+			if (!nSamplesPerSecondInput || !nSamplesPerSecondOutput || !nChannels || nTaps < 2) {
+				return sl_null;
+			}
+			sl_uint32 g = _AudioResampler_gcd(nSamplesPerSecondInput, nSamplesPerSecondOutput);
+			sl_uint32 L = nSamplesPerSecondOutput / g;
+			sl_uint32 M = nSamplesPerSecondInput / g;
+			if (L > _RESAMPLER_MAX_PHASES || M > _RESAMPLER_MAX_PHASES * 16) {
+				return sl_null;
+			}
+			Ref<_AudioResamplerTable> table = _AudioResampler_getTable(L, M, nTaps);
+			if (table.isNull()) {
+				return sl_null;
+			}
+			Ref<AudioResampler> ret = new AudioResampler;
+			if (ret.isNotNull()) {
+				ret->m_table = table;
+				ret->m_nSamplesPerSecondInput = nSamplesPerSecondInput;
+				ret->m_nSamplesPerSecondOutput = nSamplesPerSecondOutput;
+				ret->m_nChannels = nChannels;
+				if (ret->reserve(1024)) {
+					return ret;
+				}
+			}
+			return sl_null;
+		}
+		
+		sl_uint32 AudioResampler::getMaxOutputFrames(sl_uint32 nFramesInput)
+		{
+			return (sl_uint32)((sl_uint64)nFramesInput * m_table->L / m_table->M) + 2;
+		}
+		
+		sl_bool AudioResampler::reserve(sl_uint32 nFramesInput)
+		{
+			sl_uint32 nHistory = m_table->nTaps - 1;
+			if (nHistory + nFramesInput > m_nCapacity) {
+				sl_uint32 nCapacity = nHistory + nFramesInput;
+				float* history = new float[(sl_size)nCapacity * m_nChannels];
+				if (!history) {
+					return sl_false;
+				}
+				for (sl_uint32 ch = 0; ch < m_nChannels; ch++) {
+					float* dst = history + (sl_size)ch * nCapacity;
+					if (m_history) {
+						Base::copyMemory(dst, m_history + (sl_size)ch * m_nCapacity, nHistory * sizeof(float));
+					} else {
+						Base::zeroMemory(dst, nHistory * sizeof(float));
+					}
+				}
+				if (m_history) {
+					delete[] m_history;
+				}
+				m_history = history;
+				m_nCapacity = nCapacity;
+			}
+			sl_uint32 nOutput = getMaxOutputFrames(nFramesInput) * m_nChannels;
+			if (nOutput > m_nCapacityOutput) {
+				float* output = new float[nOutput];
+				if (!output) {
+					return sl_false;
+				}
+				if (m_output) {
+					delete[] m_output;
+				}
+				m_output = output;
+				m_nCapacityOutput = nOutput;
+			}
+			return sl_true;
+		}
+		
+		sl_uint32 AudioResampler::process(const sl_int16* input, sl_uint32 nFramesInput, sl_int16* output, sl_uint32 nMaxFramesOutput)
+		{
+			if (!nFramesInput || !(reserve(nFramesInput))) {
+				return 0;
+			}
+			_AudioResamplerTable* table = m_table.get();
+			sl_uint32 L = table->L;
+			sl_uint32 M = table->M;
+			sl_uint32 nTaps = table->nTaps;
+			sl_uint32 nHistory = nTaps - 1;
+			sl_uint32 nChannels = m_nChannels;
+			
+			for (sl_uint32 ch = 0; ch < nChannels; ch++) {
+				float* dst = m_history + (sl_size)ch * m_nCapacity + nHistory;
+				if (nChannels == 1) {
+					PcmKernels::convertInt16ToFloat(dst, input, nFramesInput);
+				} else {
+					const sl_int16* src = input + ch;
+					for (sl_uint32 i = 0; i < nFramesInput; i++) {
+						dst[i] = *src * (1.0f / 32768.0f);
+						src += nChannels;
+					}
+				}
+			}
+			
+			sl_uint32 nOutput = 0;
+			sl_uint32 position = m_position;
+			sl_uint32 phase = m_phase;
+			while (position < nFramesInput) {
+				if (nOutput < nMaxFramesOutput) {
+					// the window ends at the input sample of `position`
+					const float* c = table->coefficients + (sl_size)phase * nTaps;
+					float* out = m_output + (sl_size)nOutput * nChannels;
+					for (sl_uint32 ch = 0; ch < nChannels; ch++) {
+						out[ch] = PcmKernels::dotProduct(c, m_history + (sl_size)ch * m_nCapacity + position, nTaps);
+					}
+					nOutput++;
+				}
+				phase += M;
+				position += phase / L;
+				phase %= L;
+			}
+			m_position = position - nFramesInput;
+			m_phase = phase;
+			
+			for (sl_uint32 ch = 0; ch < nChannels; ch++) {
+				float* buf = m_history + (sl_size)ch * m_nCapacity;
+				Base::moveMemory(buf, buf + nFramesInput, nHistory * sizeof(float));
+			}
+			PcmKernels::convertFloatToInt16(output, m_output, (sl_size)nOutput * nChannels);
+			return nOutput;
+		}
+		
+		void AudioResampler::reset()
+		{
+			sl_uint32 nHistory = m_table->nTaps - 1;
+			for (sl_uint32 ch = 0; ch < m_nChannels; ch++) {
+				Base::zeroMemory(m_history + (sl_size)ch * m_nCapacity, nHistory * sizeof(float));
+			}
+			m_position = 0;
+			m_phase = 0;
+		}
+		
+		
+		AudioResampleFilter::AudioResampleFilter(sl_uint32 nSamplesPerSecond, sl_uint32 nChannels)
+		{
+			setTaps(SLIB_STREAMER_RESAMPLER_DEFAULT_TAPS);
+			m_nSamplesPerSecond = nSamplesPerSecond;
+			m_nChannels = nChannels;
+			m_nChannelsInput = 0;
+			m_bufferChannels = sl_null;
+			m_nCapacityChannels = 0;
+		}
+		
+		AudioResampleFilter::~AudioResampleFilter()
+		{
+			if (m_bufferChannels) {
+				delete[] m_bufferChannels;
+			}
+		}
+		
+		void AudioResampleFilter::filter(const Packet& input, PacketEmitter& emitter)
+		{
+			if (input.format != Packet::formatAudio_PCM_S16) {
+				return;
+			}
+			sl_uint32 nSamplesPerSecond = input.audioParam.nSamplesPerSecond;
+			sl_uint32 nChannels = input.audioParam.nChannels;
+			if (nSamplesPerSecond == m_nSamplesPerSecond && nChannels == m_nChannels) {
+				emitter.emit(input);
+				return;
+			}
+			if (!nSamplesPerSecond || !nChannels) {
+				return;
+			}
+			if (nChannels != m_nChannels && !((nChannels == 1 || nChannels == 2) && (m_nChannels == 1 || m_nChannels == 2))) {
+				return;
+			}
+			sl_uint32 nFrames = (sl_uint32)(input.data.getSize() / 2 / nChannels);
+			if (!nFrames) {
+				return;
+			}
+			const sl_int16* samples = (const sl_int16*)(input.data.getData());
+			
+			// resamples the fewer channels
+			sl_uint32 nChannelsResample = nChannels < m_nChannels ? nChannels : m_nChannels;
+			sl_uint32 nFramesOutput = nFrames;
+			Ref<AudioResampler> resampler;
+			if (nSamplesPerSecond != m_nSamplesPerSecond) {
+				resampler = m_resampler;
+				if (resampler.isNull() || resampler->getInputSampleRate() != nSamplesPerSecond || m_nChannelsInput != nChannels) {
+					resampler = AudioResampler::create(nSamplesPerSecond, m_nSamplesPerSecond, nChannelsResample, getTaps());
+					if (resampler.isNull()) {
+						return;
+					}
+					m_resampler = resampler;
+					m_nChannelsInput = nChannels;
+				}
+				nFramesOutput = resampler->getMaxOutputFrames(nFrames);
+			}
+			
+			// scratch for the down-mixed input or the resampled output before the up-mix
+			sl_uint32 nScratch = (nFrames > nFramesOutput ? nFrames : nFramesOutput) * nChannelsResample;
+			if (nScratch > m_nCapacityChannels) {
+				sl_int16* buf = new sl_int16[nScratch];
+				if (!buf) {
+					return;
+				}
+				if (m_bufferChannels) {
+					delete[] m_bufferChannels;
+				}
+				m_bufferChannels = buf;
+				m_nCapacityChannels = nScratch;
+			}
+			
+			Packet output = input;
+			if (!(output.data.allocate((sl_size)nFramesOutput * m_nChannels * 2, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM))) {
+				return;
+			}
+			sl_int16* out = (sl_int16*)(output.data.getData());
+			if (nChannels > m_nChannels) {
+				PcmKernels::convertStereoToMono(m_bufferChannels, samples, nFrames);
+				samples = m_bufferChannels;
+			}
+			sl_int16* outResample = nChannels < m_nChannels ? m_bufferChannels : out;
+			if (resampler.isNotNull()) {
+				nFramesOutput = resampler->process(samples, nFrames, outResample, nFramesOutput);
+				if (!nFramesOutput) {
+					return;
+				}
+			} else if (outResample != samples) {
+				Base::copyMemory(outResample, samples, (sl_size)nFrames * nChannelsResample * 2);
+			}
+			if (nChannels < m_nChannels) {
+				PcmKernels::convertMonoToStereo(out, outResample, nFramesOutput);
+			}
+			output.data.removeBack(output.data.getSize() - (sl_size)nFramesOutput * m_nChannels * 2);
+			output.audioParam.nSamplesPerSecond = m_nSamplesPerSecond;
+			output.audioParam.nChannels = m_nChannels;
+			emitter.emit(output);
+		}
+		
+	}
+	
+}
@@ -0,0 +1,678 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#include "../../../inc/slibx/streamer/scheduler.h"
+
+#include <slib/core/system.h>
+#include <slib/core/log.h>
+
+#if defined(SLIB_PLATFORM_IS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+#define STATE_IDLE 0
+#define STATE_SCHEDULED 1
+#define STATE_RUNNING 2
+#define STATE_RUNNING_NOTIFIED 3
+
+#define POLLER_EVENTS_MAX 64
+#define POLLER_WAIT_TIMEOUT 100
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class _GraphSchedulerEntry : public Referable
+		{
+		public:
+			Ref<Graph> graph;
+			Ref<Source> source;
+			sl_int32 indexWorker;
+			sl_bool flagPolled;
+			// descriptor watched by the poller, or -1
+			sl_int64 handleWatched;
+			sl_bool flagRemoved;
+			sl_int32 state;
+			
+		public:
+			_GraphSchedulerEntry()
+			{
+				indexWorker = -1;
+				flagPolled = sl_false;
+				handleWatched = -1;
+				flagRemoved = sl_false;
+				state = STATE_IDLE;
+			}
+			
+		};
+		
+		// ring of the scheduled entries, guarded by the lock of the worker
+		class _GraphSchedulerQueue
+		{
+		public:
+			Ref<_GraphSchedulerEntry>* m_data;
+			sl_size m_capacity;
+			sl_size m_head;
+			sl_size m_count;
+			
+		public:
+			_GraphSchedulerQueue()
+			{
+				m_data = sl_null;
+				m_capacity = 0;
+				m_head = 0;
+				m_count = 0;
+			}
+			
+			~_GraphSchedulerQueue()
+			{
+				if (m_data) {
+					delete[] m_data;
+				}
+			}
+			
+		public:
+			sl_bool pushBack(_GraphSchedulerEntry* entry)
+			{
+				if (m_count == m_capacity) {
+					sl_size capacity = m_capacity ? m_capacity * 2 : 16;
+					Ref<_GraphSchedulerEntry>* data = new Ref<_GraphSchedulerEntry>[capacity];
+					if (!data) {
+						return sl_false;
+					}
+					for (sl_size i = 0; i < m_count; i++) {
+						data[i] = m_data[(m_head + i) & (m_capacity - 1)];
+					}
+					if (m_data) {
+						delete[] m_data;
+					}
+					m_data = data;
+					m_capacity = capacity;
+					m_head = 0;
+				}
+				m_data[(m_head + m_count) & (m_capacity - 1)] = entry;
+				m_count++;
+				return sl_true;
+			}
+			
+			sl_bool popFront(Ref<_GraphSchedulerEntry>& _out)
+			{
+				if (!m_count) {
+					return sl_false;
+				}
+				_out = m_data[m_head];
+				m_data[m_head].setNull();
+				m_head = (m_head + 1) & (m_capacity - 1);
+				m_count--;
+				return sl_true;
+			}
+			
+			sl_bool popBack(Ref<_GraphSchedulerEntry>& _out)
+			{
+				if (!m_count) {
+					return sl_false;
+				}
+				m_count--;
+				sl_size index = (m_head + m_count) & (m_capacity - 1);
+				_out = m_data[index];
+				m_data[index].setNull();
+				return sl_true;
+			}
+			
+		};
+		
+		class _GraphSchedulerWorker : public Referable
+		{
+		public:
+			GraphScheduler* scheduler;
+			sl_uint32 index;
+			Ref<Thread> thread;
+			Ref<Event> event;
+			sl_int32 flagIdle;
+			
+			SpinLock lock;
+			// graphs bound to this worker, never stolen
+			_GraphSchedulerQueue queuePinned;
+			_GraphSchedulerQueue queue;
+			
+		public:
+			_GraphSchedulerWorker()
+			{
+				scheduler = sl_null;
+				index = 0;
+				flagIdle = 0;
+			}
+			
+		public:
+			void wake()
+			{
+				if (Base::interlockedCompareExchange32(&flagIdle, 0, 1)) {
+					event->set();
+				}
+			}
+			
+		};
+		
+		static thread_local _GraphSchedulerWorker* _t_GraphScheduler_worker = sl_null;
+		
+		static sl_bool _GraphScheduler_setAffinity(sl_uint32 cpu)
+		{
+#if defined(SLIB_PLATFORM_IS_LINUX)
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+			return sl_false;
+#endif
+		}
+		
+		
+		SLIB_DEFINE_OBJECT(GraphScheduler, Object)
+		
+		GraphScheduler::GraphScheduler()
+		{
+			setPacketsPerTurn(64);
+			setPollInterval(5);
+			m_flagPinThreads = sl_false;
+			m_flagReleased = sl_false;
+			m_indexNextWorker = 0;
+			m_timeLastPoll = 0;
+			m_handlePoller = -1;
+		}
+		
+		GraphScheduler::~GraphScheduler()
+		{
+			// the last reference may be released by a worker, so the workers are not waited here
+			Ref<_GraphSchedulerWorker>* workers = m_workers.getData();
+			sl_size nWorkers = m_workers.getCount();
+			for (sl_size i = 0; i < nWorkers; i++) {
+				Ref<Thread> thread = workers[i]->thread;
+				if (thread.isNotNull()) {
+					thread->finish();
+					workers[i]->event->set();
+				}
+			}
+			if (m_threadPoller.isNotNull()) {
+				m_threadPoller->finish();
+			}
+		}
+		
+		Ref<GraphScheduler> GraphScheduler::create(sl_uint32 nThreads, sl_bool flagPinThreads)
+		{
+#if !defined(SLIB_PLATFORM_IS_LINUX)
+			if (flagPinThreads) {
+				LogError("Streamer", "GraphScheduler: pinning the threads is not supported on this platform");
+				return sl_null;
+			}
+#endif
+			if (nThreads == 0) {
+				nThreads = System::getProcessorsCount();
+				if (nThreads == 0) {
+					nThreads = 1;
+				}
+			}
+			Ref<GraphScheduler> ret = new GraphScheduler;
+			if (ret.isNull()) {
+				return sl_null;
+			}
+			ret->m_flagPinThreads = flagPinThreads;
+			Array< Ref<_GraphSchedulerWorker> > workers = Array< Ref<_GraphSchedulerWorker> >::create(nThreads);
+			if (workers.isNull()) {
+				return sl_null;
+			}
+			for (sl_uint32 i = 0; i < nThreads; i++) {
+				Ref<_GraphSchedulerWorker> worker = new _GraphSchedulerWorker;
+				if (worker.isNull()) {
+					return sl_null;
+				}
+				worker->scheduler = ret.get();
+				worker->index = i;
+				worker->event = Event::create();
+				if (worker->event.isNull()) {
+					return sl_null;
+				}
+				workers[i] = worker;
+			}
+			ret->m_workers = workers;
+			WeakRef<GraphScheduler> scheduler = ret;
+			for (sl_uint32 i = 0; i < nThreads; i++) {
+				Ref<Thread> thread = Thread::start(Function<void()>::bind(&GraphScheduler::runWorker, scheduler, workers[i]));
+				if (thread.isNull()) {
+					ret->release();
+					return sl_null;
+				}
+				workers[i]->thread = thread;
+			}
+			return ret;
+		}
+		
+		sl_bool GraphScheduler::addGraph(const Ref<Graph>& graph, sl_int32 cpu)
+		{
+			if (graph.isNull()) {
+				return sl_false;
+			}
+			Ref<Source> source = graph->getSource();
+			if (source.isNull() || graph->getSink().isNull()) {
+				return sl_false;
+			}
+			Ref<_GraphSchedulerEntry> entry = new _GraphSchedulerEntry;
+			if (entry.isNull()) {
+				return sl_false;
+			}
+			entry->graph = graph;
+			entry->source = source;
+			{
+				ObjectLocker lock(this);
+				if (m_flagReleased) {
+					return sl_false;
+				}
+				sl_size nWorkers = m_workers.getCount();
+				if (cpu >= 0) {
+					entry->indexWorker = (sl_int32)(cpu % nWorkers);
+				}
+				graph->startTimers();
+				if (graph->getPipelined()) {
+					if (!(graph->startStages())) {
+						return sl_false;
+					}
+				}
+				sl_int64 handle = source->attachPoller();
+				if (handle >= 0) {
+					if (!(watchSource(entry.get(), handle))) {
+						source->detachPoller();
+					}
+				}
+				// the graphs having timers are also scheduled every PollInterval
+				entry->flagPolled = (entry->handleWatched < 0 && !(source->isReadyListenerSupported())) || graph->m_timerInterval > 0;
+				m_entries.add(entry);
+				if (entry->flagPolled) {
+					updatePolledEntries();
+				}
+			}
+			if (entry->handleWatched < 0) {
+				source->setReadyListener(Function<void()>::bind(&GraphScheduler::onReady, WeakRef<GraphScheduler>(this), WeakRef<_GraphSchedulerEntry>(entry)));
+			}
+			// the packets received before the listener was registered
+			schedule(entry.get());
+			return sl_true;
+		}
+		
+		void GraphScheduler::removeGraph(const Ref<Graph>& graph)
+		{
+			Ref<_GraphSchedulerEntry> entry;
+			{
+				ObjectLocker lock(this);
+				ListLocker< Ref<_GraphSchedulerEntry> > entries(m_entries);
+				for (sl_size i = 0; i < entries.count; i++) {
+					if (entries[i]->graph == graph) {
+						entry = entries[i];
+						break;
+					}
+				}
+				if (entry.isNull()) {
+					return;
+				}
+				entry->flagRemoved = sl_true;
+				m_entries.removeValue(entry);
+				if (entry->flagPolled) {
+					updatePolledEntries();
+				}
+				unwatchSource(entry.get());
+			}
+			if (entry->handleWatched >= 0) {
+				entry->source->detachPoller();
+			} else {
+				entry->source->setReadyListener(sl_null);
+			}
+			graph->releaseStages();
+		}
+		
+		void GraphScheduler::release()
+		{
+			List< Ref<_GraphSchedulerEntry> > entries;
+			Ref<Thread> threadPoller;
+			{
+				ObjectLocker lock(this);
+				if (m_flagReleased) {
+					return;
+				}
+				m_flagReleased = sl_true;
+				entries = m_entries;
+				m_entries.setNull();
+				updatePolledEntries();
+				threadPoller = m_threadPoller;
+				// the descriptor is closed by the poller thread
+				m_handlePoller = -1;
+			}
+			if (threadPoller.isNotNull()) {
+				threadPoller->finishAndWait();
+			}
+			{
+				SpinLocker lock(&m_lockPoller);
+				m_entriesUnwatched.setNull();
+			}
+			// the workers are kept until the destruction, so the running entries can access them
+			Ref<_GraphSchedulerWorker>* workers = m_workers.getData();
+			sl_size nWorkers = m_workers.getCount();
+			for (sl_size i = 0; i < nWorkers; i++) {
+				Ref<Thread> thread = workers[i]->thread;
+				if (thread.isNotNull()) {
+					thread->finish();
+					workers[i]->event->set();
+				}
+			}
+			for (sl_size i = 0; i < nWorkers; i++) {
+				Ref<Thread> thread = workers[i]->thread;
+				if (thread.isNotNull()) {
+					thread->finishAndWait();
+				}
+			}
+			ListLocker< Ref<_GraphSchedulerEntry> > items(entries);
+			for (sl_size i = 0; i < items.count; i++) {
+				items[i]->flagRemoved = sl_true;
+				if (items[i]->handleWatched >= 0) {
+					items[i]->source->detachPoller();
+				} else {
+					items[i]->source->setReadyListener(sl_null);
+				}
+				items[i]->graph->releaseStages();
+			}
+		}
+		
+		sl_uint32 GraphScheduler::getThreadsCount()
+		{
+			return (sl_uint32)(m_workers.getCount());
+		}
+		
+		void GraphScheduler::schedule(_GraphSchedulerEntry* entry)
+		{
+			for (;;) {
+				sl_int32 state = Base::interlockedAdd32(&(entry->state), 0);
+				if (state == STATE_IDLE) {
+					if (Base::interlockedCompareExchange32(&(entry->state), STATE_SCHEDULED, STATE_IDLE)) {
+						enqueue(entry);
+						return;
+					}
+				} else if (state == STATE_RUNNING) {
+					// the running worker takes the graph again after the turn
+					if (Base::interlockedCompareExchange32(&(entry->state), STATE_RUNNING_NOTIFIED, STATE_RUNNING)) {
+						return;
+					}
+				} else {
+					return;
+				}
+			}
+		}
+		
+		void GraphScheduler::enqueue(_GraphSchedulerEntry* entry)
+		{
+			Ref<_GraphSchedulerWorker>* workers = m_workers.getData();
+			sl_uint32 nWorkers = (sl_uint32)(m_workers.getCount());
+			if (!nWorkers) {
+				return;
+			}
+			_GraphSchedulerWorker* worker;
+			if (entry->indexWorker >= 0) {
+				worker = workers[entry->indexWorker].get();
+				SpinLocker lock(&(worker->lock));
+				worker->queuePinned.pushBack(entry);
+			} else {
+				// keeps the graph on the current worker when it is rescheduled by a worker of this scheduler
+				worker = _t_GraphScheduler_worker;
+				if (!worker || worker->scheduler != this) {
+					worker = workers[((sl_uint32)(Base::interlockedIncrement32(&m_indexNextWorker))) % nWorkers].get();
+				}
+				SpinLocker lock(&(worker->lock));
+				worker->queue.pushBack(entry);
+			}
+			worker->wake();
+			if (entry->indexWorker < 0 && Base::interlockedAdd32(&(worker->flagIdle), 0) == 0) {
+				// the worker is busy, so an idle worker steals the graph
+				for (sl_uint32 i = 0; i < nWorkers; i++) {
+					_GraphSchedulerWorker* other = workers[i].get();
+					if (other != worker && Base::interlockedAdd32(&(other->flagIdle), 0)) {
+						other->wake();
+						break;
+					}
+				}
+			}
+		}
+		
+		sl_bool GraphScheduler::dequeue(_GraphSchedulerWorker* worker, Ref<_GraphSchedulerEntry>& _out)
+		{
+			{
+				SpinLocker lock(&(worker->lock));
+				if (worker->queuePinned.popFront(_out)) {
+					return sl_true;
+				}
+				if (worker->queue.popFront(_out)) {
+					return sl_true;
+				}
+			}
+			Ref<_GraphSchedulerWorker>* workers = m_workers.getData();
+			sl_uint32 nWorkers = (sl_uint32)(m_workers.getCount());
+			for (sl_uint32 i = 1; i < nWorkers; i++) {
+				_GraphSchedulerWorker* victim = workers[(worker->index + i) % nWorkers].get();
+				SpinLocker lock(&(victim->lock));
+				if (victim->queue.popBack(_out)) {
+					return sl_true;
+				}
+			}
+			return sl_false;
+		}
+		
+		void GraphScheduler::runEntry(_GraphSchedulerEntry* entry)
+		{
+			if (entry->flagRemoved) {
+				Base::interlockedCompareExchange32(&(entry->state), STATE_IDLE, STATE_SCHEDULED);
+				return;
+			}
+			Base::interlockedCompareExchange32(&(entry->state), STATE_RUNNING, STATE_SCHEDULED);
+			sl_uint32 nMax = getPacketsPerTurn();
+			if (nMax < 1) {
+				nMax = 1;
+			}
+			sl_uint32 n = entry->graph->processSourcePackets(nMax);
+			entry->graph->processTimers();
+			if (n < nMax) {
+				if (Base::interlockedCompareExchange32(&(entry->state), STATE_IDLE, STATE_RUNNING)) {
+					return;
+				}
+			}
+			// the turn is over while more packets are pending
+			if (!(Base::interlockedCompareExchange32(&(entry->state), STATE_SCHEDULED, STATE_RUNNING))) {
+				Base::interlockedCompareExchange32(&(entry->state), STATE_SCHEDULED, STATE_RUNNING_NOTIFIED);
+			}
+			enqueue(entry);
+		}
+		
+		void GraphScheduler::pollSources()
+		{
+			sl_int64 now = (sl_int64)(System::getTickCount64());
+			sl_int64 last = Base::interlockedAdd64(&m_timeLastPoll, 0);
+			if (now - last < (sl_int64)(getPollInterval())) {
+				return;
+			}
+			if (!(Base::interlockedCompareExchange64(&m_timeLastPoll, now, last))) {
+				return;
+			}
+			Array< Ref<_GraphSchedulerEntry> > arr;
+			{
+				SpinLocker lock(&m_lockEntriesPolled);
+				arr = m_entriesPolled;
+			}
+			Ref<_GraphSchedulerEntry>* entries = arr.getData();
+			sl_size n = arr.getCount();
+			for (sl_size i = 0; i < n; i++) {
+				schedule(entries[i].get());
+			}
+		}
+		
+		sl_bool GraphScheduler::watchSource(_GraphSchedulerEntry* entry, sl_int64 handle)
+		{
+#if defined(SLIB_PLATFORM_IS_LINUX)
+			if (m_handlePoller < 0) {
+				int epfd = epoll_create1(EPOLL_CLOEXEC);
+				if (epfd < 0) {
+					return sl_false;
+				}
+				Ref<Thread> thread = Thread::start(Function<void()>::bind(&GraphScheduler::runPoller, WeakRef<GraphScheduler>(this), (sl_int64)epfd));
+				if (thread.isNull()) {
+					::close(epfd);
+					return sl_false;
+				}
+				m_handlePoller = epfd;
+				m_threadPoller = thread;
+			}
+			epoll_event ev;
+			Base::zeroMemory(&ev, sizeof(ev));
+			// edge-triggered: the graph receives until the source is empty, and a new datagram schedules it again
+			ev.events = EPOLLIN | EPOLLET;
+			ev.data.ptr = entry;
+			if (epoll_ctl((int)m_handlePoller, EPOLL_CTL_ADD, (int)handle, &ev) != 0) {
+				return sl_false;
+			}
+			entry->handleWatched = handle;
+			return sl_true;
+#else
+			return sl_false;
+#endif
+		}
+		
+		void GraphScheduler::unwatchSource(_GraphSchedulerEntry* entry)
+		{
+#if defined(SLIB_PLATFORM_IS_LINUX)
+			if (entry->handleWatched < 0 || m_handlePoller < 0) {
+				return;
+			}
+			epoll_ctl((int)m_handlePoller, EPOLL_CTL_DEL, (int)(entry->handleWatched), sl_null);
+			// the events returned by the current wait may still point to the entry
+			SpinLocker lock(&m_lockPoller);
+			m_entriesUnwatched.add(entry);
+#endif
+		}
+		
+		void GraphScheduler::runPoller(WeakRef<GraphScheduler> _scheduler, sl_int64 handlePoller)
+		{
+#if defined(SLIB_PLATFORM_IS_LINUX)
+			int epfd = (int)handlePoller;
+			epoll_event events[POLLER_EVENTS_MAX];
+			Ref<_GraphSchedulerEntry> entries[POLLER_EVENTS_MAX];
+			while (!Thread::isStoppingCurrent()) {
+				int n = epoll_wait(epfd, events, POLLER_EVENTS_MAX, POLLER_WAIT_TIMEOUT);
+				Ref<GraphScheduler> scheduler = _scheduler;
+				if (scheduler.isNull()) {
+					break;
+				}
+				List< Ref<_GraphSchedulerEntry> > unwatched;
+				{
+					SpinLocker lock(&(scheduler->m_lockPoller));
+					for (int i = 0; i < n; i++) {
+						entries[i] = (_GraphSchedulerEntry*)(events[i].data.ptr);
+					}
+					// no later wait returns the events of the entries unwatched so far
+					unwatched = scheduler->m_entriesUnwatched;
+					scheduler->m_entriesUnwatched.setNull();
+				}
+				for (int i = 0; i < n; i++) {
+					scheduler->schedule(entries[i].get());
+					entries[i].setNull();
+				}
+			}
+			::close(epfd);
+#endif
+		}
+		
+		void GraphScheduler::updatePolledEntries()
+		{
+			List< Ref<_GraphSchedulerEntry> > list;
+			ListLocker< Ref<_GraphSchedulerEntry> > entries(m_entries);
+			for (sl_size i = 0; i < entries.count; i++) {
+				if (entries[i]->flagPolled) {
+					list.add(entries[i]);
+				}
+			}
+			ListLocker< Ref<_GraphSchedulerEntry> > polled(list);
+			Array< Ref<_GraphSchedulerEntry> > snapshot = Array< Ref<_GraphSchedulerEntry> >::create(polled.data, polled.count);
+			SpinLocker lock(&m_lockEntriesPolled);
+			m_entriesPolled = snapshot;
+		}
+		
+		void GraphScheduler::runWorker(WeakRef<GraphScheduler> _scheduler, Ref<_GraphSchedulerWorker> worker)
+		{
+			{
+				Ref<GraphScheduler> scheduler = _scheduler;
+				if (scheduler.isNull()) {
+					return;
+				}
+				if (scheduler->m_flagPinThreads) {
+					if (!(_GraphScheduler_setAffinity(worker->index))) {
+						LogError("Streamer", "GraphScheduler: failed to pin the worker %d", worker->index);
+					}
+				}
+			}
+			_t_GraphScheduler_worker = worker.get();
+			Ref<Event> ev = worker->event;
+			while (!Thread::isStoppingCurrent()) {
+				sl_int32 timeout = -1;
+				{
+					Ref<GraphScheduler> scheduler = _scheduler;
+					if (scheduler.isNull()) {
+						break;
+					}
+					scheduler->pollSources();
+					Ref<_GraphSchedulerEntry> entry;
+					if (scheduler->dequeue(worker.get(), entry)) {
+						scheduler->runEntry(entry.get());
+						continue;
+					}
+					// announces the idle state, and checks the queues again not to miss the entry pushed meanwhile
+					Base::interlockedCompareExchange32(&(worker->flagIdle), 1, 0);
+					if (scheduler->dequeue(worker.get(), entry)) {
+						Base::interlockedCompareExchange32(&(worker->flagIdle), 0, 1);
+						scheduler->runEntry(entry.get());
+						continue;
+					}
+					{
+						SpinLocker lock(&(scheduler->m_lockEntriesPolled));
+						if (scheduler->m_entriesPolled.isNotNull()) {
+							timeout = (sl_int32)(scheduler->getPollInterval());
+						}
+					}
+				}
+				ev->wait(timeout);
+				Base::interlockedCompareExchange32(&(worker->flagIdle), 0, 1);
+			}
+			_t_GraphScheduler_worker = sl_null;
+		}
+		
+		void GraphScheduler::onReady(WeakRef<GraphScheduler> _scheduler, WeakRef<_GraphSchedulerEntry> _entry)
+		{
+			Ref<GraphScheduler> scheduler = _scheduler;
+			if (scheduler.isNull()) {
+				return;
+			}
+			Ref<_GraphSchedulerEntry> entry = _entry;
+			if (entry.isNull()) {
+				return;
+			}
+			scheduler->schedule(entry.get());
+		}
+		
+	}
+	
+}
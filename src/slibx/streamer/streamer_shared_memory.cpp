@@ -0,0 +1,722 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#include "../../../inc/slibx/streamer/shared_memory.h"
+
+#if defined(SLIB_PLATFORM_IS_LINUX)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#if defined(SYS_memfd_create) && defined(SYS_futex)
+#define STREAMER_SHARED_MEMORY_SUPPORTED
+#endif
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#endif
+#ifndef F_SEAL_SEAL
+#define F_SEAL_SEAL 0x0001
+#endif
+#ifndef F_SEAL_SHRINK
+#define F_SEAL_SHRINK 0x0002
+#endif
+#ifndef F_SEAL_GROW
+#define F_SEAL_GROW 0x0004
+#endif
+#endif
+
+#define SHARED_MEMORY_MAGIC 0x4D534C53
+#define SHARED_MEMORY_VERSION 2
+#define SHARED_MEMORY_HEADER_SIZE 4096
+#define SHARED_MEMORY_MIN_CAPACITY 4096
+#define SHARED_MEMORY_RECORD_HEADER_SIZE 48
+// size of the record skipping the rest of the lap
+#define SHARED_MEMORY_RECORD_WRAP 0
+// state of a side which is not attached yet; an attached side stores its process id
+#define SHARED_MEMORY_STATE_NONE 0
+#define SHARED_MEMORY_STATE_CLOSED -1
+// marks the released entries in the record list of the source
+#define SHARED_MEMORY_RECORD_RELEASED 0x80000000
+#define SHARED_MEMORY_WAIT_TIMEOUT 100
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+#if defined(STREAMER_SHARED_MEMORY_SUPPORTED)
+		
+		// the fields shared by the processes are accessed only by the interlocked functions
+		struct _SharedMemoryHeader
+		{
+			sl_uint32 magic;
+			sl_uint32 version;
+			sl_uint32 capacity;
+			sl_uint32 reserved;
+			// process id of the attached side, or SHARED_MEMORY_STATE_NONE or SHARED_MEMORY_STATE_CLOSED
+			sl_int32 stateProducer;
+			sl_int32 stateConsumer;
+			sl_uint8 padding1[40];
+			
+			// written only by the sink
+			sl_int64 posWrite;
+			sl_int64 countDropped;
+			sl_uint8 padding2[48];
+			
+			// written only by the source; the bytes before this position are free to the sink
+			sl_int64 posRead;
+			sl_uint8 padding3[56];
+			
+			// raised by the source before sleeping on `wakeSequence`
+			sl_int32 flagWaiting;
+			sl_int32 wakeSequence;
+		};
+		
+		struct _SharedMemoryRecord
+		{
+			sl_uint32 size;
+			sl_uint32 sizePayload;
+			sl_uint32 format;
+			sl_uint32 flags;
+			sl_uint64 sequence;
+			sl_int64 timestamp;
+			sl_uint32 streamId;
+			sl_uint32 nSamplesPerSecond;
+			sl_uint32 nChannels;
+			sl_uint32 reserved;
+		};
+		
+		// reads the field written by the peer exactly once, so the checked value is the used value
+		SLIB_INLINE static sl_uint32 _SharedMemory_load(const sl_uint32* p)
+		{
+			return *((const volatile sl_uint32*)p);
+		}
+		
+		class _SharedMemoryRing : public Referable
+		{
+		public:
+			int m_fd;
+			void* m_base;
+			sl_size m_sizeMapped;
+			_SharedMemoryHeader* m_header;
+			sl_uint8* m_data;
+			sl_uint32 m_capacity;
+			sl_uint32 m_mask;
+			
+		public:
+			_SharedMemoryRing()
+			{
+				m_fd = -1;
+				m_base = sl_null;
+				m_sizeMapped = 0;
+				m_header = sl_null;
+				m_data = sl_null;
+				m_capacity = 0;
+				m_mask = 0;
+			}
+			
+			~_SharedMemoryRing()
+			{
+				if (m_base) {
+					::munmap(m_base, m_sizeMapped);
+				}
+				if (m_fd >= 0) {
+					::close(m_fd);
+				}
+			}
+			
+		public:
+			static Ref<_SharedMemoryRing> map(int fd, sl_size size)
+			{
+				void* base = ::mmap(sl_null, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+				if (base == MAP_FAILED) {
+					::close(fd);
+					return sl_null;
+				}
+				Ref<_SharedMemoryRing> ret = new _SharedMemoryRing;
+				if (ret.isNull()) {
+					::munmap(base, size);
+					::close(fd);
+					return sl_null;
+				}
+				ret->m_fd = fd;
+				ret->m_base = base;
+				ret->m_sizeMapped = size;
+				ret->m_header = (_SharedMemoryHeader*)base;
+				ret->m_data = (sl_uint8*)base + SHARED_MEMORY_HEADER_SIZE;
+				return ret;
+			}
+			
+			static Ref<_SharedMemoryRing> create(sl_uint32 capacity)
+			{
+				sl_uint32 n = SHARED_MEMORY_MIN_CAPACITY;
+				while (n < capacity && n < 0x40000000) {
+					n <<= 1;
+				}
+				int fd = (int)(::syscall(SYS_memfd_create, "slib_streamer", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+				if (fd < 0) {
+					return sl_null;
+				}
+				sl_size size = SHARED_MEMORY_HEADER_SIZE + (sl_size)n;
+				if (::ftruncate(fd, (off_t)size) != 0) {
+					::close(fd);
+					return sl_null;
+				}
+				// the peer cannot shrink the file under our mapping
+				::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+				Ref<_SharedMemoryRing> ret = map(fd, size);
+				if (ret.isNull()) {
+					return sl_null;
+				}
+				// a new memfd is filled with zeros
+				_SharedMemoryHeader* header = ret->m_header;
+				header->version = SHARED_MEMORY_VERSION;
+				header->capacity = n;
+				Base::interlockedCompareExchange32((sl_int32*)&(header->magic), (sl_int32)SHARED_MEMORY_MAGIC, 0);
+				ret->m_capacity = n;
+				ret->m_mask = n - 1;
+				return ret;
+			}
+			
+			static Ref<_SharedMemoryRing> open(sl_int32 handle)
+			{
+				int fd = ::fcntl((int)handle, F_DUPFD_CLOEXEC, 0);
+				if (fd < 0) {
+					return sl_null;
+				}
+				struct stat st;
+				if (::fstat(fd, &st) != 0 || st.st_size < SHARED_MEMORY_HEADER_SIZE + SHARED_MEMORY_MIN_CAPACITY) {
+					::close(fd);
+					return sl_null;
+				}
+				Ref<_SharedMemoryRing> ret = map(fd, SHARED_MEMORY_HEADER_SIZE);
+				if (ret.isNull()) {
+					return sl_null;
+				}
+				_SharedMemoryHeader* header = ret->m_header;
+				sl_uint32 n = header->capacity;
+				if ((sl_uint32)(Base::interlockedAdd32((sl_int32*)&(header->magic), 0)) != SHARED_MEMORY_MAGIC
+					|| header->version != SHARED_MEMORY_VERSION
+					|| n < SHARED_MEMORY_MIN_CAPACITY || (n & (n - 1)) != 0
+					|| (sl_uint64)(st.st_size) < SHARED_MEMORY_HEADER_SIZE + (sl_uint64)n) {
+					return sl_null;
+				}
+				// maps the records with the duplicated descriptor
+				int fdRing = ret->m_fd;
+				ret->m_fd = -1;
+				ret = map(fdRing, SHARED_MEMORY_HEADER_SIZE + (sl_size)n);
+				if (ret.isNull()) {
+					return sl_null;
+				}
+				ret->m_capacity = n;
+				ret->m_mask = n - 1;
+				return ret;
+			}
+			
+			// claims the role of the sink or the source; the role left by a closed or exited process is taken over, and `flagTakenOver` is set
+			sl_bool attach(sl_int32* state, sl_bool& flagTakenOver)
+			{
+				sl_int32 pid = (sl_int32)(::getpid());
+				for (;;) {
+					sl_int32 stateOld = Base::interlockedAdd32(state, 0);
+					if (stateOld != SHARED_MEMORY_STATE_NONE && stateOld != SHARED_MEMORY_STATE_CLOSED) {
+						// the processes share the pid namespace
+						if (stateOld == pid || ::kill((pid_t)stateOld, 0) == 0 || errno != ESRCH) {
+							return sl_false;
+						}
+					}
+					if (Base::interlockedCompareExchange32(state, pid, stateOld)) {
+						flagTakenOver = stateOld != SHARED_MEMORY_STATE_NONE;
+						return sl_true;
+					}
+				}
+			}
+			
+			void detach(sl_int32* state)
+			{
+				Base::interlockedCompareExchange32(state, SHARED_MEMORY_STATE_CLOSED, (sl_int32)(::getpid()));
+				wake(sl_true);
+			}
+			
+			sl_bool isClosed(sl_int32* state)
+			{
+				return Base::interlockedAdd32(state, 0) == SHARED_MEMORY_STATE_CLOSED;
+			}
+			
+			// called by the sink
+			void wake(sl_bool flagForce = sl_false)
+			{
+				if (Base::interlockedCompareExchange32(&(m_header->flagWaiting), 0, 1) || flagForce) {
+					Base::interlockedIncrement32(&(m_header->wakeSequence));
+					::syscall(SYS_futex, &(m_header->wakeSequence), FUTEX_WAKE, 1, sl_null, sl_null, 0);
+				}
+			}
+			
+			// called by the source; returns when `wakeSequence` is not `sequence`, or the timeout expires
+			void wait(sl_int32 sequence, sl_int32 timeout)
+			{
+				struct timespec ts;
+				ts.tv_sec = timeout / 1000;
+				ts.tv_nsec = (timeout % 1000) * 1000000;
+				::syscall(SYS_futex, &(m_header->wakeSequence), FUTEX_WAIT, sequence, &ts, sl_null, 0);
+			}
+			
+		};
+		
+		class _SharedMemorySinkImpl : public SharedMemorySink
+		{
+		public:
+			Ref<_SharedMemoryRing> m_ring;
+			
+		public:
+			~_SharedMemorySinkImpl()
+			{
+				if (m_ring.isNotNull()) {
+					m_ring->detach(&(m_ring->m_header->stateProducer));
+				}
+			}
+			
+		public:
+			static Ref<_SharedMemorySinkImpl> create(const Ref<_SharedMemoryRing>& ring)
+			{
+				if (ring.isNull()) {
+					return sl_null;
+				}
+				sl_int32* state = &(ring->m_header->stateProducer);
+				// the records published by the previous sink are still valid, and are written after them
+				sl_bool flagTakenOver;
+				if (!(ring->attach(state, flagTakenOver))) {
+					return sl_null;
+				}
+				Ref<_SharedMemorySinkImpl> ret = new _SharedMemorySinkImpl;
+				if (ret.isNull()) {
+					ring->detach(state);
+					return sl_null;
+				}
+				ret->m_ring = ring;
+				return ret;
+			}
+			
+			// override
+			sl_bool sendPacket(const Packet& packet)
+			{
+				_SharedMemoryRing* ring = m_ring.get();
+				_SharedMemoryHeader* header = ring->m_header;
+				if (ring->isClosed(&(header->stateConsumer))) {
+					return sl_false;
+				}
+				sl_uint32 capacity = ring->m_capacity;
+				sl_size sizePayload = packet.data.getSize();
+				// a record is limited to the quarter, so skipping the rest of a lap wastes at most the quarter
+				if (sizePayload > capacity / 4) {
+					Base::interlockedIncrement64(&(header->countDropped));
+					return sl_false;
+				}
+				sl_uint32 size = (sl_uint32)((SHARED_MEMORY_RECORD_HEADER_SIZE + sizePayload + 7) & ~((sl_size)7));
+				sl_int64 posWrite = Base::interlockedAdd64(&(header->posWrite), 0);
+				sl_int64 posRead = Base::interlockedAdd64(&(header->posRead), 0);
+				sl_int64 pos = posWrite;
+				sl_uint32 offset = (sl_uint32)pos & ring->m_mask;
+				sl_uint32 sizeSkip = capacity - offset;
+				if (sizeSkip >= size) {
+					sizeSkip = 0;
+				}
+				if (pos + sizeSkip + size - posRead > (sl_int64)capacity) {
+					Base::interlockedIncrement64(&(header->countDropped));
+					return sl_false;
+				}
+				if (sizeSkip) {
+					((_SharedMemoryRecord*)(ring->m_data + offset))->size = SHARED_MEMORY_RECORD_WRAP;
+					pos += sizeSkip;
+					offset = 0;
+				}
+				_SharedMemoryRecord* record = (_SharedMemoryRecord*)(ring->m_data + offset);
+				record->size = size;
+				record->sizePayload = (sl_uint32)sizePayload;
+				record->format = (sl_uint32)(packet.format);
+				record->flags = packet.flags;
+				record->sequence = packet.sequence;
+				record->timestamp = packet.timestamp;
+				record->streamId = packet.streamId;
+				record->nSamplesPerSecond = packet.audioParam.nSamplesPerSecond;
+				record->nChannels = packet.audioParam.nChannels;
+				record->reserved = 0;
+				if (sizePayload) {
+					Base::copyMemory(record + 1, packet.data.getData(), sizePayload);
+				}
+				// publishes the record
+				Base::interlockedAdd64(&(header->posWrite), pos + size - posWrite);
+				ring->wake();
+				return sl_true;
+			}
+			
+			// override
+			sl_int32 getHandle()
+			{
+				return m_ring->m_fd;
+			}
+			
+			// override
+			sl_uint64 getDroppedCount()
+			{
+				return (sl_uint64)(Base::interlockedAdd64(&(m_ring->m_header->countDropped), 0));
+			}
+			
+			// override
+			sl_bool isClosed()
+			{
+				return m_ring->isClosed(&(m_ring->m_header->stateConsumer));
+			}
+			
+		};
+		
+		class _SharedMemorySourceImpl;
+		
+		// returns the record to the sink when the last view of the payload is released
+		class _SharedMemoryView : public Referable
+		{
+		public:
+			Ref<_SharedMemorySourceImpl> m_source;
+			sl_uint64 m_index;
+			
+		public:
+			~_SharedMemoryView();
+			
+		};
+		
+		class _SharedMemorySourceImpl : public SharedMemorySource
+		{
+		public:
+			Ref<_SharedMemoryRing> m_ring;
+			Ref<Thread> m_thread;
+			Ref<Event> m_event;
+			// set when the graph is woken, and cleared when the graph finds the ring empty
+			sl_int32 m_flagNotified;
+			// next record to receive, written only by the graph
+			sl_int64 m_posParse;
+			// the bytes before this position are returned to the sink; `posRead` in the header is only written from this
+			sl_int64 m_posRead;
+			/*
+				sizes of the received records (with the skipped rest of the lap before them) which are not returned yet,
+				kept on this side so a broken peer cannot move `posRead` by rewriting the ring
+			*/
+			sl_uint32* m_records;
+			sl_uint32 m_countRecords;
+			sl_uint64 m_indexRead;
+			sl_uint64 m_indexParse;
+			// the views may be released on any thread
+			SpinLock m_lockRelease;
+			
+		public:
+			_SharedMemorySourceImpl()
+			{
+				m_event = Event::create();
+				m_flagNotified = 0;
+				m_posParse = 0;
+				m_posRead = 0;
+				m_records = sl_null;
+				m_countRecords = 0;
+				m_indexRead = 0;
+				m_indexParse = 0;
+			}
+			
+			~_SharedMemorySourceImpl()
+			{
+				if (m_thread.isNotNull()) {
+					m_thread->finish();
+				}
+				if (m_ring.isNotNull()) {
+					m_ring->detach(&(m_ring->m_header->stateConsumer));
+				}
+				if (m_records) {
+					delete[] m_records;
+				}
+			}
+			
+		public:
+			static Ref<_SharedMemorySourceImpl> create(const Ref<_SharedMemoryRing>& ring)
+			{
+				if (ring.isNull()) {
+					return sl_null;
+				}
+				_SharedMemoryHeader* header = ring->m_header;
+				sl_int32* state = &(header->stateConsumer);
+				sl_bool flagTakenOver;
+				if (!(ring->attach(state, flagTakenOver))) {
+					return sl_null;
+				}
+				if (flagTakenOver) {
+					// the records left to the previous source are dropped, with the views it may never release
+					sl_int64 posWrite = Base::interlockedAdd64(&(header->posWrite), 0);
+					Base::interlockedAdd64(&(header->posRead), posWrite - Base::interlockedAdd64(&(header->posRead), 0));
+					Base::interlockedCompareExchange32(&(header->flagWaiting), 0, 1);
+				}
+				// a record has 48 bytes at least
+				sl_uint32 nRecords = ring->m_capacity / SHARED_MEMORY_RECORD_HEADER_SIZE + 1;
+				Ref<_SharedMemorySourceImpl> ret = new _SharedMemorySourceImpl;
+				if (ret.isNotNull()) {
+					ret->m_records = new sl_uint32[nRecords];
+				}
+				if (ret.isNotNull() && ret->m_event.isNotNull() && ret->m_records) {
+					ret->m_ring = ring;
+					ret->m_countRecords = nRecords;
+					// the records written before the source is attached are also received
+					ret->m_posRead = Base::interlockedAdd64(&(header->posRead), 0);
+					ret->m_posParse = ret->m_posRead;
+					WeakRef<_SharedMemorySourceImpl> wr = ret;
+					ret->m_thread = Thread::start(Function<void()>::bind(&_SharedMemorySourceImpl::run, ring, wr));
+					if (ret->m_thread.isNotNull()) {
+						return ret;
+					}
+					return sl_null;
+				}
+				ring->detach(state);
+				return sl_null;
+			}
+			
+			// override
+			sl_bool receivePacket(Packet* out)
+			{
+				if (_receive(out)) {
+					return sl_true;
+				}
+				Base::interlockedCompareExchange32(&m_flagNotified, 0, 1);
+				// the next record wakes the receiving thread
+				Base::interlockedCompareExchange32(&(m_ring->m_header->flagWaiting), 1, 0);
+				// checks again not to miss the record published before the flags are changed
+				return _receive(out);
+			}
+			
+			// override
+			Ref<Event> getEvent()
+			{
+				return m_event;
+			}
+			
+			// override
+			sl_bool isReadyListenerSupported()
+			{
+				return sl_true;
+			}
+			
+			// override
+			sl_int32 getHandle()
+			{
+				return m_ring->m_fd;
+			}
+			
+			// override
+			sl_uint64 getDroppedCount()
+			{
+				return (sl_uint64)(Base::interlockedAdd64(&(m_ring->m_header->countDropped), 0));
+			}
+			
+			// override
+			sl_bool isClosed()
+			{
+				return m_ring->isClosed(&(m_ring->m_header->stateProducer));
+			}
+			
+			sl_bool hasPacket()
+			{
+				return Base::interlockedAdd64(&m_posParse, 0) != Base::interlockedAdd64(&(m_ring->m_header->posWrite), 0);
+			}
+			
+			sl_bool _receive(Packet* out)
+			{
+				_SharedMemoryRing* ring = m_ring.get();
+				_SharedMemoryHeader* header = ring->m_header;
+				sl_uint32 capacity = ring->m_capacity;
+				sl_int64 posWrite = Base::interlockedAdd64(&(header->posWrite), 0);
+				sl_int64 pos = m_posParse;
+				if (posWrite - pos > (sl_int64)capacity) {
+					// broken by the peer
+					return sl_false;
+				}
+				_SharedMemoryRecord* record;
+				sl_uint32 size;
+				for (;;) {
+					if (pos >= posWrite) {
+						return sl_false;
+					}
+					sl_uint32 offset = (sl_uint32)pos & ring->m_mask;
+					record = (_SharedMemoryRecord*)(ring->m_data + offset);
+					size = _SharedMemory_load(&(record->size));
+					if (size == SHARED_MEMORY_RECORD_WRAP) {
+						pos += capacity - offset;
+						continue;
+					}
+					if (size < SHARED_MEMORY_RECORD_HEADER_SIZE || size > capacity - offset || (size & 7) || pos + size > posWrite) {
+						// broken by the peer
+						return sl_false;
+					}
+					break;
+				}
+				sl_int64 posEnd = pos + size;
+				sl_uint32 sizePayload = _SharedMemory_load(&(record->sizePayload));
+				if (sizePayload > size - SHARED_MEMORY_RECORD_HEADER_SIZE) {
+					// broken by the peer
+					return sl_false;
+				}
+				const sl_uint8* payload = (const sl_uint8*)(record + 1);
+				
+				Packet packet;
+				packet.format = (Packet::Format)(record->format);
+				packet.flags = record->flags;
+				packet.sequence = record->sequence;
+				packet.timestamp = record->timestamp;
+				packet.streamId = record->streamId;
+				packet.audioParam.nSamplesPerSecond = record->nSamplesPerSecond;
+				packet.audioParam.nChannels = record->nChannels;
+				
+				sl_uint64 index = m_indexParse;
+				sl_bool flagView = sl_false;
+				if (sizePayload && posEnd - Base::interlockedAdd64(&m_posRead, 0) <= (sl_int64)(capacity / 2)) {
+					Ref<_SharedMemoryView> view = new _SharedMemoryView;
+					if (view.isNotNull()) {
+						Memory mem = Memory::createStatic(payload, sizePayload, view.get());
+						if (mem.isNotNull()) {
+							view->m_source = this;
+							view->m_index = index;
+							packet.data = mem;
+							flagView = sl_true;
+						}
+					}
+				}
+				if (!flagView && sizePayload) {
+					if (!(packet.data.copyFrom(payload, sizePayload, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM))) {
+						// leaves the record to the next call
+						return sl_false;
+					}
+				}
+				{
+					SpinLocker lock(&m_lockRelease);
+					m_records[index % m_countRecords] = (sl_uint32)(posEnd - m_posParse);
+					m_indexParse = index + 1;
+					Base::interlockedAdd64(&m_posParse, posEnd - m_posParse);
+				}
+				if (!flagView) {
+					release(index);
+				}
+				if (out) {
+					*out = packet;
+				}
+				return sl_true;
+			}
+			
+			void release(sl_uint64 index)
+			{
+				SpinLocker lock(&m_lockRelease);
+				m_records[index % m_countRecords] |= SHARED_MEMORY_RECORD_RELEASED;
+				sl_int64 pos = m_posRead;
+				// the records are returned in order
+				while (m_indexRead < m_indexParse) {
+					sl_uint32& entry = m_records[m_indexRead % m_countRecords];
+					if (!(entry & SHARED_MEMORY_RECORD_RELEASED)) {
+						break;
+					}
+					pos += entry & ~((sl_uint32)SHARED_MEMORY_RECORD_RELEASED);
+					entry = 0;
+					m_indexRead++;
+				}
+				if (pos != m_posRead) {
+					Base::interlockedAdd64(&(m_ring->m_header->posRead), pos - m_posRead);
+					Base::interlockedAdd64(&m_posRead, pos - m_posRead);
+				}
+			}
+			
+			static void run(Ref<_SharedMemoryRing> ring, WeakRef<_SharedMemorySourceImpl> wr)
+			{
+				_SharedMemoryHeader* header = ring->m_header;
+				while (!Thread::isStoppingCurrent()) {
+					Ref<_SharedMemorySourceImpl> object = wr;
+					if (object.isNull()) {
+						return;
+					}
+					sl_int32 sequence = Base::interlockedAdd32(&(header->wakeSequence), 0);
+					sl_bool flagWait = sl_true;
+					if (object->hasPacket()) {
+						if (Base::interlockedCompareExchange32(&(object->m_flagNotified), 1, 0)) {
+							object->notifyPacketReady();
+						}
+						// the graph is receiving, and raises the waiting flag when it finds the ring empty
+					} else {
+						Base::interlockedCompareExchange32(&(header->flagWaiting), 1, 0);
+						// checks again not to miss the record published before the flag is raised
+						flagWait = !(object->hasPacket());
+					}
+					object.setNull();
+					if (flagWait) {
+						ring->wait(sequence, SHARED_MEMORY_WAIT_TIMEOUT);
+					}
+				}
+			}
+			
+		};
+		
+		_SharedMemoryView::~_SharedMemoryView()
+		{
+			m_source->release(m_index);
+		}
+		
+#endif
+		
+		Ref<SharedMemorySink> SharedMemorySink::create(sl_uint32 capacity)
+		{
+#if defined(STREAMER_SHARED_MEMORY_SUPPORTED)
+			return Ref<SharedMemorySink>::from(_SharedMemorySinkImpl::create(_SharedMemoryRing::create(capacity)));
+#else
+			return sl_null;
+#endif
+		}
+		
+		Ref<SharedMemorySink> SharedMemorySink::open(sl_int32 handle)
+		{
+#if defined(STREAMER_SHARED_MEMORY_SUPPORTED)
+			return Ref<SharedMemorySink>::from(_SharedMemorySinkImpl::create(_SharedMemoryRing::open(handle)));
+#else
+			return sl_null;
+#endif
+		}
+		
+		Ref<SharedMemorySource> SharedMemorySource::create(sl_uint32 capacity)
+		{
+#if defined(STREAMER_SHARED_MEMORY_SUPPORTED)
+			return Ref<SharedMemorySource>::from(_SharedMemorySourceImpl::create(_SharedMemoryRing::create(capacity)));
+#else
+			return sl_null;
+#endif
+		}
+		
+		Ref<SharedMemorySource> SharedMemorySource::open(sl_int32 handle)
+		{
+#if defined(STREAMER_SHARED_MEMORY_SUPPORTED)
+			return Ref<SharedMemorySource>::from(_SharedMemorySourceImpl::create(_SharedMemoryRing::open(handle)));
+#else
+			return sl_null;
+#endif
+		}
+		
+	}
+	
+}
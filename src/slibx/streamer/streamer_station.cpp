@@ -0,0 +1,285 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#include "../../../inc/slibx/streamer/station.h"
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		class _StationSink : public Sink
+		{
+		public:
+			Ref<PacketQueue> queue;
+			WeakRef<Station> station;
+			
+			// accessed only by the dispatching thread
+			Packet head;
+			sl_bool flagHead;
+			
+		public:
+			_StationSink()
+			{
+				flagHead = sl_false;
+			}
+			
+		public:
+			// override
+			sl_bool sendPacket(const Packet& input)
+			{
+				sl_bool flagPushed;
+				if (input.timestamp == 0) {
+					Packet packet = input;
+					packet.timestamp = Packet::getCurrentTimestamp();
+					flagPushed = queue->push(packet);
+				} else {
+					flagPushed = queue->push(input);
+				}
+				Ref<Station> _station = station;
+				if (_station.isNotNull()) {
+					_station->notify();
+				}
+				return flagPushed;
+			}
+			
+		};
+		
+		class _StationSource : public Source
+		{
+		public:
+			Ref<PacketQueue> queue;
+			Ref<Event> event;
+			
+		public:
+			// override
+			Ref<Event> getEvent()
+			{
+				return event;
+			}
+			
+			// override
+			sl_bool receivePacket(Packet* out)
+			{
+				return queue->pop(out);
+			}
+			
+			// override
+			sl_bool isReadyListenerSupported()
+			{
+				return sl_true;
+			}
+			
+			void signal()
+			{
+				notifyPacketReady();
+			}
+			
+		};
+		
+		
+		SLIB_DEFINE_OBJECT(Station, Object)
+		
+		Station::Station()
+		{
+			setQueueSize(256);
+			setOverflowPolicy(PacketQueue::overflowDropOldest);
+			m_flagSignaled = 0;
+		}
+		
+		Station::~Station()
+		{
+			// the last reference may be released by the dispatching thread itself, so it is not waited here
+			if (m_thread.isNotNull()) {
+				m_thread->finish();
+				m_event->set();
+			}
+		}
+		
+		Ref<Station> Station::create()
+		{
+			Ref<Event> ev = Event::create();
+			if (ev.isNull()) {
+				return sl_null;
+			}
+			Ref<Station> ret = new Station;
+			if (ret.isNotNull()) {
+				ret->m_event = ev;
+				WeakRef<Station> station = ret;
+				ret->m_thread = Thread::start(Function<void()>::bind(&Station::run, ev, station));
+				if (ret->m_thread.isNotNull()) {
+					return ret;
+				}
+			}
+			return sl_null;
+		}
+		
+		Ref<Sink> Station::createSink()
+		{
+			Ref<PacketQueue> queue = PacketQueue::create(getQueueSize(), getOverflowPolicy());
+			if (queue.isNull()) {
+				return sl_null;
+			}
+			Ref<_StationSink> sink = new _StationSink;
+			if (sink.isNull()) {
+				return sl_null;
+			}
+			sink->queue = queue;
+			sink->station = this;
+			ObjectLocker lock(this);
+			m_sinks.add(sink);
+			ListLocker< Ref<_StationSink> > sinks(m_sinks);
+			Array< Ref<_StationSink> > snapshot = Array< Ref<_StationSink> >::create(sinks.data, sinks.count);
+			SpinLocker lockSnapshot(&m_lockSnapshot);
+			m_snapshotSinks = snapshot;
+			return Ref<Sink>::from(sink);
+		}
+		
+		void Station::removeSink(const Ref<Sink>& sink)
+		{
+			ObjectLocker lock(this);
+			Ref<_StationSink> _sink = Ref<_StationSink>::from(sink);
+			if (!(m_sinks.removeValue(_sink))) {
+				return;
+			}
+			_sink->queue->close();
+			ListLocker< Ref<_StationSink> > sinks(m_sinks);
+			Array< Ref<_StationSink> > snapshot = Array< Ref<_StationSink> >::create(sinks.data, sinks.count);
+			SpinLocker lockSnapshot(&m_lockSnapshot);
+			m_snapshotSinks = snapshot;
+		}
+		
+		Ref<Source> Station::createSource()
+		{
+			Ref<PacketQueue> queue = PacketQueue::create(getQueueSize(), getOverflowPolicy());
+			if (queue.isNull()) {
+				return sl_null;
+			}
+			Ref<Event> ev = Event::create();
+			if (ev.isNull()) {
+				return sl_null;
+			}
+			Ref<_StationSource> source = new _StationSource;
+			if (source.isNull()) {
+				return sl_null;
+			}
+			source->queue = queue;
+			source->event = ev;
+			ObjectLocker lock(this);
+			m_sources.add(source);
+			ListLocker< Ref<_StationSource> > sources(m_sources);
+			Array< Ref<_StationSource> > snapshot = Array< Ref<_StationSource> >::create(sources.data, sources.count);
+			SpinLocker lockSnapshot(&m_lockSnapshot);
+			m_snapshotSources = snapshot;
+			return Ref<Source>::from(source);
+		}
+		
+		void Station::removeSource(const Ref<Source>& source)
+		{
+			ObjectLocker lock(this);
+			Ref<_StationSource> _source = Ref<_StationSource>::from(source);
+			if (!(m_sources.removeValue(_source))) {
+				return;
+			}
+			_source->queue->close();
+			ListLocker< Ref<_StationSource> > sources(m_sources);
+			Array< Ref<_StationSource> > snapshot = Array< Ref<_StationSource> >::create(sources.data, sources.count);
+			SpinLocker lockSnapshot(&m_lockSnapshot);
+			m_snapshotSources = snapshot;
+		}
+		
+		void Station::release()
+		{
+			Ref<Thread> thread = m_thread;
+			if (thread.isNotNull()) {
+				thread->finish();
+				m_event->set();
+				thread->finishAndWait();
+				m_thread.setNull();
+			}
+			ObjectLocker lock(this);
+			m_sinks.removeAll();
+			m_sources.removeAll();
+			SpinLocker lockSnapshot(&m_lockSnapshot);
+			m_snapshotSinks.setNull();
+			m_snapshotSources.setNull();
+		}
+		
+		void Station::notify()
+		{
+			if (Base::interlockedCompareExchange32(&m_flagSignaled, 1, 0)) {
+				m_event->set();
+			}
+		}
+		
+		void Station::dispatch()
+		{
+			Array< Ref<_StationSink> > arrSinks;
+			Array< Ref<_StationSource> > arrSources;
+			{
+				SpinLocker lock(&m_lockSnapshot);
+				arrSinks = m_snapshotSinks;
+				arrSources = m_snapshotSources;
+			}
+			Ref<_StationSink>* sinks = arrSinks.getData();
+			sl_size nSinks = arrSinks.getCount();
+			Ref<_StationSource>* sources = arrSources.getData();
+			sl_size nSources = arrSources.getCount();
+			
+			sl_bool flagDispatched = sl_false;
+			for (;;) {
+				// picks the earliest packet among the heads of the inputs
+				_StationSink* earliest = sl_null;
+				for (sl_size i = 0; i < nSinks; i++) {
+					_StationSink* sink = sinks[i].get();
+					if (!(sink->flagHead)) {
+						sink->flagHead = sink->queue->pop(&(sink->head));
+					}
+					if (sink->flagHead) {
+						if (!earliest || sink->head.timestamp < earliest->head.timestamp) {
+							earliest = sink;
+						}
+					}
+				}
+				if (!earliest) {
+					break;
+				}
+				for (sl_size i = 0; i < nSources; i++) {
+					sources[i]->queue->push(earliest->head);
+				}
+				earliest->head = Packet();
+				earliest->flagHead = sl_false;
+				flagDispatched = sl_true;
+			}
+			if (flagDispatched) {
+				for (sl_size i = 0; i < nSources; i++) {
+					sources[i]->signal();
+				}
+			}
+		}
+		
+		void Station::run(Ref<Event> ev, WeakRef<Station> _station)
+		{
+			while (!Thread::isStoppingCurrent()) {
+				ev->wait(100);
+				Ref<Station> station = _station;
+				if (station.isNull()) {
+					return;
+				}
+				Base::interlockedCompareExchange32(&(station->m_flagSignaled), 0, 1);
+				station->dispatch();
+			}
+		}
+		
+	}
+	
+}
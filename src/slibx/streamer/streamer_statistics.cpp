@@ -0,0 +1,122 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#include "../../../inc/slibx/streamer/statistics.h"
+
+#define SUB_BITS SLIB_STREAMER_HISTOGRAM_SUB_BITS
+#define SUB_COUNT (1 << SUB_BITS)
+#define SUB_HALF (1 << (SUB_BITS - 1))
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		static sl_uint32 _LatencyHistogram_getMostSignificantBit(sl_uint64 value)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return 63 - (sl_uint32)(__builtin_clzll(value));
+#else
+			sl_uint32 n = 0;
+			while (value >>= 1) {
+				n++;
+			}
+			return n;
+#endif
+		}
+		
+		LatencyHistogram::LatencyHistogram()
+		{
+			reset();
+		}
+		
+		sl_uint32 LatencyHistogram::getBucketIndex(sl_uint64 value)
+		{
+			if (value < SUB_COUNT) {
+				return (sl_uint32)value;
+			}
+			if (value >> SLIB_STREAMER_HISTOGRAM_MAX_BITS) {
+				value = (((sl_uint64)1) << SLIB_STREAMER_HISTOGRAM_MAX_BITS) - 1;
+			}
+			sl_uint32 e = _LatencyHistogram_getMostSignificantBit(value) - SUB_BITS + 1;
+			return e * SUB_HALF + (sl_uint32)(value >> e);
+		}
+		
+		sl_uint64 LatencyHistogram::getBucketValue(sl_uint32 index)
+		{
+			if (index < SUB_COUNT) {
+				return index;
+			}
+			sl_uint32 e = (index >> (SUB_BITS - 1)) - 1;
+			return ((sl_uint64)(index - e * SUB_HALF)) << e;
+		}
+		
+		void LatencyHistogram::add(const LatencyHistogram& other)
+		{
+			for (sl_uint32 i = 0; i < SLIB_STREAMER_HISTOGRAM_BUCKETS; i++) {
+				counts[i] += other.counts[i];
+			}
+		}
+		
+		void LatencyHistogram::reset()
+		{
+			Base::zeroMemory(counts, sizeof(counts));
+		}
+		
+		sl_uint64 LatencyHistogram::getCount() const
+		{
+			sl_uint64 n = 0;
+			for (sl_uint32 i = 0; i < SLIB_STREAMER_HISTOGRAM_BUCKETS; i++) {
+				n += counts[i];
+			}
+			return n;
+		}
+		
+		sl_uint64 LatencyHistogram::getPercentile(double percent) const
+		{
+			sl_uint64 total = getCount();
+			if (total == 0) {
+				return 0;
+			}
+			if (percent < 0) {
+				percent = 0;
+			}
+			if (percent > 100) {
+				percent = 100;
+			}
+			sl_uint64 target = (sl_uint64)((double)total * percent / 100.0 + 0.5);
+			if (target < 1) {
+				target = 1;
+			}
+			sl_uint64 n = 0;
+			for (sl_uint32 i = 0; i < SLIB_STREAMER_HISTOGRAM_BUCKETS; i++) {
+				n += counts[i];
+				if (n >= target) {
+					return getBucketValue(i + 1) - 1;
+				}
+			}
+			return getMaximum();
+		}
+		
+		sl_uint64 LatencyHistogram::getMaximum() const
+		{
+			for (sl_uint32 i = SLIB_STREAMER_HISTOGRAM_BUCKETS; i > 0; i--) {
+				if (counts[i - 1]) {
+					return getBucketValue(i) - 1;
+				}
+			}
+			return 0;
+		}
+		
+	}
+	
+}
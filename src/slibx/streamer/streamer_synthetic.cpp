@@ -0,0 +1,487 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "../../../inc/slibx/streamer/synthetic.h"
+
+#include "../../../inc/slibx/streamer/queue.h"
+
+#include <slib/core/math.h>
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		SyntheticSourceParam::SyntheticSourceParam()
+		{
+			format = Packet::formatAudio_PCM_S16;
+			nSamplesPerSecond = 48000;
+			nChannels = 1;
+			nSamplesPerFrame = 960;
+			sizePacket = 200;
+			nPacketsPerSecond = 50;
+			nPackets = 0;
+			streamId = 0;
+		}
+		
+#define SYNTHETIC_TONE_FREQUENCY 440
+#define SYNTHETIC_TONE_AMPLITUDE 8000
+		
+		class _SyntheticSourceImpl : public SyntheticSource
+		{
+		public:
+			SyntheticSourceParam m_param;
+			Ref<Event> m_event;
+			Ref<Thread> m_thread;
+			sl_int64 m_timeStart;
+			sl_int64 m_period;
+			sl_int64 m_countGenerated;
+			// sine oscillator: y[n] = 2cos(w) * y[n - 1] - y[n - 2]
+			double m_oscCoefficient;
+			double m_osc1;
+			double m_osc2;
+			
+		public:
+			_SyntheticSourceImpl()
+			{
+				m_timeStart = 0;
+				m_period = 0;
+				m_countGenerated = 0;
+				m_oscCoefficient = 0;
+				m_osc1 = 0;
+				m_osc2 = 0;
+			}
+			
+			~_SyntheticSourceImpl()
+			{
+				if (m_thread.isNotNull()) {
+					m_thread->finish();
+				}
+			}
+			
+		public:
+			// override
+			Ref<Event> getEvent()
+			{
+				return m_event;
+			}
+			
+			// override
+			sl_bool isReadyListenerSupported()
+			{
+				// the generator without pacing is polled by GraphScheduler
+				return m_period != 0;
+			}
+			
+			// override
+			sl_uint64 getGeneratedCount()
+			{
+				return (sl_uint64)(Base::interlockedAdd64(&m_countGenerated, 0));
+			}
+			
+			// override
+			sl_bool isFinished()
+			{
+				return m_param.nPackets && getGeneratedCount() >= m_param.nPackets;
+			}
+			
+			// override
+			sl_bool receivePacket(Packet* out)
+			{
+				sl_uint64 index = (sl_uint64)m_countGenerated;
+				if (m_param.nPackets && index >= m_param.nPackets) {
+					return sl_false;
+				}
+				sl_int64 now = Packet::getCurrentTimestamp();
+				sl_int64 timestamp = now;
+				if (m_period) {
+					timestamp = m_timeStart + (sl_int64)index * m_period;
+					if (now < timestamp) {
+						return sl_false;
+					}
+				}
+				if (m_param.format == Packet::formatAudio_PCM_S16) {
+					sl_uint32 nChannels = m_param.nChannels;
+					sl_uint32 nFrames = m_param.nSamplesPerFrame;
+					if (!(out->data.allocate(nFrames * nChannels * 2, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM))) {
+						return sl_false;
+					}
+					sl_int16* samples = (sl_int16*)(out->data.getData());
+					for (sl_uint32 i = 0; i < nFrames; i++) {
+						double y = m_oscCoefficient * m_osc1 - m_osc2;
+						m_osc2 = m_osc1;
+						m_osc1 = y;
+						sl_int16 v = (sl_int16)(y * SYNTHETIC_TONE_AMPLITUDE);
+						for (sl_uint32 k = 0; k < nChannels; k++) {
+							*(samples++) = v;
+						}
+					}
+					out->audioParam.nChannels = nChannels;
+					out->audioParam.nSamplesPerSecond = m_param.nSamplesPerSecond;
+				} else {
+					sl_uint32 size = m_param.sizePacket;
+					if (!(out->data.allocate(size, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM))) {
+						return sl_false;
+					}
+					sl_uint8* p = (sl_uint8*)(out->data.getData());
+					for (sl_uint32 i = 0; i < size; i++) {
+						p[i] = (sl_uint8)(index + i);
+					}
+				}
+				out->format = m_param.format;
+				out->timestamp = timestamp;
+				out->flags = Packet::flagSequence;
+				out->sequence = index;
+				out->streamId = m_param.streamId;
+				Base::interlockedIncrement64(&m_countGenerated);
+				return sl_true;
+			}
+			
+			static void run(WeakRef<_SyntheticSourceImpl> wr, sl_int64 timeStart, sl_int64 period)
+			{
+				sl_int64 index = 0;
+				while (!Thread::isStoppingCurrent()) {
+					sl_int64 due = timeStart + index * period;
+					sl_int64 now = Packet::getCurrentTimestamp();
+					if (now < due) {
+						Thread::sleep((sl_uint32)((due - now + 999999) / 1000000));
+						continue;
+					}
+					Ref<_SyntheticSourceImpl> object = wr;
+					if (object.isNull() || object->isFinished()) {
+						return;
+					}
+					object->notifyPacketReady();
+					index++;
+				}
+			}
+			
+		};
+		
+		Ref<SyntheticSource> SyntheticSource::create(const SyntheticSourceParam& param)
+		{
+			if (param.format == Packet::formatAudio_PCM_S16) {
+				if (!(param.nSamplesPerSecond) || !(param.nChannels) || !(param.nSamplesPerFrame)) {
+					return sl_null;
+				}
+			}
+			Ref<_SyntheticSourceImpl> ret = new _SyntheticSourceImpl;
+			if (ret.isNull()) {
+				return sl_null;
+			}
+			ret->m_param = param;
+			ret->m_event = Event::create();
+			if (ret->m_event.isNull()) {
+				return sl_null;
+			}
+			if (param.nSamplesPerSecond) {
+				double w = 2 * 3.14159265358979323846 * SYNTHETIC_TONE_FREQUENCY / param.nSamplesPerSecond;
+				ret->m_oscCoefficient = 2 * Math::cos(w);
+				ret->m_osc1 = 0;
+				ret->m_osc2 = -(Math::sin(w));
+			}
+			ret->m_timeStart = Packet::getCurrentTimestamp();
+			if (param.nPacketsPerSecond) {
+				ret->m_period = 1000000000 / param.nPacketsPerSecond;
+				WeakRef<_SyntheticSourceImpl> wr = ret;
+				ret->m_thread = Thread::start(Function<void()>::bind(&_SyntheticSourceImpl::run, wr, ret->m_timeStart, ret->m_period));
+				if (ret->m_thread.isNull()) {
+					return sl_null;
+				}
+			} else {
+				ret->m_event->set();
+			}
+			return Ref<SyntheticSource>::from(ret);
+		}
+		
+		
+		class _LoopbackSource : public Source
+		{
+		public:
+			Ref<PacketQueue> queue;
+			Ref<Event> event;
+			
+		public:
+			// override
+			Ref<Event> getEvent()
+			{
+				return event;
+			}
+			
+			// override
+			sl_bool receivePacket(Packet* out)
+			{
+				return queue->pop(out);
+			}
+			
+			// override
+			sl_bool isReadyListenerSupported()
+			{
+				return sl_true;
+			}
+			
+			void signal()
+			{
+				notifyPacketReady();
+			}
+			
+		};
+		
+		LoopbackSink::LoopbackSink()
+		{
+			resetStatistics();
+		}
+		
+		LoopbackSink::~LoopbackSink()
+		{
+		}
+		
+		Ref<LoopbackSink> LoopbackSink::create(sl_uint32 queueSize)
+		{
+			Ref<LoopbackSink> ret = new LoopbackSink;
+			if (ret.isNull()) {
+				return sl_null;
+			}
+			if (queueSize) {
+				Ref<_LoopbackSource> source = new _LoopbackSource;
+				if (source.isNull()) {
+					return sl_null;
+				}
+				source->queue = PacketQueue::create(queueSize, PacketQueue::overflowDropOldest);
+				source->event = Event::create();
+				if (source->queue.isNull() || source->event.isNull()) {
+					return sl_null;
+				}
+				ret->m_source = Ref<Source>::from(source);
+			}
+			return ret;
+		}
+		
+		sl_bool LoopbackSink::sendPacket(const Packet& packet)
+		{
+			sl_int64 now = Packet::getCurrentTimestamp();
+			{
+				SpinLocker lock(&m_lock);
+				LoopbackSinkStatistics& s = m_statistics;
+				s.countPackets++;
+				s.sizeBytes += packet.data.getSize();
+				if (packet.timestamp && now >= packet.timestamp) {
+					s.age.add((sl_uint64)(now - packet.timestamp));
+				}
+				if (packet.flags & Packet::flagSequence) {
+					sl_uint64 sequence = packet.sequence;
+					if (!m_flagSequence) {
+						m_flagSequence = sl_true;
+						m_sequenceNext = sequence + 1;
+						m_maskReceived = 1;
+					} else if (sequence >= m_sequenceNext) {
+						sl_uint64 shift = sequence - m_sequenceNext + 1;
+						s.countLost += shift - 1;
+						m_maskReceived = (shift >= 64 ? 0 : (m_maskReceived << shift)) | 1;
+						m_sequenceNext = sequence + 1;
+					} else {
+						sl_uint64 distance = m_sequenceNext - 1 - sequence;
+						if (distance < 64 && (m_maskReceived & ((sl_uint64)1 << distance))) {
+							s.countDuplicated++;
+						} else {
+							if (distance < 64) {
+								m_maskReceived |= (sl_uint64)1 << distance;
+							}
+							// counted as lost when the gap was found
+							s.countReordered++;
+							if (s.countLost) {
+								s.countLost--;
+							}
+						}
+					}
+				}
+			}
+			_LoopbackSource* source = (_LoopbackSource*)(m_source.get());
+			if (source) {
+				sl_bool flagPushed = source->queue->push(packet);
+				source->signal();
+				return flagPushed;
+			}
+			return sl_true;
+		}
+		
+		Ref<Source> LoopbackSink::getSource()
+		{
+			return m_source;
+		}
+		
+		void LoopbackSink::getStatistics(LoopbackSinkStatistics& _out)
+		{
+			SpinLocker lock(&m_lock);
+			_out = m_statistics;
+		}
+		
+		void LoopbackSink::resetStatistics()
+		{
+			SpinLocker lock(&m_lock);
+			m_statistics.countPackets = 0;
+			m_statistics.sizeBytes = 0;
+			m_statistics.countLost = 0;
+			m_statistics.countReordered = 0;
+			m_statistics.countDuplicated = 0;
+			m_statistics.age.reset();
+			m_flagSequence = sl_false;
+			m_sequenceNext = 0;
+			m_maskReceived = 0;
+		}
+		
+		
+		NetworkImpairmentFilter::NetworkImpairmentFilter(sl_uint32 seed)
+		{
+			setLossRate(0);
+			setMeanBurstLength(1);
+			setDuplicateRate(0);
+			setMaxDelay(0);
+			setKeepOrder(sl_false);
+			// xorshift needs a non-zero state
+			m_random = ((sl_uint64)seed << 32) | 0x9E3779B9;
+			m_flagBurst = sl_false;
+			m_countLost = 0;
+			m_countDuplicated = 0;
+			m_timeLastRelease = 0;
+			m_nHeld = 0;
+		}
+		
+		NetworkImpairmentFilter::~NetworkImpairmentFilter()
+		{
+		}
+		
+		float NetworkImpairmentFilter::random()
+		{
+			sl_uint64 x = m_random;
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+			m_random = x;
+			return (float)(x >> 40) * (1.0f / 16777216.0f);
+		}
+		
+		void NetworkImpairmentFilter::filter(const Packet& input, PacketEmitter& emitter)
+		{
+			sl_int64 now = Packet::getCurrentTimestamp();
+			release(now, emitter);
+			
+			float rate = getLossRate();
+			if (rate > 0) {
+				float burst = getMeanBurstLength();
+				if (burst < 1) {
+					burst = 1;
+				}
+				// two-state Markov chain staying in the loss state for `burst` packets on average, and in it for `rate` of the time
+				if (m_flagBurst) {
+					if (random() < 1 / burst) {
+						m_flagBurst = sl_false;
+					}
+				} else {
+					if (rate >= 1 || random() < rate / (burst * (1 - rate))) {
+						m_flagBurst = sl_true;
+					}
+				}
+				if (m_flagBurst) {
+					m_countLost++;
+					return;
+				}
+			} else {
+				m_flagBurst = sl_false;
+			}
+			
+			sl_uint32 nCopies = 1;
+			if (getDuplicateRate() > 0 && random() < getDuplicateRate()) {
+				nCopies = 2;
+				m_countDuplicated++;
+			}
+			sl_uint32 maxDelay = getMaxDelay();
+			for (sl_uint32 i = 0; i < nCopies; i++) {
+				sl_int64 timeRelease = now;
+				if (maxDelay) {
+					timeRelease += (sl_int64)(random() * maxDelay) * 1000;
+				}
+				if (getKeepOrder() && timeRelease < m_timeLastRelease) {
+					timeRelease = m_timeLastRelease;
+				}
+				m_timeLastRelease = timeRelease;
+				if (timeRelease <= now) {
+					emitter.emit(input);
+				} else {
+					hold(input, timeRelease, emitter);
+				}
+			}
+		}
+		
+		void NetworkImpairmentFilter::flush(PacketEmitter& emitter)
+		{
+			for (sl_uint32 i = 0; i < m_nHeld; i++) {
+				emitter.emit(m_held[i].packet);
+				m_held[i].packet = Packet();
+			}
+			m_nHeld = 0;
+		}
+		
+		sl_uint64 NetworkImpairmentFilter::getLostCount()
+		{
+			return m_countLost;
+		}
+		
+		sl_uint64 NetworkImpairmentFilter::getDuplicatedCount()
+		{
+			return m_countDuplicated;
+		}
+		
+		void NetworkImpairmentFilter::hold(const Packet& packet, sl_int64 timeRelease, PacketEmitter& emitter)
+		{
+			if (m_nHeld == SLIB_STREAMER_IMPAIRMENT_MAX_HELD) {
+				// releases the earliest packet before its time
+				emitter.emit(m_held[0].packet);
+				for (sl_uint32 i = 1; i < m_nHeld; i++) {
+					m_held[i - 1].timeRelease = m_held[i].timeRelease;
+					m_held[i - 1].packet = m_held[i].packet;
+				}
+				m_nHeld--;
+			}
+			sl_uint32 pos = m_nHeld;
+			while (pos > 0 && m_held[pos - 1].timeRelease > timeRelease) {
+				m_held[pos].timeRelease = m_held[pos - 1].timeRelease;
+				m_held[pos].packet = m_held[pos - 1].packet;
+				pos--;
+			}
+			m_held[pos].timeRelease = timeRelease;
+			m_held[pos].packet = packet;
+			m_nHeld++;
+		}
+		
+		void NetworkImpairmentFilter::release(sl_int64 now, PacketEmitter& emitter)
+		{
+			sl_uint32 n = 0;
+			while (n < m_nHeld && m_held[n].timeRelease <= now) {
+				emitter.emit(m_held[n].packet);
+				n++;
+			}
+			if (!n) {
+				return;
+			}
+			for (sl_uint32 i = n; i < m_nHeld; i++) {
+				m_held[i - n].timeRelease = m_held[i].timeRelease;
+				m_held[i - n].packet = m_held[i].packet;
+			}
+			for (sl_uint32 i = m_nHeld - n; i < m_nHeld; i++) {
+				m_held[i].packet = Packet();
+			}
+			m_nHeld -= n;
+		}
+		
+	}
+	
+}
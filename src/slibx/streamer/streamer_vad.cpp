@@ -0,0 +1,159 @@
+/*
+ *  Copyright (c) 2008-2017 SLIBIO. All Rights Reserved.
+ *
+ *  This file is part of the SLib.io project.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this
+ *  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+
+#include "../../../inc/slibx/streamer/vad.h"
+
+#include "../../../inc/slibx/streamer/pcm.h"
+
+#include <slib/core/math.h>
+
+// zero crossings of a tone over this frequency (Hz) tell the unvoiced consonants
+#define VAD_UNVOICED_FREQUENCY 3000
+
+namespace slib
+{
+	
+	namespace streamer
+	{
+		
+		void VoiceActivityFilter::filter(const Packet& input, PacketEmitter& emitter)
+		{
+			sl_uint32 nChannels = input.audioParam.nChannels;
+			sl_uint32 nSamplesPerSecond = input.audioParam.nSamplesPerSecond;
+			sl_size count = input.data.getSize() / 2;
+			if (input.format != Packet::formatAudio_PCM_S16 || !count || !nChannels || !nSamplesPerSecond) {
+				emitter.emit(input);
+				return;
+			}
+			const sl_int16* samples = (const sl_int16*)(input.data.getData());
+			// the adjacent samples of the interleaved channels are not comparable
+			sl_size nCrossings = 0;
+			double energy = (double)(PcmKernels::getEnergy(samples, count, nChannels == 1 ? &nCrossings : sl_null)) / (double)count;
+			sl_int32 duration = (sl_int32)((sl_uint64)(count / nChannels) * 1000 / nSamplesPerSecond);
+			
+			if (!m_flagStarted) {
+				m_flagStarted = sl_true;
+				m_noise = energy;
+			}
+			if (m_noise < 1.0) {
+				m_noise = 1.0;
+			}
+			double ratio = Math::pow(10.0, getThreshold() / 10.0);
+			double levelMin = 32768.0 * Math::pow(10.0, getMinLevel() / 20.0);
+			levelMin *= levelMin;
+			
+			sl_bool flagActive = sl_false;
+			if (energy > levelMin) {
+				if (energy > m_noise * ratio) {
+					flagActive = sl_true;
+				} else if ((double)nCrossings * nSamplesPerSecond > 2.0 * VAD_UNVOICED_FREQUENCY * count && energy > m_noise * Math::sqrt(ratio)) {
+					flagActive = sl_true;
+				}
+			}
+			
+			// the floor falls quickly to the pauses, and rises slowly to the louder background
+			if (energy < m_noise) {
+				m_noise = m_noise * 0.8 + energy * 0.2;
+			} else if (flagActive) {
+				m_noise *= 1.0 + 0.0001 * duration;
+			} else {
+				m_noise *= 1.0 + 0.001 * duration;
+			}
+			
+			if (flagActive) {
+				m_hangover = (sl_int32)(getHangover());
+			} else if (m_hangover > 0) {
+				m_hangover -= duration;
+				flagActive = sl_true;
+			}
+			m_flagActive = flagActive;
+			
+			if (flagActive) {
+				if (input.flags & Packet::flagSilence) {
+					Packet output = input;
+					output.flags &= ~((sl_uint32)(Packet::flagSilence));
+					emitter.emit(output);
+				} else {
+					emitter.emit(input);
+				}
+			} else {
+				Packet output = input;
+				output.flags |= Packet::flagSilence;
+				emitter.emit(output);
+			}
+		}
+		
+		void ComfortNoiseFilter::filter(const Packet& input, PacketEmitter& emitter)
+		{
+			if (input.format != Packet::formatAudio_PCM_S16) {
+				emitter.emit(input);
+				return;
+			}
+			sl_uint32 count = (sl_uint32)(input.data.getSize() / 2);
+			if (count) {
+				m_nSamplesLastFrame = count;
+				if (input.flags & Packet::flagSilence) {
+					float level = (float)(Math::sqrt((double)(PcmKernels::getEnergy((const sl_int16*)(input.data.getData()), count)) / count));
+					if (m_level > 0) {
+						m_level = (m_level + level) * 0.5f;
+					} else {
+						m_level = level;
+					}
+				}
+				emitter.emit(input);
+				return;
+			}
+			// the lost frames are left to the concealment
+			if (!(input.flags & Packet::flagSilence) || !m_nSamplesLastFrame) {
+				emitter.emit(input);
+				return;
+			}
+			
+			count = m_nSamplesLastFrame;
+			Packet output;
+			output.format = Packet::formatAudio_PCM_S16;
+			output.audioParam = input.audioParam;
+			output.copyMetadata(input);
+			output.timestamp = 0;
+			output.flags |= Packet::flagConcealed;
+			if (!(output.data.allocate(count * 2, SLIB_STREAMER_PACKET_HEADROOM, SLIB_STREAMER_PACKET_TAILROOM))) {
+				return;
+			}
+			sl_int16* samples = (sl_int16*)(output.data.getData());
+			float level = m_level;
+			if (level > (float)(getMaxLevel())) {
+				level = (float)(getMaxLevel());
+			}
+			// the uniform noise in [-a, a] has the RMS of a / sqrt(3)
+			sl_uint32 amplitude = (sl_uint32)(level * 1.7320508f);
+			if (amplitude > 32767) {
+				amplitude = 32767;
+			}
+			if (amplitude) {
+				sl_uint64 range = 2 * (sl_uint64)amplitude + 1;
+				sl_uint32 x = m_seed;
+				for (sl_uint32 i = 0; i < count; i++) {
+					// xorshift32
+					x ^= x << 13;
+					x ^= x >> 17;
+					x ^= x << 5;
+					samples[i] = (sl_int16)((sl_int32)((x * range) >> 32) - (sl_int32)amplitude);
+				}
+				m_seed = x;
+			} else {
+				Base::zeroMemory(samples, count * 2);
+			}
+			emitter.emit(output);
+		}
+		
+	}
+	
+}